@@ -0,0 +1,186 @@
+#include "Calibration.h"
+#include "DofRegistry.h"
+#include "Hand.h"
+
+
+static uint32_t calibrationSequence = 0;
+static int calibrationSlot = -1;
+static CalibrationResult loadResult = CALIBRATION_EMPTY;
+
+static inline void putInt16(uint8_t* data, int16_t value) {
+  data[0] = static_cast<uint8_t>(value);
+  data[1] = static_cast<uint8_t>(static_cast<uint16_t>(value) >> 8);
+}
+
+static inline int16_t getInt16(const uint8_t* data) {
+  return static_cast<int16_t>(data[0] | (data[1] << 8));
+}
+
+static inline uint32_t getUint32(const uint8_t* data) {
+  return static_cast<uint32_t>(data[0]) | (static_cast<uint32_t>(data[1]) << 8) |
+    (static_cast<uint32_t>(data[2]) << 16) | (static_cast<uint32_t>(data[3]) << 24);
+}
+
+static inline bool isServoLimit(uint8_t position) {
+  // As ManagedServo takes them
+  return position > 0 && position < 180;
+}
+
+
+size_t encodeCalibration(uint8_t* blob, uint32_t sequence) {
+  size_t length = 0;
+  putInt16(blob, static_cast<int16_t>(CALIBRATION_MAGIC));
+  length += 2;
+  blob[length++] = CALIBRATION_VERSION;
+  blob[length++] = NUM_SERVOS;
+  blob[length++] = DOF_COUNT;
+  blob[length++] = NUM_FINGERS;
+  for (int i = 0; i < 4; i++) {
+    blob[length++] = static_cast<uint8_t>(sequence >> (8 * i));
+  }
+
+  for (const ManagedServo& servo : managedServos) {
+    blob[length++] = servo.getMinPosition();
+    blob[length++] = servo.getMaxPosition();
+    blob[length++] = servo.getDefaultPosition();
+  }
+  for (const DofInfo& dof : DOF_REGISTRY) {
+    int16_t min, max;
+    dof.getRange(min, max);
+    putInt16(blob + length, min);
+    putInt16(blob + length + 2, max);
+    length += 4;
+  }
+  for (const Finger& finger : fingers) {
+    putInt16(blob + length, finger.getYawBias());
+    length += 2;
+  }
+
+  putInt16(blob + length, static_cast<int16_t>(crc16(blob, length)));
+  length += 2;
+  return length;
+}
+
+CalibrationResult decodeCalibration(const uint8_t* blob, size_t length, bool apply) {
+  if (length < CALIBRATION_LENGTH || static_cast<uint16_t>(getInt16(blob)) != CALIBRATION_MAGIC) {
+    return CALIBRATION_EMPTY;
+  }
+  if (static_cast<uint16_t>(getInt16(blob + CALIBRATION_LENGTH - 2)) != crc16(blob, CALIBRATION_LENGTH - 2)) {
+    return CALIBRATION_BAD_CHECKSUM;
+  }
+  if (blob[2] != CALIBRATION_VERSION || blob[3] != NUM_SERVOS || blob[4] != DOF_COUNT || blob[5] != NUM_FINGERS) {
+    return CALIBRATION_BAD_FORMAT;
+  }
+
+  // Everything is checked before anything is applied
+  const uint8_t* servos = blob + CALIBRATION_HEADER_LENGTH;
+  const uint8_t* ranges = servos + 3 * NUM_SERVOS;
+  const uint8_t* biases = ranges + 4 * DOF_COUNT;
+  for (int servo = 0; servo < NUM_SERVOS; servo++) {
+    const uint8_t* entry = servos + 3 * servo;
+    if (!isServoLimit(entry[0]) || !isServoLimit(entry[1]) || entry[0] >= entry[1] || entry[2] > 180) {
+      return CALIBRATION_BAD_FORMAT;
+    }
+  }
+  for (int dof = 0; dof < DOF_COUNT; dof++) {
+    if (getInt16(ranges + 4 * dof) >= getInt16(ranges + 4 * dof + 2)) {
+      return CALIBRATION_BAD_FORMAT;
+    }
+  }
+  if (!apply) {
+    return CALIBRATION_OK;
+  }
+
+  for (int servo = 0; servo < NUM_SERVOS; servo++) {
+    const uint8_t* entry = servos + 3 * servo;
+    managedServos[servo].setMinPosition(entry[0]);
+    managedServos[servo].setMaxPosition(entry[1]);
+    managedServos[servo].setDefaultPosition(entry[2]);
+  }
+  for (int dof = 0; dof < DOF_COUNT; dof++) {
+    DOF_REGISTRY[dof].setRange(getInt16(ranges + 4 * dof), getInt16(ranges + 4 * dof + 2));
+  }
+  for (int finger = 0; finger < NUM_FINGERS; finger++) {
+    fingers[finger].setYawBias(getInt16(biases + 2 * finger));
+  }
+  return CALIBRATION_OK;
+}
+
+CalibrationResult loadCalibration(CalibrationStorage& storage) {
+  uint8_t blobs[CALIBRATION_SLOTS][CALIBRATION_LENGTH];
+
+  // The newest good slot. Sequence numbers are compared as a difference, so
+  // they can wrap.
+  int newest = -1;
+  loadResult = CALIBRATION_EMPTY;
+  for (int slot = 0; slot < CALIBRATION_SLOTS; slot++) {
+    if (!storage.read(static_cast<uint8_t>(slot), blobs[slot], CALIBRATION_LENGTH)) {
+      continue;
+    }
+    CalibrationResult result = decodeCalibration(blobs[slot], CALIBRATION_LENGTH, false);
+    if (result != CALIBRATION_OK) {
+      // A damaged slot is worth knowing about, an empty one isn't
+      if (loadResult == CALIBRATION_EMPTY) {
+        loadResult = result;
+      }
+      continue;
+    }
+    if (newest < 0 || static_cast<int32_t>(getUint32(blobs[slot] + 6) - getUint32(blobs[newest] + 6)) > 0) {
+      newest = slot;
+    }
+  }
+  if (newest < 0) {
+    return loadResult;
+  }
+
+  decodeCalibration(blobs[newest], CALIBRATION_LENGTH, true);
+  calibrationSequence = getUint32(blobs[newest] + 6);
+  calibrationSlot = newest;
+  loadResult = CALIBRATION_OK;
+  return loadResult;
+}
+
+CalibrationResult saveCalibration(CalibrationStorage& storage) {
+  uint8_t blob[CALIBRATION_LENGTH];
+  uint32_t sequence = calibrationSlot < 0 ? 1 : calibrationSequence + 1;
+  int slot = calibrationSlot < 0 ? 0 : (calibrationSlot + 1) % CALIBRATION_SLOTS;
+  size_t length = encodeCalibration(blob, sequence);
+
+  // The other slot still has the last calibration if this doesn't take
+  if (!storage.write(static_cast<uint8_t>(slot), blob, length)) {
+    return CALIBRATION_WRITE_FAILED;
+  }
+  calibrationSequence = sequence;
+  calibrationSlot = slot;
+  return CALIBRATION_OK;
+}
+
+void setRestPositions() {
+  for (ManagedServo& servo : managedServos) {
+    servo.setDefaultPosition(servo.getServoPosition());
+  }
+}
+
+void restoreDefaultCalibration() {
+  for (int servo = 0; servo < NUM_SERVOS; servo++) {
+    managedServos[servo].setMinPosition(SERVO_CONFIG[servo].minPosition);
+    managedServos[servo].setMaxPosition(SERVO_CONFIG[servo].maxPosition);
+    managedServos[servo].setDefaultPosition(SERVO_CONFIG[servo].defaultPosition);
+  }
+  applyDofRanges();
+  for (Finger& finger : fingers) {
+    finger.setYawBias(FINGER_YAW_BIAS);
+  }
+}
+
+uint32_t getCalibrationSequence() {
+  return calibrationSequence;
+}
+
+int getCalibrationSlot() {
+  return calibrationSlot;
+}
+
+CalibrationResult getCalibrationLoadResult() {
+  return loadResult;
+}
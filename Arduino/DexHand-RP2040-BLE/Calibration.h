@@ -0,0 +1,90 @@
+#ifndef CALIBRATION_H
+#define CALIBRATION_H
+
+/*
+Calibration
+
+Everything that's tuned to a particular hand, kept in flash so it survives
+a reboot: each servo's limits and rest position, each DOF's range, and each
+finger's yaw bias. The compiled in values in HandConfig.h and the DOF
+registry are the defaults until something has been saved.
+
+The calibration is a compact blob, little endian throughout:
+
+  0-1    CALIBRATION_MAGIC
+  2      CALIBRATION_VERSION
+  3      Number of servos
+  4      Number of DOFs
+  5      Number of fingers
+  6-9    Sequence number, one more on each save
+  Then for each servo, in managedServos[] order:
+  0      Minimum position
+  1      Maximum position
+  2      Rest position, where it starts at boot
+  Then for each DOF, in wire order:
+  0-1    Minimum angle in degrees, int16
+  2-3    Maximum angle in degrees, int16
+  Then for each finger:
+  0-1    Yaw bias, int16
+  Last   CRC-16/CCITT-FALSE of everything before it, uint16
+
+A blob from a build with a different version or layout is ignored rather
+than half applied.
+
+Saves alternate between the backend's two slots (see CalibrationStorage.h),
+and loading takes the valid slot with the newer sequence number. A save cut
+short by a reset leaves a slot that fails its CRC, and the one before it is
+used - so a save either happens completely or not at all.
+
+The blob is loaded before the servos start (see startServos()), so they
+come up at their rest positions straight away.
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "CalibrationStorage.h"
+#include "DofProtocol.h"
+#include "HandConfig.h"
+
+#define CALIBRATION_MAGIC         0x4844      // "DH"
+#define CALIBRATION_VERSION       1
+#define CALIBRATION_HEADER_LENGTH 10
+#define CALIBRATION_LENGTH        (CALIBRATION_HEADER_LENGTH + 3 * NUM_SERVOS + 4 * DOF_COUNT + 2 * NUM_FINGERS + 2)
+
+static_assert(CALIBRATION_LENGTH <= CALIBRATION_SLOT_SIZE, "The calibration doesn't fit a storage slot");
+
+enum CalibrationResult {
+  CALIBRATION_OK,
+  CALIBRATION_EMPTY,          // Nothing saved yet, or not readable
+  CALIBRATION_BAD_CHECKSUM,
+  CALIBRATION_BAD_FORMAT,     // Another version or layout, or values out of range
+  CALIBRATION_WRITE_FAILED
+};
+
+// Packs the current calibration. Returns the length.
+size_t encodeCalibration(uint8_t* blob, uint32_t sequence);
+
+// Checks a blob, and applies it if it's good
+CalibrationResult decodeCalibration(const uint8_t* blob, size_t length, bool apply);
+
+// Applies the newest good calibration in storage. With nothing usable, the
+// hand keeps the values it has.
+CalibrationResult loadCalibration(CalibrationStorage& storage);
+
+// Writes the current calibration to the slot after the one last used
+CalibrationResult saveCalibration(CalibrationStorage& storage);
+
+// Makes each servo's current position its rest position, for saving
+void setRestPositions();
+
+// Back to the compiled in values. Saved calibrations are kept.
+void restoreDefaultCalibration();
+
+// What was last loaded or saved. The slot is -1 if neither has happened.
+uint32_t getCalibrationSequence();
+int getCalibrationSlot();
+CalibrationResult getCalibrationLoadResult();
+
+
+#endif
@@ -0,0 +1,51 @@
+#include "CalibrationStorage.h"
+#include "ControlCore.h"
+
+#include <Arduino.h>
+#include <string.h>
+
+#include "hardware/flash.h"
+#include "hardware/sync.h"
+
+static_assert(CALIBRATION_SLOT_SIZE % FLASH_PAGE_SIZE == 0, "Slots are programmed a page at a time");
+static_assert(CALIBRATION_FLASH_OFFSET % FLASH_SECTOR_SIZE == 0, "Slots start on a sector");
+
+static inline uint32_t slotOffset(uint8_t slot) {
+    return CALIBRATION_FLASH_OFFSET + slot * FLASH_SECTOR_SIZE;
+}
+
+
+bool FlashCalibrationStorage::read(uint8_t slot, uint8_t* data, size_t length) {
+    if (slot >= CALIBRATION_SLOTS || length > CALIBRATION_SLOT_SIZE) {
+        return false;
+    }
+
+    // Flash is memory mapped through the XIP cache
+    memcpy(data, reinterpret_cast<const uint8_t*>(XIP_BASE + slotOffset(slot)), length);
+    return true;
+}
+
+bool FlashCalibrationStorage::write(uint8_t slot, const uint8_t* data, size_t length) {
+    if (slot >= CALIBRATION_SLOTS || length > CALIBRATION_SLOT_SIZE) {
+        return false;
+    }
+
+    // Whole pages only, padded as erased flash
+    static uint8_t page[CALIBRATION_SLOT_SIZE];
+    memset(page, 0xFF, sizeof(page));
+    memcpy(page, data, length);
+
+#if DUAL_CORE_CONTROL
+    rp2040.idleOtherCore();
+#endif
+    uint32_t interrupts = save_and_disable_interrupts();
+    flash_range_erase(slotOffset(slot), FLASH_SECTOR_SIZE);
+    flash_range_program(slotOffset(slot), page, sizeof(page));
+    restore_interrupts(interrupts);
+#if DUAL_CORE_CONTROL
+    rp2040.resumeOtherCore();
+#endif
+
+    // Check it took
+    return memcmp(reinterpret_cast<const uint8_t*>(XIP_BASE + slotOffset(slot)), page, sizeof(page)) == 0;
+}
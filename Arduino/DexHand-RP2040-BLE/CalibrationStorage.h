@@ -0,0 +1,66 @@
+#ifndef CALIBRATION_STORAGE_H
+#define CALIBRATION_STORAGE_H
+
+/*
+Calibration Storage Definition
+
+Where the calibration blob is kept (see Calibration.h). A backend has two
+slots, each big enough for one blob, and only ever has to read or replace a
+whole slot. Calibration.cpp takes care of writing the slots in turn so a
+save is atomic, and the backend doesn't need to know anything about the
+blob.
+
+FlashCalibrationStorage keeps the slots in two sectors of the RP2040's
+flash, at CALIBRATION_FLASH_OFFSET from its start. The host build swaps in
+a file backed stand-in (see Host/sim/FileCalibrationStorage.h).
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define CALIBRATION_SLOTS         2
+#define CALIBRATION_SLOT_SIZE     256     // One flash page
+
+class CalibrationStorage {
+
+    public:
+        virtual ~CalibrationStorage() {}
+
+        // Reads the first length bytes of a slot. Returns false if the slot
+        // can't be read.
+        virtual bool read(uint8_t slot, uint8_t* data, size_t length) = 0;
+
+        // Replaces the slot's contents with length bytes, no more than
+        // CALIBRATION_SLOT_SIZE. Returns false if it didn't work.
+        virtual bool write(uint8_t slot, const uint8_t* data, size_t length) = 0;
+};
+
+#if !defined(DEXHAND_HOST_BUILD)
+
+// Two sectors, clear of the last ones that arduino-pico's EEPROM and file
+// system use. Move them if the sketch has anything else in flash up there.
+#ifndef CALIBRATION_FLASH_SIZE
+#define CALIBRATION_FLASH_SIZE    (16 * 1024 * 1024)      // Nano RP2040 Connect
+#endif
+#ifndef CALIBRATION_FLASH_OFFSET
+#define CALIBRATION_FLASH_OFFSET  (CALIBRATION_FLASH_SIZE - 4 * 4096)
+#endif
+
+class FlashCalibrationStorage : public CalibrationStorage {
+
+    public:
+        constexpr FlashCalibrationStorage() {
+        }
+
+        bool read(uint8_t slot, uint8_t* data, size_t length) override;
+
+        // Erases the slot's sector and programs it, with interrupts off and,
+        // with DUAL_CORE_CONTROL, the other core parked, as neither can run
+        // from flash meanwhile. Takes a few tens of ms.
+        bool write(uint8_t slot, const uint8_t* data, size_t length) override;
+};
+
+#endif
+
+
+#endif
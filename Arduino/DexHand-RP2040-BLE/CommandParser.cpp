@@ -0,0 +1,142 @@
+#include "CommandParser.h"
+
+
+// Same as String::toInt(): leading sign and digits, 0 if there are none
+static int32_t parseNumber(const char* text) {
+    while (*text == ' ') {
+        text++;
+    }
+
+    bool negative = *text == '-';
+    if (*text == '-' || *text == '+') {
+        text++;
+    }
+
+    int32_t value = 0;
+    while (*text >= '0' && *text <= '9') {
+        value = value * 10 + (*text - '0');
+        text++;
+    }
+    return negative ? -value : value;
+}
+
+// Ends a field at the next colon, and returns the start of the following one
+static char* splitField(char* field) {
+    char* colon = strchr(field, ':');
+    if (colon == nullptr) {
+        return nullptr;
+    }
+    *colon = '\0';
+    return colon + 1;
+}
+
+
+bool CommandParser::parse(char* line, CommandArgs& args) {
+    // Lower case, and strip trailing whitespace and line endings
+    char* end = line;
+    for (; *end; end++) {
+        if (*end >= 'A' && *end <= 'Z') {
+            *end = static_cast<char>(*end - 'A' + 'a');
+        }
+    }
+    while (end > line && (end[-1] == ' ' || end[-1] == '\r' || end[-1] == '\n' || end[-1] == '\t')) {
+        *--end = '\0';
+    }
+    while (*line == ' ' || *line == '\t') {
+        line++;
+    }
+
+    args.name = line;
+    args.arg = "";
+    args.index = 0;
+    args.value = 0;
+    args.count = 0;
+
+    char* arg = splitField(line);
+    if (arg != nullptr) {
+        char* value = splitField(arg);
+        args.arg = arg;
+        args.index = parseNumber(arg);
+        args.count = 1;
+
+        if (value != nullptr) {
+            splitField(value);      // Anything after a third colon is ignored
+            args.value = parseNumber(value);
+            args.count = 2;
+        }
+    }
+
+    return *args.name != '\0';
+}
+
+const Command* CommandParser::find(const char* name) const {
+    size_t low = 0;
+    size_t high = mCount;
+    while (low < high) {
+        size_t middle = (low + high) / 2;
+        int order = compare(name, mCommands[middle].name);
+        if (order == 0) {
+            return &mCommands[middle];
+        }
+        if (order < 0) {
+            high = middle;
+        }
+        else {
+            low = middle + 1;
+        }
+    }
+    return nullptr;
+}
+
+CommandResult CommandParser::dispatch(const CommandArgs& args) const {
+    const Command* command = find(args.name);
+    if (command == nullptr) {
+        return COMMAND_UNKNOWN;
+    }
+    command->handler(args);
+    return COMMAND_OK;
+}
+
+CommandResult CommandParser::execute(char* line) const {
+    CommandArgs args;
+    if (!parse(line, args)) {
+        return COMMAND_EMPTY;
+    }
+    return dispatch(args);
+}
+
+bool CommandParser::extractLine(const uint8_t* data, size_t length, char* line) {
+    const void* newline = memchr(data, '\n', length);
+    if (newline == nullptr) {
+        return false;
+    }
+
+    size_t lineLength = static_cast<const uint8_t*>(newline) - data;
+    if (lineLength > COMMAND_MAX_LENGTH) {
+        return false;
+    }
+    memcpy(line, data, lineLength);
+    line[lineLength] = '\0';
+    return true;
+}
+
+bool CommandLineReader::add(char c) {
+    if (c == '\n') {
+        bool complete = !mOverlong;
+        mLine[mLength] = '\0';
+        mLength = 0;
+        mOverlong = false;
+        return complete;
+    }
+
+    if (mOverlong) {
+        return false;
+    }
+    if (mLength == COMMAND_MAX_LENGTH) {
+        mLength = 0;
+        mOverlong = true;
+        return false;
+    }
+    mLine[mLength++] = c;
+    return false;
+}
@@ -0,0 +1,121 @@
+#ifndef COMMAND_PARSER_H
+#define COMMAND_PARSER_H
+
+/*
+Command Parser Definition
+
+Commands arrive over serial and the BLE UART as lines of the form
+
+  name[:arg[:value]]
+
+for example "set:3:90", "wrist:pitch:20" or "streamstats:reset". The parser
+works in place on a fixed buffer: it lower-cases the line, splits it at the
+colons by writing terminators over them, and converts the arguments to
+numbers once, so handlers get them ready to use. The command is then found
+by binary search of a table sorted by name, and only its handler runs.
+
+Nothing here allocates memory, which matters on a small heap that the
+String based parser used to fragment a little with every command.
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define COMMAND_MAX_LENGTH        63      // Longer lines are rejected
+
+
+// A parsed command line. The strings point into the line, which must outlive it.
+struct CommandArgs {
+    const char* name;
+    const char* arg;        // First argument as text, "" if there isn't one
+    int32_t index;          // First argument as a number, 0 if it isn't one
+    int32_t value;          // Second argument as a number, 0 if there isn't one
+    uint8_t count;          // Number of arguments given
+
+    inline bool argIs(const char* text) const { return strcmp(arg, text) == 0; }
+};
+
+typedef void (*CommandHandler)(const CommandArgs& args);
+
+struct Command {
+    const char* name;
+    CommandHandler handler;
+};
+
+enum CommandResult {
+    COMMAND_OK,
+    COMMAND_EMPTY,
+    COMMAND_UNKNOWN
+};
+
+class CommandParser {
+
+    public:
+        // The table must be sorted by name - check it with a static_assert on isSorted()
+        constexpr CommandParser(const Command* commands, size_t count)
+        : mCommands(commands), mCount(count) {
+        }
+
+        // Splits a line in place. Returns false if there is no command name.
+        static bool parse(char* line, CommandArgs& args);
+
+        // Runs the handler for a parsed command
+        CommandResult dispatch(const CommandArgs& args) const;
+
+        // Parses and dispatches a line, which is modified
+        CommandResult execute(char* line) const;
+
+        const Command* find(const char* name) const;
+
+        // Copies the text up to the first newline into a line buffer of
+        // COMMAND_MAX_LENGTH+1 characters. Returns false if there is no newline
+        // or the line doesn't fit.
+        static bool extractLine(const uint8_t* data, size_t length, char* line);
+
+        static constexpr int compare(const char* a, const char* b) {
+            while (*a && *a == *b) {
+                a++;
+                b++;
+            }
+            return static_cast<unsigned char>(*a) - static_cast<unsigned char>(*b);
+        }
+
+        static constexpr bool isSorted(const Command* commands, size_t count) {
+            for (size_t i = 1; i < count; i++) {
+                if (compare(commands[i-1].name, commands[i].name) >= 0) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+    private:
+        const Command* mCommands;
+        size_t mCount;
+};
+
+// Gathers a line a character at a time, for serial input that is read as it
+// arrives rather than waited for. A line longer than COMMAND_MAX_LENGTH is
+// dropped whole, up to its newline, as extractLine() drops it.
+class CommandLineReader {
+
+    public:
+        constexpr CommandLineReader()
+        : mLine{}, mLength(0), mOverlong(false) {
+        }
+
+        // Returns true when the character ends a line, which getLine() then
+        // holds, terminated, until the next add()
+        bool add(char c);
+
+        inline char* getLine() { return mLine; }
+
+    private:
+        char mLine[COMMAND_MAX_LENGTH + 1];
+        size_t mLength;
+        bool mOverlong;             // Dropping the rest of a line that didn't fit
+};
+
+
+#endif
@@ -0,0 +1,5 @@
+#include "ControlCore.h"
+
+
+SpscQueue<ControlMessage, CONTROL_QUEUE_LENGTH> controlMessages;
+SpscQueue<ControlReply, CONTROL_QUEUE_LENGTH> controlReplies;
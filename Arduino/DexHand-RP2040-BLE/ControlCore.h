@@ -0,0 +1,77 @@
+#ifndef CONTROL_CORE_H
+#define CONTROL_CORE_H
+
+/*
+Control Core
+
+The RP2040 has two cores. By default everything runs on the first one,
+from loop() and the BLE handlers. With DUAL_CORE_CONTROL set, the hand is
+driven from the second core instead, so the BLE stack can't hold up a
+control tick and a long command can't hold up the BLE stack:
+
+  Core 0   BLE polling and handlers, serial input, heartbeats and the
+           connection timeout
+  Core 1   Commands, pose commands, gestures, the control tick, the
+           kinematics and the servo writes
+
+Neither side ever waits on the other. Streamed frames already reach the
+control tick through dofMailbox and the jitter buffer (see DofStream.h).
+Command lines and binary pose commands go over controlMessages, and the
+replies to binary commands, which have to be sent from the BLE core, come
+back over controlReplies. Those are single producer, single consumer
+queues.
+
+Commands that touch state the BLE core owns leave it a request instead, an
+atomic sequence number that it takes up between packets, as the recorder's
+requests do (see DofRecorder.h). That's how streamstats:reset zeroes the
+BLE handler's counters, and how a heartbeat reaches the connection timeout.
+Flags the BLE handler only reads, like whether the jitter buffer is in use,
+are atomic. Stats read across the cores are plain loads, and may be a
+packet behind.
+
+The second core is started with setup1()/loop1(), which needs the
+arduino-pico core. The loop profiler assumes one core, so it is off by
+default when this is on.
+*/
+
+#include <stdint.h>
+
+#include "CommandParser.h"
+#include "JointArbiter.h"
+#include "SpscQueue.h"
+
+#ifndef DUAL_CORE_CONTROL
+#define DUAL_CORE_CONTROL         0
+#endif
+
+#if DUAL_CORE_CONTROL && defined(ARDUINO_ARCH_MBED)
+#error DUAL_CORE_CONTROL needs the arduino-pico core, the mbed core does not run loop1()
+#endif
+
+#define CONTROL_QUEUE_LENGTH      8       // Power of two
+#define CONTROL_REPLY_LENGTH      20      // One write to the TX characteristic
+
+enum ControlMessageType {
+  CONTROL_MESSAGE_COMMAND,        // A command line or binary command
+  CONTROL_MESSAGE_DISCONNECTED    // The central has gone, with no data
+};
+
+// A command line, or a binary command from the UART characteristic, and
+// where it came from for the arbiter (see JointArbiter.h)
+struct ControlMessage {
+  uint8_t length;
+  uint8_t type;                   // ControlMessageType
+  uint8_t source;                 // ControlSource
+  uint8_t data[COMMAND_MAX_LENGTH + 1];
+};
+
+// Text for the TX characteristic, terminated
+struct ControlReply {
+  char text[CONTROL_REPLY_LENGTH + 1];
+};
+
+extern SpscQueue<ControlMessage, CONTROL_QUEUE_LENGTH> controlMessages;   // Core 0 to core 1
+extern SpscQueue<ControlReply, CONTROL_QUEUE_LENGTH> controlReplies;      // Core 1 to core 0
+
+
+#endif
@@ -1,88 +1,26 @@
 #include <ArduinoBLE.h>
 #include <UniversalTimer.h>
 
-#include "ManagedServo.h"
-#include "Finger.h"
-#include "Thumb.h"
-#include "Wrist.h"
+#include "Calibration.h"
+#include "CommandParser.h"
+#include "ControlCore.h"
+#include "DofRecorder.h"
+#include "DofRegistry.h"
+#include "DofStream.h"
+#include "Gestures.h"
+#include "Hand.h"
+#include "JointArbiter.h"
+#include "Latency.h"
+#include "Log.h"
+#include "PoseLibrary.h"
+#include "Profiler.h"
+#include "Scheduler.h"
 #include "WiFiNINA.h"
 
 
-// ----- Servo Setup -----
-#define NUM_SERVOS       18
-
-#define SERVO_INDEX_LOWER   0
-#define SERVO_INDEX_UPPER   1
-#define SERVO_MIDDLE_LOWER  2
-#define SERVO_MIDDLE_UPPER  3
-#define SERVO_RING_LOWER  4
-#define SERVO_RING_UPPER  5
-#define SERVO_PINKY_LOWER  6
-#define SERVO_PINKY_UPPER  7
-#define SERVO_INDEX_TIP 8
-#define SERVO_MIDDLE_TIP 9
-#define SERVO_RING_TIP 10
-#define SERVO_PINKY_TIP 11
-#define SERVO_THUMB_TIP 12
-#define SERVO_THUMB_RIGHT 13
-#define SERVO_THUMB_LEFT 14
-#define SERVO_THUMB_ROTATE 15
-#define SERVO_WRIST_L 16
-#define SERVO_WRIST_R 17
-
 #define DEMO_BUTTON 19    // Used for an optional external button to allow the hand to run through a series of canned poses
 
-
-// The table below defines the servo parameters for each of the servos in the hand.
-// You may need to adjust these if you are using different servos, or wire the
-// servos to different GPIO pins.
-
-ManagedServo managedServos[NUM_SERVOS] = 
-{
-  // Servo GPIO Pin, Min, Max, Default, Inverted
-  ManagedServo(2, 30, 110, 30, false),  // Index Lower 0
-  ManagedServo(1, 30, 140, 30, true),  // Index Upper 1
-  ManagedServo(5, 30, 120, 30, false),  // Middle Lower 2
-  ManagedServo(4, 30, 150, 30, true),  // Middle Upper 3
-  ManagedServo(3, 30, 150, 30, true),   // Ring Lower 4
-  ManagedServo(0, 30, 100, 30, false),   // Ring Upper  5
-  ManagedServo(7, 30, 140, 30, true),   // Pinky Lower 6
-  ManagedServo(6, 30, 100, 30, false),   // Pinky Upper 7
-  ManagedServo(10, 30, 100, 30, false),  // Index Tip 8
-  ManagedServo(11, 30, 90, 30, false), // Middle Tip 9
-  ManagedServo(12, 30, 120, 30, true),  // Ring Tip 10
-  ManagedServo(13, 30, 130, 30, true),  // Pinky Tip 11
-  ManagedServo(14, 30, 130, 30, false),  // Thumb Tip 12
-  ManagedServo(15, 30, 150, 30, false),  // Thumb Right 13
-  ManagedServo(16, 20, 120, 20, false),  // Thumb Left 14
-  ManagedServo(17, 30, 90, 30, false),  // Thumb Rotate 15
-  ManagedServo(9, 30, 160, 95, false),  // Wrist Left 16
-  ManagedServo(8, 30, 160, 95, false)   // Wrist Right 17
-};
-
-
-// Finger, Thumb, and Wrist objects for managing the DOF's in a more intuitive fashion.
-typedef enum fingerIdx {
-  FINGER_INDEX,
-  FINGER_MIDDLE,
-  FINGER_RING,
-  FINGER_PINKY,
-  NUM_FINGERS
-} FINGER_IDX;
-
-Finger fingers[NUM_FINGERS] = {
-  Finger("index", managedServos[SERVO_INDEX_LOWER], managedServos[SERVO_INDEX_UPPER], managedServos[SERVO_INDEX_TIP]),
-  Finger("middle", managedServos[SERVO_MIDDLE_LOWER], managedServos[SERVO_MIDDLE_UPPER], managedServos[SERVO_MIDDLE_TIP]),
-  Finger("ring", managedServos[SERVO_RING_LOWER], managedServos[SERVO_RING_UPPER], managedServos[SERVO_RING_TIP]),
-  Finger("pinky", managedServos[SERVO_PINKY_LOWER], managedServos[SERVO_PINKY_UPPER], managedServos[SERVO_PINKY_TIP])
-};
-
-Thumb thumb(managedServos[SERVO_THUMB_LEFT], managedServos[SERVO_THUMB_RIGHT], managedServos[SERVO_THUMB_TIP], managedServos[SERVO_THUMB_ROTATE]);
-Wrist wrist(managedServos[SERVO_WRIST_L], managedServos[SERVO_WRIST_R]);
-
-
-
-
+#define LOG_DRAIN_RECORDS 4   // Most log records printed per run of the log task
 
 
 // ----- BLE Setup -----
@@ -102,790 +40,1198 @@ BLECharacteristic rxCharacteristic("6E400002-B5A3-F393-E0A9-E50E24DCCA9E", BLEWr
 BLEService dofService("1e16c1b4-1936-4f0e-ab62-5e0a702a4935");
 
 // Custom DOF streaming characteristics
-BLECharacteristic dofCharacteristic("1e16c1b5-1936-4f0e-ab62-5e0a702a4935", BLEWriteWithoutResponse, 20);
+BLECharacteristic dofCharacteristic("1e16c1b5-1936-4f0e-ab62-5e0a702a4935", BLEWriteWithoutResponse, DOF_MAX_PACKET_LENGTH);
+
+// Layout of the DOFs in a frame, see DofRegistry.h
+BLECharacteristic dofDescriptorCharacteristic("1e16c1b6-1936-4f0e-ab62-5e0a702a4935", BLERead, DOF_DESCRIPTOR_LENGTH, true);
+
+#if LATENCY_INSTRUMENTATION
+// Pipeline latency histograms and stream error counters, see Latency.h
+BLECharacteristic statsCharacteristic("1e16c1b7-1936-4f0e-ab62-5e0a702a4935", BLERead, LATENCY_STATS_LENGTH, true);
+#endif
 
 
-// Heartbeat timer
+// Servo limits, ranges and rest positions saved in flash, see Calibration.h
+FlashCalibrationStorage calibrationStorage;
+
+// micros() when the servos started, for the boot time
+uint32_t firstPulseUs = 0;
+
+// Heartbeat count
 uint32_t heartbeat = 0;
-UniversalTimer heartbeatTimer(5000, true);  // 5 second message interval
 
 // Connection timeout timer
 UniversalTimer connectionTimeout(10000, true); // 10 second timeout
 
-// Reset servos to default position
-void setDefaultPose() {
-  for (int index = 0; index < NUM_SERVOS; index++)
-  {
-    managedServos[index].setServoPosition(managedServos[index].getDefaultPosition());
-  }
-}
+// Heartbeats from the central, counted by the command handler and taken up
+// by the timeout task, which owns the timer
+std::atomic<uint32_t> heartbeatsReceived(0);
+uint32_t heartbeatsTaken = 0;
 
+#if DUAL_CORE_CONTROL
+// Control tick on the control core - steps the joints toward their targets within the motion limits
+UniversalTimer controlTimer(1000 / CONTROL_RATE_HZ, true);
+#endif
 
-// -- Canned Procedural Poses for Testing -----------------------
+// The main loop's tasks, see Scheduler.h and setupTasks()
+Scheduler scheduler;
+int heartbeatTask = -1;
+int timeoutTask = -1;
 
-// Hand pose for countdown - all fingers closed
-void setZeroPose() {
-  
-  setDefaultPose();
-  
-  // Move thumb to lower closed position
-  thumb.setMaxPosition();
+// The connected central, if there is one
+BLEDevice connectedCentral;
+bool centralConnected = false;
 
-  // Move all fingers to max position
-  for (int finger = 0; finger < NUM_FINGERS; finger++)
-  {
-    fingers[finger].setMaxPosition();
-    fingers[finger].update();
-  }
-}
+// Overruns already reported for each task
+uint32_t overrunsReported[SCHEDULER_MAX_TASKS];
 
-// Hand pose for countdown - one finger open
-void setOnePose() {
+#if DUAL_CORE_CONTROL
+// Set once setup() has finished with the servos
+std::atomic<bool> handReady(false);
+#endif
 
-  setDefaultPose();
-  
-  // Move thumb to lower closed position
-  thumb.setMaxPosition();
-  
-  // Move all fingers other than index to max position
-  for (int finger = 1; finger < NUM_FINGERS; finger++)
+// Where the command being run came from, for its claims on the joints
+ControlSource commandSource = CONTROL_SOURCE_SERIAL;
+
+// Dump out the current DOF angles
+void printDOFS()
+{
+  // This command outputs a JSON array of all of the angle ranges for the DOFS in the hand,
+  // in the order they are streamed. It's printed a piece at a time from the DOF registry
+  // rather than built up in a String.
+  Serial.print("DOFS:[ ");
+
+  for (int i = 0; i < DOF_COUNT; i++)
   {
-    fingers[finger].setMaxPosition();
-    fingers[finger].update();
+    const DofInfo& dof = DOF_REGISTRY[i];
+    Serial.print("{ \"name\": \"");
+    Serial.print(dof.name);
+    Serial.print("\", \"range\": [");
+    Serial.print(dof.min);
+    Serial.print(", ");
+    Serial.print(dof.max);
+    Serial.print(i < DOF_COUNT - 1 ? "] }, " : "] } ");
   }
 
+  Serial.println("]");
 }
 
-// Hand pose for countdown - two fingers open
-void setTwoPose() {
 
-  setDefaultPose();
+// --- Main Setup -----------------------
+
+void setup() {
+  Serial.begin(115200);    // initialize serial communication
+
+  // ----- Servo Setup -----
+  // The servos start straight away, at the rest positions in the saved
+  // calibration, rather than after waiting for a serial monitor. Anything
+  // printed before one is open is lost.
+  applyDofRanges();
+  CalibrationResult calibration = loadCalibration(calibrationStorage);
+  startServos();
+  firstPulseUs = micros();
 
-  // Move thumb to lower closed position
-  thumb.setMaxPosition();
   
-  // Move all fingers other than index,middle finger to max position
-  for (int finger = 2; finger < NUM_FINGERS; finger++)
-  {
-    fingers[finger].setMaxPosition();
-    fingers[finger].update();
+  // ----- BLE Setup -----
+  if (!BLE.begin()) {   // initialize BLE
+    Serial.println("starting BLE failed!");
+    while (1);
   }
 
-}
-
-// Hand pose for countdown - three fingers open
-void setThreePose() {
+  BLE.setConnectionInterval(6, 10); // Ask for a fast connection interval: 7.5 ms minimum, 12.5s maximum
 
-  setDefaultPose();
+  connectionTimeout.start(); // Start timeout
+#if DUAL_CORE_CONTROL
+  controlTimer.start();  // Start control tick
+#endif
 
-  // Move thumb to lower closed position
-  thumb.setMaxPosition();
+  BLE.setLocalName("DexHand");  // Set name for connection
+  BLE.setAdvertisedService(uartService); // Add the service UUID
   
-  // Move all fingers other than index,middle,ring finger to max position
-  for (int finger = 3; finger < NUM_FINGERS; finger++)
-  {
-    fingers[finger].setMaxPosition();
-    fingers[finger].update();
-  }
-}
+  uartService.addCharacteristic(rxCharacteristic); // Add the rxCharacteristic
+  uartService.addCharacteristic(txCharacteristic); // Add the txCharacteristic
 
-// Hand pose for countdown - four fingers open
-void setFourPose() {
+  dofService.addCharacteristic(dofCharacteristic); // Add the dofCharacteristic
+  dofService.addCharacteristic(dofDescriptorCharacteristic); // Add the dofDescriptorCharacteristic
+  dofDescriptorCharacteristic.writeValue(DOF_DESCRIPTOR, DOF_DESCRIPTOR_LENGTH);  // Constant, so it's only set once
+#if LATENCY_INSTRUMENTATION
+  dofService.addCharacteristic(statsCharacteristic); // Add the statsCharacteristic
+#endif
 
-  setDefaultPose();
+  BLE.addService(uartService); // Add the service
+  BLE.addService(dofService); // Add the service
 
-  // Move thumb to lower closed position
-  thumb.setMaxPosition();
+  rxCharacteristic.setEventHandler(BLEWritten, rxHandler);  // Assign event handler for characteristic
+  dofCharacteristic.setEventHandler(BLEWritten, dofHandler);  // Assign event handler for characteristic
   
-}
+  BLE.advertise();  // Start advertising
+  Serial.println("Bluetooth device active, waiting for connections...");
 
+  Serial.print("Calibration: ");
+  Serial.println(calibration == CALIBRATION_OK ? "loaded" : "defaults");
 
+  setDefaultPose();
 
-// Countdown and back up
-void count() {
+  // ----- Demo Button Setup -----
+  pinMode(DEMO_BUTTON, INPUT_PULLUP);
 
-  // Move thumb to lower closed position
-  managedServos[SERVO_THUMB_TIP].moveToMaxPosition();
-  managedServos[SERVO_THUMB_RIGHT].moveToMinPosition();
-  managedServos[SERVO_THUMB_LEFT].moveToMaxPosition();
-  delay(200);
+  setupTasks();
 
-  setZeroPose();
-  delay(1000);
-  setOnePose();
-  delay(1000);
-  setTwoPose();
-  delay(1000);
-  setThreePose();
-  delay(1000);
-  setFourPose();
-  delay(1000);
-  setDefaultPose();
-  delay(1000);
-  setFourPose();
-  delay(1000);
-  setThreePose();
-  delay(1000);
-  setTwoPose();
-  delay(1000);
-  setOnePose();
-  delay(1000);
-  setZeroPose();
-  delay(1000);
-  setDefaultPose();
-  
+#if DUAL_CORE_CONTROL
+  // The control core can have the hand now
+  handReady.store(true, std::memory_order_release);
+#endif
 }
 
-// Waves the hand side to side
-void wave() {
-  setDefaultPose();
-  for (int cycle = 0; cycle < 5; ++cycle) {
-    for (int yaw = wrist.getYawMin(); yaw <= wrist.getYawMax(); yaw ++) {
-      wrist.setYaw(yaw);
-      wrist.update();
-      delay(3);
-    }
-    for (int yaw = wrist.getYawMax(); yaw >= wrist.getYawMin(); yaw --) {
-      wrist.setYaw(yaw);
-      wrist.update();
-      delay(3);
-    }
+// --- Main Loop and Processing -------------------------------
+
+// --- Commands --------------------------------
+// See the README.md for details on the commands and format. Each handler gets
+// the command already split and converted by CommandParser.
+
+// Refuses a command that wanted the joints, with the source in the way
+void replyBusy(const CommandArgs& args, uint8_t refused, ControlSource owner) {
+  LOG_TEXT(COMMAND_BUSY, args.name, refused, owner);
+
+  char reply[CONTROL_REPLY_LENGTH + 1];
+  snprintf(reply, sizeof(reply), "BUSY:%s", getControlSourceName(owner));
+  Serial.println(reply);
+  if (commandSource == CONTROL_SOURCE_UART) {
+    sendReply(reply);
   }
-  setDefaultPose();
 }
 
-// Perform a shaka
-void shaka()
-{
-  const int SHAKA_RANGE = 20;
-  setDefaultPose();
-
-  for (int finger = FINGER_INDEX; finger < FINGER_PINKY; ++finger)
-  {
-    fingers[finger].setMaxPosition();
-    fingers[finger].update();
-  }
-  thumb.setPitch(0);
-  thumb.setYaw(0);
-  thumb.setRoll(15);
-  thumb.update();
-
-  for (int cycle = 0; cycle < 5; ++cycle) {
-    for (int yaw = -SHAKA_RANGE; yaw <= SHAKA_RANGE; yaw ++) {
-      wrist.setYaw(yaw);
-      wrist.update();
-      delay(5);
-    }
-    for (int yaw = SHAKA_RANGE; yaw >= -SHAKA_RANGE; yaw --) {
-      wrist.setYaw(yaw);
-      wrist.update();
-      delay(5);
+// Claims the joints a command is about to set, see JointArbiter.h. It gets
+// all of them or none, so a command never moves half of what it asked for.
+// If it can't, the command is refused with the owner of a joint it can't have.
+bool claimForCommand(const CommandArgs& args, uint8_t joints) {
+  uint32_t nowMs = millis();
+  uint8_t refused = static_cast<uint8_t>(joints & ~getClaimableJoints(commandSource, joints, nowMs));
+  if (refused != 0) {
+    uint8_t joint = 0;
+    while (!(refused & HAND_JOINT(joint))) {
+      joint++;
     }
+    replyBusy(args, refused, getJointOwner(joint, nowMs));
+    return false;
   }
+  claimJoints(commandSource, joints, nowMs);
+  return true;
+}
 
-  setDefaultPose();
+void cmdSet(const CommandArgs& args) {
+  // Set the servo position
+  if (args.index < 0 || args.index >= NUM_SERVOS ||
+      !claimForCommand(args, HAND_JOINT(SERVO_CONFIG[args.index].joint))) {
+    return;
+  }
+  Serial.print("Setting Servo ");
+  Serial.print(args.index);
+  Serial.print(" to ");
+  Serial.println(args.value);
 
+  managedServos[args.index].setServoPosition(args.value);
 }
 
-void thumbRangeTest()
-{
-  // Cycle through the two thumb servos testing the range
-  for (int right = managedServos[SERVO_THUMB_RIGHT].getMinPosition(); right <= managedServos[SERVO_THUMB_RIGHT].getMaxPosition(); right+=5)
+void cmdMax(const CommandArgs& args) {
+  if (args.index < 0 || args.index >= NUM_SERVOS ||
+      !claimForCommand(args, HAND_JOINT(SERVO_CONFIG[args.index].joint))) {
+    return;
+  }
+  if (args.value != 0)
   {
-    managedServos[SERVO_THUMB_RIGHT].setServoPosition(right);
-    
-    for (int left = managedServos[SERVO_THUMB_LEFT].getMinPosition(); left <= managedServos[SERVO_THUMB_LEFT].getMaxPosition(); left+=5)
-    {
-      managedServos[SERVO_THUMB_LEFT].setServoPosition(left);
-      delay(100);
-    }
+    managedServos[args.index].setMaxPosition(args.value);
   }
-  setDefaultPose();
+  Serial.print("Setting Servo ");
+  Serial.print(args.index);
+  Serial.print(" to max");
+
+  managedServos[args.index].moveToMaxPosition();
 }
 
-void defaultFingers()
-{
-  for (int finger = FINGER_INDEX; finger <= FINGER_PINKY; ++finger)
+void cmdMin(const CommandArgs& args) {
+  if (args.index < 0 || args.index >= NUM_SERVOS ||
+      !claimForCommand(args, HAND_JOINT(SERVO_CONFIG[args.index].joint))) {
+    return;
+  }
+  if (args.value != 0)
   {
-    fingers[finger].setExtension(100);
-    fingers[finger].update();
+    managedServos[args.index].setMinPosition(args.value);
   }
-  thumb.setExtension(100);
-  thumb.update();
+  Serial.print("Setting Servo ");
+  Serial.print(args.index);
+  Serial.print(" to min");
+
+  managedServos[args.index].moveToMinPosition();
 }
-void fingerTest()
-{
 
-  defaultFingers();
-  delay(1000);
-
-  // Pinky
-  fingers[FINGER_PINKY].setExtension(25);
-  fingers[FINGER_PINKY].update();
-  thumb.setPitch(60);
-  thumb.setYaw(0);
-  thumb.setFlexion(45);
-  thumb.setRoll(0);
-  thumb.update();
-  delay(1000);
-
-  defaultFingers();
-  delay(1000);
-
-  // Ring
-  fingers[FINGER_RING].setExtension(30);
-  fingers[FINGER_RING].update();
-  thumb.setPitch(60);
-  thumb.setYaw(0);
-  thumb.setFlexion(30);
-  thumb.setRoll(0);
-  thumb.update();
-  delay(1000);
-
-  defaultFingers();
-  delay(1000);
-
-  // Middle
-  fingers[FINGER_MIDDLE].setExtension(35);
-  fingers[FINGER_MIDDLE].update();
-  thumb.setPitch(50);
-  thumb.setYaw(0);
-  thumb.setFlexion(40);
-  thumb.setRoll(0);
-  thumb.update();
-  delay(1000);
-
-  defaultFingers();
-  delay(1000);
-
-  // Index
-  fingers[FINGER_INDEX].setExtension(35);
-  fingers[FINGER_INDEX].update();
-  thumb.setPitch(40);
-  thumb.setYaw(0);
-  thumb.setFlexion(45);
-  thumb.setRoll(0);
-  thumb.update();
-  delay(1000);
-
-  defaultFingers();
-  delay(1000);
+void cmdFingerMax(const CommandArgs& args) {
+  if (args.index >= 0 && args.index < NUM_FINGERS && claimForCommand(args, HAND_JOINT_FINGER(args.index))) {
+    fingers[args.index].setMaxPosition();
+    updateHandJoints(HAND_JOINT_FINGER(args.index));
+  
+    Serial.print("Setting finger ");
+    Serial.print(args.index);
+    Serial.print(" to max");
+  }
 }
 
-// Dump out the current DOF angles
-String printDOFS()
-{
-  // This command outputs a JSON array of all of the angle ranges for the DOFS in the hand
-    String result = "DOFS:[ ";
-
-    // Would be nicer if this could be more automated based on the data structures, but for
-    // now we just output the values in the right order
-
-    for (int finger = 0; finger < NUM_FINGERS; ++finger)
-    {
-      // Fingers
-      result += "{ \"name\": \"";
-      result += fingers[finger].getName();
-      result += "_pitch\", \"range\": [";
-      result += fingers[finger].getPitchMin();
-      result += ", ";
-      result += fingers[finger].getPitchMax();
-      result += "] }, ";
-
-      result += "{ \"name\": \"";
-      result += fingers[finger].getName();
-      result += "_yaw\", \"range\": [";
-      result += fingers[finger].getYawMin();
-      result += ", ";
-      result += fingers[finger].getYawMax();
-      result += "] }, ";
-
-      result += "{ \"name\": \"";
-      result += fingers[finger].getName();
-      result += "_flexion\", \"range\": [";
-      result += fingers[finger].getFlexionMin();
-      result += ", ";
-      result += fingers[finger].getFlexionMax();
-      result += "] }, ";
-    }
-    
-    // Thumb
-    result += "{ \"name\": \"thumb_pitch\", \"range\": [";
-    result += thumb.getPitchMin();
-    result += ", ";
-    result += thumb.getPitchMax();
-    result += "] }, ";
-
-    result += "{ \"name\": \"thumb_yaw\", \"range\": [";
-    result += thumb.getYawMin();
-    result += ", ";
-    result += thumb.getYawMax();
-    result += "] }, ";
-
-    result += "{ \"name\": \"thumb_flexion\", \"range\": [";
-    result += thumb.getFlexionMin();
-    result += ", ";
-    result += thumb.getFlexionMax();
-    result += "] }, ";
-
-    // Roll is currently not used - this is here for when we want to enable it
-    //result += "{ \"name\": \"thumb_roll\", \"range\": [";
-    //result += thumb.getRollMin();
-    //result += ", ";
-    //result += thumb.getRollMax();
-    //result += "] }, ";
-
-    // Wrist
-    result += "{ \"name\": \"wrist_pitch\", \"range\": [";
-    result += wrist.getPitchMin();
-    result += ", ";
-    result += wrist.getPitchMax();
-    result += "] }, ";
-
-    result += "{ \"name\": \"wrist_yaw\", \"range\": [";
-    result += wrist.getYawMin();
-    result += ", ";
-    result += wrist.getYawMax();
-    result += "] } ";
-    
-    result += "]";
-
-    return result;
+void cmdFingerMin(const CommandArgs& args) {
+  if (args.index >= 0 && args.index < NUM_FINGERS && claimForCommand(args, HAND_JOINT_FINGER(args.index))) {
+    fingers[args.index].setMinPosition();
+    updateHandJoints(HAND_JOINT_FINGER(args.index));
+  
+    Serial.print("Setting finger ");
+    Serial.print(args.index);
+    Serial.print(" to min");
+  }
 }
 
+void cmdFingerExtension(const CommandArgs& args) {
+  // Accepts range from 0-100 where 0 is fully retracted toward palm, and 100 is fully extended away from palm
+  if (args.index >= 0 && args.index < NUM_FINGERS && claimForCommand(args, HAND_JOINT_FINGER(args.index)))
+  {
+    fingers[args.index].setExtension(args.value);
+    updateHandJoints(HAND_JOINT_FINGER(args.index));
 
-// --- Main Setup -----------------------
+    Serial.print("Setting finger ");
+    Serial.print(args.index);
+    Serial.print(" extension to ");
+    Serial.println(args.value);
+  }
+  else if (args.index == NUM_FINGERS && claimForCommand(args, HAND_JOINT_THUMB))
+  {
+    thumb.setExtension(args.value);
+    updateHandJoints(HAND_JOINT_THUMB);
 
-void setup() {
-  Serial.begin(9600);    // initialize serial communication
-  delay(2000);
+    Serial.print("Setting thumb extension to ");
+    Serial.println(args.value);
+  }
+}
 
-  // ----- Servo Setup -----
-  for (int index = 0; index < NUM_SERVOS; index++)
-  {
-    managedServos[index].setupServo();
+void cmdWrist(const CommandArgs& args) {
+  if ((args.argIs("pitch") || args.argIs("yaw")) && !claimForCommand(args, HAND_JOINT_WRIST)) {
+    return;
   }
 
-  
-  // ----- BLE Setup -----
-  if (!BLE.begin()) {   // initialize BLE
-    Serial.println("starting BLE failed!");
-    while (1);
+  if (args.argIs("pitch")) {
+    wrist.setPitch(args.value);
+    updateHandJoints(HAND_JOINT_WRIST);
+
+    Serial.print("Setting wrist pitch to ");
+    Serial.println(args.value);
   }
+  else if (args.argIs("yaw")) {
+    wrist.setYaw(args.value);
+    updateHandJoints(HAND_JOINT_WRIST);
 
-  BLE.setConnectionInterval(6, 10); // Ask for a fast connection interval: 7.5 ms minimum, 12.5s maximum
+    Serial.print("Setting wrist yaw to ");
+    Serial.println(args.value);
+  }
+}
 
-  heartbeatTimer.start();  // Start heartbeat timer
-  connectionTimeout.start(); // Start timeout
+void cmdThumb(const CommandArgs& args) {
+  if ((args.argIs("pitch") || args.argIs("yaw") || args.argIs("flexion") || args.argIs("roll")) &&
+      !claimForCommand(args, HAND_JOINT_THUMB)) {
+    return;
+  }
 
-  BLE.setLocalName("DexHand");  // Set name for connection
-  BLE.setAdvertisedService(uartService); // Add the service UUID
-  
-  uartService.addCharacteristic(rxCharacteristic); // Add the rxCharacteristic
-  uartService.addCharacteristic(txCharacteristic); // Add the txCharacteristic
+  if (args.argIs("pitch")) {
+    thumb.setPitch(args.value);
+    updateHandJoints(HAND_JOINT_THUMB);
 
-  dofService.addCharacteristic(dofCharacteristic); // Add the dofCharacteristic
+    Serial.print("Setting thumb pitch to ");
+    Serial.println(args.value);
+  }
+  else if (args.argIs("yaw")) {
+    thumb.setYaw(args.value);
+    updateHandJoints(HAND_JOINT_THUMB);
 
-  BLE.addService(uartService); // Add the service
-  BLE.addService(dofService); // Add the service
+    Serial.print("Setting thumb yaw to ");
+    Serial.println(args.value);
+  }
+  else if (args.argIs("flexion")) {
+    thumb.setFlexion(args.value);
+    updateHandJoints(HAND_JOINT_THUMB);
 
-  rxCharacteristic.setEventHandler(BLEWritten, rxHandler);  // Assign event handler for characteristic
-  dofCharacteristic.setEventHandler(BLEWritten, dofHandler);  // Assign event handler for characteristic
-  
-  BLE.advertise();  // Start advertising
-  Serial.println("Bluetooth device active, waiting for connections...");
+    Serial.print("Setting thumb flexion to ");
+    Serial.println(args.value);
+  }
+  else if (args.argIs("roll")) {
+    thumb.setRoll(args.value);
+    updateHandJoints(HAND_JOINT_THUMB);
 
-  setDefaultPose();
+    Serial.print("Setting thumb roll to ");
+    Serial.println(args.value);
+  }
+}
 
-  // ----- Demo Button Setup -----
-  pinMode(DEMO_BUTTON, INPUT_PULLUP);
+// Gestures play out from the control tick, so these return straight away.
+// The command's own leases on the gesture's joints are handed to the
+// gesture once it has been granted the rest, see requestGesture().
+void playGesture(const CommandArgs& args, const Gesture* gesture) {
+  if (gesture == nullptr) {
+    return;
+  }
+  ControlSource owner;
+  uint8_t refused = requestGesture(*gesture, commandSource, false, millis(), owner);
+  if (refused != 0) {
+    replyBusy(args, refused, owner);
+  }
+}
 
+void cmdOne(const CommandArgs& args) { if (claimForCommand(args, COUNT_POSE_JOINTS)) setOnePose(); }
+void cmdTwo(const CommandArgs& args) { if (claimForCommand(args, COUNT_POSE_JOINTS)) setTwoPose(); }
+void cmdThree(const CommandArgs& args) { if (claimForCommand(args, COUNT_POSE_JOINTS)) setThreePose(); }
+void cmdFour(const CommandArgs& args) { if (claimForCommand(args, COUNT_POSE_JOINTS)) setFourPose(); }
+void cmdDefault(const CommandArgs& args) { if (claimForCommand(args, HAND_JOINTS_ALL)) setDefaultPose(); }
+void cmdCount(const CommandArgs& args) { playGesture(args, findGesture("count")); }
+void cmdWave(const CommandArgs& args) { playGesture(args, findGesture("wave")); }
+void cmdShaka(const CommandArgs& args) { playGesture(args, findGesture("shaka")); }
+void cmdThumbTest(const CommandArgs& args) { playGesture(args, findGesture("thumbtest")); }
+void cmdFingerTest(const CommandArgs& args) { playGesture(args, findGesture("fingertest")); }
+
+void cmdHeartbeat(const CommandArgs&) {
+  heartbeatsReceived.store(heartbeatsReceived.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+  Serial.println("HB: Heartbeat received");
 }
 
-// --- Main Loop and Processing -------------------------------
+void cmdDof(const CommandArgs& args) {
+  // Set any streamed DOF by name or wire index, e.g. dof:thumb_yaw:20 or dof:13:20
+  const DofInfo* dof = findDof(args.arg);
+  if (dof == nullptr && args.count > 0 && args.arg[0] >= '0' && args.arg[0] <= '9' && args.index < DOF_COUNT) {
+    dof = &DOF_REGISTRY[args.index];
+  }
+  if (dof == nullptr || !claimForCommand(args, HAND_JOINT(dof->joint))) {
+    return;
+  }
 
-// Basic command parser for servo commands - nothing special, but it works
-// See the README.md for details on the commands and format
-void processCommand(String cmd) {
+  dof->set(args.value);
+  updateHandJoints(HAND_JOINT(dof->joint));
 
-  cmd.toLowerCase();
+  Serial.print("Setting ");
+  Serial.print(dof->name);
+  Serial.print(" to ");
+  Serial.println(args.value);
+}
 
-  // Split the string
-  int colonPos = cmd.indexOf(':');
-  String cmdType;
-  String servoIndex;
-  String servoPosition;
-  int index = 0;
-  int position = 0;
-  
-  if (colonPos != -1) {
-    cmdType = cmd.substring(0, colonPos);
-    cmd = cmd.substring(colonPos + 1);
-    colonPos = cmd.indexOf(':');
-    servoIndex = cmd.substring(0, colonPos);
-    
-    if (colonPos != -1) {
-      servoPosition = cmd.substring(colonPos + 1);
-      position = servoPosition.toInt();
+void cmdGesture(const CommandArgs& args) {
+  // Play a gesture by name, stop it, or choose how it mixes with streamed frames
+  if (findGesture(args.arg) != nullptr) {
+    playGesture(args, findGesture(args.arg));
+  }
+  else if (args.argIs("reset")) {
+    if (!gesturePlayer.mayReplace(commandSource)) {
+      replyBusy(args, gesturePlayer.getGesture()->joints, gesturePlayer.getSource());
+    }
+    else if (claimForCommand(args, HAND_JOINTS_ALL)) {
+      stopGesture(commandSource);
+      setDefaultPose();
     }
-
-    // Convert to integers
-    index = servoIndex.toInt();
-    
   }
-  else {
-    // Single word command
-    cmdType = cmd;
-    cmdType.trim();
+  else if (args.argIs("demo")) {
+    ControlSource owner;
+    uint8_t refused = playDemo(commandSource, millis(), owner);
+    if (refused != 0) {
+      replyBusy(args, refused, owner);
+    }
+  }
+  else if (args.argIs("blend")) {
+    gesturePlayer.setStreamMode(GESTURE_STREAM_BLEND);
+  }
+  else if (args.argIs("preempt")) {
+    gesturePlayer.setStreamMode(GESTURE_STREAM_PREEMPT);
   }
 
-  
-  Serial.print("CMD:");
-  Serial.print(cmdType);
-  Serial.print(":");
-  Serial.print(index);
-  Serial.print(":");
-  Serial.println(position);
+  const Gesture* playing = gesturePlayer.getGesture();
+  Serial.print("GESTURE: playing:");
+  Serial.print(playing != nullptr ? playing->name : "none");
+  Serial.print(" step:");
+  Serial.print(gesturePlayer.getStep());
+  Serial.print(" stream:");
+  Serial.print(gesturePlayer.getStreamMode() == GESTURE_STREAM_BLEND ? "blend" : "preempt");
+  Serial.print(" played:");
+  Serial.print(gesturePlayer.getPlayed());
+  Serial.print(" preempted:");
+  Serial.println(gesturePlayer.getPreempted());
+}
 
-  // Set the servo position
-  if (cmdType == "set") {
-    Serial.print("Setting Servo ");
-    Serial.print(index);
-    Serial.print(" to ");
-    Serial.println(position);
-
-    managedServos[index].setServoPosition(position);
-  }
-  if (cmdType == "max") {
-    if (position != 0)
-    {
-      managedServos[index].setMaxPosition(position);
-    }
-    Serial.print("Setting Servo ");
-    Serial.print(index);
-    Serial.print(" to max");
+void cmdPose(const CommandArgs& args) {
+  // Play a pose from the library by name or id, e.g. pose:fist or pose:1
+  const Gesture* pose = findPose(args.arg);
+  if (pose == nullptr && args.count > 0 && args.arg[0] >= '0' && args.arg[0] <= '9' && args.index <= UINT8_MAX) {
+    pose = findPose(static_cast<uint8_t>(args.index));
+  }
+  playGesture(args, pose);
 
-    managedServos[index].moveToMaxPosition();
+  Serial.print("POSE: library:");
+  for (uint8_t id = 0; id < getPoseLibraryCount(); id++) {
+    Serial.print(" ");
+    Serial.print(findPose(id)->name);
   }
-  if (cmdType == "min") {
-    if (position != 0)
-    {
-      managedServos[index].setMinPosition(position);
+  Serial.print(" uploaded:");
+  for (uint8_t slot = 0; slot < POSE_UPLOAD_SLOTS; slot++) {
+    const Gesture* upload = findPose(static_cast<uint8_t>(POSE_UPLOAD_FIRST_ID + slot));
+    if (upload != nullptr) {
+      Serial.print(" ");
+      Serial.print(upload->name);
     }
-    Serial.print("Setting Servo ");
-    Serial.print(index);
-    Serial.print(" to min");
+  }
+  Serial.print(" committed:");
+  Serial.print(getPoseUploadsCommitted());
+  Serial.print(" rejected:");
+  Serial.println(getPoseUploadsRejected());
+}
+
+void cmdDofs(const CommandArgs&) {
+  printDOFS();
+}
 
-    managedServos[index].moveToMinPosition();
+void cmdMotion(const CommandArgs& args) {
+  // Turn the joint velocity/acceleration limits on or off
+  if (args.argIs("on")) {
+    setMotionLimiting(true);
   }
-  if (cmdType == "fingermax") {
+  else if (args.argIs("off")) {
+    setMotionLimiting(false);
+    updateHand();
+  }
+  Serial.print("MOTION: limits ");
+  Serial.println(isMotionLimiting() ? "on" : "off");
+}
 
-    if (index < NUM_FINGERS) {
-      fingers[index].setMaxPosition();
-      fingers[index].update();
-    
-      Serial.print("Setting finger ");
-      Serial.print(index);
-      Serial.print(" to max");
-    }
+void cmdStreamStats(const CommandArgs& args) {
+  // DOF packets received over BLE, and what happened to them
+  Serial.print("STREAMSTATS: received:");
+  Serial.print(getDofPacketsReceived());
+  Serial.print(" badlength:");
+  Serial.print(getDofPacketsBadLength());
+  Serial.print(" badchecksum:");
+  Serial.print(getDofPacketsBadChecksum());
+  Serial.print(" badversion:");
+  Serial.print(getDofPacketsBadVersion());
+  Serial.print(" lost:");
+  Serial.print(getDofFramesLost());
+  Serial.print(" stale:");
+  Serial.print(getDofFramesStale());
+  Serial.print(" deltas:");
+  Serial.print(getDofDeltaFrames());
+  Serial.print(" deltasdropped:");
+  Serial.print(getDofDeltasDropped());
+  Serial.print(" applied:");
+  Serial.print(getDofFramesApplied());
+  Serial.print(" coalesced:");
+  Serial.println(getDofFramesCoalesced());
+
+  if (args.argIs("reset")) {
+    resetDofStreamCounters();
   }
-  if (cmdType == "fingermin") {
+}
 
-    if (index < NUM_FINGERS) {
-      fingers[index].setMinPosition();
-      fingers[index].update();
-    
-      Serial.print("Setting finger ");
-      Serial.print(index);
-      Serial.print(" to min");
-    }
+void cmdJitter(const CommandArgs& args) {
+  // Playout delay for streamed frames, and how the buffer is coping.
+  // jitter:extrapolate:<ms> sets the dead reckoning horizon, 0 to hold.
+  if (args.argIs("reset")) {
+    dofJitterBuffer.resetCounters();
   }
-  if (cmdType == "fingerextension") {
-    // Accepts range from 0-100 where 0 is fully retracted toward palm, and 100 is fully extended away from palm
-    if (index < NUM_FINGERS)
-    {
-      fingers[index].setExtension(position);
-      fingers[index].update();
-
-      Serial.print("Setting finger ");
-      Serial.print(index);
-      Serial.print(" extension to ");
-      Serial.println(position);
+  else if (args.argIs("extrapolate")) {
+    if (args.count > 1) {
+      dofJitterBuffer.setExtrapolationUs(CLAMP(args.value, 0, JITTER_MAX_EXTRAPOLATE_MS) * 1000ul);
     }
-    else if (index == NUM_FINGERS)
-    {
-      thumb.setExtension(position);
-      thumb.update();
+  }
+  else if (args.count > 0) {
+    setDofJitterDelay(CLAMP(args.index, 0, JITTER_MAX_DELAY_MS));
+  }
+  Serial.print("JITTER: delay:");
+  Serial.print(getDofJitterDelay());
+  Serial.print("ms extrapolate:");
+  Serial.print(dofJitterBuffer.getExtrapolationUs() / 1000);
+  Serial.print("ms depth:");
+  Serial.print(dofJitterBuffer.getDepth());
+  Serial.print(" maxdepth:");
+  Serial.print(dofJitterBuffer.getMaxDepth());
+  Serial.print(" played:");
+  Serial.print(dofJitterBuffer.getPlayed());
+  Serial.print(" underruns:");
+  Serial.print(dofJitterBuffer.getUnderruns());
+  Serial.print(" extrapolated:");
+  Serial.print(dofJitterBuffer.getExtrapolations());
+  Serial.print(" overflows:");
+  Serial.print(dofJitterBuffer.getOverflows());
+  Serial.print(" late:");
+  Serial.print(dofJitterBuffer.getLate());
+  Serial.print(" latency:");
+  Serial.print(dofJitterBuffer.getLastLatencyUs());
+  Serial.print("us meanlatency:");
+  Serial.print(dofJitterBuffer.getMeanLatencyUs());
+  Serial.print("us maxlatency:");
+  Serial.print(dofJitterBuffer.getMaxLatencyUs());
+  Serial.println("us");
+}
 
-      Serial.print("Setting thumb extension to ");
-      Serial.println(position);
+void cmdLog(const CommandArgs& args) {
+  // Log levels by module, e.g. log:stream:4, or log:all:0 to turn it all
+  // off. log:binary and log:text choose how it prints.
+  if (args.argIs("reset")) {
+    resetLogCounters();
+  }
+  else if (args.argIs("binary")) {
+    setLogOutput(LOG_OUTPUT_BINARY);
+  }
+  else if (args.argIs("text")) {
+    setLogOutput(LOG_OUTPUT_TEXT);
+  }
+  else if (args.count > 1) {
+    int module = args.argIs("all") ? LOG_MODULES : findLogModule(args.arg);
+    if (module == LOG_MODULES && !args.argIs("all")) {
+      return;
     }
+    setLogLevel(module, static_cast<uint8_t>(CLAMP(args.value, LOG_LEVEL_OFF, LOG_LEVEL_DEBUG)));
   }
-  if (cmdType == "wrist") {
-    if (servoIndex == "pitch") {
-      wrist.setPitch(position);
-      wrist.update();
 
-      Serial.print("Setting wrist pitch to ");
-      Serial.println(position);
-    }
-    if (servoIndex == "yaw") {
-      wrist.setYaw(position);
-      wrist.update();
+  Serial.print("LOG: output:");
+  Serial.print(getLogOutput() == LOG_OUTPUT_BINARY ? "binary" : "text");
+  Serial.print(" logged:");
+  Serial.print(getLogRecordsLogged());
+  Serial.print(" dropped:");
+  Serial.print(getLogRecordsDropped());
+  Serial.print(" depth:");
+  Serial.print(getLogDepth());
+  Serial.print(" maxdepth:");
+  Serial.println(getLogMaxDepth());
+
+  Serial.print("LOG: levels:");
+  for (int module = 0; module < LOG_MODULES; module++) {
+    Serial.print(" ");
+    Serial.print(getLogModuleName(module));
+    Serial.print(":");
+    Serial.print(getLogLevelLetter(logLevels[module]));
+  }
+  Serial.println();
+}
 
-      Serial.print("Setting wrist yaw to ");
-      Serial.println(position);
-    }
+void cmdArbiter(const CommandArgs& args) {
+  // Who owns each joint and for how long, e.g. arbiter, or arbiter:release
+  // to free them all
+  if (args.argIs("release")) {
+    resetArbiter();
   }
-  if (cmdType == "thumb") {
-    if (servoIndex == "pitch") {
-      thumb.setPitch(position);
-      thumb.update();
 
-      Serial.print("Setting thumb pitch to ");
-      Serial.println(position);
+  uint32_t nowMs = millis();
+  Serial.print("ARBITER:");
+  for (uint8_t joint = 0; joint < NUM_JOINTS; joint++) {
+    ControlSource owner = getJointOwner(joint, nowMs);
+    Serial.print(" ");
+    Serial.print(joint);
+    Serial.print(":");
+    Serial.print(getControlSourceName(owner));
+    if (owner != CONTROL_SOURCES) {
+      Serial.print(":");
+      Serial.print(getJointLeaseMs(joint, nowMs));
+      Serial.print("ms");
     }
-    if (servoIndex == "yaw") {
-      thumb.setYaw(position);
-      thumb.update();
+  }
+  Serial.print(" denied:");
+  for (int source = 0; source < CONTROL_SOURCES; source++) {
+    Serial.print(" ");
+    Serial.print(getControlSourceName(static_cast<ControlSource>(source)));
+    Serial.print(":");
+    Serial.print(getArbiterDenied(static_cast<ControlSource>(source)));
+  }
+  Serial.print(" takeovers:");
+  Serial.println(getArbiterTakeovers());
+}
 
-      Serial.print("Setting thumb yaw to ");
-      Serial.println(position);
-    }
-    if (servoIndex == "flexion") {
-      thumb.setFlexion(position);
-      thumb.update();
+void cmdCalibration(const CommandArgs& args) {
+  // Where the servo limits, ranges and rest positions came from, and how long
+  // the servos took to start. calibration:defaults goes back to the compiled
+  // in values, until the next save.
+  if (args.argIs("defaults")) {
+    restoreDefaultCalibration();
+    updateHand();
+  }
+  Serial.print("CALIBRATION: loaded:");
+  Serial.print(getCalibrationLoadResult());
+  Serial.print(" slot:");
+  Serial.print(getCalibrationSlot());
+  Serial.print(" sequence:");
+  Serial.print(getCalibrationSequence());
+  Serial.print(" length:");
+  Serial.print(CALIBRATION_LENGTH);
+  Serial.print(" firstpulse:");
+  Serial.print(firstPulseUs);
+  Serial.println("us");
+}
 
-      Serial.print("Setting thumb flexion to ");
-      Serial.println(position);
-    }
-    if (servoIndex == "roll") {
-      thumb.setRoll(position);
-      thumb.update();
+void cmdSave(const CommandArgs& args) {
+  // Saves the calibration to flash. save:rest makes where each servo is now
+  // its rest position first.
+  if (args.argIs("rest")) {
+    setRestPositions();
+  }
+  CalibrationResult result = saveCalibration(calibrationStorage);
+  Serial.print("SAVE: ");
+  Serial.print(result == CALIBRATION_OK ? "ok" : "failed");
+  Serial.print(" slot:");
+  Serial.print(getCalibrationSlot());
+  Serial.print(" sequence:");
+  Serial.println(getCalibrationSequence());
+}
 
-      Serial.print("Setting thumb roll to ");
-      Serial.println(position);
-    }
+void cmdServoStats(const CommandArgs& args) {
+  // Servo writes that reached the hardware vs. skipped because nothing changed
+  Serial.print("SERVOSTATS: issued:");
+  Serial.print(ManagedServo::getWritesIssued());
+  Serial.print(" skipped:");
+  Serial.print(ManagedServo::getWritesSkipped());
+
+  // Batched frames, and the time between the first and last servo write in one
+  Serial.print(" frames:");
+  Serial.print(ManagedServo::getFramesCommitted());
+  Serial.print(" deferred:");
+  Serial.print(ManagedServo::getFramesDeferred());
+  Serial.print(" spread:");
+  Serial.print(ManagedServo::getLastFrameSpreadUs());
+  Serial.print("us maxspread:");
+  Serial.print(ManagedServo::getMaxFrameSpreadUs());
+  Serial.println("us");
+
+  if (args.argIs("reset")) {
+    ManagedServo::resetWriteCounters();
   }
-  if (cmdType == "one") {
-    setOnePose();
+}
+
+void cmdStats(const CommandArgs& args) {
+  // Where the time goes between a DOF packet arriving and the servos moving
+  Serial.print("STATS: received:");
+  Serial.print(getDofPacketsReceived());
+  Serial.print(" badlength:");
+  Serial.print(getDofPacketsBadLength());
+  Serial.print(" badchecksum:");
+  Serial.print(getDofPacketsBadChecksum());
+  Serial.print(" coalesced:");
+  Serial.println(getDofFramesCoalesced());
+
+#if LATENCY_INSTRUMENTATION
+  for (int stage = 0; stage < LATENCY_STAGES; stage++) {
+    const LatencyHistogram& histogram = latencyHistograms[stage];
+    Serial.print("STATS:");
+    Serial.print(getLatencyStageName(stage));
+    Serial.print(" count:");
+    Serial.print(histogram.getCount());
+    Serial.print(" p50:");
+    Serial.print(histogram.getPercentile(50) / static_cast<double>(LATENCY_TICKS_PER_US), 1);
+    Serial.print("us p90:");
+    Serial.print(histogram.getPercentile(90) / static_cast<double>(LATENCY_TICKS_PER_US), 1);
+    Serial.print("us p99:");
+    Serial.print(histogram.getPercentile(99) / static_cast<double>(LATENCY_TICKS_PER_US), 1);
+    Serial.print("us max:");
+    Serial.print(histogram.getMax() / static_cast<double>(LATENCY_TICKS_PER_US), 1);
+    Serial.println("us");
   }
-  if (cmdType == "two") {
-    setTwoPose();
+#else
+  Serial.println("STATS: latency instrumentation is compiled out");
+#endif
+
+  if (args.argIs("reset")) {
+    resetLatency();
   }
-  if (cmdType == "three") {
-    setThreePose();
+}
+
+void cmdProfile(const CommandArgs& args) {
+  // How busy the loop is, and where its time goes
+#if PROFILING
+  Serial.print("PROFILE: passes:");
+  Serial.print(profiler.getPasses());
+  Serial.print(" idlepasses:");
+  Serial.print(profiler.getIdlePasses());
+  Serial.print(" busy:");
+  Serial.print(profiler.getUtilisation() / 10.0, 1);
+  Serial.print("% window:");
+  Serial.print(profiler.getWindowUtilisation() / 10.0, 1);
+  Serial.println("%");
+
+  for (int section = 0; section < PROFILE_SECTIONS; section++) {
+    const LatencyHistogram& histogram = profiler.getSection(section);
+    Serial.print("PROFILE:");
+    Serial.print(Profiler::getSectionName(section));
+    Serial.print(" count:");
+    Serial.print(histogram.getCount());
+    Serial.print(" min:");
+    Serial.print(histogram.getMin() / static_cast<double>(LATENCY_TICKS_PER_US), 1);
+    Serial.print("us mean:");
+    Serial.print(histogram.getMean() / static_cast<double>(LATENCY_TICKS_PER_US), 1);
+    Serial.print("us p99:");
+    Serial.print(histogram.getPercentile(99) / static_cast<double>(LATENCY_TICKS_PER_US), 1);
+    Serial.print("us max:");
+    Serial.print(histogram.getMax() / static_cast<double>(LATENCY_TICKS_PER_US), 1);
+    Serial.println("us");
   }
-  if (cmdType == "four") {
-    setFourPose();
+#else
+  Serial.println("PROFILE: profiling is compiled out");
+#endif
+
+  if (args.argIs("reset")) {
+    profiler.reset();
   }
-  if (cmdType == "default") {
-    setDefaultPose();
+}
+
+void cmdRecord(const CommandArgs& args) {
+  // The last few seconds of DOF packets, as they arrived. record:dump prints
+  // them (see DofRecorder.h for the format), record:on and record:off start
+  // and stop the capture, and record:clear empties it.
+  if (args.argIs("dump")) {
+    requestDofDump();
   }
-  if (cmdType == "count") {
-    count();
+  else if (args.argIs("on")) {
+    setDofRecording(true);
   }
-  if (cmdType == "wave") {
-    wave();
+  else if (args.argIs("off")) {
+    setDofRecording(false);
   }
-  if (cmdType == "shaka") {
-    shaka();
+  else if (args.argIs("clear")) {
+    requestDofRecordingClear();
   }
-  if (cmdType == "thumbtest") {
-    thumbRangeTest();
+  Serial.print("RECORD: recording:");
+  Serial.print(isDofRecording() ? "on" : "off");
+  Serial.print(" records:");
+  Serial.print(getDofRecordCount());
+  Serial.print(" bytes:");
+  Serial.print(getDofRecordBytes());
+  Serial.print(" span:");
+  Serial.print(getDofRecordSpanUs());
+  Serial.print("us recorded:");
+  Serial.print(getDofRecordsRecorded());
+  Serial.print(" overwritten:");
+  Serial.print(getDofRecordsOverwritten());
+  Serial.print(" activity:");
+  Serial.println(getDofRecorderActivityName());
+}
+
+void cmdReplay(const CommandArgs& args) {
+  // Plays the capture back through the stream, at its original timing or
+  // faster, e.g. replay:4 for four times as fast. replay:stop ends it early.
+  uint8_t speed = static_cast<uint8_t>(args.count > 0 ? CLAMP(args.index, 1, DOF_REPLAY_MAX_SPEED) : 1);
+  if (args.argIs("stop")) {
+    requestDofRecorderStop();
   }
-  if (cmdType == "fingertest") {
-    fingerTest();
+  else {
+    requestDofReplay(speed);
   }
-  if (cmdType == "hb") {
-    connectionTimeout.resetTimerValue();
-    Serial.println("HB: Heartbeat received");
+  Serial.print("REPLAY: speed:");
+  Serial.print(args.argIs("stop") ? 0 : speed);
+  Serial.print(" records:");
+  Serial.print(getDofRecordCount());
+  Serial.print(" replayed:");
+  Serial.print(getDofRecordsReplayed());
+  Serial.print(" held:");
+  Serial.println(getDofLivePacketsHeld());
+}
+
+void cmdTasks(const CommandArgs& args) {
+  // The loop's tasks, and how well each is keeping to its period and budget
+  Serial.print("TASKS: overruns:");
+  Serial.println(scheduler.getOverruns());
+
+  for (int i = 0; i < scheduler.getTaskCount(); i++) {
+    const SchedulerTask& task = scheduler.getTask(i);
+    Serial.print("TASKS:");
+    Serial.print(task.name);
+    Serial.print(task.enabled ? "" : " (off)");
+    Serial.print(" period:");
+    Serial.print(task.periodUs);
+    Serial.print("us budget:");
+    Serial.print(task.budgetUs);
+    Serial.print("us runs:");
+    Serial.print(task.runs);
+    Serial.print(" overruns:");
+    Serial.print(task.overruns);
+    Serial.print(" skipped:");
+    Serial.print(task.skipped);
+    Serial.print(" meanrun:");
+    Serial.print(task.runs > 0 ? static_cast<uint32_t>(task.totalRunUs / task.runs) : 0);
+    Serial.print("us maxrun:");
+    Serial.print(task.maxRunUs);
+    Serial.print("us maxlate:");
+    Serial.print(task.maxLateUs);
+    Serial.println("us");
   }
-  if (cmdType == "gesture") {
-    if (servoIndex == "count") {
-      count();
-    }
-    if (servoIndex == "wave") {
-      wave();
-    }
-    if (servoIndex == "shaka") {
-      shaka();
-    }
-    if (servoIndex == "reset") {
-      setDefaultPose();
-      delay(500);
-    }
+
+  if (args.argIs("reset")) {
+    scheduler.resetStats();
   }
-  if (cmdType == "dofs") {
-    Serial.println(printDOFS().c_str());
+}
+
+// Sorted by name, for the parser's binary search
+constexpr Command COMMANDS[] = {
+  { "arbiter", cmdArbiter },
+  { "calibration", cmdCalibration },
+  { "count", cmdCount },
+  { "default", cmdDefault },
+  { "dof", cmdDof },
+  { "dofs", cmdDofs },
+  { "fingerextension", cmdFingerExtension },
+  { "fingermax", cmdFingerMax },
+  { "fingermin", cmdFingerMin },
+  { "fingertest", cmdFingerTest },
+  { "four", cmdFour },
+  { "gesture", cmdGesture },
+  { "hb", cmdHeartbeat },
+  { "jitter", cmdJitter },
+  { "log", cmdLog },
+  { "max", cmdMax },
+  { "min", cmdMin },
+  { "motion", cmdMotion },
+  { "one", cmdOne },
+  { "pose", cmdPose },
+  { "profile", cmdProfile },
+  { "record", cmdRecord },
+  { "replay", cmdReplay },
+  { "save", cmdSave },
+  { "servostats", cmdServoStats },
+  { "set", cmdSet },
+  { "shaka", cmdShaka },
+  { "stats", cmdStats },
+  { "streamstats", cmdStreamStats },
+  { "tasks", cmdTasks },
+  { "three", cmdThree },
+  { "thumb", cmdThumb },
+  { "thumbtest", cmdThumbTest },
+  { "two", cmdTwo },
+  { "wave", cmdWave },
+  { "wrist", cmdWrist }
+};
+
+static_assert(CommandParser::isSorted(COMMANDS, sizeof(COMMANDS) / sizeof(COMMANDS[0])), "COMMANDS must be sorted by name");
+
+constexpr CommandParser commandParser(COMMANDS, sizeof(COMMANDS) / sizeof(COMMANDS[0]));
+
+// Runs one command line, which is modified in place, from the given source
+void processCommand(char* line, ControlSource source) {
+  PROFILE_SCOPE(PROFILE_COMMAND);
+  CommandArgs args;
+  if (!CommandParser::parse(line, args)) {
+    return;
   }
+  commandSource = source;
+
+  LOG_TEXT(COMMAND, args.name, args.index, args.value);
+
+  commandParser.dispatch(args);
+}
+
+// Text for the central on the TX characteristic. The BLE stack belongs to
+// core 0, so the control core queues it (see ControlCore.h).
+void sendReply(const char* text) {
+#if DUAL_CORE_CONTROL
+  ControlReply reply;
+  strncpy(reply.text, text, CONTROL_REPLY_LENGTH);
+  reply.text[CONTROL_REPLY_LENGTH] = '\0';
+  controlReplies.push(reply);
+#else
+  txCharacteristic.writeValue(text);
+#endif
 }
 
+// The central has gone, and its commands' leases and its stream with it. The
+// joints nobody else holds go back to the default pose, without a lease that
+// would keep the next central's stream off them.
+void centralDisconnected() {
+  dropDofStreamFrames();
+  releaseJoints(CONTROL_SOURCE_UART, HAND_JOINTS_ALL);
+  releaseJoints(CONTROL_SOURCE_STREAM, HAND_JOINTS_ALL);
+  setDefaultPose(getClaimableJoints(CONTROL_SOURCE_STREAM, HAND_JOINTS_ALL, millis()));
+}
 
-// This method is called to process all of the higher level objects (Finger,Thumb)
-// and update the servo positions based on the current hand angles.
-void updateHand() {
-  // Update fingers
-  for (int index = 0; index < NUM_FINGERS; index++) {
-    fingers[index].update();
+// Runs a command line, binary pose command or disconnect, on the core that owns the hand
+void runControlMessage(ControlMessage& message) {
+  if (message.type == CONTROL_MESSAGE_DISCONNECTED) {
+    centralDisconnected();
+  }
+  else if (message.length > 0 && (message.data[0] & 0x80)) {
+    PoseCommandResult result = receivePoseCommand(message.data, message.length,
+                                                  static_cast<ControlSource>(message.source), millis());
+
+    // The uploader waits for the result of a commit, and hears about errors
+    if (result != POSE_COMMAND_OK || message.data[0] == POSE_OP_COMMIT) {
+      char reply[CONTROL_REPLY_LENGTH + 1];
+      snprintf(reply, sizeof(reply), "POSE:%d", static_cast<int>(result));
+      sendReply(reply);
+      Serial.println(reply);
+    }
+  }
+  else {
+    processCommand(reinterpret_cast<char*>(message.data), static_cast<ControlSource>(message.source));
   }
-  // Update thumb
-  thumb.update();
+}
 
-  // Update wrist
-  wrist.update();
+// Hands a message to the hand: straight away, or over the queue to the
+// control core
+void postToControl(ControlMessage& message) {
+#if DUAL_CORE_CONTROL
+  if (!controlMessages.push(message)) {
+    LOG(CONTROL_QUEUE_FULL);
+  }
+#else
+  runControlMessage(message);
+#endif
+}
 
+// Text commands are ASCII, so a byte with the top bit set starts a binary
+// pose command (see PoseLibrary.h)
+void sendToControl(const uint8_t* data, size_t length, ControlSource source) {
+  ControlMessage message;
+  message.length = static_cast<uint8_t>(length < COMMAND_MAX_LENGTH ? length : COMMAND_MAX_LENGTH);
+  message.type = CONTROL_MESSAGE_COMMAND;
+  message.source = source;
+  memcpy(message.data, data, message.length);
+  message.data[message.length] = '\0';
+  postToControl(message);
 }
 
-void loop() {
+void sendToControl(const char* line, ControlSource source) {
+  sendToControl(reinterpret_cast<const uint8_t*>(line), strlen(line), source);
+}
 
-  // ---- Serial Input Loop -----
-  // If there is no active BLE connection to the peripheral, then we will
-  // process serial commands for debugging/tuning/testing etc.
+// See centralDisconnected()
+void sendDisconnectToControl() {
+  ControlMessage message;
+  message.length = 0;
+  message.type = CONTROL_MESSAGE_DISCONNECTED;
+  message.source = CONTROL_SOURCE_UART;
+  message.data[0] = '\0';
+  postToControl(message);
+}
 
-  // Is there serial data available for input?
-  if (Serial.available()) {
-    String cmd = Serial.readStringUntil('\n');
+// --- Tasks -----------------------------------
+// The loop's work, run by the scheduler. None of them may block: anything
+// that has to wait is checked again on the task's next run.
 
-    Serial.print("Received CMD: ");
-    Serial.println(cmd);
+#if !DUAL_CORE_CONTROL
+// Applies the newest streamed frame and steps the joints
+void taskControl() {
+  controlTick();
+}
+#endif
+
+// BLE polling, where the characteristic handlers run, and the connection
+void taskBle() {
+  takeDofStreamRequests();
+
+  if (!centralConnected) {
+    BLEDevice central = BLE.central();
+    if (central) {
+      Serial.print("Connected to central - entering BLE streaming mode:");
+      Serial.println(central.address());  // print the central's MAC address
+
+      // Start a fresh connection timeout timer
+      connectedCentral = central;
+      centralConnected = true;
+      connectionTimeout.resetTimerValue();
+      restartDofStream();
+      scheduler.setEnabled(heartbeatTask, true);
+      scheduler.setEnabled(timeoutTask, true);
+    }
+  }
+  else if (!connectedCentral.connected()) {
+    Serial.print("Disconnected from central: ");
+    Serial.println(connectedCentral.address());
+    centralConnected = false;
+    restartDofStream();
+    scheduler.setEnabled(heartbeatTask, false);
+    scheduler.setEnabled(timeoutTask, false);
+    sendDisconnectToControl();
+  }
 
-    processCommand(cmd);
+#if DUAL_CORE_CONTROL
+  // Pass on what the control core has for the central
+  ControlReply reply;
+  while (controlReplies.pop(reply)) {
+    txCharacteristic.writeValue(reply.text);
   }
+#endif
+}
 
-  
-  // ----- BLE Loop -----
-  // If there is an active BLE connection to the peripheral, then we will
-  // ignore serial processing and run in a tight loop where we receive
-  // packets with the hand angles and convert those into servo positions
-  
-  BLEDevice central = BLE.central();  // wait for a BLE central
+// Serial commands for debugging/tuning/testing etc, connected or not
+void taskSerial() {
+  // Takes what has arrived and never waits for the rest of a line, one line per run
+  static CommandLineReader reader;
+  while (Serial.available()) {
+    if (reader.add(static_cast<char>(Serial.read()))) {
+      Serial.print("Received CMD: ");
+      Serial.println(reader.getLine());
+
+      sendToControl(reader.getLine(), CONTROL_SOURCE_SERIAL);
+      return;
+    }
+  }
+}
+
+// Heartbeat to the central, while one is connected
+void taskHeartbeat() {
+  heartbeat++;
+  String data = "HB:" + String(heartbeat);
+  txCharacteristic.writeValue(data.c_str());
+}
 
-  if (central) {  // if a central is connected to the peripheral:
-    Serial.print("Connected to central - entering BLE streaming mode:");
-    Serial.println(central.address());  // print the central's MAC address
-   
-    // Start a fresh connection timeout timer
+// Makes sure we've received a heartbeat from the central recently. The BLE
+// task sees the disconnect on its next run.
+void taskTimeout() {
+  uint32_t heartbeats = heartbeatsReceived.load(std::memory_order_acquire);
+  if (heartbeats != heartbeatsTaken) {
+    heartbeatsTaken = heartbeats;
     connectionTimeout.resetTimerValue();
+  }
 
+  if (connectionTimeout.check()) {
+    Serial.println("Connection timeout - disconnecting");
+    connectedCentral.disconnect();
+  }
+}
 
-    while (central.connected()) {  // while the central is still connected to peripheral:
-       
-      // Check if it's time to send a heartbeat
-      if (heartbeatTimer.check()) {
-        heartbeat++;
-        String data = "HB:" + String(heartbeat);
-        txCharacteristic.writeValue(data.c_str());
-      }
-
-      // Make sure we've received a heartbeat from the central recently
-      if (connectionTimeout.check())
-      {
-        Serial.println("Connection timeout - disconnecting");
-        central.disconnect();
-        break;
-      }
-      
+// Refreshes the stats for the central to read, and reports tasks that have
+// gone over their budget since the last run
+void taskTelemetry() {
+#if LATENCY_INSTRUMENTATION
+  if (centralConnected) {
+    uint8_t stats[LATENCY_STATS_LENGTH];
+    statsCharacteristic.writeValue(stats, encodeLatencyStats(stats));
+  }
+#endif
+
+  for (int i = 0; i < scheduler.getTaskCount(); i++) {
+    const SchedulerTask& task = scheduler.getTask(i);
+    if (task.overruns > overrunsReported[i]) {
+      Serial.print("OVERRUN:");
+      Serial.print(task.name);
+      Serial.print(" overruns:");
+      Serial.print(task.overruns);
+      Serial.print(" maxrun:");
+      Serial.print(task.maxRunUs);
+      Serial.print("us budget:");
+      Serial.print(task.budgetUs);
+      Serial.println("us");
     }
-
-    Serial.print("Disconnected from central: ");
-    Serial.println(central.address());
-    setDefaultPose();
+    overrunsReported[i] = task.overruns;
   }
+}
+
+// Dumps or replays the DOF capture, a few records at a time. On the same core
+// as the BLE handler, which records into it.
+void taskRecorder() {
+  runDofRecorder();
+}
 
-  // ----- Demo Button Loop -----
-  // If the demo button is pressed, then we will run through a series of canned poses
-  // to demonstrate the hand functionality
-  if (digitalRead(DEMO_BUTTON) == LOW) {
+// Prints what's been logged, a few records at a time so a burst can't hold
+// the other tasks up
+void taskLog() {
+  drainLog(LOG_DRAIN_RECORDS);
+}
+
+// If the demo button is pressed, then we will run through a series of canned poses
+// to demonstrate the hand functionality. They play from the control tick.
+void taskButton() {
+  if (digitalRead(DEMO_BUTTON) == LOW && !gesturePlayer.isPlaying()) {
     Serial.println("Demo button pressed");
-    wave();
-    delay(500);
-    fingerTest();
-    delay(500);
-    count();
-    delay(500);
-    shaka();
-    delay(500);
-    setDefaultPose();
-    delay(500);
+    sendToControl("gesture:demo", CONTROL_SOURCE_GESTURE);
   }
-  
 }
 
-void rxHandler(BLEDevice central, BLECharacteristic characteristic) {
-  String receivedData = reinterpret_cast<const char*>(characteristic.value());  // get the data
+// Periods and budgets in microseconds. Tasks that tie for a deadline run in
+// the order they're added, so the control tick goes first.
+void setupTasks() {
+  uint32_t nowUs = micros();
+#if !DUAL_CORE_CONTROL
+  scheduler.addTask("control", taskControl, 1000000 / CONTROL_RATE_HZ, 2000, nowUs);
+#endif
+  scheduler.addTask("ble", taskBle, 1000, 1000, nowUs);
+  scheduler.addTask("serial", taskSerial, 10000, 5000, nowUs);
+  heartbeatTask = scheduler.addTask("heartbeat", taskHeartbeat, 5000000, 1000, nowUs);
+  timeoutTask = scheduler.addTask("timeout", taskTimeout, 100000, 1000, nowUs);
+  scheduler.addTask("telemetry", taskTelemetry, 1000000, 5000, nowUs);
+  scheduler.addTask("button", taskButton, 50000, 1000, nowUs);
+  scheduler.addTask("log", taskLog, 10000, 2000, nowUs);
+  scheduler.addTask("recorder", taskRecorder, 1000, 1000, nowUs);
+
+  // Only while a central is connected
+  scheduler.setEnabled(heartbeatTask, false);
+  scheduler.setEnabled(timeoutTask, false);
+}
 
-  // Extract all data up to newline
-  int newlinePos = receivedData.indexOf('\n');
-  if (newlinePos != -1)
-  {
-    receivedData = receivedData.substring(0, newlinePos);
-      processCommand(receivedData);
-  }  
+
+void loop() {
+  // Each pass runs at most one task. The time left over until the next one
+  // is due is spent asleep, which on mbed lets the RTOS idle the core.
+  PROFILE_SCOPE(PROFILE_LOOP);
+
+  if (!scheduler.runNext()) {
+    uint32_t idleUs = scheduler.getIdleUs();
+    if (idleUs >= 1000) {
+      delay(idleUs / 1000);
+    }
+  }
 }
 
-#define DOF_COUNT 17
-void dofHandler(BLEDevice central, BLECharacteristic characteristic) {
+#if DUAL_CORE_CONTROL
+// ----- Control Core -----
+// Owns the hand once setup() is done with it: runs the commands core 0
+// hands over, and the control tick
 
-  // The angles are packed into 8-bit values centered at 128, so we need to
-  // unpack them and convert them back into decimal angles for the servos
-  const uint8_t* data = characteristic.value();
+void setup1() {
+  while (!handReady.load(std::memory_order_acquire)) {
+  }
+}
 
-  // Simple data integrity checks
-  if (characteristic.valueLength() != DOF_COUNT+1) {
-    Serial.print("Invalid DOF length: ");
-    Serial.println(characteristic.valueLength());
-    return;
+void loop1() {
+  ControlMessage message;
+  while (controlMessages.pop(message)) {
+    runControlMessage(message);
   }
-  
-  // Last byte is a checksum - check against other bytes
-  uint8_t checksum = 0;
-  for (int i = 0; i < DOF_COUNT; i++) {
-    checksum += data[i];
-  }
-  if (checksum != data[DOF_COUNT]) {
-    Serial.print("Invalid DOF checksum: ");
-    Serial.println(checksum);
-    return;
+
+  if (controlTimer.check()) {
+    controlTick();
   }
+}
+#endif
 
-  Serial.println(characteristic.valueLength());
-  int16_t unpackedAngles[DOF_COUNT];
+void rxHandler(BLEDevice central, BLECharacteristic characteristic) {
+  PROFILE_SCOPE(PROFILE_RX_HANDLER);
 
-  for (int i = 0; i < DOF_COUNT; i++) {
-    float angle = (data[i] - 127)*360.0/256.0;
-    unpackedAngles[i] = static_cast<int16_t>(angle);
+  // Binary pose commands go as they are
+  const uint8_t* value = characteristic.value();
+  int length = characteristic.valueLength();
+  if (length > 0 && (value[0] & 0x80)) {
+    sendToControl(value, length, CONTROL_SOURCE_UART);
+    return;
   }
 
-  #ifdef DEBUG  // Useful debug prints for tuning
-  // Print out the angles
-  Serial.print("DOF: ");
-    
-  for (int i = 0; i < DOF_COUNT; i++) {
-    Serial.print(unpackedAngles[i]);
-    Serial.print(" ");
+  // Extract all data up to newline
+  char line[COMMAND_MAX_LENGTH + 1];
+  if (CommandParser::extractLine(value, length, line))
+  {
+    sendToControl(line, CONTROL_SOURCE_UART);
   }
-  Serial.println();
-  #endif
+}
 
+void dofHandler(BLEDevice central, BLECharacteristic characteristic) {
+  PROFILE_SCOPE(PROFILE_DOF_HANDLER);
 
-  // Fingers first
-  for (int i = 0; i < NUM_FINGERS; i++) {
-    fingers[i].setPitch(unpackedAngles[i*3]);
-    fingers[i].setYaw(unpackedAngles[i*3+1]);
-    fingers[i].setFlexion(unpackedAngles[i*3+2]);
+  // Kept for record:dump, unless a replay is running, which has the stream
+  // to itself
+  if (!recordDofPacket(characteristic.value(), characteristic.valueLength())) {
+    return;
   }
 
-  // Thumb
-  thumb.setPitch(unpackedAngles[12]);
-  thumb.setYaw(unpackedAngles[13]);
-  thumb.setFlexion(unpackedAngles[14]);
-
-  // Wrist
-  wrist.setPitch(unpackedAngles[15]);
-  wrist.setYaw(unpackedAngles[16]);
+  // Only validate and hand the frame over - the control tick applies it
+  DofPacketResult result = receiveDofPacket(characteristic.value(), characteristic.valueLength());
 
-
-  updateHand();
-    
+  if (result == DOF_PACKET_BAD_LENGTH) {
+    LOG(DOF_BAD_LENGTH, characteristic.valueLength());
+  }
+  else if (result == DOF_PACKET_BAD_CHECKSUM) {
+    LOG(DOF_BAD_CHECKSUM);
+  }
+  else if (result == DOF_PACKET_BAD_VERSION) {
+    LOG(DOF_BAD_VERSION);
+  }
 }
@@ -0,0 +1,249 @@
+#include "DofProtocol.h"
+
+
+// The CRC table is built at compile time and lives in flash
+struct Crc16Table {
+  uint16_t values[256];
+
+  constexpr Crc16Table() : values() {
+    for (int byte = 0; byte < 256; byte++) {
+      uint16_t crc = static_cast<uint16_t>(byte << 8);
+      for (int bit = 0; bit < 8; bit++) {
+        crc = static_cast<uint16_t>((crc & 0x8000) ? ((crc << 1) ^ 0x1021) : (crc << 1));
+      }
+      values[byte] = crc;
+    }
+  }
+};
+
+static constexpr Crc16Table CRC16_TABLE;
+
+static_assert(CRC16_TABLE.values[1] == 0x1021, "CRC table generation is broken");
+
+
+uint16_t crc16(const uint8_t* data, size_t length) {
+  uint16_t crc = 0xFFFF;
+  for (size_t i = 0; i < length; i++) {
+    crc = static_cast<uint16_t>((crc << 8) ^ CRC16_TABLE.values[((crc >> 8) ^ data[i]) & 0xFF]);
+  }
+  return crc;
+}
+
+
+static inline uint16_t readUint16(const uint8_t* data) {
+  return static_cast<uint16_t>(data[0] | (data[1] << 8));
+}
+
+static inline uint32_t readUint32(const uint8_t* data) {
+  return static_cast<uint32_t>(data[0]) | (static_cast<uint32_t>(data[1]) << 8) |
+    (static_cast<uint32_t>(data[2]) << 16) | (static_cast<uint32_t>(data[3]) << 24);
+}
+
+static inline void writeUint16(uint8_t* data, uint16_t value) {
+  data[0] = static_cast<uint8_t>(value);
+  data[1] = static_cast<uint8_t>(value >> 8);
+}
+
+static inline void writeUint32(uint8_t* data, uint32_t value) {
+  writeUint16(data, static_cast<uint16_t>(value));
+  writeUint16(data + 2, static_cast<uint16_t>(value >> 16));
+}
+
+
+// Hundredths of a degree, as they're kept in the frame
+static inline int16_t readAngle(const uint8_t* data) {
+  return static_cast<int16_t>(readUint16(data));
+}
+
+
+static DofPacketResult decodeV1(const uint8_t* data, DofFrame& frame) {
+  // Last byte is a checksum - check against other bytes
+  uint8_t checksum = 0;
+  for (int i = 0; i < DOF_COUNT; i++) {
+    checksum += data[i];
+  }
+  if (checksum != data[DOF_COUNT]) {
+    return DOF_PACKET_BAD_CHECKSUM;
+  }
+
+  // The angles are packed into 8-bit values centered at 127. 256 steps cover
+  // 360 degrees, and the division truncates toward zero the same way the
+  // float version of this did, before scaling up to the frame's units.
+  for (int i = 0; i < DOF_COUNT; i++) {
+    frame.angles[i] = static_cast<int16_t>(((data[i] - 127) * 360) / 256 * DOF_V2_ANGLE_SCALE);
+  }
+  frame.mask = DOF_ALL_MASK;
+  frame.sequence = 0;
+  frame.timestamp = 0;
+  frame.version = DOF_PROTOCOL_V1;
+  return DOF_PACKET_OK;
+}
+
+static DofPacketResult decodeV2(const uint8_t* data, DofFrame& frame) {
+  if (data[0] != DOF_PROTOCOL_V2 || data[1] != DOF_COUNT) {
+    return DOF_PACKET_BAD_VERSION;
+  }
+  if (crc16(data, DOF_V2_PACKET_LENGTH - 2) != readUint16(data + DOF_V2_PACKET_LENGTH - 2)) {
+    return DOF_PACKET_BAD_CHECKSUM;
+  }
+
+  const uint8_t* angles = data + DOF_V2_HEADER_LENGTH;
+  for (int i = 0; i < DOF_COUNT; i++) {
+    frame.angles[i] = readAngle(angles + 2*i);
+  }
+  frame.mask = DOF_ALL_MASK;
+  frame.sequence = readUint16(data + 2);
+  frame.timestamp = readUint32(data + 4);
+  frame.version = DOF_PROTOCOL_V2;
+  return DOF_PACKET_OK;
+}
+
+static DofPacketResult decodeDelta(const uint8_t* data, int length, DofFrame& frame) {
+  if (length < DOF_DELTA_PACKET_LENGTH(0)) {
+    return DOF_PACKET_BAD_LENGTH;
+  }
+  if (data[1] != DOF_COUNT) {
+    return DOF_PACKET_BAD_VERSION;
+  }
+
+  uint32_t mask = readUint16(data + DOF_V2_HEADER_LENGTH) | (static_cast<uint32_t>(data[DOF_V2_HEADER_LENGTH + 2]) << 16);
+  if (mask & ~DOF_ALL_MASK) {
+    return DOF_PACKET_BAD_VERSION;
+  }
+  if (length != DOF_DELTA_PACKET_LENGTH(dofMaskCount(mask))) {
+    return DOF_PACKET_BAD_LENGTH;
+  }
+  if (crc16(data, length - 2) != readUint16(data + length - 2)) {
+    return DOF_PACKET_BAD_CHECKSUM;
+  }
+
+  const uint8_t* angles = data + DOF_DELTA_HEADER_LENGTH;
+  for (int i = 0; i < DOF_COUNT; i++) {
+    if (mask & (1ul << i)) {
+      frame.angles[i] = readAngle(angles);
+      angles += 2;
+    }
+  }
+  frame.mask = mask;
+  frame.sequence = readUint16(data + 2);
+  frame.timestamp = readUint32(data + 4);
+  frame.version = DOF_PROTOCOL_DELTA;
+  return DOF_PACKET_OK;
+}
+
+DofPacketResult decodeDofPacket(const uint8_t* data, int length, DofFrame& frame) {
+  // The legacy frame has no version byte, so it's told apart by its length.
+  // Delta frames are always an odd length, so they can't be mistaken for it.
+  if (length == DOF_V1_PACKET_LENGTH) {
+    return decodeV1(data, frame);
+  }
+  if (length == DOF_V2_PACKET_LENGTH && data[0] != DOF_PROTOCOL_DELTA) {
+    return decodeV2(data, frame);
+  }
+  if (length > 0 && data[0] == DOF_PROTOCOL_DELTA) {
+    return decodeDelta(data, length, frame);
+  }
+  return DOF_PACKET_BAD_LENGTH;
+}
+
+
+int encodeDofPacketV1(const int16_t angles[DOF_COUNT], uint8_t* buffer) {
+  // Same packing as the Python streamers: -180..180 degrees onto 0..255
+  uint8_t checksum = 0;
+  for (int i = 0; i < DOF_COUNT; i++) {
+    int32_t angle = angles[i] < -180 ? -180 : (angles[i] > 180 ? 180 : angles[i]);
+    buffer[i] = static_cast<uint8_t>(((angle + 180) * 255) / 360);
+    checksum += buffer[i];
+  }
+  buffer[DOF_COUNT] = checksum;
+  return DOF_V1_PACKET_LENGTH;
+}
+
+int encodeDofPacketV2(const int16_t centidegrees[DOF_COUNT], uint16_t sequence, uint32_t timestamp, uint8_t* buffer) {
+  buffer[0] = DOF_PROTOCOL_V2;
+  buffer[1] = DOF_COUNT;
+  writeUint16(buffer + 2, sequence);
+  writeUint32(buffer + 4, timestamp);
+
+  uint8_t* angles = buffer + DOF_V2_HEADER_LENGTH;
+  for (int i = 0; i < DOF_COUNT; i++) {
+    writeUint16(angles + 2*i, static_cast<uint16_t>(centidegrees[i]));
+  }
+
+  writeUint16(buffer + DOF_V2_PACKET_LENGTH - 2, crc16(buffer, DOF_V2_PACKET_LENGTH - 2));
+  return DOF_V2_PACKET_LENGTH;
+}
+
+int encodeDofPacketDelta(const int16_t centidegrees[DOF_COUNT], uint32_t mask, uint16_t sequence, uint32_t timestamp, uint8_t* buffer) {
+  mask &= DOF_ALL_MASK;
+
+  buffer[0] = DOF_PROTOCOL_DELTA;
+  buffer[1] = DOF_COUNT;
+  writeUint16(buffer + 2, sequence);
+  writeUint32(buffer + 4, timestamp);
+  writeUint16(buffer + DOF_V2_HEADER_LENGTH, static_cast<uint16_t>(mask));
+  buffer[DOF_V2_HEADER_LENGTH + 2] = static_cast<uint8_t>(mask >> 16);
+
+  uint8_t* angles = buffer + DOF_DELTA_HEADER_LENGTH;
+  for (int i = 0; i < DOF_COUNT; i++) {
+    if (mask & (1ul << i)) {
+      writeUint16(angles, static_cast<uint16_t>(centidegrees[i]));
+      angles += 2;
+    }
+  }
+
+  int length = static_cast<int>(angles - buffer) + 2;
+  writeUint16(buffer + length - 2, crc16(buffer, length - 2));
+  return length;
+}
+
+
+uint32_t dofChangedMask(const int16_t previous[DOF_COUNT], const int16_t current[DOF_COUNT], int16_t deadband) {
+  uint32_t mask = 0;
+  for (int i = 0; i < DOF_COUNT; i++) {
+    int32_t change = current[i] - previous[i];
+    if (change > deadband || change < -deadband) {
+      mask |= 1ul << i;
+    }
+  }
+  return mask;
+}
+
+uint8_t dofMaskCount(uint32_t mask) {
+  uint8_t count = 0;
+  while (mask) {
+    mask &= mask - 1;
+    count++;
+  }
+  return count;
+}
+
+
+int DofDeltaEncoder::encode(const int16_t centidegrees[DOF_COUNT], uint32_t timestamp, uint8_t* buffer) {
+  uint32_t mask = DOF_ALL_MASK;
+  if (mHaveKeyframe && ++mSinceKeyframe < mKeyframeInterval) {
+    mask = dofChangedMask(mSent, centidegrees, mDeadband);
+    if (mask == 0) {
+      return 0;
+    }
+  }
+
+  int length;
+  if (mask == DOF_ALL_MASK || DOF_DELTA_PACKET_LENGTH(dofMaskCount(mask)) >= DOF_V2_PACKET_LENGTH) {
+    length = encodeDofPacketV2(centidegrees, mSequence, timestamp, buffer);
+    mask = DOF_ALL_MASK;
+    mHaveKeyframe = true;
+    mSinceKeyframe = 0;
+  }
+  else {
+    length = encodeDofPacketDelta(centidegrees, mask, mSequence, timestamp, buffer);
+  }
+
+  for (int i = 0; i < DOF_COUNT; i++) {
+    if (mask & (1ul << i)) {
+      mSent[i] = centidegrees[i];
+    }
+  }
+  mSequence++;
+  return length;
+}
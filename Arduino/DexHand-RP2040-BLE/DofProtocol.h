@@ -0,0 +1,167 @@
+#ifndef DOF_PROTOCOL_H
+#define DOF_PROTOCOL_H
+
+/*
+DOF Streaming Protocol
+
+Wire format for the frames written to the DOF characteristic. The same
+code is built into the host tools, and Python/dof_protocol.py implements
+the sending side for the streaming scripts.
+
+Version 1 (legacy) - 18 bytes, recognised by its length
+
+  0-16   One byte per DOF, the angle packed into 8 bits centered at 127
+         (about 1.4 degree steps)
+  17     Additive checksum of bytes 0-16
+
+Version 2 - 8 + 2*DOF_COUNT + 2 bytes, little endian throughout
+
+  0      Protocol version, DOF_PROTOCOL_V2
+  1      Number of DOFs in the frame, must be DOF_COUNT
+  2-3    Sequence number, incremented by the sender for every frame
+  4-7    Sender timestamp in microseconds, free running
+  8-     Angles, int16 in hundredths of a degree
+  last 2 CRC-16/CCITT-FALSE over everything before it
+
+Delta - 8 + 3 + 2*n + 2 bytes, little endian throughout
+
+  0      DOF_PROTOCOL_DELTA
+  1-7    As version 2
+  8-10   Bitmask of the DOFs in the frame, bit 0 is DOF 0
+  11-    Angles of the n DOFs in the mask, lowest bit first, int16 in
+         hundredths of a degree
+  last 2 CRC-16/CCITT-FALSE over everything before it
+
+A delta frame carries only the DOFs that changed since the last frame the
+sender sent. DOFs not in the mask keep their last value, so the receiver
+needs a full version 2 (or version 1) keyframe before it can use deltas.
+Senders send a keyframe every so often to recover from lost frames, and
+whenever a delta wouldn't be smaller. Delta frames share the version 2
+sequence numbers.
+
+The DOFs are in the same order in every version, the order of the table in
+DofRegistry.cpp:
+
+  0-11   Index, middle, ring, pinky: pitch, yaw, flexion
+  12-14  Thumb pitch, yaw, flexion
+  15-16  Wrist pitch, yaw
+
+A version 2 frame is 44 bytes, so the central needs to negotiate an ATT
+MTU of at least 47. Senders should fall back to version 1 if it can't.
+Delta frames with up to 15 DOFs are no longer than that.
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "Latency.h"
+
+#define DOF_COUNT                 17
+
+#define DOF_PROTOCOL_V1           1
+#define DOF_PROTOCOL_V2           2
+#define DOF_PROTOCOL_DELTA        3
+
+#define DOF_ALL_MASK              ((1ul << DOF_COUNT) - 1)
+
+#define DOF_V1_PACKET_LENGTH      (DOF_COUNT+1)
+#define DOF_V2_HEADER_LENGTH      8
+#define DOF_V2_PACKET_LENGTH      (DOF_V2_HEADER_LENGTH + 2*DOF_COUNT + 2)
+#define DOF_DELTA_HEADER_LENGTH   (DOF_V2_HEADER_LENGTH + 3)
+#define DOF_DELTA_PACKET_LENGTH(n) (DOF_DELTA_HEADER_LENGTH + 2*(n) + 2)
+#define DOF_MAX_PACKET_LENGTH     DOF_DELTA_PACKET_LENGTH(DOF_COUNT)
+
+#define DOF_V2_ANGLE_SCALE        100     // Wire units per degree
+
+// Kept for code that predates version 2
+#define DOF_PACKET_LENGTH         DOF_V1_PACKET_LENGTH
+
+// A decoded frame. Version 1 frames have no sequence number or timestamp,
+// and both are left at 0. Only the angles in the mask are set - that's all
+// of them except in a delta frame.
+//
+// The angles stay in hundredths of a degree, as version 2 sends them, so
+// the jitter buffer interpolates and extrapolates without losing the
+// sender's precision. They're only rounded to the joints' whole degrees as
+// the frame is applied (see dofAngleDegrees()). Version 1 angles are whole
+// degrees scaled up.
+struct DofFrame {
+  int16_t angles[DOF_COUNT];      // Hundredths of a degree
+  uint32_t mask;
+  uint16_t sequence;
+  uint32_t timestamp;             // Sender microseconds
+  uint8_t version;
+#if LATENCY_INSTRUMENTATION
+  uint32_t receivedTicks;         // latencyTicks() when the packet arrived
+#endif
+};
+
+enum DofPacketResult {
+  DOF_PACKET_OK,
+  DOF_PACKET_BAD_LENGTH,
+  DOF_PACKET_BAD_CHECKSUM,
+  DOF_PACKET_BAD_VERSION
+};
+
+// A frame angle rounded to the nearest whole degree
+inline int16_t dofAngleDegrees(int16_t centidegrees) {
+  int32_t half = centidegrees >= 0 ? DOF_V2_ANGLE_SCALE/2 : -DOF_V2_ANGLE_SCALE/2;
+  return static_cast<int16_t>((centidegrees + half) / DOF_V2_ANGLE_SCALE);
+}
+
+// CRC-16/CCITT-FALSE (polynomial 0x1021, initial value 0xFFFF), table driven
+uint16_t crc16(const uint8_t* data, size_t length);
+
+// Checks and unpacks a DOF characteristic write of either version
+DofPacketResult decodeDofPacket(const uint8_t* data, int length, DofFrame& frame);
+
+// Packs a frame for sending. Angles are whole degrees for version 1, and
+// hundredths of a degree for version 2 so senders keep their precision.
+// A delta frame takes the full set of angles and sends the ones in the mask.
+// All return the packet length.
+int encodeDofPacketV1(const int16_t angles[DOF_COUNT], uint8_t* buffer);
+int encodeDofPacketV2(const int16_t centidegrees[DOF_COUNT], uint16_t sequence, uint32_t timestamp, uint8_t* buffer);
+int encodeDofPacketDelta(const int16_t centidegrees[DOF_COUNT], uint32_t mask, uint16_t sequence, uint32_t timestamp, uint8_t* buffer);
+
+// Mask of the DOFs that moved more than the deadband between two sets of angles
+uint32_t dofChangedMask(const int16_t previous[DOF_COUNT], const int16_t current[DOF_COUNT], int16_t deadband);
+
+// Number of DOFs in a mask
+uint8_t dofMaskCount(uint32_t mask);
+
+
+/*
+Sending side of a delta stream, for host tools and tests. Python/dof_protocol.py
+does the same for the streaming scripts.
+
+Each frame offered is compared against what the receiver already has. DOFs
+that moved more than the deadband go out in a delta frame, and if none did
+nothing is sent. A full version 2 keyframe goes out every keyframeInterval
+frames offered, and in place of any delta that wouldn't be smaller.
+*/
+class DofDeltaEncoder {
+    public:
+        constexpr DofDeltaEncoder(int16_t deadband, uint16_t keyframeInterval)
+        : mDeadband(deadband), mKeyframeInterval(keyframeInterval), mSinceKeyframe(0), mSequence(0),
+            mHaveKeyframe(false), mSent{} {
+        }
+
+        // Returns the packet length, or 0 if there's nothing to send
+        int encode(const int16_t centidegrees[DOF_COUNT], uint32_t timestamp, uint8_t* buffer);
+
+        // Forces a keyframe next time, e.g. after reconnecting
+        inline void reset() { mHaveKeyframe = false; }
+
+        inline uint16_t getSequence() const { return mSequence; }
+
+    private:
+        int16_t mDeadband;              // Hundredths of a degree
+        uint16_t mKeyframeInterval;
+        uint16_t mSinceKeyframe;
+        uint16_t mSequence;
+        bool mHaveKeyframe;
+        int16_t mSent[DOF_COUNT];       // What the receiver has for each DOF
+};
+
+
+#endif
@@ -0,0 +1,353 @@
+#include "DofRecorder.h"
+#include "DofStream.h"
+
+#include <Arduino.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+
+
+static_assert((DOF_RECORD_BUFFER_BYTES & (DOF_RECORD_BUFFER_BYTES - 1)) == 0, "DOF_RECORD_BUFFER_BYTES must be a power of two");
+static_assert(DOF_MAX_PACKET_LENGTH <= UINT8_MAX, "Record lengths are one byte");
+
+#define RING_MASK   (DOF_RECORD_BUFFER_BYTES - 1)
+
+enum DofRecorderRequest {
+  REQUEST_DUMP,
+  REQUEST_REPLAY,
+  REQUEST_STOP,
+  REQUEST_CLEAR
+};
+
+// The ring, as free running byte indexes. Only the BLE core touches these.
+static uint8_t ring[DOF_RECORD_BUFFER_BYTES];
+static uint32_t head = 0;
+static uint32_t tail = 0;
+static uint32_t recordCount = 0;
+static uint32_t newestTimeUs = 0;
+
+static uint32_t recordsRecorded = 0;
+static uint32_t recordsOverwritten = 0;
+static uint32_t recordsReplayed = 0;
+static uint32_t livePacketsHeld = 0;
+
+// The record the dump or replay is up to
+static uint32_t cursor = 0;
+static uint32_t dumped = 0;
+static uint32_t replayStartUs = 0;
+static uint32_t replayFirstUs = 0;
+static uint8_t replaySpeed = 1;
+
+// Read by the other core for the status
+static std::atomic<bool> recording(true);
+static std::atomic<uint8_t> activity(DOF_RECORDER_IDLE);
+
+// A request is published by bumping the sequence, after its type and speed.
+// Only loads and stores are used, as the Cortex-M0+ has no atomic
+// read-modify-write instructions.
+static std::atomic<uint8_t> requestType(REQUEST_STOP);
+static std::atomic<uint8_t> requestSpeed(1);
+static std::atomic<uint32_t> requestSequence(0);
+static uint32_t takenSequence = 0;
+
+
+// ----- Ring -----
+
+static void writeRing(uint32_t index, const uint8_t* data, uint32_t length) {
+  for (uint32_t i = 0; i < length; i++) {
+    ring[(index + i) & RING_MASK] = data[i];
+  }
+}
+
+static void readRing(uint32_t index, uint8_t* data, uint32_t length) {
+  for (uint32_t i = 0; i < length; i++) {
+    data[i] = ring[(index + i) & RING_MASK];
+  }
+}
+
+static uint32_t recordTime(uint32_t index) {
+  uint8_t bytes[4];
+  readRing(index, bytes, sizeof(bytes));
+  return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | (static_cast<uint32_t>(bytes[3]) << 24);
+}
+
+static uint8_t recordLength(uint32_t index) {
+  return ring[(index + 4) & RING_MASK];
+}
+
+static uint32_t nextRecord(uint32_t index) {
+  return index + DOF_RECORD_HEADER_LENGTH + recordLength(index);
+}
+
+
+// ----- Recording -----
+
+bool recordDofPacket(const uint8_t* data, int length) {
+  uint8_t current = activity.load(std::memory_order_relaxed);
+  if (current == DOF_RECORDER_REPLAYING) {
+    livePacketsHeld++;
+    return false;
+  }
+  if (!recording.load(std::memory_order_relaxed) || current != DOF_RECORDER_IDLE ||
+      length < 0 || length > DOF_MAX_PACKET_LENGTH) {
+    return true;
+  }
+
+  // The oldest records make way
+  uint32_t needed = DOF_RECORD_HEADER_LENGTH + length;
+  while (DOF_RECORD_BUFFER_BYTES - (head - tail) < needed) {
+    tail = nextRecord(tail);
+    recordCount--;
+    recordsOverwritten++;
+  }
+
+  uint32_t timeUs = micros();
+  uint8_t header[DOF_RECORD_HEADER_LENGTH] = {
+    static_cast<uint8_t>(timeUs), static_cast<uint8_t>(timeUs >> 8), static_cast<uint8_t>(timeUs >> 16),
+    static_cast<uint8_t>(timeUs >> 24), static_cast<uint8_t>(length)
+  };
+  writeRing(head, header, sizeof(header));
+  writeRing(head + DOF_RECORD_HEADER_LENGTH, data, length);
+  head += needed;
+  recordCount++;
+  recordsRecorded++;
+  newestTimeUs = timeUs;
+  return true;
+}
+
+
+// ----- Dump and Replay -----
+
+static void finishActivity() {
+  uint8_t current = activity.load(std::memory_order_relaxed);
+  if (current == DOF_RECORDER_DUMPING) {
+    Serial.print("REC:end records:");
+    Serial.println(dumped);
+  }
+  else if (current == DOF_RECORDER_REPLAYING) {
+    // The live stream's sequence has nothing to do with the replay's
+    restartDofStream();
+  }
+  activity.store(DOF_RECORDER_IDLE, std::memory_order_relaxed);
+}
+
+static void startDump() {
+  cursor = tail;
+  dumped = 0;
+  Serial.print("REC:begin records:");
+  Serial.print(recordCount);
+  Serial.print(" span:");
+  Serial.print(getDofRecordSpanUs());
+  Serial.println("us");
+  activity.store(DOF_RECORDER_DUMPING, std::memory_order_relaxed);
+}
+
+static void startReplay(uint8_t speed) {
+  if (recordCount == 0) {
+    return;
+  }
+  cursor = tail;
+  replayFirstUs = recordTime(tail);
+  replayStartUs = micros();
+  replaySpeed = speed;
+  restartDofStream();
+  activity.store(DOF_RECORDER_REPLAYING, std::memory_order_relaxed);
+}
+
+static void takeRequest() {
+  uint32_t sequence = requestSequence.load(std::memory_order_acquire);
+  if (sequence == takenSequence) {
+    return;
+  }
+  takenSequence = sequence;
+
+  finishActivity();
+  switch (requestType.load(std::memory_order_relaxed)) {
+    case REQUEST_DUMP:
+      startDump();
+      break;
+    case REQUEST_REPLAY:
+      startReplay(requestSpeed.load(std::memory_order_relaxed));
+      break;
+    case REQUEST_CLEAR:
+      head = tail = 0;
+      recordCount = 0;
+      break;
+    default:
+      break;
+  }
+}
+
+static void dumpRecords(int maxRecords) {
+  for (int i = 0; i < maxRecords && cursor != head; i++) {
+    uint8_t packet[DOF_MAX_PACKET_LENGTH];
+    uint8_t length = recordLength(cursor);
+    readRing(cursor + DOF_RECORD_HEADER_LENGTH, packet, length);
+
+    char line[DOF_RECORD_LINE_LENGTH + 1];
+    formatDofRecord(recordTime(cursor), packet, length, line, sizeof(line));
+    Serial.println(line);
+    cursor = nextRecord(cursor);
+    dumped++;
+  }
+  if (cursor == head) {
+    finishActivity();
+  }
+}
+
+// Every record whose time has come, at the replay's speed. Arrival times are
+// taken as offsets from the first, so they can wrap.
+static void feedReplay(uint32_t nowUs) {
+  uint32_t elapsedUs = (nowUs - replayStartUs) * replaySpeed;
+  while (cursor != head && recordTime(cursor) - replayFirstUs <= elapsedUs) {
+    uint8_t packet[DOF_MAX_PACKET_LENGTH];
+    uint8_t length = recordLength(cursor);
+    readRing(cursor + DOF_RECORD_HEADER_LENGTH, packet, length);
+
+    receiveDofPacket(packet, length);
+    cursor = nextRecord(cursor);
+    recordsReplayed++;
+  }
+  if (cursor == head) {
+    finishActivity();
+  }
+}
+
+void runDofRecorder() {
+  takeRequest();
+
+  uint8_t current = activity.load(std::memory_order_relaxed);
+  if (current == DOF_RECORDER_DUMPING) {
+    dumpRecords(DOF_DUMP_RECORDS);
+  }
+  else if (current == DOF_RECORDER_REPLAYING) {
+    feedReplay(micros());
+  }
+}
+
+
+// ----- Requests -----
+
+static void request(DofRecorderRequest type, uint8_t speed = 1) {
+  requestType.store(type, std::memory_order_relaxed);
+  requestSpeed.store(speed, std::memory_order_relaxed);
+  requestSequence.store(requestSequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+void setDofRecording(bool on) {
+  recording.store(on, std::memory_order_relaxed);
+}
+
+void requestDofDump() {
+  request(REQUEST_DUMP);
+}
+
+void requestDofReplay(uint8_t speed) {
+  request(REQUEST_REPLAY, speed < 1 ? 1 : speed > DOF_REPLAY_MAX_SPEED ? DOF_REPLAY_MAX_SPEED : speed);
+}
+
+void requestDofRecorderStop() {
+  request(REQUEST_STOP);
+}
+
+void requestDofRecordingClear() {
+  request(REQUEST_CLEAR);
+}
+
+bool isDofRecording() {
+  return recording.load(std::memory_order_relaxed);
+}
+
+DofRecorderActivity getDofRecorderActivity() {
+  return static_cast<DofRecorderActivity>(activity.load(std::memory_order_relaxed));
+}
+
+const char* getDofRecorderActivityName() {
+  static const char* const NAMES[] = { "idle", "dumping", "replaying" };
+  return NAMES[getDofRecorderActivity()];
+}
+
+
+// ----- Counters -----
+
+uint32_t getDofRecordCount() {
+  return recordCount;
+}
+
+uint32_t getDofRecordBytes() {
+  return head - tail;
+}
+
+uint32_t getDofRecordSpanUs() {
+  return recordCount > 0 ? newestTimeUs - recordTime(tail) : 0;
+}
+
+uint32_t getDofRecordsRecorded() {
+  return recordsRecorded;
+}
+
+uint32_t getDofRecordsOverwritten() {
+  return recordsOverwritten;
+}
+
+uint32_t getDofRecordsReplayed() {
+  return recordsReplayed;
+}
+
+uint32_t getDofLivePacketsHeld() {
+  return livePacketsHeld;
+}
+
+
+// ----- Dump Lines -----
+
+size_t formatDofRecord(uint32_t timeUs, const uint8_t* data, uint8_t length, char* line, size_t size) {
+  static const char HEX_DIGITS[] = "0123456789abcdef";
+  if (size == 0) {
+    return 0;
+  }
+
+  int written = snprintf(line, size, "REC:%lu ", static_cast<unsigned long>(timeUs));
+  size_t used = written > 0 ? static_cast<size_t>(written) : 0;
+  for (uint8_t i = 0; i < length && used + 2 < size; i++) {
+    line[used++] = HEX_DIGITS[data[i] >> 4];
+    line[used++] = HEX_DIGITS[data[i] & 0x0F];
+  }
+  if (used >= size) {
+    used = size - 1;
+  }
+  line[used] = '\0';
+  return used;
+}
+
+static int hexValue(char c) {
+  return c >= '0' && c <= '9' ? c - '0' :
+    c >= 'a' && c <= 'f' ? c - 'a' + 10 :
+    c >= 'A' && c <= 'F' ? c - 'A' + 10 : -1;
+}
+
+bool parseDofRecord(const char* line, uint32_t& timeUs, uint8_t* data, uint8_t& length) {
+  // Skips the begin and end lines, and anything else in the capture
+  if (strncmp(line, "REC:", 4) != 0 || line[4] < '0' || line[4] > '9') {
+    return false;
+  }
+
+  char* end;
+  timeUs = static_cast<uint32_t>(strtoul(line + 4, &end, 10));
+  if (*end != ' ') {
+    return false;
+  }
+
+  length = 0;
+  for (const char* c = end + 1; *c != '\0' && *c != '\r' && *c != '\n'; c += 2) {
+    int high = hexValue(c[0]);
+    int low = high >= 0 ? hexValue(c[1]) : -1;
+    if (low < 0 || length >= DOF_MAX_PACKET_LENGTH) {
+      return false;
+    }
+    data[length++] = static_cast<uint8_t>((high << 4) | low);
+  }
+  return true;
+}
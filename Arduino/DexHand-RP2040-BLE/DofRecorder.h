@@ -0,0 +1,96 @@
+#ifndef DOF_RECORDER_H
+#define DOF_RECORDER_H
+
+/*
+DOF Recorder
+
+A glitch in a streamed session is hard to chase once the stream has gone.
+The recorder keeps the last few seconds of DOF packets in a RAM ring, as
+they arrived over BLE and with their arrival time, so they can be dumped
+over serial and replayed afterwards - on the hand, or on the host with
+Host/tools/replay_dof.
+
+Packets are kept raw, before they are decoded, so bad packets are captured
+too and a replay goes back through receiveDofPacket() exactly as the live
+stream did. Each record is the arrival time in us, uint32 little endian,
+the packet length and the packet. The ring is DOF_RECORD_BUFFER_BYTES long
+and the oldest records are dropped to make room, which is around 10s of
+version 2 frames at 30 Hz.
+
+The dump is text, so it can sit alongside the log and be cut out of any
+serial capture. It's a line for each record, oldest first, between a begin
+and an end line:
+
+  REC:begin records:<count> span:<newest - oldest arrival>us
+  REC:<arrival us> <packet in hex>
+  REC:end records:<count>
+
+A replay feeds the records to receiveDofPacket() at their original spacing,
+or that divided by the speed. The jitter buffer plays timestamped frames
+against the sender's clock, which a faster replay runs ahead of, so those
+are best replayed with its delay at 0. The stream's sequence checks are
+restarted at both ends of a replay, and live packets are held back while it
+runs so the two can't interleave. Recording pauses while the ring is being
+dumped or replayed.
+
+The ring, and the dumps and replays, belong to the BLE core: the BLE
+handler records, and runDofRecorder() does the rest from a task of its own
+on the same core. The request functions below only leave a request for that
+task, so they can be called from either core.
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "DofProtocol.h"
+
+#define DOF_RECORD_BUFFER_BYTES   16384   // Power of two
+#define DOF_RECORD_HEADER_LENGTH  5       // Arrival time and length
+#define DOF_REPLAY_MAX_SPEED      16
+#define DOF_DUMP_RECORDS          2       // Most records dumped per run of the recorder
+#define DOF_RECORD_LINE_LENGTH    (4 + 10 + 1 + 2 * DOF_MAX_PACKET_LENGTH)
+
+enum DofRecorderActivity {
+  DOF_RECORDER_IDLE,
+  DOF_RECORDER_DUMPING,
+  DOF_RECORDER_REPLAYING
+};
+
+// BLE handler side. Records a live packet, if recording is on and the ring
+// isn't busy. Returns false if a replay is running and the packet should be
+// dropped rather than decoded.
+bool recordDofPacket(const uint8_t* data, int length);
+
+// The recorder's task: takes up any request, then dumps a few records or
+// feeds the replay the packets that are due. Runs on the BLE core.
+void runDofRecorder();
+
+// Requests for the recorder's task, from either core. A later request
+// replaces one that hasn't been taken up yet.
+void setDofRecording(bool on);
+void requestDofDump();
+void requestDofReplay(uint8_t speed);
+void requestDofRecorderStop();        // Ends a dump or replay early
+void requestDofRecordingClear();
+
+bool isDofRecording();
+DofRecorderActivity getDofRecorderActivity();
+const char* getDofRecorderActivityName();
+
+// What's in the ring, and what's happened to it
+uint32_t getDofRecordCount();
+uint32_t getDofRecordBytes();
+uint32_t getDofRecordSpanUs();
+uint32_t getDofRecordsRecorded();
+uint32_t getDofRecordsOverwritten();
+uint32_t getDofRecordsReplayed();
+uint32_t getDofLivePacketsHeld();
+
+// One record as a dump line, terminated, and back from a line of a capture,
+// with or without its line ending. The format returns the line's length,
+// and the parse false for a line that isn't a record.
+size_t formatDofRecord(uint32_t timeUs, const uint8_t* data, uint8_t length, char* line, size_t size);
+bool parseDofRecord(const char* line, uint32_t& timeUs, uint8_t* data, uint8_t& length);
+
+
+#endif
@@ -0,0 +1,131 @@
+#include "DofRegistry.h"
+
+
+// Set, get and range accessors for one axis of a joint object
+#define DOF_ACCESSORS(object, Axis) \
+  [](int16_t angle) { object.set##Axis(angle); }, \
+  []() -> int16_t { return object.get##Axis(); }, \
+  [](int16_t min, int16_t max) { object.set##Axis##Range(min, max); }, \
+  [](int16_t& min, int16_t& max) { min = object.get##Axis##Min(); max = object.get##Axis##Max(); }
+
+constexpr DofInfo DOF_REGISTRY[DOF_COUNT] =
+{
+  // Name, Wire index, Joint, Axis, Min, Max, Accessors
+  { "index_pitch", 0, JOINT_INDEX, DOF_AXIS_PITCH, 0, 40, DOF_ACCESSORS(fingers[FINGER_INDEX], Pitch) },
+  { "index_yaw", 1, JOINT_INDEX, DOF_AXIS_YAW, -20, 20, DOF_ACCESSORS(fingers[FINGER_INDEX], Yaw) },
+  { "index_flexion", 2, JOINT_INDEX, DOF_AXIS_FLEXION, 0, 100, DOF_ACCESSORS(fingers[FINGER_INDEX], Flexion) },
+  { "middle_pitch", 3, JOINT_MIDDLE, DOF_AXIS_PITCH, 0, 40, DOF_ACCESSORS(fingers[FINGER_MIDDLE], Pitch) },
+  { "middle_yaw", 4, JOINT_MIDDLE, DOF_AXIS_YAW, -20, 20, DOF_ACCESSORS(fingers[FINGER_MIDDLE], Yaw) },
+  { "middle_flexion", 5, JOINT_MIDDLE, DOF_AXIS_FLEXION, 0, 100, DOF_ACCESSORS(fingers[FINGER_MIDDLE], Flexion) },
+  { "ring_pitch", 6, JOINT_RING, DOF_AXIS_PITCH, 0, 40, DOF_ACCESSORS(fingers[FINGER_RING], Pitch) },
+  { "ring_yaw", 7, JOINT_RING, DOF_AXIS_YAW, -20, 20, DOF_ACCESSORS(fingers[FINGER_RING], Yaw) },
+  { "ring_flexion", 8, JOINT_RING, DOF_AXIS_FLEXION, 0, 100, DOF_ACCESSORS(fingers[FINGER_RING], Flexion) },
+  { "pinky_pitch", 9, JOINT_PINKY, DOF_AXIS_PITCH, 0, 40, DOF_ACCESSORS(fingers[FINGER_PINKY], Pitch) },
+  { "pinky_yaw", 10, JOINT_PINKY, DOF_AXIS_YAW, -20, 20, DOF_ACCESSORS(fingers[FINGER_PINKY], Yaw) },
+  { "pinky_flexion", 11, JOINT_PINKY, DOF_AXIS_FLEXION, 0, 100, DOF_ACCESSORS(fingers[FINGER_PINKY], Flexion) },
+  { "thumb_pitch", 12, JOINT_THUMB, DOF_AXIS_PITCH, 30, 60, DOF_ACCESSORS(thumb, Pitch) },
+  { "thumb_yaw", 13, JOINT_THUMB, DOF_AXIS_YAW, 0, 45, DOF_ACCESSORS(thumb, Yaw) },
+  { "thumb_flexion", 14, JOINT_THUMB, DOF_AXIS_FLEXION, 0, 45, DOF_ACCESSORS(thumb, Flexion) },
+  { "wrist_pitch", 15, JOINT_WRIST, DOF_AXIS_PITCH, -40, 40, DOF_ACCESSORS(wrist, Pitch) },
+  { "wrist_yaw", 16, JOINT_WRIST, DOF_AXIS_YAW, -40, 40, DOF_ACCESSORS(wrist, Yaw) }
+
+  // Thumb roll is currently not used - this is here for when we want to enable it
+  //{ "thumb_roll", 17, JOINT_THUMB, DOF_AXIS_ROLL, 0, 20, DOF_ACCESSORS(thumb, Roll) }
+};
+
+
+// ----- Compile Time Checks -----
+
+constexpr size_t nameLength(const char* name) {
+  size_t length = 0;
+  while (name[length]) {
+    length++;
+  }
+  return length;
+}
+
+constexpr bool namesMatch(const char* a, const char* b) {
+  while (*a && *a == *b) {
+    a++;
+    b++;
+  }
+  return *a == *b;
+}
+
+constexpr bool dofRegistryIsValid() {
+  for (uint8_t dof = 0; dof < DOF_COUNT; dof++) {
+    const DofInfo& info = DOF_REGISTRY[dof];
+    if (info.wireIndex != dof || info.joint >= NUM_JOINTS || info.min >= info.max ||
+        nameLength(info.name) == 0 || nameLength(info.name) > 255) {
+      return false;
+    }
+    for (uint8_t other = dof + 1; other < DOF_COUNT; other++) {
+      if (namesMatch(DOF_REGISTRY[other].name, info.name)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+static_assert(dofRegistryIsValid(), "DOF registry is inconsistent - check wire order, joints, ranges and names");
+
+
+// ----- Descriptor -----
+
+constexpr size_t descriptorLength() {
+  size_t length = 2;
+  for (uint8_t dof = 0; dof < DOF_COUNT; dof++) {
+    length += 7 + nameLength(DOF_REGISTRY[dof].name);
+  }
+  return length;
+}
+
+struct DofDescriptor {
+  uint8_t bytes[descriptorLength()];
+};
+
+constexpr DofDescriptor makeDescriptor() {
+  DofDescriptor descriptor = {};
+  size_t position = 0;
+  descriptor.bytes[position++] = DOF_DESCRIPTOR_VERSION;
+  descriptor.bytes[position++] = DOF_COUNT;
+
+  for (uint8_t dof = 0; dof < DOF_COUNT; dof++) {
+    const DofInfo& info = DOF_REGISTRY[dof];
+    descriptor.bytes[position++] = info.joint;
+    descriptor.bytes[position++] = info.axis;
+    descriptor.bytes[position++] = static_cast<uint8_t>(info.min);
+    descriptor.bytes[position++] = static_cast<uint8_t>(static_cast<uint16_t>(info.min) >> 8);
+    descriptor.bytes[position++] = static_cast<uint8_t>(info.max);
+    descriptor.bytes[position++] = static_cast<uint8_t>(static_cast<uint16_t>(info.max) >> 8);
+
+    size_t length = nameLength(info.name);
+    descriptor.bytes[position++] = static_cast<uint8_t>(length);
+    for (size_t i = 0; i < length; i++) {
+      descriptor.bytes[position++] = static_cast<uint8_t>(info.name[i]);
+    }
+  }
+  return descriptor;
+}
+
+static constexpr DofDescriptor DESCRIPTOR = makeDescriptor();
+
+constexpr const uint8_t* DOF_DESCRIPTOR = DESCRIPTOR.bytes;
+constexpr size_t DOF_DESCRIPTOR_LENGTH = sizeof(DESCRIPTOR.bytes);
+
+
+const DofInfo* findDof(const char* name) {
+  for (const DofInfo& info : DOF_REGISTRY) {
+    if (strcmp(info.name, name) == 0) {
+      return &info;
+    }
+  }
+  return nullptr;
+}
+
+void applyDofRanges() {
+  for (const DofInfo& info : DOF_REGISTRY) {
+    info.setRange(info.min, info.max);
+  }
+}
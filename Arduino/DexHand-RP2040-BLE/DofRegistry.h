@@ -0,0 +1,74 @@
+#ifndef DOF_REGISTRY_H
+#define DOF_REGISTRY_H
+
+/*
+DOF Registry
+
+The one description of the degrees of freedom the hand exposes to the
+outside world: each DOF's name, the joint that owns it, its range in
+degrees, how to set it, and where it sits in a streamed frame. Streaming
+(applyDofFrame), the dofs command and the descriptor characteristic are all
+driven from this table, and the joints take their ranges from it in
+setupServos(), so adding or reordering a DOF is a change in one place.
+
+The table is in wire order - entry i is DOF i in every frame - which is
+checked at compile time.
+
+The descriptor is a compact binary copy of the table that a central can read
+over BLE instead of hard coding the layout. It is built at compile time into
+a constant buffer, little endian throughout:
+
+  0      DOF_DESCRIPTOR_VERSION
+  1      Number of DOFs
+  Then for each DOF, in wire order:
+  0      Joint, a JOINT_ index
+  1      Axis, a DOF_AXIS_ value
+  2-3    Minimum angle in degrees, int16
+  4-5    Maximum angle in degrees, int16
+  6      Length of the name
+  7-     Name, without a terminator
+*/
+
+#include <Arduino.h>
+
+#include "DofProtocol.h"
+#include "Hand.h"
+
+#define DOF_DESCRIPTOR_VERSION    1
+
+typedef enum dofAxis {
+  DOF_AXIS_PITCH,
+  DOF_AXIS_YAW,
+  DOF_AXIS_FLEXION,
+  DOF_AXIS_ROLL
+} DOF_AXIS;
+
+struct DofInfo {
+  const char* name;
+  uint8_t wireIndex;
+  uint8_t joint;
+  uint8_t axis;
+  int16_t min;
+  int16_t max;
+
+  // Accessors for the joint angle this DOF drives
+  void (*set)(int16_t angle);
+  int16_t (*get)();
+  void (*setRange)(int16_t min, int16_t max);
+  void (*getRange)(int16_t& min, int16_t& max);
+};
+
+extern const DofInfo DOF_REGISTRY[DOF_COUNT];
+
+extern const uint8_t* const DOF_DESCRIPTOR;
+extern const size_t DOF_DESCRIPTOR_LENGTH;
+
+// Looks a DOF up by name, nullptr if there isn't one
+const DofInfo* findDof(const char* name);
+
+// Gives every joint the ranges in the registry. The calibration can change
+// them from there (see Calibration.h).
+void applyDofRanges();
+
+
+#endif
@@ -0,0 +1,311 @@
+#include "DofStream.h"
+#include "DofRegistry.h"
+#include "Gesture.h"
+#include "Hand.h"
+#include "JointArbiter.h"
+#include "Profiler.h"
+
+#include <string.h>
+
+#include <atomic>
+
+
+Mailbox<DofFrame> dofMailbox;
+JitterBuffer dofJitterBuffer(DOF_JITTER_DELAY_MS * 1000ul, DOF_EXTRAPOLATE_MS * 1000ul);
+
+// Set from the control side, read by the BLE handler
+static std::atomic<bool> jitterBuffering(DOF_JITTER_DELAY_MS > 0);
+
+// The control side asks for the BLE handler's counters to be zeroed by
+// bumping this, as for the recorder's requests (see DofRecorder.cpp)
+static std::atomic<uint32_t> resetSequence(0);
+static uint32_t resetTaken = 0;
+
+// Written by the BLE handler only
+static uint32_t packetsReceived = 0;
+static uint32_t packetsBadLength = 0;
+static uint32_t packetsBadChecksum = 0;
+static uint32_t packetsBadVersion = 0;
+static uint32_t framesLost = 0;
+static uint32_t framesStale = 0;
+
+static uint32_t deltaFrames = 0;
+static uint32_t deltasDropped = 0;
+
+static bool haveSequence = false;
+static uint16_t lastSequence = 0;
+
+// Every DOF as of the newest frame. Delta frames are merged into this, so the
+// mailbox always holds a whole frame and coalescing can't lose a change.
+static DofFrame streamFrame = {};
+static bool haveKeyframe = false;
+
+#if LATENCY_INSTRUMENTATION
+// The frame the queue and end to end latency were last taken for. The jitter
+// buffer hands the same frame out for several ticks while it interpolates or
+// holds, and it's only counted the first time.
+static uint32_t latencyFrameTicks = 0;
+static bool latencyFrameSeen = false;
+static bool latencyFramePending = false;
+
+static void takeLatencyFrame(const DofFrame& frame) {
+  if (latencyFrameSeen && frame.receivedTicks == latencyFrameTicks) {
+    return;
+  }
+  latencyFrameTicks = frame.receivedTicks;
+  latencyFrameSeen = true;
+  latencyFramePending = true;
+  recordLatency(LATENCY_QUEUE, frame.receivedTicks);
+}
+#endif
+
+
+void takeDofStreamRequests() {
+  uint32_t sequence = resetSequence.load(std::memory_order_acquire);
+  if (sequence == resetTaken) {
+    return;
+  }
+  resetTaken = sequence;
+
+  packetsReceived = 0;
+  packetsBadLength = 0;
+  packetsBadChecksum = 0;
+  packetsBadVersion = 0;
+  framesLost = 0;
+  framesStale = 0;
+  deltaFrames = 0;
+  deltasDropped = 0;
+}
+
+DofPacketResult receiveDofPacket(const uint8_t* data, int length) {
+  LATENCY_START(receivedTicks);
+  takeDofStreamRequests();
+  packetsReceived++;
+
+  DofFrame frame;
+  DofPacketResult result = decodeDofPacket(data, length, frame);
+
+  if (result == DOF_PACKET_BAD_LENGTH) {
+    packetsBadLength++;
+    return result;
+  }
+  if (result == DOF_PACKET_BAD_CHECKSUM) {
+    packetsBadChecksum++;
+    return result;
+  }
+  if (result == DOF_PACKET_BAD_VERSION) {
+    packetsBadVersion++;
+    return result;
+  }
+
+  if (frame.version >= DOF_PROTOCOL_V2) {
+    // Sequence numbers wrap, so compare them as a signed difference
+    int16_t delta = static_cast<int16_t>(frame.sequence - lastSequence);
+
+    if (haveSequence && delta <= 0 && delta > -DOF_SEQUENCE_RESTART) {
+      framesStale++;
+      return result;
+    }
+    if (haveSequence && delta > 1) {
+      framesLost += delta - 1;
+    }
+    if (haveSequence && delta <= 0) {
+      // The sender restarted, and may not have kept its last frame
+      haveKeyframe = false;
+    }
+    haveSequence = true;
+    lastSequence = frame.sequence;
+  }
+
+  if (frame.version == DOF_PROTOCOL_DELTA) {
+    // Nothing to apply the changes to until a keyframe has arrived
+    if (!haveKeyframe) {
+      deltasDropped++;
+      return result;
+    }
+    deltaFrames++;
+
+    for (int i = 0; i < DOF_COUNT; i++) {
+      if (frame.mask & (1ul << i)) {
+        streamFrame.angles[i] = frame.angles[i];
+      }
+    }
+    streamFrame.mask = frame.mask;
+  }
+  else {
+    memcpy(streamFrame.angles, frame.angles, sizeof(streamFrame.angles));
+    streamFrame.mask = DOF_ALL_MASK;
+    haveKeyframe = true;
+  }
+  streamFrame.sequence = frame.sequence;
+  streamFrame.timestamp = frame.timestamp;
+  streamFrame.version = frame.version;
+#if LATENCY_INSTRUMENTATION
+  streamFrame.receivedTicks = receivedTicks;
+#endif
+
+  // Version 1 frames have no timestamp to play them out against
+  if (jitterBuffering.load(std::memory_order_relaxed) && streamFrame.version != DOF_PROTOCOL_V1) {
+    dofJitterBuffer.push(streamFrame, micros());
+  }
+  else {
+    dofMailbox.publish(streamFrame);
+  }
+
+  LATENCY_RECORD(LATENCY_VALIDATE, receivedTicks);
+  return result;
+}
+
+void restartDofStream() {
+  haveSequence = false;
+  haveKeyframe = false;
+}
+
+void dropDofStreamFrames() {
+  DofFrame frame;
+  dofMailbox.take(frame);
+  dofJitterBuffer.reset();
+}
+
+uint8_t applyDofFrame(const DofFrame& frame, uint8_t allowedJoints) {
+  LATENCY_START(start);
+  uint8_t joints = 0;
+
+  // The registry is in wire order, so each angle goes to its DOF's setter
+  for (int i = 0; i < DOF_COUNT; i++) {
+    const DofInfo& dof = DOF_REGISTRY[i];
+    if (!(allowedJoints & HAND_JOINT(dof.joint))) {
+      continue;
+    }
+    int16_t angle = dof.get();
+    dof.set(dofAngleDegrees(frame.angles[i]));
+    if (dof.get() != angle) {
+      joints |= HAND_JOINT(dof.joint);
+    }
+  }
+
+  LATENCY_RECORD(LATENCY_APPLY, start);
+  return joints;
+}
+
+void controlTick() {
+  PROFILE_SCOPE(PROFILE_CONTROL_TICK);
+  DofFrame frame;
+  DofFrame sampledFrame;
+  uint8_t joints = 0;
+
+  // A new frame from the stream stops a gesture, unless it's blending
+  uint32_t played = dofJitterBuffer.getPlayed();
+  bool taken = dofMailbox.take(frame);
+  bool sampled = jitterBuffering.load(std::memory_order_relaxed) && dofJitterBuffer.sample(micros(), sampledFrame);
+  if (taken || dofJitterBuffer.getPlayed() != played) {
+    gesturePlayer.streamFrameArrived();
+  }
+
+  // A gesture holds its joints while it plays, and stops once anything
+  // above it has taken one of them. The stream gets whatever is left.
+  uint32_t nowMs = millis();
+  if (gesturePlayer.isPlaying()) {
+    uint8_t gestureJoints = gesturePlayer.getGesture()->joints;
+    if (claimJoints(CONTROL_SOURCE_GESTURE, gestureJoints, nowMs) != gestureJoints) {
+      gesturePlayer.stop();
+      releaseJoints(CONTROL_SOURCE_GESTURE, HAND_JOINTS_ALL);
+    }
+  }
+  else {
+    releaseJoints(CONTROL_SOURCE_GESTURE, HAND_JOINTS_ALL);
+  }
+  gesturePlayer.tick(nowMs);
+  uint8_t streamJoints = gesturePlayer.getStreamJoints();
+  if (taken || sampled) {
+    streamJoints = claimJoints(CONTROL_SOURCE_STREAM, streamJoints, nowMs);
+  }
+
+  if (taken) {
+    joints |= applyDofFrame(frame, streamJoints);
+#if LATENCY_INSTRUMENTATION
+    takeLatencyFrame(frame);
+#endif
+  }
+  if (sampled) {
+    joints |= applyDofFrame(sampledFrame, streamJoints);
+#if LATENCY_INSTRUMENTATION
+    takeLatencyFrame(sampledFrame);
+#endif
+  }
+
+  // Without motion limits the joints are already at their new targets, and
+  // only the ones whose targets changed need their servos recomputed.
+  // tickHand() only updates joints that are still moving.
+  if (!isMotionLimiting() && joints) {
+    updateHandJoints(joints);
+  }
+
+  tickHand();
+
+#if LATENCY_INSTRUMENTATION
+  // The servos now have the frame
+  if (latencyFramePending) {
+    latencyFramePending = false;
+    recordLatency(LATENCY_END_TO_END, latencyFrameTicks);
+  }
+#endif
+}
+
+void setDofJitterDelay(uint16_t ms) {
+  jitterBuffering.store(false, std::memory_order_relaxed);
+  dofJitterBuffer.reset();
+  dofJitterBuffer.setDelayUs(ms * 1000ul);
+  jitterBuffering.store(ms > 0, std::memory_order_relaxed);
+}
+
+uint16_t getDofJitterDelay() {
+  return jitterBuffering.load(std::memory_order_relaxed) ? dofJitterBuffer.getDelayUs() / 1000 : 0;
+}
+
+
+uint32_t getDofPacketsReceived() {
+  return packetsReceived;
+}
+
+uint32_t getDofPacketsBadLength() {
+  return packetsBadLength;
+}
+
+uint32_t getDofPacketsBadChecksum() {
+  return packetsBadChecksum;
+}
+
+uint32_t getDofPacketsBadVersion() {
+  return packetsBadVersion;
+}
+
+uint32_t getDofFramesLost() {
+  return framesLost;
+}
+
+uint32_t getDofFramesStale() {
+  return framesStale;
+}
+
+uint32_t getDofDeltaFrames() {
+  return deltaFrames;
+}
+
+uint32_t getDofDeltasDropped() {
+  return deltasDropped;
+}
+
+uint32_t getDofFramesApplied() {
+  return dofMailbox.getTaken();
+}
+
+uint32_t getDofFramesCoalesced() {
+  return dofMailbox.getCoalesced();
+}
+
+void resetDofStreamCounters() {
+  resetSequence.store(resetSequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+  dofMailbox.resetCounters();
+  dofJitterBuffer.resetCounters();
+}
@@ -0,0 +1,112 @@
+#ifndef DOF_STREAM_H
+#define DOF_STREAM_H
+
+/*
+DOF Stream
+
+Streamed joint angles arrive as BLE writes to the DOF characteristic, at
+whatever rate and in whatever bunches the connection delivers them. The
+BLE handler only validates and decodes a packet and publishes the frame
+into a mailbox. The control tick, running at CONTROL_RATE_HZ, takes the
+newest frame, applies it to the joints and steps the hand. Frames that
+arrive together are coalesced rather than applied back to back, so link
+burstiness doesn't turn into servo jitter.
+
+Packets can be in either version of the format in DofProtocol.h. Version 2
+frames carry a sequence number, which is used to count frames lost on the
+way and to drop frames that arrive out of order. Delta frames are merged
+into the last full frame as they arrive, and the control tick only updates
+the joints whose targets actually changed.
+
+Timestamped frames (version 2 and delta) go through a jitter buffer instead
+of the mailbox, unless its delay is set to 0. The control tick then plays
+them out a fixed delay behind the sender, interpolating between frames, so
+uneven arrivals don't turn into uneven motion. If a frame is overdue the
+buffer extrapolates the recent motion for a short while rather than holding
+the hand still. See JitterBuffer.h.
+*/
+
+#include <Arduino.h>
+
+#include "DofProtocol.h"
+#include "Hand.h"
+#include "JitterBuffer.h"
+#include "Mailbox.h"
+
+// A version 2 sequence number this far behind the last one is taken to be a
+// sender that restarted, rather than a very late frame
+#define DOF_SEQUENCE_RESTART    64
+
+// Default playout delay for timestamped frames. It needs to cover the longest
+// gap between camera frames plus a BLE connection interval.
+#define DOF_JITTER_DELAY_MS     80
+
+// Default dead reckoning horizon for the jitter buffer, see JitterBuffer.h.
+// The delay already covers a lost frame or two, so this only has to carry
+// the hand through the rest of a longer gap. Measured with
+// bench_dead_reckoning, longer horizons overshoot more than they save.
+#define DOF_EXTRAPOLATE_MS      60
+
+// Frames from the BLE handler to the control tick
+extern Mailbox<DofFrame> dofMailbox;
+extern JitterBuffer dofJitterBuffer;
+
+// Validates a packet and publishes it to the mailbox. This is all the BLE
+// handler does, and it never blocks.
+DofPacketResult receiveDofPacket(const uint8_t* data, int length);
+
+// Starts the sequence checks again, as for a sender that restarted, so the
+// next frame is taken whatever its sequence number and deltas wait for a
+// keyframe. Belongs to the BLE handler's side, like receiveDofPacket().
+void restartDofStream();
+
+// Takes up a counter reset asked for by resetDofStreamCounters(). The BLE
+// handler's counters are only written from its own side, so this is called
+// before each packet, and from the BLE task for when none are coming.
+void takeDofStreamRequests();
+
+// Drops the frames still waiting for the control tick, for a stream that has
+// ended. Control side, like controlTick().
+void dropDofStreamFrames();
+
+// Sets the joint targets from a frame, for the joints in allowedJoints.
+// Returns the HAND_JOINT_ bits of the joints whose targets changed.
+uint8_t applyDofFrame(const DofFrame& frame, uint8_t allowedJoints = HAND_JOINTS_ALL);
+
+// One control tick: advances any gesture that is playing, applies the newest
+// frame in the mailbox, if there is one, or the jitter buffer's frame for
+// this moment, and steps the hand. A new streamed frame stops a gesture,
+// unless it is blending with the stream (see Gesture.h). The gesture and the
+// stream only drive the joints the arbiter gives them (see JointArbiter.h).
+// Call this at CONTROL_RATE_HZ.
+void controlTick();
+
+// Playout delay of the jitter buffer, 0 to apply frames as they arrive.
+// Changing it empties the buffer. Control side, like controlTick().
+void setDofJitterDelay(uint16_t ms);
+uint16_t getDofJitterDelay();
+
+// Packets received and rejected by receiveDofPacket(), and frames applied by the
+// control tick. Frames coalesced are the ones replaced by a newer frame before
+// a tick got to them. Lost and stale frames are only known for version 2:
+// lost are gaps in the sequence numbers, stale arrived after a newer frame
+// and were dropped. Deltas dropped arrived before any keyframe.
+uint32_t getDofPacketsReceived();
+uint32_t getDofPacketsBadLength();
+uint32_t getDofPacketsBadChecksum();
+uint32_t getDofPacketsBadVersion();
+uint32_t getDofFramesLost();
+uint32_t getDofFramesStale();
+uint32_t getDofDeltaFrames();
+uint32_t getDofDeltasDropped();
+uint32_t getDofFramesApplied();
+uint32_t getDofFramesCoalesced();
+
+// Zeroes the counters above and the jitter buffer's. The stream itself
+// carries on; restartDofStream() is the one for a new connection. Control
+// side: the BLE handler's counters are left a request, and read as before
+// until takeDofStreamRequests() has run.
+void resetDofStreamCounters();
+
+
+#endif
@@ -12,9 +12,9 @@ that control the knuckle pitch and yaw. The third servo controls the
 finger's flexion which is the tendon running through the finger
 to the tip.
 
-The finger class mixes together the signals for the two differential
-servos to create the poses specified by the pitch and yaw angles from
-the controller.
+The finger class holds the pitch, yaw and flexion angles from the
+controller, and their ranges and motion limits. The mixer (see Mixer.h)
+mixes them into the signals for the two differential servos.
 
 Finger yaw is also modulated by the flexion angle. As the finger flexes,
 the yaw angle is reduced to keep the finger from bending sideways as the
@@ -22,15 +22,23 @@ fingers align into more of a fist.
 */
 #include <Arduino.h>
 
-class ManagedServo;
+#include "MathUtils.h"
+#include "Trajectory.h"
+
+#define FINGER_YAW_BIAS             60
+#define FINGER_FLEXION_PITCH_GAIN   30      // Degrees of pitch added at full flexion, from 50%
 
 class Finger {
     public:
-        Finger(String name, ManagedServo& leftPitchServo, ManagedServo& rightPitchServo, ManagedServo& flexionServo);
-        virtual ~Finger();
+        // Default ranges to something sane, but they can be overriden by a tuning
+        // routine or by the user if desired.
+        constexpr Finger(const char* name, const FingerMotionConfig& motion = FingerMotionConfig{})
+        : mName(name), mPitch(motion.pitch), mYaw(motion.yaw), mFlexion(motion.flexion),
+            mPitchRange{0, 40}, mYawRange{-20, 20}, mFlexionRange{0, 100}, mYawBias(FINGER_YAW_BIAS) {
+        }
 
         // Loop
-        void update();          // Called from the main loop to update the finger's servos
+        bool tick();            // Steps the joint angles toward their targets, returns true if any moved
 
         // Positioning
         inline void setPosition(int16_t pitch, int16_t yaw, int16_t flexion) { setPitch(pitch); setYaw(yaw); setFlexion(flexion);}
@@ -41,11 +49,21 @@ class Finger {
         void setMinPosition();
         void setExtension(int16_t percent);     // Sets overall finger extension from 0 (closed) to 100 (open)
         
-        inline String& getName() { return mName; }
+        inline const char* getName() const { return mName; }
+
+        inline int16_t getPitch() const { return mPitch.getTarget();}
+        inline int16_t getYaw() const { return mYaw.getTarget();}
+        inline int16_t getFlexion() const { return mFlexion.getTarget();}
+
+        // Angles the servos are currently being driven to, which lag the targets
+        // above while the joint is moving under its motion limits
+        inline int16_t getPitchPosition() const { return mPitch.getPosition();}
+        inline int16_t getYawPosition() const { return mYaw.getPosition();}
+        inline int16_t getFlexionPosition() const { return mFlexion.getPosition();}
 
-        inline int16_t getPitch() const { return mPitchTarget;}
-        inline int16_t getYaw() const { return mYawTarget;}
-        inline int16_t getFlexion() const { return mFlexionTarget;}
+        // Motion limits
+        void setMotionLimits(const FingerMotionConfig& motion);
+        inline bool isSettled() const { return mPitch.isSettled() && mYaw.isSettled() && mFlexion.isSettled(); }
 
         // Ranges
         inline void setPitchRange(int16_t min, int16_t max) { mPitchRange[0] = min; mPitchRange[1] = max; }
@@ -66,23 +84,17 @@ class Finger {
 
 
     private:
-        String mName;
-        
-        ManagedServo& mLeftPitchServo;
-        ManagedServo& mRightPitchServo;
-        ManagedServo& mFlexionServo;
+        const char* mName;
 
-        int16_t mPitchTarget;
-        int16_t mYawTarget;
-        int16_t mFlexionTarget;
+        Trajectory mPitch;
+        Trajectory mYaw;
+        Trajectory mFlexion;
 
         int16_t mPitchRange[2];
         int16_t mYawRange[2];
         int16_t mFlexionRange[2];
         int16_t mYawBias;
 
-        void updatePitchServos();
-
  
 
 
@@ -0,0 +1,202 @@
+#include "Gesture.h"
+#include "DofRegistry.h"
+#include "Hand.h"
+#include "PoseLibrary.h"
+
+
+GesturePlayer gesturePlayer;
+
+
+void GesturePlayer::play(const Gesture& gesture, uint32_t nowMs, ControlSource source) {
+    stop();
+    mSource = source;
+    start(gesture, nowMs);
+}
+
+bool GesturePlayer::queue(const Gesture& gesture, uint32_t nowMs, ControlSource source) {
+    if (mGesture == nullptr) {
+        mSource = source;
+        start(gesture, nowMs);
+        return true;
+    }
+    if (mQueueLength == GESTURE_QUEUE_LENGTH) {
+        return false;
+    }
+    if (source > mSource) {
+        mSource = source;
+    }
+    mQueue[(mQueueHead + mQueueLength) % GESTURE_QUEUE_LENGTH] = &gesture;
+    mQueueLength++;
+    return true;
+}
+
+void GesturePlayer::stop() {
+    mGesture = nullptr;
+    mQueueLength = 0;
+}
+
+void GesturePlayer::tick(uint32_t nowMs) {
+    while (mGesture != nullptr) {
+        uint32_t elapsedMs = nowMs - mStepStartMs;
+
+        if (mGesture->keyframes != nullptr) {
+            const uint8_t* keyframe = mGesture->keyframes + mStep * POSE_KEYFRAME_LENGTH;
+            uint16_t durationMs = poseKeyframeDuration(keyframe);
+            moveToKeyframe(keyframe, elapsedMs, durationMs);
+            if (elapsedMs < durationMs) {
+                return;
+            }
+
+            // On to the next keyframe, from when this one was reached
+            uint32_t nextStartMs = mStepStartMs + durationMs;
+            if (++mStep >= mGesture->stepCount) {
+                finish(nextStartMs);
+            }
+            else {
+                startStep(nextStartMs);
+            }
+            continue;
+        }
+
+        const GestureStep& step = mGesture->steps[mStep];
+
+        if (elapsedMs < step.durationMs) {
+            if (step.sweep != nullptr) {
+                step.sweep(static_cast<int16_t>(step.from +
+                    static_cast<int32_t>(step.to - step.from) * static_cast<int32_t>(elapsedMs) / step.durationMs));
+            }
+            return;
+        }
+
+        // The step is over, and the next one was due when it ended
+        if (step.sweep != nullptr) {
+            step.sweep(step.to);
+        }
+        uint32_t nextStartMs = mStepStartMs + step.durationMs;
+
+        if (mRepeat < step.repeats) {
+            mRepeat++;
+            mStep = step.repeatFrom;
+        }
+        else {
+            if (step.repeats > 0) {
+                mRepeat = 0;        // Done with this repeat, ready for the next
+            }
+            mStep++;
+        }
+
+        if (mStep >= mGesture->stepCount) {
+            finish(nextStartMs);
+        }
+        else {
+            startStep(nextStartMs);
+        }
+    }
+}
+
+void GesturePlayer::streamFrameArrived() {
+    if (mGesture != nullptr && mStreamMode == GESTURE_STREAM_PREEMPT) {
+        stop();
+        mPreempted++;
+    }
+}
+
+uint8_t GesturePlayer::getStreamJoints() const {
+    // In preempt mode a new frame has already stopped the gesture, so this
+    // only keeps a held frame from fighting it
+    if (mGesture == nullptr) {
+        return HAND_JOINTS_ALL;
+    }
+    return HAND_JOINTS_ALL & ~mGesture->joints;
+}
+
+void GesturePlayer::start(const Gesture& gesture, uint32_t nowMs) {
+    mGesture = &gesture;
+    mStep = 0;
+    mRepeat = 0;
+    mPlayed++;
+
+    if (gesture.stepCount == 0) {
+        finish(nowMs);
+    }
+    else {
+        startStep(nowMs);
+    }
+}
+
+void GesturePlayer::startStep(uint32_t startMs) {
+    mStepStartMs = startMs;
+    if (mGesture->keyframes != nullptr) {
+        for (int dof = 0; dof < DOF_COUNT; dof++) {
+            mFrom[dof] = DOF_REGISTRY[dof].get();
+        }
+        return;
+    }
+    const GestureStep& step = mGesture->steps[mStep];
+    if (step.pose != nullptr) {
+        step.pose();
+    }
+}
+
+void GesturePlayer::moveToKeyframe(const uint8_t* keyframe, uint32_t elapsedMs, uint16_t durationMs) {
+    uint8_t joints = 0;
+    for (int dof = 0; dof < DOF_COUNT; dof++) {
+        const DofInfo& info = DOF_REGISTRY[dof];
+        int32_t to = poseKeyframeAngle(keyframe, dof);
+        int32_t angle = elapsedMs < durationMs ?
+            mFrom[dof] + (to - mFrom[dof]) * static_cast<int32_t>(elapsedMs) / durationMs : to;
+        int16_t before = info.get();
+        info.set(static_cast<int16_t>(angle));
+        if (info.get() != before) {
+            joints |= HAND_JOINT(info.joint);
+        }
+    }
+
+    // As for a streamed frame, the motion limits move the joints otherwise
+    if (!isMotionLimiting() && joints) {
+        updateHandJoints(joints);
+    }
+}
+
+void GesturePlayer::finish(uint32_t nowMs) {
+    mGesture = nullptr;
+    if (mQueueLength > 0) {
+        const Gesture* next = mQueue[mQueueHead];
+        mQueueHead = (mQueueHead + 1) % GESTURE_QUEUE_LENGTH;
+        mQueueLength--;
+        start(*next, nowMs);
+    }
+}
+
+uint8_t requestGesture(const Gesture& gesture, ControlSource source, bool queued, uint32_t nowMs, ControlSource& owner) {
+    if (!gesturePlayer.mayReplace(source)) {
+        owner = gesturePlayer.getSource();
+        return gesture.joints;
+    }
+
+    // Behind a gesture that's playing, the joints are claimed when it starts
+    if (queued && gesturePlayer.isPlaying()) {
+        gesturePlayer.queue(gesture, nowMs, source);
+        return 0;
+    }
+
+    uint8_t refused = claimJointsForGesture(source, gesture.joints, nowMs);
+    if (refused != 0) {
+        uint8_t joint = 0;
+        while (!(refused & HAND_JOINT(joint))) {
+            joint++;
+        }
+        owner = getJointOwner(joint, nowMs);
+        return refused;
+    }
+    gesturePlayer.play(gesture, nowMs, source);
+    return 0;
+}
+
+bool stopGesture(ControlSource source) {
+    if (!gesturePlayer.mayReplace(source)) {
+        return false;
+    }
+    gesturePlayer.stop();
+    return true;
+}
@@ -0,0 +1,166 @@
+#ifndef GESTURE_H
+#define GESTURE_H
+
+/*
+Gesture Definition
+
+A gesture is a timeline of steps, played out by the control tick rather
+than with delay(), so the loop and the BLE stack keep running while the
+hand counts or waves. Each step lasts a fixed time and is one of:
+
+  pose      Calls a pose function when the step starts, then holds
+  hold      Leaves the joints where they are for the step
+  sweep     Calls a setter every tick with a value moved linearly from one
+            end of a range to the other across the step
+  repeat    Goes back to an earlier step a number of times, then carries on
+
+Steps are built with gesturePose(), gestureHold(), gestureSweep() and
+gestureRepeat() into constant tables, see Gestures.cpp. Repeats don't nest.
+
+A gesture can instead be a binary keyframe sequence from the pose library
+(see PoseLibrary.h). Each keyframe is then a step that moves every DOF
+linearly from where it was when the step started to the keyframe's angles.
+
+A gesture names the joints it animates. Streamed DOF frames either stop a
+gesture that is playing (GESTURE_STREAM_PREEMPT, the default), after which
+the motion limits carry the joints over to the streamed pose, or leave the
+gesture's joints alone and drive the rest of the hand around it
+(GESTURE_STREAM_BLEND).
+
+The player keeps its own schedule from the time each step was due to start,
+so late ticks don't stretch a gesture out. A tick only does the work of the
+steps it crosses, which is a handful of calls at most.
+*/
+
+#include <Arduino.h>
+
+#include "DofProtocol.h"
+#include "JointArbiter.h"
+
+#define GESTURE_QUEUE_LENGTH    8
+
+struct GestureStep {
+    void (*pose)();                 // Called when the step starts, or nullptr
+    void (*sweep)(int16_t value);   // Called every tick with the value for that moment, or nullptr
+    int16_t from;
+    int16_t to;
+    uint16_t durationMs;
+    uint8_t repeatFrom;             // Step to go back to
+    uint8_t repeats;                // Times to go back, 0 for none
+};
+
+constexpr GestureStep gesturePose(void (*pose)(), uint16_t holdMs) {
+    return { pose, nullptr, 0, 0, holdMs, 0, 0 };
+}
+
+constexpr GestureStep gestureHold(uint16_t holdMs) {
+    return gesturePose(nullptr, holdMs);
+}
+
+constexpr GestureStep gestureSweep(void (*sweep)(int16_t), int16_t from, int16_t to, uint16_t durationMs) {
+    return { nullptr, sweep, from, to, durationMs, 0, 0 };
+}
+
+constexpr GestureStep gestureRepeat(uint8_t fromStep, uint8_t times) {
+    return { nullptr, nullptr, 0, 0, 0, fromStep, times };
+}
+
+struct Gesture {
+    const char* name;
+    const GestureStep* steps;
+    uint8_t stepCount;              // Steps, or keyframes
+    uint8_t joints;                 // HAND_JOINT_ bits the gesture animates
+    const uint8_t* keyframes = nullptr;     // First keyframe of a pose sequence, in place of the steps
+};
+
+typedef enum gestureStreamMode {
+    GESTURE_STREAM_PREEMPT,
+    GESTURE_STREAM_BLEND
+} GESTURE_STREAM_MODE;
+
+class GesturePlayer {
+
+    public:
+        constexpr GesturePlayer()
+        : mGesture(nullptr), mSource(CONTROL_SOURCE_GESTURE), mStep(0), mStepStartMs(0), mRepeat(0), mFrom{}, mQueue{},
+            mQueueHead(0), mQueueLength(0), mStreamMode(GESTURE_STREAM_PREEMPT), mPlayed(0), mPreempted(0) {
+        }
+
+        // Starts a gesture straight away, dropping anything playing or queued.
+        // The source is whoever asked for it, see requestGesture().
+        void play(const Gesture& gesture, uint32_t nowMs, ControlSource source = CONTROL_SOURCE_GESTURE);
+
+        // Plays a gesture after the ones already playing or queued. Returns
+        // false, and drops it, if the queue is full.
+        bool queue(const Gesture& gesture, uint32_t nowMs, ControlSource source = CONTROL_SOURCE_GESTURE);
+
+        // Stops the gesture and empties the queue. The joints stay where the
+        // gesture left them.
+        void stop();
+
+        // Advances the playing gesture to the given time. Called from the
+        // control tick.
+        void tick(uint32_t nowMs);
+
+        // A streamed frame is about to be applied. In preempt mode this stops
+        // the gesture and counts it as preempted.
+        void streamFrameArrived();
+
+        inline bool isPlaying() const { return mGesture != nullptr; }
+        inline const Gesture* getGesture() const { return mGesture; }
+        inline uint8_t getStep() const { return mStep; }
+
+        // The highest priority source that asked for the gestures playing and
+        // queued. Only it, or a source above it, may replace them.
+        inline ControlSource getSource() const { return mSource; }
+        inline bool mayReplace(ControlSource source) const { return mGesture == nullptr || source >= mSource; }
+
+        // Joints a streamed frame may set: all of them, or the ones the
+        // playing gesture doesn't animate
+        uint8_t getStreamJoints() const;
+
+        inline void setStreamMode(GESTURE_STREAM_MODE mode) { mStreamMode = mode; }
+        inline GESTURE_STREAM_MODE getStreamMode() const { return mStreamMode; }
+
+        // Gestures started, and stopped by a streamed frame
+        inline uint32_t getPlayed() const { return mPlayed; }
+        inline uint32_t getPreempted() const { return mPreempted; }
+
+    private:
+        const Gesture* mGesture;
+        ControlSource mSource;
+        uint8_t mStep;
+        uint32_t mStepStartMs;          // When the current step was due to start
+        uint8_t mRepeat;                // Times the current repeat step has gone back
+        int16_t mFrom[DOF_COUNT];       // DOF angles when the current keyframe started
+
+        const Gesture* mQueue[GESTURE_QUEUE_LENGTH];
+        uint8_t mQueueHead;
+        uint8_t mQueueLength;
+
+        GESTURE_STREAM_MODE mStreamMode;
+        uint32_t mPlayed;
+        uint32_t mPreempted;
+
+        void start(const Gesture& gesture, uint32_t nowMs);
+        void startStep(uint32_t startMs);
+        void moveToKeyframe(const uint8_t* keyframe, uint32_t elapsedMs, uint16_t durationMs);
+        void finish(uint32_t nowMs);
+};
+
+extern GesturePlayer gesturePlayer;
+
+// Plays, or queues, a gesture for a command from the source. It won't
+// replace or queue behind gestures a higher priority source asked for, and
+// it only starts with all of its joints, taking over the source's own
+// leases on them (see JointArbiter.h). Returns the joints refused, 0 if the
+// gesture is playing or queued, with the source in the way in owner.
+uint8_t requestGesture(const Gesture& gesture, ControlSource source, bool queued, uint32_t nowMs, ControlSource& owner);
+
+// Stops the gestures playing and queued for a command from the source.
+// Returns false, leaving them playing, if a higher priority source asked
+// for them.
+bool stopGesture(ControlSource source);
+
+
+#endif
@@ -0,0 +1,279 @@
+#include "Gestures.h"
+#include "Hand.h"
+
+#include <string.h>
+
+
+// ----- Poses -----
+
+// Hand pose for countdown - all fingers closed
+void setZeroPose() {
+
+  setDefaultPose(COUNT_POSE_JOINTS);
+
+  // Move thumb to lower closed position
+  thumb.setMaxPosition();
+  uint8_t joints = HAND_JOINT_THUMB;
+
+  // Move all fingers to max position
+  for (int finger = 0; finger < NUM_FINGERS; finger++)
+  {
+    fingers[finger].setMaxPosition();
+    joints |= HAND_JOINT_FINGER(finger);
+  }
+  updateHandJoints(joints);
+}
+
+// Hand pose for countdown - one finger open
+void setOnePose() {
+
+  setDefaultPose(COUNT_POSE_JOINTS);
+
+  // Move thumb to lower closed position
+  thumb.setMaxPosition();
+  uint8_t joints = HAND_JOINT_THUMB;
+
+  // Move all fingers other than index to max position
+  for (int finger = 1; finger < NUM_FINGERS; finger++)
+  {
+    fingers[finger].setMaxPosition();
+    joints |= HAND_JOINT_FINGER(finger);
+  }
+  updateHandJoints(joints);
+
+}
+
+// Hand pose for countdown - two fingers open
+void setTwoPose() {
+
+  setDefaultPose(COUNT_POSE_JOINTS);
+
+  // Move thumb to lower closed position
+  thumb.setMaxPosition();
+  uint8_t joints = HAND_JOINT_THUMB;
+
+  // Move all fingers other than index,middle finger to max position
+  for (int finger = 2; finger < NUM_FINGERS; finger++)
+  {
+    fingers[finger].setMaxPosition();
+    joints |= HAND_JOINT_FINGER(finger);
+  }
+  updateHandJoints(joints);
+
+}
+
+// Hand pose for countdown - three fingers open
+void setThreePose() {
+
+  setDefaultPose(COUNT_POSE_JOINTS);
+
+  // Move thumb to lower closed position
+  thumb.setMaxPosition();
+  uint8_t joints = HAND_JOINT_THUMB;
+
+  // Move all fingers other than index,middle,ring finger to max position
+  for (int finger = 3; finger < NUM_FINGERS; finger++)
+  {
+    fingers[finger].setMaxPosition();
+    joints |= HAND_JOINT_FINGER(finger);
+  }
+  updateHandJoints(joints);
+}
+
+// Hand pose for countdown - four fingers open
+void setFourPose() {
+
+  setDefaultPose(COUNT_POSE_JOINTS);
+
+  // Move thumb to lower closed position
+  thumb.setMaxPosition();
+  updateHandJoints(HAND_JOINT_THUMB);
+
+}
+
+// Thumb tucked down ahead of the countdown
+static void setThumbClosedPose() {
+  managedServos[SERVO_THUMB_TIP].moveToMaxPosition();
+  managedServos[SERVO_THUMB_RIGHT].moveToMinPosition();
+  managedServos[SERVO_THUMB_LEFT].moveToMaxPosition();
+}
+
+// The default pose for the joints the playing gesture animates. The rest may
+// belong to the stream or a command, see JointArbiter.h.
+static void setGestureDefaultPose() {
+  setDefaultPose(gesturePlayer.getGesture()->joints);
+}
+
+// Index, middle and ring closed with the thumb out, for the shaka
+static void setShakaPose() {
+  setGestureDefaultPose();
+
+  uint8_t joints = HAND_JOINT_THUMB;
+  for (int finger = FINGER_INDEX; finger < FINGER_PINKY; ++finger)
+  {
+    fingers[finger].setMaxPosition();
+    joints |= HAND_JOINT_FINGER(finger);
+  }
+  thumb.setPitch(0);
+  thumb.setYaw(0);
+  thumb.setRoll(15);
+  updateHandJoints(joints);
+}
+
+static void defaultFingers()
+{
+  for (int finger = FINGER_INDEX; finger <= FINGER_PINKY; ++finger)
+  {
+    fingers[finger].setExtension(100);
+  }
+  thumb.setExtension(100);
+  updateHandJoints(HAND_JOINTS_FINGERS | HAND_JOINT_THUMB);
+}
+
+// One finger curled to meet the thumb
+static void setFingerTouch(int finger, int16_t extension, int16_t pitch, int16_t flexion) {
+  fingers[finger].setExtension(extension);
+  thumb.setPitch(pitch);
+  thumb.setYaw(0);
+  thumb.setFlexion(flexion);
+  thumb.setRoll(0);
+  updateHandJoints(HAND_JOINT_FINGER(finger) | HAND_JOINT_THUMB);
+}
+
+static void setPinkyTouch() { setFingerTouch(FINGER_PINKY, 25, 60, 45); }
+static void setRingTouch() { setFingerTouch(FINGER_RING, 30, 60, 30); }
+static void setMiddleTouch() { setFingerTouch(FINGER_MIDDLE, 35, 50, 40); }
+static void setIndexTouch() { setFingerTouch(FINGER_INDEX, 35, 40, 45); }
+
+static void setWristYaw(int16_t yaw) {
+  wrist.setYaw(yaw);
+  updateHandJoints(HAND_JOINT_WRIST);
+}
+
+
+// ----- Thumb Range Test -----
+
+// Steps the two thumb servos through their ranges, 5 at a time, with the left
+// servo moving fastest. Each cell of the grid is held for THUMB_TEST_HOLD_MS.
+#define THUMB_TEST_STEP       5
+#define THUMB_TEST_HOLD_MS    100
+
+constexpr int thumbTestPositions(uint8_t servo) {
+  return (SERVO_CONFIG[servo].maxPosition - SERVO_CONFIG[servo].minPosition) / THUMB_TEST_STEP + 1;
+}
+
+constexpr int THUMB_TEST_CELLS = thumbTestPositions(SERVO_THUMB_RIGHT) * thumbTestPositions(SERVO_THUMB_LEFT);
+
+static_assert(THUMB_TEST_CELLS * THUMB_TEST_HOLD_MS <= UINT16_MAX, "Thumb range test is too long for one step");
+
+// The ranges can be changed at runtime, so the grid is worked out from the
+// servos' current ranges and stops at its last cell
+static void setThumbTestCell(int16_t cell) {
+  ManagedServo& right = managedServos[SERVO_THUMB_RIGHT];
+  ManagedServo& left = managedServos[SERVO_THUMB_LEFT];
+  int rightPositions = (right.getMaxPosition() - right.getMinPosition()) / THUMB_TEST_STEP + 1;
+  int leftPositions = (left.getMaxPosition() - left.getMinPosition()) / THUMB_TEST_STEP + 1;
+  cell = CLAMP(cell, 0, rightPositions * leftPositions - 1);
+
+  right.setServoPosition(right.getMinPosition() + (cell / leftPositions) * THUMB_TEST_STEP);
+  left.setServoPosition(left.getMinPosition() + (cell % leftPositions) * THUMB_TEST_STEP);
+}
+
+
+// ----- Gestures -----
+
+#define STEPS(steps)    steps, sizeof(steps) / sizeof(steps[0])
+
+// Countdown and back up
+static constexpr GestureStep COUNT_STEPS[] = {
+  gesturePose(setThumbClosedPose, 200),
+  gesturePose(setZeroPose, 1000),
+  gesturePose(setOnePose, 1000),
+  gesturePose(setTwoPose, 1000),
+  gesturePose(setThreePose, 1000),
+  gesturePose(setFourPose, 1000),
+  gesturePose(setGestureDefaultPose, 1000),
+  gesturePose(setFourPose, 1000),
+  gesturePose(setThreePose, 1000),
+  gesturePose(setTwoPose, 1000),
+  gesturePose(setOnePose, 1000),
+  gesturePose(setZeroPose, 1000),
+  gesturePose(setGestureDefaultPose, 0)
+};
+
+// Waves the hand side to side. With motion limiting on the wrist trails
+// the sweep and brakes for each end, so every sweep ends in a hold that lets
+// it arrive there before it turns back (see WAVE_SWEEP_MS).
+static constexpr GestureStep WAVE_STEPS[] = {
+  gesturePose(setGestureDefaultPose, 0),
+  gestureSweep(setWristYaw, -WAVE_YAW, WAVE_YAW, WAVE_SWEEP_MS),
+  gestureHold(WAVE_HOLD_MS),
+  gestureSweep(setWristYaw, WAVE_YAW, -WAVE_YAW, WAVE_SWEEP_MS),
+  gestureHold(WAVE_HOLD_MS),
+  gestureRepeat(1, 4),
+  gesturePose(setGestureDefaultPose, 0)
+};
+
+// Perform a shaka, rocking the wrist the same way as the wave
+static constexpr GestureStep SHAKA_STEPS[] = {
+  gesturePose(setShakaPose, 0),
+  gestureSweep(setWristYaw, -SHAKA_YAW, SHAKA_YAW, SHAKA_SWEEP_MS),
+  gestureHold(SHAKA_HOLD_MS),
+  gestureSweep(setWristYaw, SHAKA_YAW, -SHAKA_YAW, SHAKA_SWEEP_MS),
+  gestureHold(SHAKA_HOLD_MS),
+  gestureRepeat(1, 4),
+  gesturePose(setGestureDefaultPose, 0)
+};
+
+static constexpr GestureStep THUMB_TEST_STEPS[] = {
+  gestureSweep(setThumbTestCell, 0, THUMB_TEST_CELLS, THUMB_TEST_CELLS * THUMB_TEST_HOLD_MS),
+  gesturePose(setGestureDefaultPose, 0)
+};
+
+// Touches each finger in turn with the thumb
+static constexpr GestureStep FINGER_TEST_STEPS[] = {
+  gesturePose(defaultFingers, 1000),
+  gesturePose(setPinkyTouch, 1000),
+  gesturePose(defaultFingers, 1000),
+  gesturePose(setRingTouch, 1000),
+  gesturePose(defaultFingers, 1000),
+  gesturePose(setMiddleTouch, 1000),
+  gesturePose(defaultFingers, 1000),
+  gesturePose(setIndexTouch, 1000),
+  gesturePose(defaultFingers, 1000)
+};
+
+static constexpr Gesture GESTURES[] = {
+  // Name, Steps, Joints
+  { "count", STEPS(COUNT_STEPS), COUNT_POSE_JOINTS },
+  { "wave", STEPS(WAVE_STEPS), HAND_JOINT_WRIST },
+  { "shaka", STEPS(SHAKA_STEPS), HAND_JOINTS_ALL },
+  { "thumbtest", STEPS(THUMB_TEST_STEPS), HAND_JOINT_THUMB },
+  { "fingertest", STEPS(FINGER_TEST_STEPS), HAND_JOINTS_FINGERS | HAND_JOINT_THUMB }
+};
+
+#define NUM_GESTURES    (sizeof(GESTURES) / sizeof(GESTURES[0]))
+
+
+const Gesture* findGesture(const char* name) {
+  for (size_t i = 0; i < NUM_GESTURES; i++) {
+    if (strcmp(GESTURES[i].name, name) == 0) {
+      return &GESTURES[i];
+    }
+  }
+  return nullptr;
+}
+
+uint8_t playDemo(ControlSource source, uint32_t nowMs, ControlSource& owner) {
+  static const char* const DEMO[] = { "wave", "fingertest", "count", "shaka" };
+
+  bool queued = false;
+  for (const char* name : DEMO) {
+    uint8_t refused = requestGesture(*findGesture(name), source, queued, nowMs, owner);
+    if (refused != 0) {
+      return refused;
+    }
+    queued = true;
+  }
+  return 0;
+}
@@ -0,0 +1,48 @@
+#ifndef GESTURES_H
+#define GESTURES_H
+
+/*
+Canned Poses and Gestures
+
+The poses and animations the hand can run on its own, for testing and for
+the demo button. The poses are applied straight away. The gestures are
+timelines for gesturePlayer (see Gesture.h), so they play out from the
+control tick without holding up the loop.
+*/
+
+#include "Gesture.h"
+#include "Hand.h"
+
+// Countdown poses, the number of fingers open. They only move the fingers
+// and thumb, and leave the wrist to whoever holds it.
+#define COUNT_POSE_JOINTS   (HAND_JOINTS_FINGERS | HAND_JOINT_THUMB)
+void setZeroPose();
+void setOnePose();
+void setTwoPose();
+void setThreePose();
+void setFourPose();
+
+// The wave and shaka sweep the wrist yaw from side to side, five times
+// over. With motion limiting on the wrist trails a sweep, and without a
+// pause it turns back short of the end - a 240ms wave only reached about
+// 30 degrees. Each sweep ends in a hold long enough for the wrist to brake
+// onto the end and settle under WRIST_MOTION's limits, so both gestures
+// reach their full amplitude.
+#define WAVE_YAW            40
+#define WAVE_SWEEP_MS       320
+#define WAVE_HOLD_MS        120
+#define WAVE_MS             (5 * 2 * (WAVE_SWEEP_MS + WAVE_HOLD_MS))
+#define SHAKA_YAW           20
+#define SHAKA_SWEEP_MS      200
+#define SHAKA_HOLD_MS       80
+
+// Looks a gesture up by name - count, wave, shaka, thumbtest or fingertest.
+// nullptr if there isn't one.
+const Gesture* findGesture(const char* name);
+
+// Plays the demo for a command from the source: a wave, the finger test, a
+// count and a shaka. Returns the joints refused, as requestGesture() does.
+uint8_t playDemo(ControlSource source, uint32_t nowMs, ControlSource& owner);
+
+
+#endif
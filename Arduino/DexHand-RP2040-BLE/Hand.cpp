@@ -0,0 +1,134 @@
+#include "Hand.h"
+#include "DofRegistry.h"
+#include "Latency.h"
+#include "Mixer.h"
+#include "Profiler.h"
+
+
+// Everything below is built from the tables in HandConfig.h and initialized
+// at compile time - there are no constructors to run at startup.
+
+ManagedServo managedServos[NUM_SERVOS] =
+{
+  SERVO_CONFIG[SERVO_INDEX_LOWER],
+  SERVO_CONFIG[SERVO_INDEX_UPPER],
+  SERVO_CONFIG[SERVO_MIDDLE_LOWER],
+  SERVO_CONFIG[SERVO_MIDDLE_UPPER],
+  SERVO_CONFIG[SERVO_RING_LOWER],
+  SERVO_CONFIG[SERVO_RING_UPPER],
+  SERVO_CONFIG[SERVO_PINKY_LOWER],
+  SERVO_CONFIG[SERVO_PINKY_UPPER],
+  SERVO_CONFIG[SERVO_INDEX_TIP],
+  SERVO_CONFIG[SERVO_MIDDLE_TIP],
+  SERVO_CONFIG[SERVO_RING_TIP],
+  SERVO_CONFIG[SERVO_PINKY_TIP],
+  SERVO_CONFIG[SERVO_THUMB_TIP],
+  SERVO_CONFIG[SERVO_THUMB_RIGHT],
+  SERVO_CONFIG[SERVO_THUMB_LEFT],
+  SERVO_CONFIG[SERVO_THUMB_ROTATE],
+  SERVO_CONFIG[SERVO_WRIST_L],
+  SERVO_CONFIG[SERVO_WRIST_R]
+};
+
+static constexpr Finger makeFinger(uint8_t finger) {
+  return Finger(FINGER_CONFIG[finger].name, FINGER_MOTION);
+}
+
+Finger fingers[NUM_FINGERS] = {
+  makeFinger(FINGER_INDEX),
+  makeFinger(FINGER_MIDDLE),
+  makeFinger(FINGER_RING),
+  makeFinger(FINGER_PINKY)
+};
+
+Thumb thumb(THUMB_MOTION);
+Wrist wrist(WRIST_MOTION);
+
+static bool motionLimiting = true;
+
+
+void setupServos() {
+  applyDofRanges();
+  startServos();
+}
+
+void startServos() {
+  for (int index = 0; index < NUM_SERVOS; index++)
+  {
+    managedServos[index].setupServo();
+  }
+}
+
+void setDefaultPose() {
+  setDefaultPose(HAND_JOINTS_ALL);
+}
+
+void setDefaultPose(uint8_t joints) {
+  ManagedServo::beginFrame();
+  for (int index = 0; index < NUM_SERVOS; index++)
+  {
+    if (joints & HAND_JOINT(SERVO_CONFIG[index].joint)) {
+      managedServos[index].setServoPosition(managedServos[index].getDefaultPosition());
+    }
+  }
+  ManagedServo::commitFrame();
+}
+
+void updateHand() {
+  updateHandJoints(HAND_JOINTS_ALL);
+}
+
+void updateHandJoints(uint8_t joints) {
+  PROFILE_SCOPE(PROFILE_UPDATE_HAND);
+  LATENCY_START(start);
+
+  // Joint updates are staged and sent to the servos together
+  ManagedServo::beginFrame();
+  mixHand(joints);
+  ManagedServo::commitFrame();
+  LATENCY_RECORD(LATENCY_UPDATE, start);
+}
+
+void tickHand() {
+  LATENCY_START(start);
+  uint8_t moved = 0;
+
+  // Only joints that are still moving need their servos updated, so anything
+  // set directly on a servo stays put once the joints have settled
+  for (int index = 0; index < NUM_FINGERS; index++) {
+    if (fingers[index].tick()) {
+      moved |= HAND_JOINT_FINGER(index);
+    }
+  }
+  if (thumb.tick()) {
+    moved |= HAND_JOINT_THUMB;
+  }
+  if (wrist.tick()) {
+    moved |= HAND_JOINT_WRIST;
+  }
+
+  ManagedServo::beginFrame();
+  if (moved) {
+    mixHand(moved);
+  }
+  ManagedServo::commitFrame();
+
+  // Most ticks have nothing to do once the joints settle, and aren't worth recording
+  if (moved) {
+    LATENCY_RECORD(LATENCY_UPDATE, start);
+  }
+}
+
+void setMotionLimiting(bool enabled) {
+  motionLimiting = enabled;
+
+  for (int index = 0; index < NUM_FINGERS; index++) {
+    fingers[index].setMotionLimits(enabled ? FINGER_MOTION : FingerMotionConfig{});
+  }
+  thumb.setMotionLimits(enabled ? THUMB_MOTION : ThumbMotionConfig{});
+  wrist.setMotionLimits(enabled ? WRIST_MOTION : WristMotionConfig{});
+}
+
+bool isMotionLimiting() {
+  return motionLimiting;
+}
@@ -0,0 +1,66 @@
+#ifndef HAND_H
+#define HAND_H
+
+/*
+Hand Definition
+
+The hand is the fixed set of servos, fingers, thumb and wrist that make up
+the DexHand. The objects live in Hand.cpp, built from the compile-time tables
+in HandConfig.h, so that the kinematics can be built and exercised on their
+own (see the Host folder) without pulling in the BLE and command handling
+in the main sketch.
+*/
+
+#include "HandConfig.h"
+#include "ManagedServo.h"
+#include "Finger.h"
+#include "Thumb.h"
+#include "Wrist.h"
+
+
+// Bits for updateHandJoints(), one per finger followed by the thumb and wrist
+#define HAND_JOINT(joint)           (1u << (joint))         // Any JOINT_ index
+#define HAND_JOINT_FINGER(finger)   (1u << (finger))
+#define HAND_JOINT_THUMB            (1u << NUM_FINGERS)
+#define HAND_JOINT_WRIST            (1u << (NUM_FINGERS+1))
+#define HAND_JOINTS_FINGERS         ((1u << NUM_FINGERS) - 1)
+#define HAND_JOINTS_ALL             ((1u << (NUM_FINGERS+2)) - 1)
+
+
+extern ManagedServo managedServos[NUM_SERVOS];
+extern Finger fingers[NUM_FINGERS];
+extern Thumb thumb;
+extern Wrist wrist;
+
+
+// Bind every servo in the table to its output, and give the joints their
+// ranges from the DOF registry
+void setupServos();
+
+// The second half of setupServos(), after applyDofRanges(), for a boot that
+// loads the calibration in between. Each servo starts at its rest position.
+void startServos();
+
+// Reset servos to default position, or only those of the joints in the mask
+void setDefaultPose();
+void setDefaultPose(uint8_t joints);
+
+// This method is called to process all of the higher level objects (Finger,Thumb)
+// and update the servo positions based on the current hand angles, through the
+// mixer (see Mixer.h). All of the servos are committed together as one frame.
+void updateHand();
+
+// As updateHand(), but only for the joints in the mask
+void updateHandJoints(uint8_t joints);
+
+// Steps every joint toward its targets within the motion limits and updates
+// the servos of the joints that moved. Call this at CONTROL_RATE_HZ.
+void tickHand();
+
+// Turns the motion limits in HandConfig.h on or off. With them off, each
+// joint follows its targets as soon as they are set.
+void setMotionLimiting(bool enabled);
+bool isMotionLimiting();
+
+
+#endif
@@ -0,0 +1,217 @@
+#ifndef HAND_CONFIG_H
+#define HAND_CONFIG_H
+
+/*
+Hand Configuration
+
+The DexHand is a fixed 18 servo hand, so its topology is described here as
+compile-time tables: which GPIO pin drives each servo, its limits and
+inversion, and which joint it belongs to. The tables are constexpr, so they
+live in flash, and the servo/finger/thumb/wrist objects in Hand.cpp are
+built from them without any code running at startup.
+
+You may need to adjust the servo table if you are using different servos,
+or wire the servos to different GPIO pins. The static_assert at the bottom
+checks that the tables still describe a consistent hand.
+*/
+
+#include <stdint.h>
+
+
+// ----- Servo Indices -----
+#define NUM_SERVOS       18
+
+#define SERVO_INDEX_LOWER   0
+#define SERVO_INDEX_UPPER   1
+#define SERVO_MIDDLE_LOWER  2
+#define SERVO_MIDDLE_UPPER  3
+#define SERVO_RING_LOWER  4
+#define SERVO_RING_UPPER  5
+#define SERVO_PINKY_LOWER  6
+#define SERVO_PINKY_UPPER  7
+#define SERVO_INDEX_TIP 8
+#define SERVO_MIDDLE_TIP 9
+#define SERVO_RING_TIP 10
+#define SERVO_PINKY_TIP 11
+#define SERVO_THUMB_TIP 12
+#define SERVO_THUMB_RIGHT 13
+#define SERVO_THUMB_LEFT 14
+#define SERVO_THUMB_ROTATE 15
+#define SERVO_WRIST_L 16
+#define SERVO_WRIST_R 17
+
+
+// Finger, Thumb, and Wrist objects for managing the DOF's in a more intuitive fashion.
+typedef enum fingerIdx {
+  FINGER_INDEX,
+  FINGER_MIDDLE,
+  FINGER_RING,
+  FINGER_PINKY,
+  NUM_FINGERS
+} FINGER_IDX;
+
+// Every servo belongs to exactly one joint - the fingers come first so that
+// a finger index is also its joint index.
+typedef enum jointIdx {
+  JOINT_INDEX = FINGER_INDEX,
+  JOINT_MIDDLE = FINGER_MIDDLE,
+  JOINT_RING = FINGER_RING,
+  JOINT_PINKY = FINGER_PINKY,
+  JOINT_THUMB = NUM_FINGERS,
+  JOINT_WRIST,
+  NUM_JOINTS
+} JOINT_IDX;
+
+
+struct ServoConfig {
+  uint8_t pin;
+  uint8_t minPosition;
+  uint8_t maxPosition;
+  uint8_t defaultPosition;
+  bool invertAngles;
+  uint8_t joint;
+};
+
+constexpr ServoConfig SERVO_CONFIG[NUM_SERVOS] =
+{
+  // Servo GPIO Pin, Min, Max, Default, Inverted, Joint
+  { 2, 30, 110, 30, false, JOINT_INDEX },   // Index Lower 0
+  { 1, 30, 140, 30, true, JOINT_INDEX },    // Index Upper 1
+  { 5, 30, 120, 30, false, JOINT_MIDDLE },  // Middle Lower 2
+  { 4, 30, 150, 30, true, JOINT_MIDDLE },   // Middle Upper 3
+  { 3, 30, 150, 30, true, JOINT_RING },     // Ring Lower 4
+  { 0, 30, 100, 30, false, JOINT_RING },    // Ring Upper  5
+  { 7, 30, 140, 30, true, JOINT_PINKY },    // Pinky Lower 6
+  { 6, 30, 100, 30, false, JOINT_PINKY },   // Pinky Upper 7
+  { 10, 30, 100, 30, false, JOINT_INDEX },  // Index Tip 8
+  { 11, 30, 90, 30, false, JOINT_MIDDLE },  // Middle Tip 9
+  { 12, 30, 120, 30, true, JOINT_RING },    // Ring Tip 10
+  { 13, 30, 130, 30, true, JOINT_PINKY },   // Pinky Tip 11
+  { 14, 30, 130, 30, false, JOINT_THUMB },  // Thumb Tip 12
+  { 15, 30, 150, 30, false, JOINT_THUMB },  // Thumb Right 13
+  { 16, 20, 120, 20, false, JOINT_THUMB },  // Thumb Left 14
+  { 17, 30, 90, 30, false, JOINT_THUMB },   // Thumb Rotate 15
+  { 9, 30, 160, 95, false, JOINT_WRIST },   // Wrist Left 16
+  { 8, 30, 160, 95, false, JOINT_WRIST }    // Wrist Right 17
+};
+
+
+struct FingerConfig {
+  const char* name;
+  uint8_t leftPitchServo;
+  uint8_t rightPitchServo;
+  uint8_t flexionServo;
+};
+
+constexpr FingerConfig FINGER_CONFIG[NUM_FINGERS] =
+{
+  { "index", SERVO_INDEX_LOWER, SERVO_INDEX_UPPER, SERVO_INDEX_TIP },
+  { "middle", SERVO_MIDDLE_LOWER, SERVO_MIDDLE_UPPER, SERVO_MIDDLE_TIP },
+  { "ring", SERVO_RING_LOWER, SERVO_RING_UPPER, SERVO_RING_TIP },
+  { "pinky", SERVO_PINKY_LOWER, SERVO_PINKY_UPPER, SERVO_PINKY_TIP }
+};
+
+struct ThumbConfig {
+  uint8_t leftPitchServo;
+  uint8_t rightPitchServo;
+  uint8_t flexionServo;
+  uint8_t rollServo;
+};
+
+constexpr ThumbConfig THUMB_CONFIG = { SERVO_THUMB_LEFT, SERVO_THUMB_RIGHT, SERVO_THUMB_TIP, SERVO_THUMB_ROTATE };
+
+struct WristConfig {
+  uint8_t leftPitchServo;
+  uint8_t rightPitchServo;
+};
+
+constexpr WristConfig WRIST_CONFIG = { SERVO_WRIST_L, SERVO_WRIST_R };
+
+
+// ----- Motion Limits -----
+
+// Rate of the control tick that steps the joint trajectories, see tickHand()
+#define CONTROL_RATE_HZ   100
+
+// Velocity (degrees/s) and acceleration (degrees/s^2) limits on a joint
+// angle. A limit of 0 leaves that part of the motion unconstrained, and with
+// both at 0 the joint follows its target immediately.
+struct MotionLimits {
+  uint16_t maxVelocity;
+  uint16_t maxAcceleration;
+};
+
+struct FingerMotionConfig {
+  MotionLimits pitch;
+  MotionLimits yaw;
+  MotionLimits flexion;
+};
+
+struct ThumbMotionConfig {
+  MotionLimits pitch;
+  MotionLimits yaw;
+  MotionLimits flexion;
+  MotionLimits roll;
+};
+
+struct WristMotionConfig {
+  MotionLimits pitch;
+  MotionLimits yaw;
+};
+
+// Starting points arrived at by watching the hand - fast enough that a real
+// hand movement isn't visibly slowed, but tracker noise can no longer make
+// a joint jump 20 degrees in a single frame.
+constexpr FingerMotionConfig FINGER_MOTION = { { 400, 4000 }, { 300, 3000 }, { 800, 8000 } };
+constexpr ThumbMotionConfig THUMB_MOTION = { { 300, 3000 }, { 300, 3000 }, { 400, 4000 }, { 200, 2000 } };
+constexpr WristMotionConfig WRIST_MOTION = { { 360, 3000 }, { 360, 3000 } };
+
+
+// ----- Compile Time Checks -----
+
+// Number of joint slots in the tables above that drive the given servo
+constexpr int servoUseCount(uint8_t servo) {
+  int count = 0;
+  for (int finger = 0; finger < NUM_FINGERS; finger++) {
+    count += (FINGER_CONFIG[finger].leftPitchServo == servo) + (FINGER_CONFIG[finger].rightPitchServo == servo) +
+      (FINGER_CONFIG[finger].flexionServo == servo);
+  }
+  count += (THUMB_CONFIG.leftPitchServo == servo) + (THUMB_CONFIG.rightPitchServo == servo) +
+    (THUMB_CONFIG.flexionServo == servo) + (THUMB_CONFIG.rollServo == servo);
+  count += (WRIST_CONFIG.leftPitchServo == servo) + (WRIST_CONFIG.rightPitchServo == servo);
+  return count;
+}
+
+constexpr bool servoBelongsToJoint(uint8_t servo, uint8_t joint) {
+  return joint < NUM_FINGERS ?
+    (FINGER_CONFIG[joint].leftPitchServo == servo || FINGER_CONFIG[joint].rightPitchServo == servo ||
+      FINGER_CONFIG[joint].flexionServo == servo) :
+    joint == JOINT_THUMB ?
+    (THUMB_CONFIG.leftPitchServo == servo || THUMB_CONFIG.rightPitchServo == servo ||
+      THUMB_CONFIG.flexionServo == servo || THUMB_CONFIG.rollServo == servo) :
+    (WRIST_CONFIG.leftPitchServo == servo || WRIST_CONFIG.rightPitchServo == servo);
+}
+
+constexpr bool handConfigIsValid() {
+  for (uint8_t servo = 0; servo < NUM_SERVOS; servo++) {
+    const ServoConfig& config = SERVO_CONFIG[servo];
+    if (config.minPosition > config.maxPosition || config.defaultPosition < config.minPosition ||
+        config.defaultPosition > config.maxPosition || config.joint >= NUM_JOINTS) {
+      return false;
+    }
+    if (servoUseCount(servo) != 1 || !servoBelongsToJoint(servo, config.joint)) {
+      return false;
+    }
+    for (uint8_t other = servo + 1; other < NUM_SERVOS; other++) {
+      if (SERVO_CONFIG[other].pin == config.pin) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+static_assert(handConfigIsValid(), "Hand configuration tables are inconsistent - check pins, limits and joint assignments");
+
+
+#endif
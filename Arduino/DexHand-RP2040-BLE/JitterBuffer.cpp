@@ -0,0 +1,248 @@
+#include "JitterBuffer.h"
+#include "MathUtils.h"
+
+#include <string.h>
+
+
+#define VELOCITY_SHIFT      20      // Q20 hundredths of a degree per us
+#define VELOCITY_SMOOTHING  1       // Each new frame pair moves the velocity half way
+#define MAX_VELOCITY        ((2000LL * DOF_V2_ANGLE_SCALE << VELOCITY_SHIFT) / 1000000)  // 2000 degrees per second
+#define RECIPROCAL_SHIFT    8       // Extra bits on 1/span, so slow motion across a wide span isn't lost
+#define TRAVEL_SHIFT        5       // Travel in 32us steps, so velocity * travel fits 32 bits
+
+
+bool JitterBuffer::push(const DofFrame& frame, uint32_t arrivalUs) {
+    return mEntries.push({ frame, arrivalUs });
+}
+
+void JitterBuffer::updateOffset(uint32_t depth, uint32_t nowUs) {
+    for (; mScanned < depth; mScanned++) {
+        const Entry& next = mEntries.peek(mScanned);
+        uint32_t offset = next.arrivalUs - next.frame.timestamp;
+
+        if (!mHaveOffset) {
+            mOffsetUs = offset;
+            mHaveOffset = true;
+        }
+        else {
+            // Follow the quickest trip down straight away, and let the estimate
+            // creep up slowly in case the clocks are drifting apart
+            mOffsetUs += JITTER_DRIFT_US;
+            int32_t change = static_cast<int32_t>(offset - mOffsetUs);
+            if (change < 0 || change > JITTER_RESYNC_US) {
+                if (change > JITTER_RESYNC_US || change < -JITTER_RESYNC_US) {
+                    mResyncs++;
+                }
+                mOffsetUs = offset;
+            }
+        }
+
+        // Its playout time had already passed by the time we saw it
+        uint32_t playout = nowUs - mOffsetUs - mDelayUs;
+        if (static_cast<int32_t>(playout - next.frame.timestamp) > 0) {
+            mLate++;
+        }
+    }
+}
+
+bool JitterBuffer::sample(uint32_t nowUs, DofFrame& frame) {
+    uint32_t depth = mEntries.getDepth();
+    updateOffset(depth, nowUs);
+    if (depth == 0) {
+        return false;
+    }
+
+    // Skip frames once the one after them is due. The newest frame is always
+    // kept, so there's something to hold if the buffer runs dry.
+    uint32_t playout = nowUs - mOffsetUs - mDelayUs;
+    uint32_t skipped = 0;
+    while (depth - skipped > 1 && static_cast<int32_t>(playout - mEntries.peek(skipped + 1).frame.timestamp) >= 0) {
+        skipped++;
+    }
+    if (skipped > 0) {
+        // For dead reckoning if the buffer runs dry on the new front entry
+        updateVelocity(mEntries.peek(skipped - 1).frame, mEntries.peek(skipped).frame);
+
+        mEntries.discard(skipped);
+        mScanned -= skipped;
+        depth -= skipped;
+        mPlaying = false;
+    }
+
+    if (depth > mMaxDepth) {
+        mMaxDepth = depth;
+    }
+
+    const Entry& from = mEntries.peek(0);
+    int32_t elapsed = static_cast<int32_t>(playout - from.frame.timestamp);
+    if (elapsed < 0) {
+        // Still filling up to the target delay
+        return false;
+    }
+
+    if (!mPlaying) {
+        mPlaying = true;
+        mPlayed++;
+        mLastLatencyUs = nowUs - from.arrivalUs;
+        mTotalLatencyUs += mLastLatencyUs;
+        if (mLastLatencyUs > mMaxLatencyUs) {
+            mMaxLatencyUs = mLastLatencyUs;
+        }
+    }
+
+    if (depth == 1) {
+        // Run dry - hold the newest frame until another arrives, or carry on
+        // from it with dead reckoning
+        bool extrapolated = mExtrapolateUs > 0 && extrapolate(from.frame, static_cast<uint32_t>(elapsed), frame);
+        if (!mUnderrun) {
+            mUnderrun = true;
+            mUnderruns++;
+            mExtrapolations += extrapolated;
+        }
+        if (!extrapolated) {
+            frame = from.frame;
+        }
+    }
+    else {
+        mUnderrun = false;
+
+        // Interpolate in Q15 between this frame and the next
+        const Entry& to = mEntries.peek(1);
+        uint32_t span = to.frame.timestamp - from.frame.timestamp;
+        int32_t fraction = span ? static_cast<int32_t>((static_cast<uint64_t>(elapsed) << Q15_SHIFT) / span) : Q15_ONE;
+
+        for (int i = 0; i < DOF_COUNT; i++) {
+            int32_t change = to.frame.angles[i] - from.frame.angles[i];
+            frame.angles[i] = static_cast<int16_t>(from.frame.angles[i] + ((change * fraction + Q15_HALF) >> Q15_SHIFT));
+        }
+        frame.sequence = from.frame.sequence;
+        frame.timestamp = playout;
+        frame.version = from.frame.version;
+#if LATENCY_INSTRUMENTATION
+        frame.receivedTicks = from.frame.receivedTicks;
+#endif
+    }
+    frame.mask = DOF_ALL_MASK;
+
+    if (mExtrapolateUs > 0) {
+        blend(nowUs, from.frame.timestamp, frame);
+    }
+    return true;
+}
+
+// Smooths each DOF's velocity between the frame that has finished playing
+// and the one taking over. Runs once per frame rather than once per tick.
+void JitterBuffer::updateVelocity(const DofFrame& previous, const DofFrame& next) {
+    uint32_t span = next.timestamp - previous.timestamp;
+    if (span == 0) {
+        return;
+    }
+    if (span > JITTER_EXTRAPOLATE_MAX_SPAN_US) {
+        mHaveVelocity = false;
+        return;
+    }
+
+    int32_t perUs = static_cast<int32_t>((1L << (VELOCITY_SHIFT + RECIPROCAL_SHIFT)) / span);
+    for (int i = 0; i < DOF_COUNT; i++) {
+        int64_t pair = (static_cast<int64_t>(next.angles[i] - previous.angles[i]) * perUs) >> RECIPROCAL_SHIFT;
+        int32_t velocity = static_cast<int32_t>(CLAMP(pair, -MAX_VELOCITY, MAX_VELOCITY));
+        mVelocity[i] = mHaveVelocity ? mVelocity[i] + ((velocity - mVelocity[i]) >> VELOCITY_SMOOTHING) : velocity;
+    }
+    mHaveVelocity = true;
+}
+
+// Carries the newest frame on along the velocities up to the horizon, then
+// eases back to it over another horizon, so a stream that has stopped for
+// good leaves the hand where it was last sent. Returns false if there's no
+// recent motion to go on.
+bool JitterBuffer::extrapolate(const DofFrame& newest, uint32_t elapsedUs, DofFrame& frame) {
+    if (!mHaveVelocity) {
+        return false;
+    }
+
+    uint32_t travelUs = 0;
+    if (elapsedUs < mExtrapolateUs) {
+        travelUs = elapsedUs;
+    }
+    else if (elapsedUs < 2 * mExtrapolateUs) {
+        travelUs = 2 * mExtrapolateUs - elapsedUs;
+    }
+    int32_t travel = static_cast<int32_t>(travelUs >> TRAVEL_SHIFT);
+
+    for (int i = 0; i < DOF_COUNT; i++) {
+        int32_t moved = (mVelocity[i] * travel + (1L << (VELOCITY_SHIFT - TRAVEL_SHIFT - 1))) >> (VELOCITY_SHIFT - TRAVEL_SHIFT);
+        int32_t angle = newest.angles[i] + moved;
+        frame.angles[i] = static_cast<int16_t>(CLAMP(angle, INT16_MIN, INT16_MAX));
+    }
+    frame.sequence = newest.sequence;
+    frame.timestamp = newest.timestamp + elapsedUs;
+    frame.version = newest.version;
+#if LATENCY_INSTRUMENTATION
+    frame.receivedTicks = newest.receivedTicks;
+#endif
+    return true;
+}
+
+// Fades out the step between a held or extrapolated pose and the frames that
+// take over from it. The step is measured against the last sample, blend
+// and all, so a new step part way through a blend carries on smoothly too.
+void JitterBuffer::blend(uint32_t nowUs, uint32_t basisTimestamp, DofFrame& frame) {
+    if (mDeadReckoned && (!mUnderrun || basisTimestamp != mDeadReckonedTimestamp)) {
+        for (int i = 0; i < DOF_COUNT; i++) {
+            mBlendOffset[i] = mLast[i] - frame.angles[i];
+        }
+        mBlendStartUs = nowUs;
+        mBlending = true;
+    }
+    mDeadReckoned = mUnderrun;
+    mDeadReckonedTimestamp = basisTimestamp;
+
+    if (mBlending) {
+        uint32_t sinceUs = nowUs - mBlendStartUs;
+        if (sinceUs >= JITTER_BLEND_MS * 1000ul) {
+            mBlending = false;
+        }
+        else {
+            int32_t weight = static_cast<int32_t>((static_cast<uint64_t>(JITTER_BLEND_MS * 1000ul - sinceUs) << Q15_SHIFT) / (JITTER_BLEND_MS * 1000ul));
+            for (int i = 0; i < DOF_COUNT; i++) {
+                int32_t angle = frame.angles[i] + ((mBlendOffset[i] * weight + Q15_HALF) >> Q15_SHIFT);
+                frame.angles[i] = static_cast<int16_t>(CLAMP(angle, INT16_MIN, INT16_MAX));
+            }
+        }
+    }
+    memcpy(mLast, frame.angles, sizeof(mLast));
+}
+
+void JitterBuffer::reset() {
+    mEntries.discard(mEntries.getDepth());
+    mScanned = 0;
+    mHaveOffset = false;
+    mUnderrun = false;
+    mPlaying = false;
+    mHaveVelocity = false;
+    mDeadReckoned = false;
+    mBlending = false;
+}
+
+void JitterBuffer::setDelayUs(uint32_t delayUs) {
+    mDelayUs = delayUs > JITTER_MAX_DELAY_MS * 1000ul ? JITTER_MAX_DELAY_MS * 1000ul : delayUs;
+}
+
+void JitterBuffer::setExtrapolationUs(uint32_t extrapolateUs) {
+    mExtrapolateUs = extrapolateUs > JITTER_MAX_EXTRAPOLATE_MS * 1000ul ? JITTER_MAX_EXTRAPOLATE_MS * 1000ul : extrapolateUs;
+    mDeadReckoned = false;
+    mBlending = false;
+}
+
+void JitterBuffer::resetCounters() {
+    mOverflowsZero = mEntries.getDropped();
+    mMaxDepth = 0;
+    mUnderruns = 0;
+    mLate = 0;
+    mResyncs = 0;
+    mPlayed = 0;
+    mExtrapolations = 0;
+    mLastLatencyUs = 0;
+    mMaxLatencyUs = 0;
+    mTotalLatencyUs = 0;
+}
@@ -0,0 +1,148 @@
+#ifndef JITTER_BUFFER_H
+#define JITTER_BUFFER_H
+
+/*
+Jitter Buffer Definition
+
+Frames from the camera pipeline leave the sender at an uneven 15-30 Hz, and
+the BLE connection interval bunches them up again on the way. Applied as
+they arrive, that unevenness shows up as stutter in the hand. The jitter
+buffer holds timestamped frames for a short, fixed delay and plays them out
+against the sender's clock, interpolating between neighbouring frames at the
+control rate.
+
+The sender's clock is mapped onto ours with the smallest arrival offset seen,
+which is the frame that had the quickest trip. That minimum leaks upward a
+little every frame so the mapping follows clock drift, and is thrown away if
+the offset jumps by more than JITTER_RESYNC_US (a sender restart). A frame is
+played at its sender time plus the offset plus the target delay, so a frame
+that had the quickest trip sits in the buffer for exactly the target delay
+and slower ones for less.
+
+When a frame is overdue and the buffer runs dry, the newest frame is held
+until another arrives, and the hand freezes and then jumps. With dead
+reckoning on, the buffer instead carries on along each DOF's recent motion
+for up to the extrapolation horizon. If nothing has come by then it eases
+back to the newest frame over another horizon, so a stream that stops for
+good doesn't leave the hand in a pose it was never sent. When real frames
+take over again, the difference between them and where the hand was taken
+is faded out over JITTER_BLEND_MS rather than jumped. Both cost a multiply
+and a shift per DOF per tick, as the interpolation does.
+
+The velocities are smoothed across frames as each one starts to play, since
+the tracker's noise makes the motion between any two frames about as noisy
+as the motion itself. Frames more than
+JITTER_EXTRAPOLATE_MAX_SPAN_US apart mean the stream paused, and the
+velocities start again from the next pair.
+
+push() is called from the BLE handler and everything else from the control
+tick. The frames are held in an SpscQueue, so the two sides can run on
+different cores.
+*/
+
+#include <Arduino.h>
+
+#include "DofProtocol.h"
+#include "SpscQueue.h"
+
+#define JITTER_BUFFER_FRAMES      16          // Power of two
+#define JITTER_MAX_DELAY_MS       250
+#define JITTER_DRIFT_US           20          // Offset leak per frame, about 600ppm at 30 Hz
+#define JITTER_RESYNC_US          1000000
+#define JITTER_MAX_EXTRAPOLATE_MS 250
+#define JITTER_EXTRAPOLATE_MAX_SPAN_US 100000   // Widest frame pair to take a velocity from
+#define JITTER_BLEND_MS           30
+
+class JitterBuffer {
+
+    public:
+        // Dead reckoning is off with an extrapolation horizon of 0
+        constexpr JitterBuffer(uint32_t delayUs, uint32_t extrapolateUs = 0)
+        : mEntries(), mScanned(0), mDelayUs(delayUs), mOffsetUs(0), mHaveOffset(false), mUnderrun(false),
+            mPlaying(false), mExtrapolateUs(extrapolateUs), mVelocity{}, mHaveVelocity(false), mDeadReckoned(false),
+            mDeadReckonedTimestamp(0), mLast{}, mBlendOffset{}, mBlendStartUs(0), mBlending(false), mMaxDepth(0), mOverflowsZero(0), mUnderruns(0), mLate(0), mResyncs(0), mPlayed(0),
+            mExtrapolations(0), mLastLatencyUs(0), mMaxLatencyUs(0), mTotalLatencyUs(0) {
+        }
+
+        // Producer side. Returns false, and drops the frame, if the buffer is full.
+        bool push(const DofFrame& frame, uint32_t arrivalUs);
+
+        // Consumer side. Fills in the frame to apply at the given time, which is
+        // interpolated between the two buffered frames either side of it, or the
+        // newest frame, held or extrapolated, if the buffer has run dry.
+        // Returns false if there is nothing to play yet.
+        bool sample(uint32_t nowUs, DofFrame& frame);
+
+        // Consumer side. Empties the buffer and starts the clock mapping again.
+        // A frame pushed meanwhile is kept, as the first of the new stream.
+        void reset();
+
+        void setDelayUs(uint32_t delayUs);
+        inline uint32_t getDelayUs() const { return mDelayUs; }
+
+        // Consumer side, like sample()
+        void setExtrapolationUs(uint32_t extrapolateUs);
+        inline uint32_t getExtrapolationUs() const { return mExtrapolateUs; }
+
+        // Stats. Latency is the time from a frame arriving to it starting to play.
+        inline uint32_t getDepth() const { return mEntries.getDepth(); }
+        inline uint32_t getMaxDepth() const { return mMaxDepth; }
+        inline uint32_t getOverflows() const { return mEntries.getDropped() - mOverflowsZero; }
+        inline uint32_t getUnderruns() const { return mUnderruns; }
+        inline uint32_t getLate() const { return mLate; }          // Arrived after their playout time
+        inline uint32_t getResyncs() const { return mResyncs; }
+        inline uint32_t getPlayed() const { return mPlayed; }
+        inline uint32_t getExtrapolations() const { return mExtrapolations; }   // Underruns extrapolated over
+        inline uint32_t getLastLatencyUs() const { return mLastLatencyUs; }
+        inline uint32_t getMaxLatencyUs() const { return mMaxLatencyUs; }
+        inline uint32_t getMeanLatencyUs() const { return mPlayed ? static_cast<uint32_t>(mTotalLatencyUs / mPlayed) : 0; }
+
+        // Consumer side too. The overflows are counted by push(), so they're
+        // zeroed by remembering where they stood rather than writing to them.
+        void resetCounters();
+
+    private:
+        struct Entry {
+            DofFrame frame;
+            uint32_t arrivalUs;
+        };
+
+        SpscQueue<Entry, JITTER_BUFFER_FRAMES> mEntries;
+        uint32_t mScanned;                  // Entries from the front taken into the clock mapping
+
+        uint32_t mDelayUs;
+        uint32_t mOffsetUs;                 // Our time minus sender time, for the quickest frame
+        bool mHaveOffset;
+        bool mUnderrun;
+        bool mPlaying;                      // The front entry has started playing
+
+        // Dead reckoning
+        uint32_t mExtrapolateUs;
+        int32_t mVelocity[DOF_COUNT];       // Hundredths of a degree per us, Q20
+        bool mHaveVelocity;
+        bool mDeadReckoned;                 // The last sample was held or extrapolated...
+        uint32_t mDeadReckonedTimestamp;    // ...from the frame with this timestamp
+        int16_t mLast[DOF_COUNT];           // The last sample's angles
+        int32_t mBlendOffset[DOF_COUNT];    // Faded out from mBlendStartUs
+        uint32_t mBlendStartUs;
+        bool mBlending;
+
+        uint32_t mMaxDepth;
+        uint32_t mOverflowsZero;            // Overflows at the last resetCounters()
+        uint32_t mUnderruns;
+        uint32_t mLate;
+        uint32_t mResyncs;
+        uint32_t mPlayed;
+        uint32_t mExtrapolations;
+        uint32_t mLastLatencyUs;
+        uint32_t mMaxLatencyUs;
+        uint64_t mTotalLatencyUs;
+
+        void updateOffset(uint32_t depth, uint32_t nowUs);
+        void updateVelocity(const DofFrame& previous, const DofFrame& next);
+        bool extrapolate(const DofFrame& newest, uint32_t elapsedUs, DofFrame& frame);
+        void blend(uint32_t nowUs, uint32_t basisTimestamp, DofFrame& frame);
+};
+
+
+#endif
@@ -0,0 +1,126 @@
+#include "JointArbiter.h"
+#include "Hand.h"
+
+
+static const uint32_t LEASE_MS[CONTROL_SOURCES] = {
+  ARBITER_STREAM_LEASE_MS,
+  ARBITER_GESTURE_LEASE_MS,
+  ARBITER_UART_LEASE_MS,
+  ARBITER_SERIAL_LEASE_MS
+};
+
+static uint8_t owners[NUM_JOINTS] = {
+  CONTROL_SOURCES, CONTROL_SOURCES, CONTROL_SOURCES, CONTROL_SOURCES, CONTROL_SOURCES, CONTROL_SOURCES
+};
+static uint32_t expiresMs[NUM_JOINTS] = {};
+
+static uint32_t denied[CONTROL_SOURCES] = {};
+static uint32_t takeovers = 0;
+
+static_assert(NUM_JOINTS == 6, "owners must start with every joint free");
+
+
+// The owner while its lease runs, wrapping with millis()
+static uint8_t currentOwner(uint8_t joint, uint32_t nowMs) {
+  uint8_t owner = owners[joint];
+  if (owner != CONTROL_SOURCES && static_cast<int32_t>(expiresMs[joint] - nowMs) <= 0) {
+    owners[joint] = CONTROL_SOURCES;
+    return CONTROL_SOURCES;
+  }
+  return owner;
+}
+
+// Sources are numbered in priority order, and one that already owns the
+// joint is renewing its lease
+static bool mayClaim(ControlSource source, uint8_t owner) {
+  return owner == CONTROL_SOURCES || source >= owner;
+}
+
+uint8_t getClaimableJoints(ControlSource source, uint8_t joints, uint32_t nowMs) {
+  uint8_t claimable = 0;
+  for (uint8_t joint = 0; joint < NUM_JOINTS; joint++) {
+    if ((joints & HAND_JOINT(joint)) && mayClaim(source, currentOwner(joint, nowMs))) {
+      claimable |= HAND_JOINT(joint);
+    }
+  }
+  return claimable;
+}
+
+uint8_t claimJoints(ControlSource source, uint8_t joints, uint32_t nowMs) {
+  uint8_t granted = 0;
+  for (uint8_t joint = 0; joint < NUM_JOINTS; joint++) {
+    if (!(joints & HAND_JOINT(joint))) {
+      continue;
+    }
+    uint8_t owner = currentOwner(joint, nowMs);
+    if (!mayClaim(source, owner)) {
+      continue;
+    }
+    if (owner != CONTROL_SOURCES && owner != source) {
+      takeovers++;
+    }
+    owners[joint] = source;
+    expiresMs[joint] = nowMs + LEASE_MS[source];
+    granted |= HAND_JOINT(joint);
+  }
+
+  if (granted != (joints & HAND_JOINTS_ALL)) {
+    denied[source]++;
+  }
+  return granted;
+}
+
+uint8_t getOwnedJoints(ControlSource source, uint8_t joints, uint32_t nowMs) {
+  uint8_t owned = 0;
+  for (uint8_t joint = 0; joint < NUM_JOINTS; joint++) {
+    if ((joints & HAND_JOINT(joint)) && currentOwner(joint, nowMs) == source) {
+      owned |= HAND_JOINT(joint);
+    }
+  }
+  return owned;
+}
+
+uint8_t claimJointsForGesture(ControlSource source, uint8_t joints, uint32_t nowMs) {
+  uint8_t handedOver = getOwnedJoints(source, joints, nowMs);
+  uint8_t refused = static_cast<uint8_t>(joints & ~handedOver & ~getClaimableJoints(CONTROL_SOURCE_GESTURE, joints, nowMs));
+  if (refused == 0) {
+    releaseJoints(source, handedOver);
+    claimJoints(CONTROL_SOURCE_GESTURE, joints, nowMs);
+  }
+  return refused;
+}
+
+void releaseJoints(ControlSource source, uint8_t joints) {
+  for (uint8_t joint = 0; joint < NUM_JOINTS; joint++) {
+    if ((joints & HAND_JOINT(joint)) && owners[joint] == source) {
+      owners[joint] = CONTROL_SOURCES;
+    }
+  }
+}
+
+void resetArbiter() {
+  for (uint8_t joint = 0; joint < NUM_JOINTS; joint++) {
+    owners[joint] = CONTROL_SOURCES;
+  }
+}
+
+ControlSource getJointOwner(uint8_t joint, uint32_t nowMs) {
+  return joint < NUM_JOINTS ? static_cast<ControlSource>(currentOwner(joint, nowMs)) : CONTROL_SOURCES;
+}
+
+uint32_t getJointLeaseMs(uint8_t joint, uint32_t nowMs) {
+  return getJointOwner(joint, nowMs) != CONTROL_SOURCES ? expiresMs[joint] - nowMs : 0;
+}
+
+const char* getControlSourceName(ControlSource source) {
+  static const char* const NAMES[] = { "stream", "gesture", "uart", "serial", "none" };
+  return NAMES[source <= CONTROL_SOURCES ? source : CONTROL_SOURCES];
+}
+
+uint32_t getArbiterDenied(ControlSource source) {
+  return source < CONTROL_SOURCES ? denied[source] : 0;
+}
+
+uint32_t getArbiterTakeovers() {
+  return takeovers;
+}
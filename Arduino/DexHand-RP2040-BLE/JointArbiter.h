@@ -0,0 +1,91 @@
+#ifndef JOINT_ARBITER_H
+#define JOINT_ARBITER_H
+
+/*
+Joint Arbiter
+
+Serial commands, commands over the UART characteristic, streamed DOF frames
+and gestures all set the same finger, thumb and wrist targets. Left alone,
+two of them running at once fight over the joints frame by frame. The
+arbiter gives each joint (see HAND_JOINT() in Hand.h) one owner at a time:
+
+  Priority   A source can take a joint from any source with a lower
+             priority, and never from one with a higher priority:
+
+               stream < gesture < UART < serial
+
+             so a gesture wins over the stream, a command from the central
+             over both, and someone at the serial port over everything.
+
+  Lease      Each claim holds the joint for the source's lease, and a
+             source renews it by claiming again. The stream and gestures
+             claim on every control tick they drive a joint, so theirs are
+             short and lapse soon after they stop. A command has nothing
+             to renew it, so it holds its joints for a few seconds, long
+             enough that the stream doesn't drag them straight back.
+
+  Ownership  Per joint, so a gesture can hold the wrist while the stream
+             drives the fingers around it.
+
+A source that is refused a joint doesn't write it. The control tick passes
+the stream only the joints it was granted, a gesture that loses any of its
+joints is stopped, and a command that can't have all of its joints is
+refused with a BUSY reply.
+
+A claim is a loop over the six joints with no division, so it is cheap to
+make on every control tick. The arbiter belongs to the core that owns the
+hand, where both the commands and the control tick run (see ControlCore.h).
+Times are millis() and wrap safely.
+*/
+
+#include <stdint.h>
+
+// Lowest priority first
+enum ControlSource {
+  CONTROL_SOURCE_STREAM,
+  CONTROL_SOURCE_GESTURE,
+  CONTROL_SOURCE_UART,
+  CONTROL_SOURCE_SERIAL,
+  CONTROL_SOURCES                 // Also the owner of a free joint
+};
+
+#define ARBITER_STREAM_LEASE_MS   250     // A few frames at the slowest stream rate
+#define ARBITER_GESTURE_LEASE_MS  100     // Renewed every tick while it plays
+#define ARBITER_UART_LEASE_MS     2000
+#define ARBITER_SERIAL_LEASE_MS   5000
+
+// Takes the joints in the mask that the source may have, and renews its
+// lease on them. Returns the joints it got.
+uint8_t claimJoints(ControlSource source, uint8_t joints, uint32_t nowMs);
+
+// The joints in the mask the source could claim, without claiming them
+uint8_t getClaimableJoints(ControlSource source, uint8_t joints, uint32_t nowMs);
+
+// The joints in the mask the source holds a lease on
+uint8_t getOwnedJoints(ControlSource source, uint8_t joints, uint32_t nowMs);
+
+// Hands the joints to a gesture that a command from the source is starting.
+// The gesture gets all of them, taking over the source's own leases, or
+// none. Returns the joints it was refused, 0 if it has them all.
+uint8_t claimJointsForGesture(ControlSource source, uint8_t joints, uint32_t nowMs);
+
+// Frees the joints in the mask that the source owns
+void releaseJoints(ControlSource source, uint8_t joints);
+
+// Frees every joint
+void resetArbiter();
+
+// The joint's owner, or CONTROL_SOURCES if it's free or its lease has run
+// out, and the time left on the lease
+ControlSource getJointOwner(uint8_t joint, uint32_t nowMs);
+uint32_t getJointLeaseMs(uint8_t joint, uint32_t nowMs);
+
+const char* getControlSourceName(ControlSource source);
+
+// Claims that were refused a joint, and joints taken from another source
+// while its lease was still running
+uint32_t getArbiterDenied(ControlSource source);
+uint32_t getArbiterTakeovers();
+
+
+#endif
@@ -0,0 +1,72 @@
+#include "Latency.h"
+#include "DofStream.h"
+
+
+static const char* const STAGE_NAMES[LATENCY_STAGES] = {
+  "validate",
+  "queue",
+  "apply",
+  "update",
+  "servowrite",
+  "endtoend"
+};
+
+const char* getLatencyStageName(uint8_t stage) {
+  return stage < LATENCY_STAGES ? STAGE_NAMES[stage] : "";
+}
+
+
+#if LATENCY_INSTRUMENTATION
+
+LatencyHistogram latencyHistograms[LATENCY_STAGES];
+
+static uint8_t* putUint16(uint8_t* data, uint16_t value) {
+  data[0] = static_cast<uint8_t>(value);
+  data[1] = static_cast<uint8_t>(value >> 8);
+  return data + 2;
+}
+
+static uint8_t* putUint32(uint8_t* data, uint32_t value) {
+  data = putUint16(data, static_cast<uint16_t>(value));
+  return putUint16(data, static_cast<uint16_t>(value >> 16));
+}
+
+void resetLatency() {
+  for (int stage = 0; stage < LATENCY_STAGES; stage++) {
+    latencyHistograms[stage].reset();
+  }
+}
+
+size_t encodeLatencyStats(uint8_t* data) {
+  uint8_t* position = data;
+  *position++ = LATENCY_STATS_VERSION;
+  *position++ = LATENCY_STAGES;
+  position = putUint16(position, LATENCY_TICKS_PER_US);
+  position = putUint32(position, getDofPacketsReceived());
+  position = putUint32(position, getDofPacketsBadLength());
+  position = putUint32(position, getDofPacketsBadChecksum());
+  position = putUint32(position, getDofFramesCoalesced());
+
+  for (int stage = 0; stage < LATENCY_STAGES; stage++) {
+    const LatencyHistogram& histogram = latencyHistograms[stage];
+    position = putUint32(position, histogram.getCount());
+    position = putUint32(position, histogram.getMax());
+    for (uint8_t bucket = 0; bucket < LATENCY_BUCKETS; bucket++) {
+      uint32_t count = histogram.getBucket(bucket);
+      position = putUint16(position, count > UINT16_MAX ? UINT16_MAX : static_cast<uint16_t>(count));
+    }
+  }
+  return position - data;
+}
+
+#else
+
+void resetLatency() {
+}
+
+size_t encodeLatencyStats(uint8_t* data) {
+  (void)data;
+  return 0;
+}
+
+#endif
@@ -0,0 +1,129 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+/*
+Latency Instrumentation
+
+Timestamps each stage a streamed frame goes through, from the DOF
+characteristic's write handler to the pulse widths reaching the PIO, and
+keeps a histogram of each stage's duration (see LatencyHistogram.h):
+
+  validate     receiveDofPacket() entry until the frame is published
+  queue        Published until the control tick first applies it, which
+               includes the jitter buffer's playout delay
+  apply        Joint setters, applyDofFrame()
+  update       Joint kinematics and servo frame, updateHandJoints()/tickHand()
+  servo write  Staged pulse widths pushed to the PIO, commitFrame()
+  end to end   receiveDofPacket() entry until the control tick that first
+               applied the frame has written the servos
+
+Durations are in ticks of the fastest clock available. The Cortex-M0+ has
+no DWT cycle counter, so on the arduino-pico core this is the core's SysTick
+based cycle count. The mbed core keeps SysTick for the RTOS, so there it is
+the RP2040's 1 MHz hardware timer, read directly rather than through
+micros(). The host build uses the real time in nanoseconds, so the
+benchmarks can use the same histograms.
+
+Set LATENCY_INSTRUMENTATION to 0 to compile all of it out - the macros below
+expand to nothing and no histograms are kept. The clock stays, for the loop
+profiler.
+
+The stats can also be read over BLE, little endian throughout:
+
+  0      LATENCY_STATS_VERSION
+  1      Number of stages
+  2-3    Ticks per microsecond
+  4-7    DOF packets received
+  8-11   Packets with a bad length
+  12-15  Packets with a bad checksum
+  16-19  Frames coalesced in the mailbox
+  Then for each stage, in the order above:
+  0-3    Count
+  4-7    Largest duration in ticks
+  8-     LATENCY_BUCKETS bucket counts, uint16, saturating
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "LatencyHistogram.h"
+
+#ifndef LATENCY_INSTRUMENTATION
+#define LATENCY_INSTRUMENTATION   1
+#endif
+
+#define LATENCY_STATS_VERSION     1
+
+enum LatencyStage {
+  LATENCY_VALIDATE,
+  LATENCY_QUEUE,
+  LATENCY_APPLY,
+  LATENCY_UPDATE,
+  LATENCY_SERVO_WRITE,
+  LATENCY_END_TO_END,
+  LATENCY_STAGES
+};
+
+#define LATENCY_STATS_LENGTH      (20 + LATENCY_STAGES * (8 + 2 * LATENCY_BUCKETS))
+
+
+// The clock, also used by the loop profiler (see Profiler.h)
+#if defined(DEXHAND_HOST_BUILD)
+  #include <chrono>
+
+  #define LATENCY_TICKS_PER_US    1000
+
+  inline uint32_t latencyTicks() {
+    return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count());
+  }
+#elif defined(ARDUINO_ARCH_MBED)
+  #include "hardware/timer.h"
+
+  #define LATENCY_TICKS_PER_US    1
+
+  inline uint32_t latencyTicks() {
+    return timer_hw->timerawl;
+  }
+#else
+  #include <Arduino.h>
+
+  #define LATENCY_TICKS_PER_US    (F_CPU / 1000000)
+
+  inline uint32_t latencyTicks() {
+    return rp2040.getCycleCount();
+  }
+#endif
+
+
+#if LATENCY_INSTRUMENTATION
+
+extern LatencyHistogram latencyHistograms[LATENCY_STAGES];
+
+inline void recordLatency(uint8_t stage, uint32_t startTicks) {
+  latencyHistograms[stage].record(latencyTicks() - startTicks);
+}
+
+#define LATENCY_START(name)             const uint32_t name = latencyTicks()
+#define LATENCY_RECORD(stage, start)    recordLatency(stage, start)
+
+#else
+
+#define LATENCY_START(name)
+#define LATENCY_RECORD(stage, start)
+
+#endif
+
+
+// Short name of a stage, for the stats command
+const char* getLatencyStageName(uint8_t stage);
+
+// Clears every stage's histogram
+void resetLatency();
+
+// Writes the stats in the format above, LATENCY_STATS_LENGTH bytes. Returns
+// the length, or 0 if the instrumentation is compiled out.
+size_t encodeLatencyStats(uint8_t* data);
+
+
+#endif
@@ -0,0 +1,47 @@
+#include "LatencyHistogram.h"
+
+
+void LatencyHistogram::record(uint32_t value) {
+    mBuckets[bucketOf(value)]++;
+    mCount++;
+    mTotal += value;
+
+    if (value < mMin) {
+        mMin = value;
+    }
+    if (value > mMax) {
+        mMax = value;
+    }
+}
+
+void LatencyHistogram::reset() {
+    for (int bucket = 0; bucket < LATENCY_BUCKETS; bucket++) {
+        mBuckets[bucket] = 0;
+    }
+    mCount = 0;
+    mMin = UINT32_MAX;
+    mMax = 0;
+    mTotal = 0;
+}
+
+uint32_t LatencyHistogram::getPercentile(uint8_t percent) const {
+    if (mCount == 0) {
+        return 0;
+    }
+
+    // Number of values at or below the percentile, rounded up
+    uint32_t rank = static_cast<uint32_t>((static_cast<uint64_t>(mCount) * (percent > 100 ? 100 : percent) + 99) / 100);
+    if (rank == 0) {
+        rank = 1;
+    }
+
+    uint32_t seen = 0;
+    for (uint8_t bucket = 0; bucket < LATENCY_BUCKETS; bucket++) {
+        seen += mBuckets[bucket];
+        if (seen >= rank) {
+            uint32_t top = bucketMax(bucket);
+            return top < mMax ? top : mMax;
+        }
+    }
+    return mMax;
+}
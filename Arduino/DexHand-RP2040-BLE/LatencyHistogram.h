@@ -0,0 +1,61 @@
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+/*
+Latency Histogram Definition
+
+A fixed size histogram of durations with power of two buckets. Bucket 0
+holds zero, and bucket b holds values from 2^(b-1) to 2^b - 1, so each
+bucket is twice as wide as the one before and 32 of them cover everything
+from a few cycles to the full 32-bit range. Recording a value is a count
+of leading zeros and an increment, cheap enough to leave in the streaming
+path. Percentiles come out as the top of the bucket they fall in, which is
+within a factor of two - plenty to see where the time goes.
+
+The values are in whatever ticks the caller measures in, see Latency.h.
+*/
+
+#include <stdint.h>
+
+#define LATENCY_BUCKETS       32
+
+class LatencyHistogram {
+
+    public:
+        constexpr LatencyHistogram()
+        : mBuckets{}, mCount(0), mMin(UINT32_MAX), mMax(0), mTotal(0) {
+        }
+
+        void record(uint32_t value);
+        void reset();
+
+        inline uint32_t getCount() const { return mCount; }
+        inline uint32_t getMin() const { return mCount ? mMin : 0; }
+        inline uint32_t getMax() const { return mMax; }
+        inline uint32_t getMean() const { return mCount ? static_cast<uint32_t>(mTotal / mCount) : 0; }
+        inline uint32_t getBucket(uint8_t bucket) const { return bucket < LATENCY_BUCKETS ? mBuckets[bucket] : 0; }
+
+        // Top of the bucket the given percentile of the values fall in, but no
+        // more than the largest value seen. 0 if nothing has been recorded.
+        uint32_t getPercentile(uint8_t percent) const;
+
+        static inline uint8_t bucketOf(uint32_t value) {
+            uint8_t bits = value ? static_cast<uint8_t>(32 - __builtin_clz(value)) : 0;
+            return bits < LATENCY_BUCKETS ? bits : LATENCY_BUCKETS - 1;
+        }
+
+        // Largest value that lands in the bucket
+        static inline uint32_t bucketMax(uint8_t bucket) {
+            return bucket >= LATENCY_BUCKETS - 1 ? UINT32_MAX : (1ul << bucket) - 1;
+        }
+
+    private:
+        uint32_t mBuckets[LATENCY_BUCKETS];
+        uint32_t mCount;
+        uint32_t mMin;
+        uint32_t mMax;
+        uint64_t mTotal;
+};
+
+
+#endif
@@ -0,0 +1,314 @@
+#include "Log.h"
+
+#include <Arduino.h>
+#include <string.h>
+
+
+uint8_t logLevels[LOG_MODULES] = {
+  LOG_LEVEL_WARN,     // system
+  LOG_LEVEL_INFO,     // command
+  LOG_LEVEL_WARN,     // stream
+  LOG_LEVEL_WARN,     // finger
+  LOG_LEVEL_WARN,     // thumb
+  LOG_LEVEL_WARN      // mixer
+};
+
+static const char* const MODULE_NAMES[LOG_MODULES] = {
+  "system",
+  "command",
+  "stream",
+  "finger",
+  "thumb",
+  "mixer"
+};
+
+static LogOutput logOutput = LOG_OUTPUT_TEXT;
+
+#if DUAL_CORE_CONTROL
+#define LOG_RINGS   2
+#else
+#define LOG_RINGS   1
+#endif
+
+// One per core, see Log.h
+static SpscQueue<LogRecord, LOG_RING_RECORDS> logRings[LOG_RINGS];
+
+// Drops the drain has already reported, per ring
+static uint32_t droppedReported[LOG_RINGS];
+
+static inline SpscQueue<LogRecord, LOG_RING_RECORDS>& producerRing() {
+#if DUAL_CORE_CONTROL
+  return logRings[rp2040.cpuid()];
+#else
+  return logRings[0];
+#endif
+}
+
+// The number of integer arguments a format takes, and whether it has a %s
+static int countFormatArgs(const char* format, bool& hasText) {
+  int count = 0;
+  hasText = false;
+  for (const char* c = format; *c; c++) {
+    if (*c != '%') {
+      continue;
+    }
+    c++;
+    if (*c == 's') {
+      hasText = true;
+    }
+    else if (*c == 'd' || *c == 'u' || *c == 'x') {
+      count++;
+    }
+    else if (*c == '\0') {
+      break;
+    }
+  }
+  return count;
+}
+
+
+// ----- Producer Side -----
+
+void logRecord(LogMessageId id, int32_t a, int32_t b, int32_t c, int32_t d) {
+  logTextRecord(id, nullptr, a, b, c, d);
+}
+
+void logTextRecord(LogMessageId id, const char* text, int32_t a, int32_t b, int32_t c, int32_t d) {
+  LogRecord record;
+  record.timeUs = micros();
+  record.id = static_cast<uint8_t>(id);
+  record.text[0] = '\0';
+  if (text != nullptr) {
+    strncpy(record.text, text, LOG_TEXT_LENGTH);
+    record.text[LOG_TEXT_LENGTH] = '\0';
+  }
+  record.args[0] = a;
+  record.args[1] = b;
+  record.args[2] = c;
+  record.args[3] = d;
+
+  // Dropped and counted if the ring is full
+  producerRing().push(record);
+}
+
+
+// ----- Formatting -----
+
+size_t formatLogRecord(const LogRecord& record, char* line, size_t size) {
+  if (size == 0) {
+    return 0;
+  }
+
+  const LogMessageInfo& message = LOG_MESSAGES[record.id < LOG_MESSAGE_COUNT ? record.id : static_cast<uint8_t>(LOG_DROPPED)];
+  int length = snprintf(line, size, "LOG:%lu %c %s: ", static_cast<unsigned long>(record.timeUs),
+    getLogLevelLetter(message.level), getLogModuleName(message.module));
+  size_t used = length > 0 ? static_cast<size_t>(length) : 0;
+
+  // A small printf of its own, as the arguments are only known at runtime
+  int arg = 0;
+  for (const char* c = message.format; *c && used + 1 < size; c++) {
+    if (*c != '%' || c[1] == '\0') {
+      line[used++] = *c;
+      continue;
+    }
+    c++;
+    char* out = line + used;
+    size_t room = size - used;
+    switch (*c) {
+      case 'd':
+        length = snprintf(out, room, "%ld", static_cast<long>(record.args[arg++ % LOG_MAX_ARGS]));
+        break;
+      case 'u':
+        length = snprintf(out, room, "%lu", static_cast<unsigned long>(static_cast<uint32_t>(record.args[arg++ % LOG_MAX_ARGS])));
+        break;
+      case 'x':
+        length = snprintf(out, room, "%lx", static_cast<unsigned long>(static_cast<uint32_t>(record.args[arg++ % LOG_MAX_ARGS])));
+        break;
+      case 's':
+        length = snprintf(out, room, "%s", record.text);
+        break;
+      default:
+        length = snprintf(out, room, "%c", *c);
+        break;
+    }
+    used += length > 0 ? static_cast<size_t>(length) : 0;
+    if (used >= size) {
+      used = size - 1;
+    }
+  }
+  if (used >= size) {
+    used = size - 1;
+  }
+  line[used] = '\0';
+  return used;
+}
+
+size_t encodeLogRecord(const LogRecord& record, uint8_t* frame) {
+  bool hasText;
+  int args = countFormatArgs(LOG_MESSAGES[record.id].format, hasText);
+  if (args > LOG_MAX_ARGS) {
+    args = LOG_MAX_ARGS;
+  }
+
+  size_t length = 0;
+  frame[length++] = LOG_FRAME_SYNC;
+  length++;     // Filled in below
+  frame[length++] = record.id;
+  for (int i = 0; i < 4; i++) {
+    frame[length++] = static_cast<uint8_t>(record.timeUs >> (8 * i));
+  }
+  for (int arg = 0; arg < args; arg++) {
+    uint32_t value = static_cast<uint32_t>(record.args[arg]);
+    for (int i = 0; i < 4; i++) {
+      frame[length++] = static_cast<uint8_t>(value >> (8 * i));
+    }
+  }
+  if (hasText) {
+    size_t textLength = strlen(record.text);
+    memcpy(frame + length, record.text, textLength);
+    length += textLength;
+  }
+  frame[1] = static_cast<uint8_t>(length - 2);
+  return length;
+}
+
+
+// ----- Consumer Side -----
+
+static void printLogRecord(const LogRecord& record) {
+  if (logOutput == LOG_OUTPUT_BINARY) {
+    uint8_t frame[LOG_MAX_FRAME_LENGTH];
+    Serial.write(frame, encodeLogRecord(record, frame));
+  }
+  else {
+    char line[LOG_MAX_LINE_LENGTH + 1];
+    formatLogRecord(record, line, sizeof(line));
+    Serial.println(line);
+  }
+}
+
+int drainLog(int maxRecords) {
+  int printed = 0;
+  while (printed < maxRecords) {
+    // Oldest first across the rings. Times are compared as a difference, so
+    // they can wrap.
+    int ring = -1;
+    for (int i = 0; i < LOG_RINGS; i++) {
+      if (!logRings[i].isEmpty() && (ring < 0 ||
+          static_cast<int32_t>(logRings[i].peek(0).timeUs - logRings[ring].peek(0).timeUs) < 0)) {
+        ring = i;
+      }
+    }
+
+    // Once a ring has room again, say how much it lost while it was full
+    if (ring < 0) {
+      for (int i = 0; i < LOG_RINGS && printed < maxRecords; i++) {
+        uint32_t dropped = logRings[i].getDropped();
+        if (dropped != droppedReported[i] && isLogEnabled(LOG_DROPPED)) {
+          LogRecord record = {};
+          record.timeUs = micros();
+          record.id = LOG_DROPPED;
+          record.args[0] = static_cast<int32_t>(dropped - droppedReported[i]);
+          printLogRecord(record);
+          printed++;
+        }
+        droppedReported[i] = dropped;
+      }
+      break;
+    }
+
+    printLogRecord(logRings[ring].peek(0));
+    logRings[ring].discard(1);
+    printed++;
+  }
+  return printed;
+}
+
+
+// ----- Settings and Counters -----
+
+void setLogLevel(int module, uint8_t level) {
+  if (level > LOG_LEVEL_DEBUG) {
+    level = LOG_LEVEL_DEBUG;
+  }
+  for (int i = 0; i < LOG_MODULES; i++) {
+    if (module == i || module == LOG_MODULES) {
+      logLevels[i] = level;
+    }
+  }
+}
+
+int findLogModule(const char* name) {
+  for (int i = 0; i < LOG_MODULES; i++) {
+    if (strcmp(MODULE_NAMES[i], name) == 0) {
+      return i;
+    }
+  }
+  return LOG_MODULES;
+}
+
+const char* getLogModuleName(int module) {
+  return module >= 0 && module < LOG_MODULES ? MODULE_NAMES[module] : "?";
+}
+
+char getLogLevelLetter(uint8_t level) {
+  static const char LETTERS[] = "-EWID";
+  return level <= LOG_LEVEL_DEBUG ? LETTERS[level] : '?';
+}
+
+void setLogOutput(LogOutput output) {
+  logOutput = output;
+}
+
+LogOutput getLogOutput() {
+  return logOutput;
+}
+
+uint32_t getLogDepth() {
+  uint32_t depth = 0;
+  for (const auto& ring : logRings) {
+    depth += ring.getDepth();
+  }
+  return depth;
+}
+
+uint32_t getLogRecordsLogged() {
+  uint32_t logged = 0;
+  for (const auto& ring : logRings) {
+    logged += ring.getPushed();
+  }
+  return logged;
+}
+
+uint32_t getLogRecordsDropped() {
+  uint32_t dropped = 0;
+  for (const auto& ring : logRings) {
+    dropped += ring.getDropped();
+  }
+  return dropped;
+}
+
+uint32_t getLogMaxDepth() {
+  uint32_t maxDepth = 0;
+  for (const auto& ring : logRings) {
+    if (ring.getMaxDepth() > maxDepth) {
+      maxDepth = ring.getMaxDepth();
+    }
+  }
+  return maxDepth;
+}
+
+void resetLogCounters() {
+  for (int i = 0; i < LOG_RINGS; i++) {
+    logRings[i].resetCounters();
+    droppedReported[i] = 0;
+  }
+}
+
+void resetLog() {
+  for (int i = 0; i < LOG_RINGS; i++) {
+    logRings[i].reset();
+    logRings[i].resetCounters();
+    droppedReported[i] = 0;
+  }
+}
@@ -0,0 +1,150 @@
+#ifndef LOG_H
+#define LOG_H
+
+/*
+Log Definition
+
+Debug output from the control path used to go straight to Serial, which
+blocks until the text has gone - at 9600 baud a 40 character line held the
+control tick up for around 40ms. LOG(name, args...) instead puts a fixed
+size record in a ring: the message's id from LogMessages.h, the time, and
+the raw arguments. Nothing is formatted, and if the ring is full the record
+is dropped and counted, so logging never waits. drainLog() runs from a task
+of its own (see Scheduler.h) and prints a few records at a time.
+
+Each message belongs to a module and has a level. A module's level can be
+changed at runtime, and messages above it are skipped before their
+arguments are even worked out. Messages above LOG_MAX_LEVEL are compiled
+out altogether.
+
+The log prints as text by default:
+
+  LOG:<time us> <level> <module>: <message>
+
+or in binary, which is shorter and is turned back into text on the host by
+Python/log_decoder.py. Each record is a frame, which can't be confused with
+the text around it because text is ASCII:
+
+  0      LOG_FRAME_SYNC
+  1      Number of bytes that follow
+  2      Message id, the position in LogMessages.h
+  3-6    Time in us, uint32 little endian
+  7-     The integer arguments the format takes, int32 little endian, then
+         the text for its %s if it has one, unterminated
+
+With DUAL_CORE_CONTROL each core logs into a ring of its own, as the rings
+only take one producer, and drainLog() merges them by time.
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ControlCore.h"
+#include "SpscQueue.h"
+
+#define LOG_LEVEL_OFF         0
+#define LOG_LEVEL_ERROR       1
+#define LOG_LEVEL_WARN        2
+#define LOG_LEVEL_INFO        3
+#define LOG_LEVEL_DEBUG       4
+
+#ifndef LOG_MAX_LEVEL
+#define LOG_MAX_LEVEL         LOG_LEVEL_DEBUG
+#endif
+
+#define LOG_RING_RECORDS      64      // Power of two
+#define LOG_MAX_ARGS          4
+#define LOG_TEXT_LENGTH       11
+#define LOG_FRAME_SYNC        0xFE
+#define LOG_MAX_FRAME_LENGTH  (7 + 4 * LOG_MAX_ARGS + LOG_TEXT_LENGTH)
+#define LOG_MAX_LINE_LENGTH   120
+
+enum LogModule {
+  LOG_MODULE_SYSTEM,
+  LOG_MODULE_COMMAND,
+  LOG_MODULE_STREAM,
+  LOG_MODULE_FINGER,
+  LOG_MODULE_THUMB,
+  LOG_MODULE_MIXER,
+  LOG_MODULES
+};
+
+enum LogMessageId {
+#define LOG_MESSAGE(name, module, level, format)  LOG_##name,
+#include "LogMessages.h"
+#undef LOG_MESSAGE
+  LOG_MESSAGE_COUNT
+};
+
+struct LogMessageInfo {
+  uint8_t module;
+  uint8_t level;
+  const char* format;
+};
+
+static constexpr LogMessageInfo LOG_MESSAGES[] = {
+#define LOG_MESSAGE(name, module, level, format)  { module, level, format },
+#include "LogMessages.h"
+#undef LOG_MESSAGE
+};
+
+static_assert(LOG_MESSAGE_COUNT <= 256, "Log message ids are one byte");
+
+struct LogRecord {
+  uint32_t timeUs;
+  uint8_t id;
+  char text[LOG_TEXT_LENGTH + 1];     // Terminated
+  int32_t args[LOG_MAX_ARGS];
+};
+
+enum LogOutput {
+  LOG_OUTPUT_TEXT,
+  LOG_OUTPUT_BINARY
+};
+
+// Current level of each module
+extern uint8_t logLevels[LOG_MODULES];
+
+inline bool isLogEnabled(LogMessageId id) {
+  return LOG_MESSAGES[id].level <= LOG_MAX_LEVEL && LOG_MESSAGES[id].level <= logLevels[LOG_MESSAGES[id].module];
+}
+
+// Producer side, through the macros below
+void logRecord(LogMessageId id, int32_t a = 0, int32_t b = 0, int32_t c = 0, int32_t d = 0);
+void logTextRecord(LogMessageId id, const char* text, int32_t a = 0, int32_t b = 0, int32_t c = 0, int32_t d = 0);
+
+#define LOG(name, ...)          do { if (isLogEnabled(LOG_##name)) { logRecord(LOG_##name, ##__VA_ARGS__); } } while (0)
+#define LOG_TEXT(name, ...)     do { if (isLogEnabled(LOG_##name)) { logTextRecord(LOG_##name, __VA_ARGS__); } } while (0)
+
+// Sets a module's level, or every module's for LOG_MODULES
+void setLogLevel(int module, uint8_t level);
+
+// Module by name, LOG_MODULES if there isn't one
+int findLogModule(const char* name);
+const char* getLogModuleName(int module);
+char getLogLevelLetter(uint8_t level);
+
+void setLogOutput(LogOutput output);
+LogOutput getLogOutput();
+
+// Consumer side. Prints up to maxRecords records, oldest first, and returns
+// how many it printed.
+int drainLog(int maxRecords);
+
+// Writes a record as a terminated line of text, or as a binary frame of up
+// to LOG_MAX_FRAME_LENGTH bytes. Returns the length.
+size_t formatLogRecord(const LogRecord& record, char* line, size_t size);
+size_t encodeLogRecord(const LogRecord& record, uint8_t* frame);
+
+// Records waiting, logged and dropped, over all the rings
+uint32_t getLogDepth();
+uint32_t getLogRecordsLogged();
+uint32_t getLogRecordsDropped();
+uint32_t getLogMaxDepth();
+void resetLogCounters();
+
+// Empties the rings, for tests. Nothing may be logging.
+void resetLog();
+
+
+#endif
@@ -0,0 +1,36 @@
+/*
+Log Messages
+
+Every message the firmware can log, as
+
+  LOG_MESSAGE(name, module, level, format)
+
+The log keeps only a message's position in this list and its arguments, so
+the format strings never leave flash until a record is printed. Logging a
+message is LOG(name, args...) (see Log.h).
+
+Formats take up to LOG_MAX_ARGS integer arguments, %d, %u or %x, and at most
+one %s, whose text comes from LOG_TEXT() and is cut to LOG_TEXT_LENGTH
+characters. Python/log_decoder.py reads this file to decode binary logs, so
+only add to the end, keep each entry on one line, and keep the modules and
+levels to the names in Log.h.
+
+No include guard - each user defines LOG_MESSAGE first.
+*/
+
+LOG_MESSAGE(DROPPED, LOG_MODULE_SYSTEM, LOG_LEVEL_WARN, "%u messages dropped, the log was full")
+LOG_MESSAGE(CONTROL_QUEUE_FULL, LOG_MODULE_SYSTEM, LOG_LEVEL_WARN, "Control queue full, command dropped")
+LOG_MESSAGE(COMMAND, LOG_MODULE_COMMAND, LOG_LEVEL_INFO, "CMD:%s:%d:%d")
+LOG_MESSAGE(DOF_BAD_LENGTH, LOG_MODULE_STREAM, LOG_LEVEL_WARN, "Invalid DOF length: %d")
+LOG_MESSAGE(DOF_BAD_CHECKSUM, LOG_MODULE_STREAM, LOG_LEVEL_WARN, "Invalid DOF checksum")
+LOG_MESSAGE(DOF_BAD_VERSION, LOG_MODULE_STREAM, LOG_LEVEL_WARN, "Unsupported DOF protocol version")
+// The finger and thumb messages came from the per-joint mixes the mixer
+// replaced. Nothing logs them now, but they keep their place so the ids
+// after them don't change.
+LOG_MESSAGE(FINGER_FLEXION, LOG_MODULE_FINGER, LOG_LEVEL_DEBUG, "FlexTgt: %d FlexRange: %d - %d FlexPos: %d")
+LOG_MESSAGE(FINGER_FLEXION_SERVO, LOG_MODULE_FINGER, LOG_LEVEL_DEBUG, "ServoRange: %d - %d")
+LOG_MESSAGE(FINGER_YAW_MIX, LOG_MODULE_FINGER, LOG_LEVEL_DEBUG, "NFlex: %d YawTgt: %d NYaw: %d SYaw: %d")
+LOG_MESSAGE(FINGER_FLEXION_GAIN, LOG_MODULE_FINGER, LOG_LEVEL_DEBUG, "FlexionGain: %d")
+LOG_MESSAGE(THUMB_YAW_OVER, LOG_MODULE_THUMB, LOG_LEVEL_DEBUG, "Yaw over: %d Adj rt pitch: %d")
+LOG_MESSAGE(MIX_SERVO, LOG_MODULE_MIXER, LOG_LEVEL_DEBUG, "Servo: %d Input: %d Mix: %d Pos: %d")
+LOG_MESSAGE(COMMAND_BUSY, LOG_MODULE_COMMAND, LOG_LEVEL_WARN, "CMD:%s refused, joints %x held by source %u")
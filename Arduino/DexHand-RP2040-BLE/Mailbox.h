@@ -0,0 +1,89 @@
+#ifndef MAILBOX_H
+#define MAILBOX_H
+
+/*
+Mailbox Definition
+
+A latest-value mailbox between one producer and one consumer. The producer
+publish()es values and never waits. The consumer take()s the newest value
+published since its last take, and anything published in between is simply
+overwritten - which is what we want for pose frames, where only the most
+recent one matters.
+
+The mailbox is a seqlock over two slots. The sequence number is odd while
+a publish is writing, and even once it's done, so sequence / 2 values have
+been published and the newest is in slot (sequence / 2) & 1. A publish
+always writes the other slot, so the consumer has one complete value to
+copy even while a write is in progress. The copy is only torn if the
+producer finished that publish and started the one after it, back in the
+slot being copied, before the copy was done. The consumer checks the
+sequence again afterwards and copies again if it got that far. Only 32-bit
+loads and stores are used on the sequence, so this works on the Cortex-M0+
+which has no atomic read-modify-write instructions.
+*/
+
+#include <stdint.h>
+
+#include <atomic>
+
+template <typename T>
+class Mailbox {
+
+    public:
+        constexpr Mailbox()
+        : mSlots{}, mSequence(0), mTakenCount(0), mTaken(0), mCoalesced(0) {
+        }
+
+        // Producer side
+        void publish(const T& value) {
+            uint32_t sequence = mSequence.load(std::memory_order_relaxed);
+            mSequence.store(sequence + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            mSlots[((sequence >> 1) + 1) & 1] = value;
+            mSequence.store(sequence + 2, std::memory_order_release);
+        }
+
+        // Consumer side. Returns false if nothing new has been published.
+        bool take(T& value) {
+            uint32_t published;
+            for (;;) {
+                uint32_t before = mSequence.load(std::memory_order_acquire);
+                published = before >> 1;
+                if (published == mTakenCount) {
+                    return false;
+                }
+                value = mSlots[published & 1];
+
+                // The publish after next writes this slot again, and it
+                // starts by making the sequence odd past published * 2 + 2
+                std::atomic_thread_fence(std::memory_order_acquire);
+                uint32_t after = mSequence.load(std::memory_order_relaxed);
+                if (after - (published << 1) <= 2) {
+                    break;
+                }
+            }
+
+            mCoalesced += published - mTakenCount - 1;
+            mTaken++;
+            mTakenCount = published;
+            return true;
+        }
+
+        inline bool hasNew() const { return (mSequence.load(std::memory_order_acquire) >> 1) != mTakenCount; }
+
+        // Counters. The consumer's counters should only be read from the consumer side.
+        inline uint32_t getPublished() const { return mSequence.load(std::memory_order_relaxed) >> 1; }
+        inline uint32_t getTaken() const { return mTaken; }
+        inline uint32_t getCoalesced() const { return mCoalesced; }     // Published but overwritten before a take
+        inline void resetCounters() { mTaken = 0; mCoalesced = 0; }
+
+    private:
+        T mSlots[2];
+        std::atomic<uint32_t> mSequence;    // Twice the values published, plus one while publishing
+        uint32_t mTakenCount;               // Values published as of the last take
+        uint32_t mTaken;
+        uint32_t mCoalesced;
+};
+
+
+#endif
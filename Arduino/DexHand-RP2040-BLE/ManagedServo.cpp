@@ -1,5 +1,6 @@
 #include "RP2040_ISR_Servo/RP2040_ISR_Servo.h"
 #include "ManagedServo.h"
+#include "Latency.h"
 
 // Published values for ES3352 servos; adjust if you are using different servos
 #define MIN_MICROS        700
@@ -7,15 +8,6 @@
 #define DEFAULT_MICROS    MIN_MICROS+((MAX_MICROS-MIN_MICROS)/2)
 
 
-ManagedServo::ManagedServo(uint8_t servoPin, uint8_t minPosition, uint8_t maxPosition, uint8_t defaultPosition, bool invertAngles)
-: mServoPin(servoPin), mMinPosition(minPosition), mMaxPosition(maxPosition), 
-    mDefaultPosition(defaultPosition), mCurrentPosition(defaultPosition), 
-    mInvertAngles(invertAngles), mISRServoIndex(-1) {
-}
-
-ManagedServo::~ManagedServo() {
-}
-
 void ManagedServo::setupServo()
 {
     mISRServoIndex = RP2040_ISR_Servos.setupServo(mServoPin, MIN_MICROS, MAX_MICROS);
@@ -58,4 +50,50 @@ void ManagedServo::moveToMaxPosition() {
 
 void ManagedServo::moveToMinPosition() {
     setServoPosition(mMinPosition);
-}
\ No newline at end of file
+}
+
+uint32_t ManagedServo::getWritesIssued() {
+    return RP2040_ISR_Servos.getWritesIssued();
+}
+
+uint32_t ManagedServo::getWritesSkipped() {
+    return RP2040_ISR_Servos.getWritesSkipped();
+}
+
+void ManagedServo::resetWriteCounters() {
+    RP2040_ISR_Servos.resetWriteCounters();
+}
+
+void ManagedServo::beginFrame() {
+    RP2040_ISR_Servos.beginFrame();
+}
+
+void ManagedServo::commitFrame() {
+#if LATENCY_INSTRUMENTATION
+    // Only frames that had something to write are timed
+    uint32_t start = latencyTicks();
+    uint32_t frames = RP2040_ISR_Servos.getFramesCommitted();
+    RP2040_ISR_Servos.commitFrame();
+    if (RP2040_ISR_Servos.getFramesCommitted() != frames) {
+        recordLatency(LATENCY_SERVO_WRITE, start);
+    }
+#else
+    RP2040_ISR_Servos.commitFrame();
+#endif
+}
+
+uint32_t ManagedServo::getFramesCommitted() {
+    return RP2040_ISR_Servos.getFramesCommitted();
+}
+
+uint32_t ManagedServo::getFramesDeferred() {
+    return RP2040_ISR_Servos.getFramesDeferred();
+}
+
+uint16_t ManagedServo::getLastFrameSpreadUs() {
+    return RP2040_ISR_Servos.getLastFrameSpreadUs();
+}
+
+uint16_t ManagedServo::getMaxFrameSpreadUs() {
+    return RP2040_ISR_Servos.getMaxFrameSpreadUs();
+}
@@ -18,23 +18,36 @@
 #error This code is intended to run on the mbed / non-mbed RP2040 platform! Please check your Tools->Board setting.
 #endif
 
+#ifndef ISR_SERVO_DEBUG
 #define ISR_SERVO_DEBUG 0
+#endif
 
 #include "RP2040_ISR_Servo/RP2040_ISR_Servo.hpp"
 
+#include "HandConfig.h"
+
 
 
 // The ManagedServo class is a wrapper around the Servo class that
 // provides range checking and absolute limits on the servo position
 // so that the model can't be asked to attain any position that would
 // damage the model.
+//
+// The constructors are constexpr so that the servo table is initialized at
+// compile time rather than by code running at startup.
 
 class ManagedServo {
     
     public:
         // Constructor
-        ManagedServo(uint8_t servoPin, uint8_t minPosition, uint8_t maxPosition, uint8_t defaultPosition, bool invertAngles);
-        virtual ~ManagedServo();
+        constexpr ManagedServo(uint8_t servoPin, uint8_t minPosition, uint8_t maxPosition, uint8_t defaultPosition, bool invertAngles)
+        : mServoPin(servoPin), mMinPosition(minPosition), mMaxPosition(maxPosition),
+            mDefaultPosition(defaultPosition), mCurrentPosition(defaultPosition),
+            mInvertAngles(invertAngles), mISRServoIndex(-1) {
+        }
+        constexpr ManagedServo(const ServoConfig& config)
+        : ManagedServo(config.pin, config.minPosition, config.maxPosition, config.defaultPosition, config.invertAngles) {
+        }
 
         // Accessors
         inline uint8_t getServoPin() const { return mServoPin; }
@@ -43,7 +56,8 @@ class ManagedServo {
         inline void setMinPosition(uint8_t minPosition) { if(minPosition > 0 && minPosition < 180) mMinPosition = minPosition; }
         inline void setMaxPosition(uint8_t maxPosition) { if(maxPosition > 0 && maxPosition < 180) mMaxPosition = maxPosition; }
 
-        inline uint8_t getDefaultPosition() { return mDefaultPosition; }
+        inline uint8_t getDefaultPosition() const { return mDefaultPosition; }
+        inline void setDefaultPosition(uint8_t defaultPosition) { if(defaultPosition <= 180) mDefaultPosition = defaultPosition; }
 
         // Initialization
         void setupServo();
@@ -54,6 +68,25 @@ class ManagedServo {
         void moveToMaxPosition();
         void moveToMinPosition();
 
+        // Servo driver counters, shared by all servos. Writes are only pushed to
+        // the hardware when the pulse width changes, so with a mostly static hand
+        // most of them end up skipped.
+        static uint32_t getWritesIssued();
+        static uint32_t getWritesSkipped();
+        static void resetWriteCounters();
+
+        // Frame batching. Positions set between beginFrame() and commitFrame()
+        // are held back and sent to all servos together on the next refresh
+        // period, so a joint's servo pair never spends a period half updated.
+        // A commit right at the end of a period is deferred to the next one
+        // rather than waiting, which the control tick's commit picks up.
+        static void beginFrame();
+        static void commitFrame();
+        static uint32_t getFramesCommitted();
+        static uint32_t getFramesDeferred();
+        static uint16_t getLastFrameSpreadUs();
+        static uint16_t getMaxFrameSpreadUs();
+
     private:
         uint8_t mServoPin;
         uint8_t mMinPosition;
@@ -61,7 +94,7 @@ class ManagedServo {
         uint8_t mDefaultPosition;
         uint8_t mCurrentPosition;
         bool mInvertAngles;
-        int mISRServoIndex;
+        int8_t mISRServoIndex;
 
 };
 
@@ -7,13 +7,47 @@ float normalizedValue(int32_t value, int32_t min, int32_t max) {
 }
 
 int32_t mapInteger(int32_t value, int32_t inMin, int32_t inMax, int32_t outMin, int32_t outMax) {
-    // Get normalized value
-    float scaled = normalizedValue(value, inMin, inMax);
-
-    // Scale to output range
-    int32_t val = static_cast<int32_t>(scaled * (outMax - outMin) + outMin);
-    
-    // Clamp
-    return CLAMP(val, outMin, outMax);  // Avoid epsilon errors
-    
+    // Not used per frame, so it's fine to pay for the divide in setRange() every call
+    LinearMap map;
+    map.setRange(inMin, inMax, outMin, outMax);
+    return map.map(value);
+}
+
+
+void LinearMap::setRange(int32_t inMin, int32_t inMax, int32_t outMin, int32_t outMax) {
+    mInMin = inMin;
+    mInMax = inMax;
+    mOutMin = outMin;
+    mOutMax = outMax;
+
+    int32_t inSpan = inMax - inMin;
+    int32_t outSpan = outMax - outMin;
+
+    if (inSpan <= 0) {
+        // Degenerate input range - everything maps to the bottom of the output
+        mInMax = inMin;
+        mSlope = 0;
+        mShift = 0;
+        mFractionThreshold = 1;
+        return;
+    }
+
+    // Use as many fraction bits as possible while keeping outSpan << shift within 30 bits
+    int64_t magnitude = outSpan < 0 ? -static_cast<int64_t>(outSpan) : outSpan;
+    uint8_t shift = 30;
+    while (shift > 0 && (magnitude << shift) > (1LL << 30)) {
+        shift--;
+    }
+
+    // Round the slope up, so that results which are exact integers are never
+    // pulled below the integer by rounding
+    int64_t numerator = static_cast<int64_t>(outSpan) << shift;
+    int64_t slope = numerator / inSpan;
+    if (numerator > 0 && numerator % inSpan != 0) {
+        slope++;
+    }
+
+    mSlope = static_cast<int32_t>(slope);
+    mShift = shift;
+    mFractionThreshold = static_cast<int32_t>((1LL << shift) / inSpan);
 }
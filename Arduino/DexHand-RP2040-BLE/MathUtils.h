@@ -6,6 +6,17 @@
 // Clamp a value between a min and max
 #define CLAMP(value, min, max) (value < min ? min : (value > max ? max : value))
 
+// Q15 fixed point - 1.0 is represented as 32768
+#define Q15_SHIFT   15
+#define Q15_ONE     (1L << Q15_SHIFT)
+#define Q15_HALF    (1L << (Q15_SHIFT-1))
+
+// Q15 steps each truncate, so a small rounding term is added before
+// converting a mix back to degrees. Without it, results that are exact whole
+// degrees (which are common with round numbered ranges) could come out one
+// degree low.
+#define MIX_ROUNDING    (1L << 8)   // 1/128 degree in Q15
+
 
 // Takes an integer and range, and returns a float between 0.0 and 1.0
 float normalizedValue(int32_t value, int32_t min, int32_t max);
@@ -13,5 +24,59 @@ float normalizedValue(int32_t value, int32_t min, int32_t max);
 // Maps an integer value from one range to another
 int32_t mapInteger(int32_t value, int32_t inMin, int32_t inMax, int32_t outMin, int32_t outMax);
 
+// Converts a Q15 value to an integer, truncating toward zero like a float to int cast
+inline int32_t q15ToInt(int32_t value) {
+    return value >= 0 ? (value >> Q15_SHIFT) : -((-value) >> Q15_SHIFT);
+}
+
+
+// LinearMap is the per-frame version of mapInteger(). The slope is worked
+// out once when the range is set, so mapping a value is a clamp, a multiply
+// and a shift - there is no FPU on the RP2040, and every float operation
+// would otherwise be a soft-float library call.
+//
+// The result is the exact integer answer (truncated toward zero) as long as
+// the input span squared is smaller than 2^shift, which holds for all of the
+// joint and servo ranges in the hand. The old float path could land one below
+// an exact integer result due to rounding, so the two can differ by 1.
+
+class LinearMap {
+
+    public:
+        // A default constructed map has an empty output range, so it never
+        // matches a servo's limits and gets set up on first use.
+        constexpr LinearMap()
+        : mInMin(0), mInMax(0), mOutMin(1), mOutMax(0), mSlope(0), mFractionThreshold(1), mShift(0) {
+        }
+
+        void setRange(int32_t inMin, int32_t inMax, int32_t outMin, int32_t outMax);
+
+        inline bool hasOutputRange(int32_t outMin, int32_t outMax) const { return mOutMin == outMin && mOutMax == outMax; }
+        inline bool hasInputRange(int32_t inMin, int32_t inMax) const { return mInMin == inMin && mInMax == inMax; }
+        inline int32_t getOutMin() const { return mOutMin; }
+        inline int32_t getOutMax() const { return mOutMax; }
+
+        inline int32_t map(int32_t value) const {
+            value = CLAMP(value, mInMin, mInMax);
+            int32_t scaled = (value - mInMin) * mSlope;
+            int32_t result = mOutMin + (scaled >> mShift);
+
+            // Match truncation toward zero for negative results
+            if (result < 0 && (scaled & ((1L << mShift) - 1)) >= mFractionThreshold) {
+                result++;
+            }
+            return result;
+        }
+
+    private:
+        int32_t mInMin;
+        int32_t mInMax;
+        int32_t mOutMin;
+        int32_t mOutMax;
+        int32_t mSlope;                 // Output units per input unit, scaled by 2^mShift
+        int32_t mFractionThreshold;     // Smallest fraction that isn't slope rounding error
+        uint8_t mShift;
+};
+
 
-#endif // MATH_UTILS_H
\ No newline at end of file
+#endif // MATH_UTILS_H
@@ -0,0 +1,240 @@
+#include "Mixer.h"
+#include "Hand.h"
+#include "Log.h"
+#include "MathUtils.h"
+
+
+// ----- Table -----
+
+constexpr MixChannel channel(uint8_t input) {
+  return { { { input, 1 }, { 0, 0 } }, input, 0, 0, {} };
+}
+
+// Both pitch servos of a finger follow its pitch. The yaw pulls them apart,
+// less as the finger flexes, and above 50% flexion both get extra pitch.
+constexpr MixChannel fingerPitchChannel(uint8_t finger, int8_t yawSign) {
+  return { { { static_cast<uint8_t>(MIX_FINGER_PITCH(finger)), 1 }, { 0, 0 } }, static_cast<uint8_t>(MIX_FINGER_PITCH(finger)), 0, 0,
+    { { MIX_COUPLING_ATTENUATE, static_cast<uint8_t>(MIX_FINGER_YAW(finger)), static_cast<uint8_t>(MIX_FINGER_FLEXION(finger)),
+        yawSign, Q15_HALF, 1, static_cast<uint8_t>(MIX_PARAM_YAW_BIAS(finger)) },
+      { MIX_COUPLING_HINGE, static_cast<uint8_t>(MIX_FINGER_FLEXION(finger)), 0, 1, Q15_HALF, FINGER_FLEXION_PITCH_GAIN, MIX_PARAM_ONE } } };
+}
+
+// The channel for a servo, from the joint tables in HandConfig.h. The wrist
+// servos take pitch + yaw and yaw - pitch, but their span covers the pitch
+// range. Past the crossover the thumb's upper servo goes back at twice the
+// rate it came, for an added slope of -3.
+constexpr MixChannel mixChannel(uint8_t servo) {
+  for (uint8_t finger = 0; finger < NUM_FINGERS; finger++) {
+    if (FINGER_CONFIG[finger].leftPitchServo == servo) {
+      return fingerPitchChannel(finger, 1);
+    }
+    if (FINGER_CONFIG[finger].rightPitchServo == servo) {
+      return fingerPitchChannel(finger, -1);
+    }
+    if (FINGER_CONFIG[finger].flexionServo == servo) {
+      return channel(static_cast<uint8_t>(MIX_FINGER_FLEXION(finger)));
+    }
+  }
+  return THUMB_CONFIG.leftPitchServo == servo ? channel(MIX_THUMB_PITCH) :
+    THUMB_CONFIG.rightPitchServo == servo ?
+      MixChannel{ { { MIX_THUMB_YAW, 1 }, { 0, 0 } }, MIX_THUMB_YAW, -3, THUMB_YAW_CROSSOVER, {} } :
+    THUMB_CONFIG.flexionServo == servo ? channel(MIX_THUMB_FLEXION) :
+    THUMB_CONFIG.rollServo == servo ? channel(MIX_THUMB_ROLL) :
+    WRIST_CONFIG.leftPitchServo == servo ?
+      MixChannel{ { { MIX_WRIST_PITCH, 1 }, { MIX_WRIST_YAW, 1 } }, MIX_WRIST_PITCH, 0, 0, {} } :
+      MixChannel{ { { MIX_WRIST_YAW, 1 }, { MIX_WRIST_PITCH, -1 } }, MIX_WRIST_PITCH, 0, 0, {} };
+}
+
+constexpr MixChannel MIX_CHANNELS[NUM_SERVOS] =
+{
+  mixChannel(0), mixChannel(1), mixChannel(2), mixChannel(3), mixChannel(4), mixChannel(5),
+  mixChannel(6), mixChannel(7), mixChannel(8), mixChannel(9), mixChannel(10), mixChannel(11),
+  mixChannel(12), mixChannel(13), mixChannel(14), mixChannel(15), mixChannel(16), mixChannel(17)
+};
+
+
+// ----- Compile Time Checks -----
+
+constexpr uint8_t inputJoint(uint8_t input) {
+  return input < 3*NUM_FINGERS ? input / 3 :
+    input == MIX_WRIST_PITCH || input == MIX_WRIST_YAW ? JOINT_WRIST : JOINT_THUMB;
+}
+
+constexpr bool mixTableIsValid() {
+  for (uint8_t servo = 0; servo < NUM_SERVOS; servo++) {
+    const MixChannel& channel = MIX_CHANNELS[servo];
+    uint8_t joint = SERVO_CONFIG[servo].joint;
+
+    // Every servo is driven, its span covers one of its inputs, and its
+    // inputs are all from its own joint
+    bool driven = false;
+    bool covered = false;
+    for (const MixTerm& term : channel.terms) {
+      if (term.input >= MIX_INPUT_COUNT || (term.weight != 0 && inputJoint(term.input) != joint)) {
+        return false;
+      }
+      driven |= term.weight != 0;
+      covered |= term.weight != 0 && term.input == channel.rangeInput;
+    }
+    if (!driven || !covered) {
+      return false;
+    }
+    for (const MixCoupling& coupling : channel.couplings) {
+      if (coupling.input >= MIX_INPUT_COUNT || coupling.modulator >= MIX_INPUT_COUNT ||
+          coupling.param >= MIX_PARAM_COUNT || coupling.knee < 0 || coupling.knee > Q15_ONE) {
+        return false;
+      }
+      bool modulated = coupling.type == MIX_COUPLING_ATTENUATE;
+      if (coupling.gain != 0 && (inputJoint(coupling.input) != joint || (modulated && inputJoint(coupling.modulator) != joint))) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+static_assert(mixTableIsValid(), "Mixer table is inconsistent - check inputs, ranges and parameters");
+
+static_assert(MIX_INPUT_COUNT <= 32, "Mixer inputs don't fit a mask");
+
+// The inputs the couplings need normalized
+constexpr uint32_t normalizedInputMask() {
+  uint32_t mask = 0;
+  for (const MixChannel& channel : MIX_CHANNELS) {
+    for (const MixCoupling& coupling : channel.couplings) {
+      if (coupling.gain != 0) {
+        mask |= 1ul << coupling.input;
+        mask |= coupling.type == MIX_COUPLING_ATTENUATE ? 1ul << coupling.modulator : 0;
+      }
+    }
+  }
+  return mask;
+}
+
+constexpr uint32_t MIX_NORMALIZED_INPUTS = normalizedInputMask();
+
+
+// ----- Mixing -----
+
+// Gathered from the joints at the start of every mix, so the pass below only
+// walks contiguous arrays
+static int32_t angles[MIX_INPUT_COUNT];
+static int16_t inputMins[MIX_INPUT_COUNT];
+static int16_t inputMaxs[MIX_INPUT_COUNT];
+static int32_t normalizedAngles[MIX_INPUT_COUNT];   // Q15 of the input's range, MIX_NORMALIZED_INPUTS only
+static int32_t params[MIX_PARAM_COUNT];
+
+// Rebuilt when a range or a servo's limits change, see LinearMap
+static LinearMap normalizedMaps[MIX_INPUT_COUNT];
+static LinearMap servoMaps[NUM_SERVOS];
+
+static inline void setInput(uint8_t input, int16_t angle, int16_t min, int16_t max) {
+  angles[input] = angle;
+  inputMins[input] = min;
+  inputMaxs[input] = max;
+}
+
+// Only the joints being mixed are gathered, as a servo's inputs all come
+// from its own joint
+static void gatherInputs(uint8_t joints) {
+  for (uint8_t index = 0; index < NUM_FINGERS; index++) {
+    if (joints & HAND_JOINT_FINGER(index)) {
+      const Finger& finger = fingers[index];
+      setInput(MIX_FINGER_PITCH(index), finger.getPitchPosition(), finger.getPitchMin(), finger.getPitchMax());
+      setInput(MIX_FINGER_YAW(index), finger.getYawPosition(), finger.getYawMin(), finger.getYawMax());
+      setInput(MIX_FINGER_FLEXION(index), finger.getFlexionPosition(), finger.getFlexionMin(), finger.getFlexionMax());
+      params[MIX_PARAM_YAW_BIAS(index)] = finger.getYawBias();
+    }
+  }
+  if (joints & HAND_JOINT_THUMB) {
+    setInput(MIX_THUMB_PITCH, thumb.getPitchPosition(), thumb.getPitchMin(), thumb.getPitchMax());
+    setInput(MIX_THUMB_YAW, thumb.getYawPosition(), thumb.getYawMin(), thumb.getYawMax());
+    setInput(MIX_THUMB_FLEXION, thumb.getFlexionPosition(), thumb.getFlexionMin(), thumb.getFlexionMax());
+    setInput(MIX_THUMB_ROLL, thumb.getRollPosition(), thumb.getRollMin(), thumb.getRollMax());
+  }
+  if (joints & HAND_JOINT_WRIST) {
+    setInput(MIX_WRIST_PITCH, wrist.getPitchPosition(), wrist.getPitchMin(), wrist.getPitchMax());
+    setInput(MIX_WRIST_YAW, wrist.getYawPosition(), wrist.getYawMin(), wrist.getYawMax());
+  }
+  params[MIX_PARAM_ONE] = 1;
+
+  for (uint8_t input = 0; input < MIX_INPUT_COUNT; input++) {
+    if (MIX_NORMALIZED_INPUTS & (1ul << input)) {
+      LinearMap& map = normalizedMaps[input];
+      if (!map.hasInputRange(inputMins[input], inputMaxs[input])) {
+        map.setRange(inputMins[input], inputMaxs[input], 0, Q15_ONE);
+      }
+      normalizedAngles[input] = map.map(angles[input]);
+    }
+  }
+}
+
+// The whole mix, sending each position to its servo as well if write is set
+static void mix(uint8_t joints, uint8_t positions[NUM_SERVOS], bool write) {
+  gatherInputs(joints);
+
+  // Checked once rather than per servo, as this is most of the cost of a
+  // LOG() that is turned off
+  bool logging = isLogEnabled(LOG_MIX_SERVO);
+
+  for (uint8_t servo = 0; servo < NUM_SERVOS; servo++) {
+    if (!(joints & HAND_JOINT(SERVO_CONFIG[servo].joint))) {
+      continue;
+    }
+
+    const MixChannel& channel = MIX_CHANNELS[servo];
+    ManagedServo& output = managedServos[servo];
+    int32_t inMin = inputMins[channel.rangeInput];
+    int32_t inMax = channel.kneeSlope != 0 ? channel.knee : inputMaxs[channel.rangeInput];
+    LinearMap& map = servoMaps[servo];
+    if (!map.hasInputRange(inMin, inMax) || !map.hasOutputRange(output.getMinPosition(), output.getMaxPosition())) {
+      map.setRange(inMin, inMax, output.getMinPosition(), output.getMaxPosition());
+    }
+
+    // The matrix row, then the knee
+    int32_t input = 0;
+    for (const MixTerm& term : channel.terms) {
+      input += term.weight * angles[term.input];
+    }
+    int32_t over = input - channel.knee;
+    input += channel.kneeSlope * (over > 0 ? over : 0);
+
+    // The couplings, in Q15 before the position is rounded to degrees, and
+    // in whole degrees after. The split shift keeps the attenuated input
+    // within 32 bits without dropping precision.
+    int32_t fine = 0;
+    int32_t coarse = 0;
+    for (const MixCoupling& coupling : channel.couplings) {
+      int32_t value = normalizedAngles[coupling.input] - coupling.knee;
+      int32_t gain = coupling.gain * params[coupling.param];
+      if (coupling.type == MIX_COUPLING_ATTENUATE) {
+        fine += coupling.sign * ((((value * (Q15_ONE - normalizedAngles[coupling.modulator])) >> 9) * gain) >> 6);
+      }
+      else {
+        coarse += coupling.sign * (((value > 0 ? value : 0) * gain + MIX_ROUNDING) >> Q15_SHIFT);
+      }
+    }
+
+    int32_t position = q15ToInt((map.map(input) << Q15_SHIFT) + fine + MIX_ROUNDING) + coarse;
+    position = CLAMP(position, output.getMinPosition(), output.getMaxPosition());
+
+    // Useful debug logging for tuning, see log:mixer
+    if (logging) {
+      logRecord(LOG_MIX_SERVO, servo, input, fine + (coarse << Q15_SHIFT), position);
+    }
+
+    positions[servo] = static_cast<uint8_t>(position);
+    if (write) {
+      output.setServoPosition(positions[servo]);
+    }
+  }
+}
+
+void mixServos(uint8_t joints, uint8_t positions[NUM_SERVOS]) {
+  mix(joints, positions, false);
+}
+
+void mixHand(uint8_t joints) {
+  uint8_t positions[NUM_SERVOS];
+  mix(joints, positions, true);
+}
@@ -0,0 +1,109 @@
+#ifndef MIXER_H
+#define MIXER_H
+
+/*
+Mixer
+
+Turns the joint angles of the whole hand into servo positions in one pass.
+The finger, thumb and wrist mixes are described as data rather than code,
+in one table in Mixer.cpp with a channel per servo:
+
+  Terms      A row of a sparse joint angle to servo matrix. The servo's
+             input is the weighted sum of up to MIX_MAX_TERMS angles, e.g.
+             the wrist's left servo is pitch + yaw and its right servo
+             yaw - pitch. Unused terms have a weight of 0.
+
+  Range      The input whose range the servo's span covers, and an optional
+             knee. Past the knee the input bends by the knee slope, which
+             is how the thumb's upper servo folds back once the yaw crosses
+             over the palm. The span then only reaches up to the knee. The
+             shaped input is mapped to the servo's limits with a LinearMap.
+
+  Couplings  Up to MIX_MAX_COUPLINGS terms added after the mapping, from
+             inputs normalized to Q15 over their range. An ATTENUATE
+             coupling adds an input, centered on its knee, scaled down as a
+             modulator input rises - the finger yaw, reduced as the finger
+             flexes and weighted by the finger's yaw bias. A HINGE coupling
+             adds whole degrees in proportion to how far an input is past
+             its knee - the extra finger pitch above 50% flexion. Unused
+             couplings have a gain of 0.
+
+Every channel does the same work whatever it drives, so the cost of a frame
+only depends on how many joints are mixed.
+
+The joint objects own the angles, ranges, motion limits and yaw biases.
+The per-joint Q15 mixes the table replaced are kept, as the readable
+reference for each mix, in Host/reference/FixedKinematics.h. test_mixer
+checks the two give the same servo positions.
+
+The mixer picks up range, servo limit and yaw bias changes on its own, so
+nothing needs to tell it when the min, max or calibration commands change
+them.
+*/
+
+#include <stdint.h>
+
+#include "HandConfig.h"
+
+
+// Inputs, one per joint axis, in DOF wire order with the thumb roll last
+#define MIX_FINGER_PITCH(finger)    (3*(finger))
+#define MIX_FINGER_YAW(finger)      (3*(finger)+1)
+#define MIX_FINGER_FLEXION(finger)  (3*(finger)+2)
+#define MIX_THUMB_PITCH             (3*NUM_FINGERS)
+#define MIX_THUMB_YAW               (3*NUM_FINGERS+1)
+#define MIX_THUMB_FLEXION           (3*NUM_FINGERS+2)
+#define MIX_WRIST_PITCH             (3*NUM_FINGERS+3)
+#define MIX_WRIST_YAW               (3*NUM_FINGERS+4)
+#define MIX_THUMB_ROLL              (3*NUM_FINGERS+5)
+#define MIX_INPUT_COUNT             (3*NUM_FINGERS+6)
+
+// Parameters a coupling's gain is multiplied by
+#define MIX_PARAM_ONE               0
+#define MIX_PARAM_YAW_BIAS(finger)  (1+(finger))
+#define MIX_PARAM_COUNT             (1+NUM_FINGERS)
+
+#define MIX_MAX_TERMS               2
+#define MIX_MAX_COUPLINGS           2
+
+enum MixCouplingType {
+  MIX_COUPLING_ATTENUATE,
+  MIX_COUPLING_HINGE
+};
+
+struct MixTerm {
+  uint8_t input;
+  int8_t weight;
+};
+
+struct MixCoupling {
+  uint8_t type;           // A MIX_COUPLING_ value
+  uint8_t input;
+  uint8_t modulator;      // ATTENUATE only
+  int8_t sign;            // Applied last, so the rounding is the same either way
+  int32_t knee;           // Q15 of the input's range
+  int16_t gain;
+  uint8_t param;          // The gain is multiplied by this MIX_PARAM_
+};
+
+struct MixChannel {
+  MixTerm terms[MIX_MAX_TERMS];
+  uint8_t rangeInput;
+  int8_t kneeSlope;       // Added to the slope past the knee, 0 for no knee
+  int16_t knee;           // Degrees
+  MixCoupling couplings[MIX_MAX_COUPLINGS];
+};
+
+extern const MixChannel MIX_CHANNELS[NUM_SERVOS];
+
+// Works out the positions of the servos of the joints in the mask (see
+// HAND_JOINT in Hand.h) from the current joint angles. Other entries are
+// left alone.
+void mixServos(uint8_t joints, uint8_t positions[NUM_SERVOS]);
+
+// As mixServos(), and sends them to the servos. updateHand() and tickHand()
+// use this inside their frame.
+void mixHand(uint8_t joints);
+
+
+#endif
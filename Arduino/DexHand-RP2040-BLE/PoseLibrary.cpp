@@ -0,0 +1,247 @@
+#include "PoseLibrary.h"
+#include "Hand.h"
+
+#include <string.h>
+
+
+// ----- Built In Poses -----
+
+// Each keyframe is index, middle, ring, pinky (pitch, yaw, flexion), thumb
+// (pitch, yaw, flexion) and wrist (pitch, yaw)
+#define FINGER_OPEN       0, 0, 0
+#define FINGER_CLOSED     40, 0, 100
+#define THUMB_OPEN        30, 0, 0
+#define THUMB_CLOSED      60, 45, 45
+#define WRIST_LEVEL       0, 0
+
+#define SEQUENCE(keyframes, ...)   POSE_FORMAT_VERSION, keyframes, __VA_ARGS__
+
+static constexpr uint8_t OPEN_POSE[] = { SEQUENCE(1,
+  POSE_KEYFRAME(300, FINGER_OPEN, FINGER_OPEN, FINGER_OPEN, FINGER_OPEN, THUMB_OPEN, WRIST_LEVEL)
+) };
+
+static constexpr uint8_t FIST_POSE[] = { SEQUENCE(1,
+  POSE_KEYFRAME(300, FINGER_CLOSED, FINGER_CLOSED, FINGER_CLOSED, FINGER_CLOSED, THUMB_CLOSED, WRIST_LEVEL)
+) };
+
+static constexpr uint8_t POINT_POSE[] = { SEQUENCE(1,
+  POSE_KEYFRAME(300, FINGER_OPEN, FINGER_CLOSED, FINGER_CLOSED, FINGER_CLOSED, THUMB_CLOSED, WRIST_LEVEL)
+) };
+
+// Index and middle open and spread
+static constexpr uint8_t PEACE_POSE[] = { SEQUENCE(1,
+  POSE_KEYFRAME(300, 0, POSE_ANGLE(-10), 0, 0, 10, 0, FINGER_CLOSED, FINGER_CLOSED, THUMB_CLOSED, WRIST_LEVEL)
+) };
+
+// Index curled to meet the thumb
+static constexpr uint8_t PINCH_POSE[] = { SEQUENCE(1,
+  POSE_KEYFRAME(400, 26, 0, 65, FINGER_OPEN, FINGER_OPEN, FINGER_OPEN, 40, 0, 45, WRIST_LEVEL)
+) };
+
+// Closes the fingers from the pinky in, then opens them from the index out
+static constexpr uint8_t RIPPLE_POSE[] = { SEQUENCE(9,
+  POSE_KEYFRAME(300, FINGER_OPEN, FINGER_OPEN, FINGER_OPEN, FINGER_OPEN, THUMB_OPEN, WRIST_LEVEL),
+  POSE_KEYFRAME(150, FINGER_OPEN, FINGER_OPEN, FINGER_OPEN, FINGER_CLOSED, THUMB_OPEN, WRIST_LEVEL),
+  POSE_KEYFRAME(150, FINGER_OPEN, FINGER_OPEN, FINGER_CLOSED, FINGER_CLOSED, THUMB_OPEN, WRIST_LEVEL),
+  POSE_KEYFRAME(150, FINGER_OPEN, FINGER_CLOSED, FINGER_CLOSED, FINGER_CLOSED, THUMB_OPEN, WRIST_LEVEL),
+  POSE_KEYFRAME(150, FINGER_CLOSED, FINGER_CLOSED, FINGER_CLOSED, FINGER_CLOSED, THUMB_OPEN, WRIST_LEVEL),
+  POSE_KEYFRAME(150, FINGER_OPEN, FINGER_CLOSED, FINGER_CLOSED, FINGER_CLOSED, THUMB_OPEN, WRIST_LEVEL),
+  POSE_KEYFRAME(150, FINGER_OPEN, FINGER_OPEN, FINGER_CLOSED, FINGER_CLOSED, THUMB_OPEN, WRIST_LEVEL),
+  POSE_KEYFRAME(150, FINGER_OPEN, FINGER_OPEN, FINGER_OPEN, FINGER_CLOSED, THUMB_OPEN, WRIST_LEVEL),
+  POSE_KEYFRAME(150, FINGER_OPEN, FINGER_OPEN, FINGER_OPEN, FINGER_OPEN, THUMB_OPEN, WRIST_LEVEL)
+) };
+
+constexpr bool sequenceIsValid(const uint8_t* data, size_t length) {
+  return length >= POSE_HEADER_LENGTH && data[0] == POSE_FORMAT_VERSION &&
+    data[1] > 0 && data[1] <= POSE_MAX_KEYFRAMES && length == static_cast<size_t>(POSE_SEQUENCE_LENGTH(data[1]));
+}
+
+#define POSE(name, data)  { name, nullptr, data[1], HAND_JOINTS_ALL, data + POSE_HEADER_LENGTH }
+
+static_assert(sequenceIsValid(OPEN_POSE, sizeof(OPEN_POSE)), "open isn't a valid sequence");
+static_assert(sequenceIsValid(FIST_POSE, sizeof(FIST_POSE)), "fist isn't a valid sequence");
+static_assert(sequenceIsValid(POINT_POSE, sizeof(POINT_POSE)), "point isn't a valid sequence");
+static_assert(sequenceIsValid(PEACE_POSE, sizeof(PEACE_POSE)), "peace isn't a valid sequence");
+static_assert(sequenceIsValid(PINCH_POSE, sizeof(PINCH_POSE)), "pinch isn't a valid sequence");
+static_assert(sequenceIsValid(RIPPLE_POSE, sizeof(RIPPLE_POSE)), "ripple isn't a valid sequence");
+
+// In id order
+static constexpr Gesture POSE_LIBRARY[] = {
+  POSE("open", OPEN_POSE),
+  POSE("fist", FIST_POSE),
+  POSE("point", POINT_POSE),
+  POSE("peace", PEACE_POSE),
+  POSE("pinch", PINCH_POSE),
+  POSE("ripple", RIPPLE_POSE)
+};
+
+#define POSE_LIBRARY_COUNT    (sizeof(POSE_LIBRARY) / sizeof(POSE_LIBRARY[0]))
+
+static_assert(POSE_LIBRARY_COUNT <= POSE_UPLOAD_FIRST_ID, "Built in pose ids run into the upload slots");
+
+
+// ----- Uploads -----
+
+static uint8_t uploadData[POSE_UPLOAD_SLOTS][POSE_MAX_SEQUENCE_LENGTH];
+static Gesture uploadPoses[POSE_UPLOAD_SLOTS] = {
+  { "upload0", nullptr, 0, HAND_JOINTS_ALL, uploadData[0] + POSE_HEADER_LENGTH },
+  { "upload1", nullptr, 0, HAND_JOINTS_ALL, uploadData[1] + POSE_HEADER_LENGTH },
+  { "upload2", nullptr, 0, HAND_JOINTS_ALL, uploadData[2] + POSE_HEADER_LENGTH },
+  { "upload3", nullptr, 0, HAND_JOINTS_ALL, uploadData[3] + POSE_HEADER_LENGTH }
+};
+
+static_assert(sizeof(uploadPoses) / sizeof(uploadPoses[0]) == POSE_UPLOAD_SLOTS, "One pose per upload slot");
+
+// The upload in progress, which only reaches its slot when it's committed
+static uint8_t staging[POSE_MAX_SEQUENCE_LENGTH];
+static uint8_t stagingSlot = POSE_UPLOAD_SLOTS;     // None
+static uint16_t stagingLength = 0;
+
+static uint32_t uploadsCommitted = 0;
+static uint32_t uploadsRejected = 0;
+
+static PoseCommandResult uploadChunk(const uint8_t* data, int length) {
+  if (length < POSE_UPLOAD_HEADER_LENGTH) {
+    return POSE_COMMAND_BAD_LENGTH;
+  }
+  uint8_t slot = data[1];
+  uint16_t offset = static_cast<uint16_t>(data[2] | (data[3] << 8));
+  size_t chunkLength = length - POSE_UPLOAD_HEADER_LENGTH;
+  if (slot >= POSE_UPLOAD_SLOTS) {
+    return POSE_COMMAND_UNKNOWN;
+  }
+
+  // A chunk at 0 starts the upload over
+  if (offset == 0) {
+    stagingSlot = slot;
+    stagingLength = 0;
+  }
+  else if (slot != stagingSlot || offset != stagingLength) {
+    return POSE_COMMAND_OUT_OF_ORDER;
+  }
+  if (offset + chunkLength > POSE_MAX_SEQUENCE_LENGTH) {
+    return POSE_COMMAND_BAD_LENGTH;
+  }
+
+  memcpy(staging + offset, data + POSE_UPLOAD_HEADER_LENGTH, chunkLength);
+  stagingLength = static_cast<uint16_t>(offset + chunkLength);
+  return POSE_COMMAND_OK;
+}
+
+static PoseCommandResult commitUpload(const uint8_t* data, int length, ControlSource source) {
+  if (length < POSE_COMMIT_LENGTH) {
+    return POSE_COMMAND_BAD_LENGTH;
+  }
+  uint8_t slot = data[1];
+  uint16_t sequenceLength = static_cast<uint16_t>(data[2] | (data[3] << 8));
+  uint16_t crc = static_cast<uint16_t>(data[4] | (data[5] << 8));
+  if (slot >= POSE_UPLOAD_SLOTS) {
+    return POSE_COMMAND_UNKNOWN;
+  }
+  if (slot != stagingSlot || sequenceLength != stagingLength) {
+    return POSE_COMMAND_OUT_OF_ORDER;
+  }
+
+  PoseCommandResult result = POSE_COMMAND_OK;
+  if (crc16(staging, stagingLength) != crc) {
+    result = POSE_COMMAND_BAD_CHECKSUM;
+  }
+  else if (!isPoseSequenceValid(staging, stagingLength)) {
+    result = POSE_COMMAND_BAD_FORMAT;
+  }
+  else if (!stopGesture(source)) {
+    // The slot may be playing or queued, so nothing plays while it changes.
+    // The upload stays staged, to commit again once the gesture is over.
+    return POSE_COMMAND_BUSY;
+  }
+  stagingSlot = POSE_UPLOAD_SLOTS;
+  if (result != POSE_COMMAND_OK) {
+    uploadsRejected++;
+    return result;
+  }
+
+  memcpy(uploadData[slot], staging, stagingLength);
+  uploadPoses[slot].stepCount = uploadData[slot][1];
+  uploadsCommitted++;
+  return POSE_COMMAND_OK;
+}
+
+
+// ----- Public Interface -----
+
+bool isPoseSequenceValid(const uint8_t* data, size_t length) {
+  return sequenceIsValid(data, length);
+}
+
+const Gesture* findPose(uint8_t id) {
+  if (id < POSE_LIBRARY_COUNT) {
+    return &POSE_LIBRARY[id];
+  }
+  if (id >= POSE_UPLOAD_FIRST_ID && id < POSE_UPLOAD_FIRST_ID + POSE_UPLOAD_SLOTS) {
+    const Gesture& pose = uploadPoses[id - POSE_UPLOAD_FIRST_ID];
+    return pose.stepCount > 0 ? &pose : nullptr;
+  }
+  return nullptr;
+}
+
+const Gesture* findPose(const char* name) {
+  for (size_t i = 0; i < POSE_LIBRARY_COUNT; i++) {
+    if (strcmp(POSE_LIBRARY[i].name, name) == 0) {
+      return &POSE_LIBRARY[i];
+    }
+  }
+  for (const Gesture& pose : uploadPoses) {
+    if (pose.stepCount > 0 && strcmp(pose.name, name) == 0) {
+      return &pose;
+    }
+  }
+  return nullptr;
+}
+
+uint8_t getPoseLibraryCount() {
+  return POSE_LIBRARY_COUNT;
+}
+
+PoseCommandResult receivePoseCommand(const uint8_t* data, int length, ControlSource source, uint32_t nowMs) {
+  if (length < 1) {
+    return POSE_COMMAND_BAD_LENGTH;
+  }
+
+  switch (data[0]) {
+    case POSE_OP_PLAY:
+    case POSE_OP_QUEUE: {
+      if (length < 2) {
+        return POSE_COMMAND_BAD_LENGTH;
+      }
+      const Gesture* pose = findPose(data[1]);
+      if (pose == nullptr) {
+        return POSE_COMMAND_UNKNOWN;
+      }
+      ControlSource owner;
+      if (requestGesture(*pose, source, data[0] == POSE_OP_QUEUE, nowMs, owner) != 0) {
+        return POSE_COMMAND_BUSY;
+      }
+      return POSE_COMMAND_OK;
+    }
+
+    case POSE_OP_STOP:
+      return stopGesture(source) ? POSE_COMMAND_OK : POSE_COMMAND_BUSY;
+
+    case POSE_OP_UPLOAD:
+      return uploadChunk(data, length);
+
+    case POSE_OP_COMMIT:
+      return commitUpload(data, length, source);
+
+    default:
+      return POSE_COMMAND_UNKNOWN;
+  }
+}
+
+uint32_t getPoseUploadsCommitted() {
+  return uploadsCommitted;
+}
+
+uint32_t getPoseUploadsRejected() {
+  return uploadsRejected;
+}
@@ -0,0 +1,119 @@
+#ifndef POSE_LIBRARY_H
+#define POSE_LIBRARY_H
+
+/*
+Pose Library
+
+Poses and keyframe sequences kept as compact binary data rather than code,
+so they can be stored in flash, triggered with a couple of bytes, and new
+ones uploaded over the UART characteristic without a reflash. A sequence
+plays through gesturePlayer, which moves every DOF linearly from where it
+was to each keyframe in turn (see Gesture.h).
+
+Sequence format, little endian throughout:
+
+  0      POSE_FORMAT_VERSION
+  1      Number of keyframes, 1 to POSE_MAX_KEYFRAMES
+  Then for each keyframe, POSE_KEYFRAME_LENGTH bytes:
+  0-1    Time to move there from the previous keyframe in ms, uint16. The
+         first moves from wherever the hand is.
+  2-     One angle per DOF in whole degrees, int8, in wire order (see
+         DofProtocol.h)
+
+Angles are clamped to each DOF's range when they are applied.
+
+Binary commands are written to the UART characteristic. Text commands are
+plain ASCII, so a first byte with the top bit set marks a binary one:
+
+  POSE_OP_PLAY    id              Play pose id straight away
+  POSE_OP_QUEUE   id              Play pose id after whatever is playing
+  POSE_OP_STOP                    Stop, leaving the hand where it is
+  POSE_OP_UPLOAD  slot off0 off1  Up to POSE_UPLOAD_CHUNK bytes of a
+                  data...         sequence, at the given offset. Chunks
+                                  are sent in order, starting from 0.
+  POSE_OP_COMMIT  slot len0 len1  Checks the upload is complete and
+                  crc0 crc1       valid, with CRC-16/CCITT-FALSE over the
+                                  sequence, and puts it in the slot
+
+Play and queue are arbitrated like the text gesture command: a pose takes
+over the sender's own leases on its joints, and is turned down with
+POSE_COMMAND_BUSY if a higher priority source holds any of them or asked
+for the gesture that's playing (see requestGesture() in Gesture.h). Stop,
+and a commit, which stops whatever is playing, are turned down the same
+way rather than stop a higher priority source's gesture.
+
+Ids below POSE_UPLOAD_FIRST_ID are the built in poses, in the order of the
+table in PoseLibrary.cpp. Uploaded sequences are at POSE_UPLOAD_FIRST_ID
+plus their slot, and are kept in RAM until the next reset.
+*/
+
+#include <Arduino.h>
+
+#include "DofProtocol.h"
+#include "Gesture.h"
+
+#define POSE_FORMAT_VERSION       1
+#define POSE_HEADER_LENGTH        2
+#define POSE_KEYFRAME_LENGTH      (2 + DOF_COUNT)
+#define POSE_MAX_KEYFRAMES        16
+#define POSE_SEQUENCE_LENGTH(n)   (POSE_HEADER_LENGTH + POSE_KEYFRAME_LENGTH*(n))
+#define POSE_MAX_SEQUENCE_LENGTH  POSE_SEQUENCE_LENGTH(POSE_MAX_KEYFRAMES)
+
+#define POSE_OP_PLAY              0x80
+#define POSE_OP_QUEUE             0x81
+#define POSE_OP_STOP              0x82
+#define POSE_OP_UPLOAD            0x83
+#define POSE_OP_COMMIT            0x84
+
+#define POSE_UPLOAD_SLOTS         4
+#define POSE_UPLOAD_FIRST_ID      0x40
+#define POSE_UPLOAD_HEADER_LENGTH 4
+#define POSE_UPLOAD_CHUNK         (20 - POSE_UPLOAD_HEADER_LENGTH)    // Fits the UART characteristic
+#define POSE_COMMIT_LENGTH        6
+
+// One keyframe of a sequence, as a list of bytes for a constant table.
+// Negative angles go through POSE_ANGLE().
+#define POSE_KEYFRAME(durationMs, ...)  \
+  static_cast<uint8_t>((durationMs) & 0xFF), static_cast<uint8_t>((durationMs) >> 8), __VA_ARGS__
+#define POSE_ANGLE(degrees)             static_cast<uint8_t>(static_cast<int8_t>(degrees))
+
+enum PoseCommandResult {
+  POSE_COMMAND_OK,
+  POSE_COMMAND_BAD_LENGTH,        // Too short for its op, or a chunk past the end
+  POSE_COMMAND_UNKNOWN,           // Op, pose id or slot that doesn't exist
+  POSE_COMMAND_OUT_OF_ORDER,      // Chunk that doesn't follow the last one
+  POSE_COMMAND_BAD_CHECKSUM,
+  POSE_COMMAND_BAD_FORMAT,        // Upload isn't a valid sequence
+  POSE_COMMAND_BUSY               // Joints or gesture held by a higher priority source
+};
+
+// Keyframe access, for the player
+inline uint16_t poseKeyframeDuration(const uint8_t* keyframe) {
+  return static_cast<uint16_t>(keyframe[0] | (keyframe[1] << 8));
+}
+
+inline int8_t poseKeyframeAngle(const uint8_t* keyframe, int dof) {
+  return static_cast<int8_t>(keyframe[2 + dof]);
+}
+
+// True if the data is a whole, well formed sequence
+bool isPoseSequenceValid(const uint8_t* data, size_t length);
+
+// Looks a pose up by id or name, nullptr if there isn't one. An upload slot
+// has no pose until something is committed to it.
+const Gesture* findPose(uint8_t id);
+const Gesture* findPose(const char* name);
+
+// Number of built in poses, ids 0 to one less than this
+uint8_t getPoseLibraryCount();
+
+// Runs one binary command from the source, normally the UART characteristic.
+// Poses start from nowMs.
+PoseCommandResult receivePoseCommand(const uint8_t* data, int length, ControlSource source, uint32_t nowMs);
+
+// Uploads committed to a slot, and turned down at commit
+uint32_t getPoseUploadsCommitted();
+uint32_t getPoseUploadsRejected();
+
+
+#endif
@@ -0,0 +1,82 @@
+#include "Profiler.h"
+
+
+#define PROFILE_WINDOW_TICKS    (static_cast<uint32_t>(PROFILE_WINDOW_US) * LATENCY_TICKS_PER_US)
+
+static const char* const SECTION_NAMES[PROFILE_SECTIONS] = {
+    "loop",
+    "rxhandler",
+    "command",
+    "dofhandler",
+    "controltick",
+    "updatehand"
+};
+
+Profiler profiler;
+
+
+static uint16_t permille(uint64_t busy, uint64_t total) {
+    if (total == 0) {
+        return 0;
+    }
+    // Work outside any timed pass can push busy past the total
+    return busy >= total ? 1000 : static_cast<uint16_t>(busy * 1000 / total);
+}
+
+bool Profiler::enter(uint8_t section) {
+    if (section == PROFILE_LOOP) {
+        return false;
+    }
+    return mDepth++ == 0;
+}
+
+void Profiler::leave(uint8_t section, uint32_t ticks, bool outermost) {
+    mSections[section].record(ticks);
+
+    if (section != PROFILE_LOOP) {
+        mDepth--;
+        if (outermost) {
+            mBusyTicks += ticks;
+            mPassBusyTicks += ticks;
+        }
+        return;
+    }
+
+    mPasses++;
+    if (mPassBusyTicks == 0) {
+        mIdlePasses++;
+    }
+    mLoopTicks += ticks;
+
+    mWindowLoopTicks += ticks;
+    mWindowBusyTicks += mPassBusyTicks;
+    mPassBusyTicks = 0;
+    if (mWindowLoopTicks >= PROFILE_WINDOW_TICKS) {
+        mWindowUtilisation = permille(mWindowBusyTicks, mWindowLoopTicks);
+        mWindowLoopTicks = 0;
+        mWindowBusyTicks = 0;
+    }
+}
+
+void Profiler::reset() {
+    for (int section = 0; section < PROFILE_SECTIONS; section++) {
+        mSections[section].reset();
+    }
+    // Sections in progress still finish, so mDepth is left alone
+    mPasses = 0;
+    mIdlePasses = 0;
+    mLoopTicks = 0;
+    mBusyTicks = 0;
+    mPassBusyTicks = 0;
+    mWindowLoopTicks = 0;
+    mWindowBusyTicks = 0;
+    mWindowUtilisation = 0;
+}
+
+uint16_t Profiler::getUtilisation() const {
+    return permille(mBusyTicks, mLoopTicks);
+}
+
+const char* Profiler::getSectionName(uint8_t section) {
+    return section < PROFILE_SECTIONS ? SECTION_NAMES[section] : "";
+}
@@ -0,0 +1,130 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+/*
+Loop Profiler Definition
+
+The time the hand has left over for new work isn't visible anywhere by
+itself. The profiler times each pass of the loop and the work done in it with scoped probes,
+PROFILE_SCOPE(section), which record into a histogram per section (see
+LatencyHistogram.h) on the way out of the scope:
+
+  loop          One pass of the loop, including the BLE polling where the
+                characteristic handlers run
+  rxhandler     A command from the UART characteristic
+  command       Running a command, from the UART characteristic or serial
+  dofhandler    A DOF packet, validated and handed to the control tick
+  controltick   Applying streamed frames and stepping the joints
+  updatehand    Recomputing the servos of the joints, updateHandJoints()
+
+Time in the outermost piece of work counts as busy, and the rest of the
+loop's time as idle, so nested probes aren't counted twice. The utilisation
+is kept since the last reset and for the last PROFILE_WINDOW_US of loop time,
+which shows what the hand is doing now. A pass with no work in it counts as
+an idle pass.
+
+Durations are in the latency clock's ticks (see Latency.h). Everything runs
+from the loop, the BLE handlers included, so there's no locking. Set
+PROFILING to 0 to compile the probes out. That's the default when the
+control path has a core of its own (see ControlCore.h).
+*/
+
+#include <stdint.h>
+
+#include "ControlCore.h"
+#include "Latency.h"
+#include "LatencyHistogram.h"
+
+#ifndef PROFILING
+#define PROFILING             (!DUAL_CORE_CONTROL)
+#endif
+
+#define PROFILE_WINDOW_US     1000000
+
+enum ProfileSection {
+    PROFILE_LOOP,
+    PROFILE_RX_HANDLER,
+    PROFILE_COMMAND,
+    PROFILE_DOF_HANDLER,
+    PROFILE_CONTROL_TICK,
+    PROFILE_UPDATE_HAND,
+    PROFILE_SECTIONS
+};
+
+class Profiler {
+
+    public:
+        constexpr Profiler()
+        : mSections{}, mDepth(0), mPasses(0), mIdlePasses(0), mLoopTicks(0), mBusyTicks(0), mPassBusyTicks(0),
+            mWindowLoopTicks(0), mWindowBusyTicks(0), mWindowUtilisation(0) {
+        }
+
+        // Start of a section. Returns true if it is the outermost piece of
+        // work, whose time counts as busy.
+        bool enter(uint8_t section);
+
+        // End of a section that took the given ticks
+        void leave(uint8_t section, uint32_t ticks, bool outermost);
+
+        void reset();
+
+        inline const LatencyHistogram& getSection(uint8_t section) const { return mSections[section]; }
+        inline uint32_t getPasses() const { return mPasses; }
+        inline uint32_t getIdlePasses() const { return mIdlePasses; }
+        inline uint64_t getLoopTicks() const { return mLoopTicks; }
+        inline uint64_t getBusyTicks() const { return mBusyTicks; }
+
+        // Busy time as tenths of a percent of the loop's time, since the last
+        // reset and over the last full window
+        uint16_t getUtilisation() const;
+        inline uint16_t getWindowUtilisation() const { return mWindowUtilisation; }
+
+        // Short name of a section, for the profile command
+        static const char* getSectionName(uint8_t section);
+
+    private:
+        LatencyHistogram mSections[PROFILE_SECTIONS];
+        uint8_t mDepth;                 // Pieces of work in progress
+
+        uint32_t mPasses;
+        uint32_t mIdlePasses;
+        uint64_t mLoopTicks;
+        uint64_t mBusyTicks;
+        uint32_t mPassBusyTicks;        // Busy so far in this pass
+
+        uint32_t mWindowLoopTicks;
+        uint32_t mWindowBusyTicks;
+        uint16_t mWindowUtilisation;
+};
+
+extern Profiler profiler;
+
+// Times the rest of the enclosing scope as one section
+class ProfileScope {
+
+    public:
+        inline explicit ProfileScope(uint8_t section)
+        : mSection(section), mOutermost(profiler.enter(section)), mStart(latencyTicks()) {
+        }
+
+        inline ~ProfileScope() {
+            profiler.leave(mSection, latencyTicks() - mStart, mOutermost);
+        }
+
+        ProfileScope(const ProfileScope&) = delete;
+        ProfileScope& operator=(const ProfileScope&) = delete;
+
+    private:
+        uint8_t mSection;
+        bool mOutermost;
+        uint32_t mStart;
+};
+
+#if PROFILING
+#define PROFILE_SCOPE(section)    ProfileScope profileScope(section)
+#else
+#define PROFILE_SCOPE(section)
+#endif
+
+
+#endif
@@ -67,6 +67,7 @@
 #define MAX_PULSE_WIDTH         2450      // the longest pulse sent to a servo 
 #define DEFAULT_PULSE_WIDTH     1500      // default pulse width when servo is attached
 #define REFRESH_INTERVAL        20000     // minumim time to refresh servos in microseconds 
+#define FRAME_COMMIT_GUARD_US   500       // a commit this close to the end of a refresh period is deferred to the next commit
 
 /////////////////////////////////////////////////////
 
@@ -217,6 +218,30 @@ class RP2040_ISR_Servo
         return MAX_SERVOS - numServos;
     };
 
+    // Pulse widths are only pushed to the hardware when they change. These count
+    // the writes that reached the hardware, and the ones skipped as unchanged.
+    uint32_t getWritesIssued() const { return writesIssued; }
+    uint32_t getWritesSkipped() const { return writesSkipped; }
+    void resetWriteCounters() { writesIssued = 0; writesSkipped = 0; framesCommitted = 0; framesDeferred = 0; lastFrameSpreadUs = 0; maxFrameSpreadUs = 0; }
+
+    // Frame batching. Between beginFrame() and commitFrame() pulse widths are
+    // staged rather than sent, and commitFrame() pushes all of them back to back
+    // so the whole frame takes effect together. commitFrame() never waits: a
+    // commit too close to the end of a refresh period leaves the frame staged
+    // for the next one, so callers should commit regularly, as a control tick
+    // does.
+    void beginFrame() { frameOpen = true; }
+    void commitFrame();
+    bool isFrameOpen() const { return frameOpen; }
+
+    // Commits that reached the hardware and ones deferred to the next commit,
+    // then the time between the first and last hardware write of the most
+    // recent commit, and the worst seen since the counters were reset
+    uint32_t getFramesCommitted() const { return framesCommitted; }
+    uint32_t getFramesDeferred() const { return framesDeferred; }
+    uint16_t getLastFrameSpreadUs() const { return lastFrameSpreadUs; }
+    uint16_t getMaxFrameSpreadUs() const { return maxFrameSpreadUs; }
+
   private:
 
     void init()
@@ -235,6 +260,9 @@ class RP2040_ISR_Servo
     // find the first available slot
     int8_t findFirstFreeSlot();
 
+    // Send a pulse width to the hardware unless it already has it
+    void pushPulse(const uint8_t& servoIndex, uint16_t value);
+
 #if defined(ARDUINO_ARCH_MBED)
 
     typedef struct
@@ -244,6 +272,8 @@ class RP2040_ISR_Servo
       bool          enabled;              // true if enabled
       uint16_t      minPulseUs;           // The minimum pulse width the servo can handle
       uint16_t      maxPulseUs;           // The maximum pulse width the servo can handle
+      uint16_t      committedUs;          // Last pulse width sent to the hardware, 0 if none
+      uint16_t      stagedUs;             // Pulse width waiting for commitFrame()
       ServoImpl*    servoImpl;
     } servo_t;
     
@@ -259,6 +289,8 @@ class RP2040_ISR_Servo
       bool          enabled;    // true if enabled
       uint16_t      minPulseUs; // The minimum pulse width the servo can handle
       uint16_t      maxPulseUs; // The maximum pulse width the servo can handle
+      uint16_t      committedUs; // Last pulse width sent to the hardware, 0 if none
+      uint16_t      stagedUs;   // Pulse width waiting for commitFrame()
     } servo_t;
 
 #endif
@@ -267,6 +299,17 @@ class RP2040_ISR_Servo
 
     // actual number of servos in use (-1 means uninitialized)
     int8_t numServos;
+
+    uint32_t writesIssued;
+    uint32_t writesSkipped;
+
+    bool     frameOpen;
+    uint32_t stagedMask;          // Bit per servo index with a staged pulse width
+    uint32_t refreshEpochUs;      // When the first servo started its refresh cycle
+    uint32_t framesCommitted;
+    uint32_t framesDeferred;      // Commits left staged near the end of a refresh period
+    uint16_t lastFrameSpreadUs;
+    uint16_t maxFrameSpreadUs;
 };
 
 /////////////////////////////////////////////////////
@@ -47,7 +47,8 @@ static RP2040_ISR_Servo RP2040_ISR_Servos;   // create servo object to control u
 /////////////////////////////////////////////////////
 
 RP2040_ISR_Servo::RP2040_ISR_Servo()
-  : numServos (-1)
+  : numServos (-1), writesIssued(0), writesSkipped(0), frameOpen(false), stagedMask(0), refreshEpochUs(0),
+    framesCommitted(0), framesDeferred(0), lastFrameSpreadUs(0), maxFrameSpreadUs(0)
 {
 }
 
@@ -103,6 +104,16 @@ int8_t RP2040_ISR_Servo::setupServo(const uint8_t& pin, const uint16_t& minPulse
   servo[servoIndex].position  = 0;
   servo[servoIndex].enabled   = true;
 
+  // The slot may have been a servo that was disabled rather than deleted, so
+  // forget what it sent, or the first write could be skipped as unchanged
+  servo[servoIndex].committedUs = 0;
+  stagedMask &= ~(1UL << servoIndex);
+
+  // All servos are set up in one pass, so their refresh periods start close
+  // enough together to be treated as one for frame commits
+  if (numServos == 0)
+    refreshEpochUs = micros();
+
   numServos++;
 
 #if defined(ARDUINO_ARCH_MBED)
@@ -135,6 +146,8 @@ int8_t RP2040_ISR_Servo::setupServo(const uint8_t& pin, const uint16_t& minPulse
 
   /////////////////////////////////////////
 
+  // The first write was consumed by the pull above, so force this one through
+  servo[servoIndex].committedUs = 0;
   write(servoIndex, value);
 
 #endif
@@ -169,24 +182,95 @@ void RP2040_ISR_Servo::writeMicroseconds(const uint8_t& servoIndex, uint16_t val
 
   if (servo[servoIndex].enabled)
   {
+    if (frameOpen)
+    {
+      servo[servoIndex].stagedUs = value;
+      stagedMask |= (1UL << servoIndex);
+      return;
+    }
+
+    // A direct write replaces anything left staged by a deferred frame
+    stagedMask &= ~(1UL << servoIndex);
+    pushPulse(servoIndex, value);
+  }
+}
+
+/////////////////////////////////////////////////////
+
+void RP2040_ISR_Servo::pushPulse(const uint8_t& servoIndex, uint16_t value)
+{
+  // Nothing to do if the hardware already has this pulse width
+  if (servo[servoIndex].committedUs == value)
+  {
+    writesSkipped++;
+    return;
+  }
+
+  servo[servoIndex].committedUs = value;
+  writesIssued++;
+
 #if defined(ARDUINO_ARCH_MBED)
 
-    value = value - TRIM_DURATION;
+  value = value - TRIM_DURATION;
 
-    if (servo[servoIndex].servoImpl->duration == -1)
-    {
-      servo[servoIndex].servoImpl->start(value);
-    }
+  if (servo[servoIndex].servoImpl->duration == -1)
+  {
+    servo[servoIndex].servoImpl->start(value);
+  }
 
-    servo[servoIndex].servoImpl->duration = value;
+  servo[servoIndex].servoImpl->duration = value;
 #else
 
-    // Remove any old updates that haven't yet taken effect
-    pio_sm_clear_fifos(servo[servoIndex].pio, servo[servoIndex].smIdx);
-    pio_sm_put_blocking(servo[servoIndex].pio, servo[servoIndex].smIdx, RP2040::usToPIOCycles(value) / 3);
+  // Remove any old updates that haven't yet taken effect
+  pio_sm_clear_fifos(servo[servoIndex].pio, servo[servoIndex].smIdx);
+  pio_sm_put_blocking(servo[servoIndex].pio, servo[servoIndex].smIdx, RP2040::usToPIOCycles(value) / 3);
 
 #endif
+}
+
+/////////////////////////////////////////////////////
+
+void RP2040_ISR_Servo::commitFrame()
+{
+  frameOpen = false;
+
+  if (stagedMask == 0)
+    return;
+
+  // The hardware only picks up a new pulse width at the start of a refresh
+  // period. If this one is about to end the frame could be split across two
+  // periods, so it stays staged and goes out with the next commit instead.
+  // Staged writes made in the meantime replace it servo by servo.
+  uint32_t phaseUs = (uint32_t) (micros() - refreshEpochUs) % REFRESH_INTERVAL;
+
+  if (REFRESH_INTERVAL - phaseUs < FRAME_COMMIT_GUARD_US)
+  {
+    framesDeferred++;
+    return;
   }
+
+  noInterrupts();
+
+  uint32_t firstUs = micros();
+  uint32_t lastUs  = firstUs;
+
+  for (int8_t servoIndex = 0; servoIndex < MAX_SERVOS; servoIndex++)
+  {
+    if ( (stagedMask & (1UL << servoIndex)) && servo[servoIndex].enabled )
+    {
+      pushPulse(servoIndex, servo[servoIndex].stagedUs);
+      lastUs = micros();
+    }
+  }
+
+  interrupts();
+
+  stagedMask = 0;
+  framesCommitted++;
+  lastFrameSpreadUs = (uint16_t) (lastUs - firstUs);
+
+  if (lastFrameSpreadUs > maxFrameSpreadUs)
+    maxFrameSpreadUs = lastFrameSpreadUs;
 }
 
 /////////////////////////////////////////////////////
@@ -318,6 +402,8 @@ void RP2040_ISR_Servo::deleteServo(const uint8_t& servoIndex)
     // Intentional bad pin, good only from 0-16 for Digital, A0=17
     servo[servoIndex].pin       = RP2040_WRONG_PIN;
 
+    stagedMask &= ~(1UL << servoIndex);
+
     // update number of servos
     numServos--;
   }
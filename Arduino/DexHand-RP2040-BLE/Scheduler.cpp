@@ -0,0 +1,111 @@
+#include "Scheduler.h"
+
+
+int Scheduler::addTask(const char* name, void (*run)(), uint32_t periodUs, uint32_t budgetUs, uint32_t startUs) {
+    if (mTaskCount == SCHEDULER_MAX_TASKS || periodUs == 0) {
+        return -1;
+    }
+
+    SchedulerTask& task = mTasks[mTaskCount];
+    task = {};
+    task.name = name;
+    task.run = run;
+    task.periodUs = periodUs;
+    task.budgetUs = budgetUs;
+    task.dueUs = startUs;
+    task.enabled = true;
+    return mTaskCount++;
+}
+
+bool Scheduler::runNext() {
+    uint32_t nowUs = micros();
+
+    // Earliest deadline first, and the first added of any that tie. Deadlines
+    // are compared as differences from now, so they can wrap.
+    int next = -1;
+    int32_t nextLate = 0;
+    for (int i = 0; i < mTaskCount; i++) {
+        const SchedulerTask& task = mTasks[i];
+        int32_t late = static_cast<int32_t>(nowUs - task.dueUs);
+        if (task.enabled && late >= 0 && (next < 0 || late > nextLate)) {
+            next = i;
+            nextLate = late;
+        }
+    }
+    if (next < 0) {
+        return false;
+    }
+
+    SchedulerTask& task = mTasks[next];
+    task.run();
+    uint32_t runUs = micros() - nowUs;
+
+    task.runs++;
+    task.totalRunUs += runUs;
+    if (runUs > task.maxRunUs) {
+        task.maxRunUs = runUs;
+    }
+    if (static_cast<uint32_t>(nextLate) > task.maxLateUs) {
+        task.maxLateUs = nextLate;
+    }
+    if (runUs > task.budgetUs) {
+        task.overruns++;
+    }
+
+    // Next period, dropping any that have been missed altogether
+    uint32_t missed = static_cast<uint32_t>(nextLate) / task.periodUs;
+    task.skipped += missed;
+    task.dueUs += (missed + 1) * task.periodUs;
+    return true;
+}
+
+uint32_t Scheduler::getIdleUs() const {
+    uint32_t nowUs = micros();
+    bool any = false;
+    int32_t idle = 0;
+    for (int i = 0; i < mTaskCount; i++) {
+        const SchedulerTask& task = mTasks[i];
+        if (!task.enabled) {
+            continue;
+        }
+        int32_t untilDue = static_cast<int32_t>(task.dueUs - nowUs);
+        if (untilDue <= 0) {
+            return 0;
+        }
+        if (!any || untilDue < idle) {
+            idle = untilDue;
+            any = true;
+        }
+    }
+    return any ? idle : UINT32_MAX;
+}
+
+void Scheduler::setEnabled(int task, bool enabled) {
+    if (task < 0 || task >= mTaskCount) {
+        return;
+    }
+    if (enabled && !mTasks[task].enabled) {
+        mTasks[task].dueUs = micros();
+    }
+    mTasks[task].enabled = enabled;
+}
+
+uint32_t Scheduler::getOverruns() const {
+    uint32_t overruns = 0;
+    for (int i = 0; i < mTaskCount; i++) {
+        overruns += mTasks[i].overruns;
+    }
+    return overruns;
+}
+
+void Scheduler::resetStats() {
+    for (int i = 0; i < mTaskCount; i++) {
+        SchedulerTask& task = mTasks[i];
+        task.runs = 0;
+        task.overruns = 0;
+        task.skipped = 0;
+        task.maxRunUs = 0;
+        task.maxLateUs = 0;
+        task.totalRunUs = 0;
+    }
+}
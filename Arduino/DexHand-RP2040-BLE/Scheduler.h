@@ -0,0 +1,78 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+/*
+Cooperative Scheduler Definition
+
+The main loop's work as a set of periodic tasks - BLE polling, the control
+tick, serial input, heartbeats and so on - each with a period and a time
+budget. Every pass of the loop runs the task with the earliest deadline
+out of those that are due, so a task that's fallen behind goes ahead of one
+that can wait, and nothing blocks the rest the way a loop inside the loop
+would. When nothing is due, getIdleUs() says how long the loop can sleep.
+
+A task is due at the start of each period. It's scheduled from its
+deadline, not from when it last ran, so a late start doesn't push the
+following runs back. If it's fallen a whole period or more behind, the
+missed runs are dropped and counted as skipped, rather than run back to
+back. A run that takes longer than its budget counts as an overrun.
+
+Time is micros(), which the host build replaces with a virtual clock, so
+the schedule can be tested there. Tasks are cooperative: a task that
+doesn't return holds up all of them.
+*/
+
+#include <Arduino.h>
+
+#define SCHEDULER_MAX_TASKS     10
+
+struct SchedulerTask {
+    const char* name;
+    void (*run)();
+    uint32_t periodUs;
+    uint32_t budgetUs;
+    uint32_t dueUs;             // Start of the current period
+    bool enabled;
+
+    // Stats
+    uint32_t runs;
+    uint32_t overruns;          // Runs that took longer than the budget
+    uint32_t skipped;           // Periods missed altogether
+    uint32_t maxRunUs;
+    uint32_t maxLateUs;         // Longest wait past the deadline
+    uint64_t totalRunUs;
+};
+
+class Scheduler {
+
+    public:
+        constexpr Scheduler()
+        : mTasks{}, mTaskCount(0) {
+        }
+
+        // Adds a task that is first due at startUs. Returns its id, or -1 if
+        // there's no room.
+        int addTask(const char* name, void (*run)(), uint32_t periodUs, uint32_t budgetUs, uint32_t startUs);
+
+        // Runs the task with the earliest deadline, if any are due. Returns
+        // false if there was nothing to do.
+        bool runNext();
+
+        // Time until the next task is due, 0 if one is due now
+        uint32_t getIdleUs() const;
+
+        // A disabled task doesn't run. Enabling it makes it due straight away.
+        void setEnabled(int task, bool enabled);
+
+        inline int getTaskCount() const { return mTaskCount; }
+        inline const SchedulerTask& getTask(int task) const { return mTasks[task]; }
+        uint32_t getOverruns() const;
+        void resetStats();
+
+    private:
+        SchedulerTask mTasks[SCHEDULER_MAX_TASKS];
+        int mTaskCount;
+};
+
+
+#endif
@@ -0,0 +1,107 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+/*
+SPSC Queue Definition
+
+A fixed size ring between one producer and one consumer, which may be on
+different cores. Neither side ever waits: push() drops the value if the
+ring is full, and pop() returns false if it's empty, both in a bounded
+number of steps.
+
+The producer owns the head and the consumer the tail. Each only ever
+stores its own index and loads the other's, so only 32-bit loads and
+stores are used - the Cortex-M0+ has no atomic read-modify-write
+instructions. The indexes run freely and wrap, and N must be a power of
+two so the slot is just the low bits. The release store of an index
+publishes the slot it covers, and the acquire load on the other side
+makes sure the slot is read after it.
+
+Besides push() and pop(), the consumer can look at the entries in place
+with peek() and drop them with discard(), for code like the jitter buffer
+that works across several entries at once.
+*/
+
+#include <stdint.h>
+
+#include <atomic>
+
+template <typename T, uint32_t N>
+class SpscQueue {
+
+    static_assert(N > 0 && (N & (N - 1)) == 0, "SpscQueue length must be a power of two");
+
+    public:
+        constexpr SpscQueue()
+        : mSlots{}, mHead(0), mTail(0), mDropped(0), mMaxDepth(0) {
+        }
+
+        // Producer side. Returns false, and drops the value, if the queue is full.
+        bool push(const T& value) {
+            uint32_t head = mHead.load(std::memory_order_relaxed);
+            uint32_t depth = head - mTail.load(std::memory_order_acquire);
+            if (depth >= N) {
+                mDropped++;
+                return false;
+            }
+
+            mSlots[head & (N - 1)] = value;
+            mHead.store(head + 1, std::memory_order_release);
+            if (depth + 1 > mMaxDepth) {
+                mMaxDepth = depth + 1;
+            }
+            return true;
+        }
+
+        // Consumer side. Returns false if the queue is empty.
+        bool pop(T& value) {
+            uint32_t tail = mTail.load(std::memory_order_relaxed);
+            if (mHead.load(std::memory_order_acquire) == tail) {
+                return false;
+            }
+
+            value = mSlots[tail & (N - 1)];
+            mTail.store(tail + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Consumer side. The entry index places from the front, which must be
+        // less than getDepth().
+        inline const T& peek(uint32_t index) const {
+            return mSlots[(mTail.load(std::memory_order_relaxed) + index) & (N - 1)];
+        }
+
+        // Consumer side. Drops count entries from the front, no more than getDepth().
+        inline void discard(uint32_t count) {
+            mTail.store(mTail.load(std::memory_order_relaxed) + count, std::memory_order_release);
+        }
+
+        // Entries waiting. Exact from the consumer side, a snapshot from anywhere else.
+        inline uint32_t getDepth() const {
+            return mHead.load(std::memory_order_acquire) - mTail.load(std::memory_order_acquire);
+        }
+        inline bool isEmpty() const { return getDepth() == 0; }
+        static constexpr uint32_t getCapacity() { return N; }
+
+        // Empties the queue. Only call this when nothing can be pushing or popping.
+        void reset() {
+            mHead.store(0, std::memory_order_relaxed);
+            mTail.store(0, std::memory_order_relaxed);
+        }
+
+        // Producer side counters
+        inline uint32_t getPushed() const { return mHead.load(std::memory_order_relaxed); }     // Since the last reset
+        inline uint32_t getDropped() const { return mDropped; }
+        inline uint32_t getMaxDepth() const { return mMaxDepth; }
+        inline void resetCounters() { mDropped = 0; mMaxDepth = 0; }
+
+    private:
+        T mSlots[N];
+        std::atomic<uint32_t> mHead;        // Written by the producer only
+        std::atomic<uint32_t> mTail;        // Written by the consumer only
+        uint32_t mDropped;
+        uint32_t mMaxDepth;
+};
+
+
+#endif
@@ -12,24 +12,31 @@ that control the knuckle pitch and yaw. The third servo controls the
 thumb's flexion which is the tendon running through the finger
 to the tip. And the fourth controls the roll of the thumb.
 
-The thumb class mixes together the signals for the two differential
-servos to create the poses specified by the pitch and yaw angles from
-the controller.
+The thumb class holds the pitch, yaw, flexion and roll angles from the
+controller, and their ranges and motion limits. The mixer (see Mixer.h)
+mixes them into the signals for the two differential servos.
 
 Roll is also automatically computed based on the pitch and yaw angles.
 
 */
 #include <Arduino.h>
 
-class ManagedServo;
+#include "MathUtils.h"
+#include "Trajectory.h"
+
+#define THUMB_YAW_CROSSOVER   30      // Degrees of yaw where the thumb crosses over the palm
 
 class Thumb {
     public:
-        Thumb(ManagedServo& leftPitchServo, ManagedServo& rightPitchServo, ManagedServo& flexionServo, ManagedServo& rollServo);
-        virtual ~Thumb();
+        // Default ranges to something sane, but they can be overriden by a tuning
+        // routine or by the user if desired.
+        constexpr Thumb(const ThumbMotionConfig& motion = ThumbMotionConfig{})
+        : mPitch(motion.pitch), mYaw(motion.yaw), mFlexion(motion.flexion), mRoll(motion.roll),
+            mPitchRange{30, 60}, mYawRange{0, 45}, mFlexionRange{0, 45}, mRollRange{0, 20} {
+        }
 
         // Loop
-        void update();          // Called from the main loop to update the thumb servos
+        bool tick();            // Steps the joint angles toward their targets, returns true if any moved
 
         // Positioning
         inline void setPosition(int16_t pitch, int16_t yaw, int16_t flexion) { setPitch(pitch); setYaw(yaw); setFlexion(flexion);}
@@ -42,15 +49,26 @@ class Thumb {
         void setExtension(int16_t percent);     // Sets overall thumb extension from 0 (closed) to 100 (open)
         
         
-        inline int16_t getPitch() const { return mPitchTarget;}
-        inline int16_t getYaw() const { return mYawTarget;}
-        inline int16_t getFlexion() const { return mFlexionTarget;}
+        inline int16_t getPitch() const { return mPitch.getTarget();}
+        inline int16_t getYaw() const { return mYaw.getTarget();}
+        inline int16_t getFlexion() const { return mFlexion.getTarget();}
+        inline int16_t getRoll() const { return mRoll.getTarget();}
+
+        // Angles the servos are currently being driven to
+        inline int16_t getPitchPosition() const { return mPitch.getPosition();}
+        inline int16_t getYawPosition() const { return mYaw.getPosition();}
+        inline int16_t getFlexionPosition() const { return mFlexion.getPosition();}
+        inline int16_t getRollPosition() const { return mRoll.getPosition();}
+
+        // Motion limits
+        void setMotionLimits(const ThumbMotionConfig& motion);
+        inline bool isSettled() const { return mPitch.isSettled() && mYaw.isSettled() && mFlexion.isSettled() && mRoll.isSettled(); }
 
         // Ranges
         inline void setPitchRange(int16_t min, int16_t max) { mPitchRange[0] = min; mPitchRange[1] = max; }
         inline void setYawRange(int16_t min, int16_t max) { mYawRange[0] = min; mYawRange[1] = max; }
         inline void setFlexionRange(int16_t min, int16_t max) { mFlexionRange[0] = min; mFlexionRange[1] = max; }
-        inline void setRollRange(int16_t min, int16_t max) { mRollRange[0] = min; mRollRange[1] = max; }    
+        inline void setRollRange(int16_t min, int16_t max) { mRollRange[0] = min; mRollRange[1] = max; }
 
         inline int16_t getPitchMin() const { return mPitchRange[0]; }
         inline int16_t getPitchMax() const { return mPitchRange[1]; }
@@ -68,22 +86,15 @@ class Thumb {
 
 
     private:
-        ManagedServo& mLeftPitchServo;
-        ManagedServo& mRightPitchServo;
-        ManagedServo& mFlexionServo;
-        ManagedServo& mRollServo;
-
-        int16_t mPitchTarget;
-        int16_t mYawTarget;
-        int16_t mFlexionTarget;
-        int16_t mRollTarget;
+        Trajectory mPitch;
+        Trajectory mYaw;
+        Trajectory mFlexion;
+        Trajectory mRoll;
 
         int16_t mPitchRange[2];
         int16_t mYawRange[2];
         int16_t mFlexionRange[2];
         int16_t mRollRange[2];
-        
-        void updatePitchServos();
 };
 
 
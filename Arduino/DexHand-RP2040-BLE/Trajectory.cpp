@@ -0,0 +1,79 @@
+#include "MathUtils.h"
+#include "Trajectory.h"
+
+
+void Trajectory::setTarget(int16_t target) {
+    mTarget = target;
+
+    if (!isLimited()) {
+        snapToTarget();
+    }
+}
+
+void Trajectory::snapToTarget() {
+    mPosition = static_cast<int32_t>(mTarget) << POSITION_SHIFT;
+    mVelocity = 0;
+}
+
+void Trajectory::setLimits(const MotionLimits& limits) {
+    mMaxVelocity = velocityPerTick(limits.maxVelocity);
+    mMaxAcceleration = accelerationPerTick(limits.maxAcceleration);
+
+    if (!isLimited()) {
+        snapToTarget();
+    }
+}
+
+
+// The position accelerates toward the target until it reaches the velocity
+// limit, and starts braking once the distance left is what it takes to stop
+// from the current speed. Braking from speed v at a per tick covers
+// v + (v-a) + (v-2a) + ... which is about v(v+a)/2a.
+//
+// The speed is also never allowed to exceed the remaining distance, so the
+// position lands on the target exactly instead of overshooting and hunting.
+
+bool Trajectory::tick() {
+    if (!isLimited() || isSettled()) {
+        return false;
+    }
+
+    int16_t before = getPosition();
+
+    int32_t target = static_cast<int32_t>(mTarget) << POSITION_SHIFT;
+    int32_t error = target - mPosition;
+    int32_t direction = error >= 0 ? 1 : -1;
+    int32_t distance = error * direction;
+
+    // Speed toward the target - negative if still moving away from it after a reversal
+    int32_t speed = mVelocity * direction;
+    int32_t maxSpeed = mMaxVelocity != 0 ? mMaxVelocity : UNLIMITED_VELOCITY;
+
+    if (mMaxAcceleration == 0) {
+        // Velocity limit only
+        speed = maxSpeed;
+    }
+    else {
+        int32_t stopping = speed > 0 ? (speed * (speed + mMaxAcceleration)) / (2 * mMaxAcceleration) : 0;
+
+        if (stopping >= distance) {
+            speed -= mMaxAcceleration;
+        }
+        else {
+            speed += mMaxAcceleration;
+        }
+        speed = CLAMP(speed, -maxSpeed, maxSpeed);
+    }
+
+    if (speed >= distance) {
+        // Arrive on the target and stop
+        mPosition = target;
+        mVelocity = 0;
+    }
+    else {
+        mVelocity = speed * direction;
+        mPosition += mVelocity;
+    }
+
+    return getPosition() != before;
+}
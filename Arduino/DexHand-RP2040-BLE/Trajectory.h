@@ -0,0 +1,79 @@
+#ifndef TRAJECTORY_H
+#define TRAJECTORY_H
+
+/*
+Trajectory Definition
+
+Trajectory sits between a joint angle target (set by the controller) and the
+angle the joint actually sends to its servos. Each control tick the position
+moves toward the target without exceeding the joint's velocity and
+acceleration limits, slowing down in time to stop on the target rather than
+overshooting it.
+
+Everything is integer math. Positions are held in 1/256 degree steps,
+velocity in 1/256 degree per tick and acceleration in 1/256 degree per tick
+per tick, so a tick is a handful of adds and one multiply/divide.
+
+With no limits set the position follows the target immediately, which is
+the same behaviour as before there was a trajectory stage.
+*/
+
+#include <Arduino.h>
+
+#include "HandConfig.h"
+
+class Trajectory {
+
+    public:
+        constexpr Trajectory(const MotionLimits& limits = MotionLimits{ 0, 0 })
+        : mTarget(0), mPosition(0), mVelocity(0),
+            mMaxVelocity(velocityPerTick(limits.maxVelocity)), mMaxAcceleration(accelerationPerTick(limits.maxAcceleration)) {
+        }
+
+        // Target angle, in degrees. Takes effect immediately if the motion is unlimited.
+        void setTarget(int16_t target);
+        inline int16_t getTarget() const { return mTarget; }
+
+        // Current angle, rounded to the nearest degree
+        inline int16_t getPosition() const { return static_cast<int16_t>((mPosition + POSITION_HALF) >> POSITION_SHIFT); }
+
+        // Advance one control tick. Returns true if the rounded position changed.
+        bool tick();
+
+        // Jump straight to the target and stop
+        void snapToTarget();
+
+        void setLimits(const MotionLimits& limits);
+        inline bool isLimited() const { return mMaxVelocity != 0 || mMaxAcceleration != 0; }
+        inline bool isSettled() const { return mVelocity == 0 && mPosition == (static_cast<int32_t>(mTarget) << POSITION_SHIFT); }
+
+    private:
+        static const int POSITION_SHIFT = 8;
+        static const int32_t POSITION_HALF = 1L << (POSITION_SHIFT-1);
+
+        // Cap on the speed when only acceleration is limited. Keeps the stopping
+        // distance calculation within 32 bits.
+        static const int32_t UNLIMITED_VELOCITY = 90L << POSITION_SHIFT;
+
+        // Limits are given in degrees per second, and stored per control tick. A
+        // limit that is set never rounds down to 0, which would mean unlimited.
+        static constexpr int32_t velocityPerTick(uint16_t degreesPerSecond) {
+            return degreesPerSecond == 0 ? 0 :
+                ((static_cast<int32_t>(degreesPerSecond) << POSITION_SHIFT) / CONTROL_RATE_HZ > 0 ?
+                    (static_cast<int32_t>(degreesPerSecond) << POSITION_SHIFT) / CONTROL_RATE_HZ : 1);
+        }
+        static constexpr int32_t accelerationPerTick(uint16_t degreesPerSecondSquared) {
+            return degreesPerSecondSquared == 0 ? 0 :
+                ((static_cast<int32_t>(degreesPerSecondSquared) << POSITION_SHIFT) / (CONTROL_RATE_HZ * CONTROL_RATE_HZ) > 0 ?
+                    (static_cast<int32_t>(degreesPerSecondSquared) << POSITION_SHIFT) / (CONTROL_RATE_HZ * CONTROL_RATE_HZ) : 1);
+        }
+
+        int16_t mTarget;
+        int32_t mPosition;
+        int32_t mVelocity;
+        int32_t mMaxVelocity;
+        int32_t mMaxAcceleration;
+};
+
+
+#endif
@@ -10,22 +10,26 @@ responsible for managing the servos that control the wrist joints.
 Each wrust consists of 2 differential servos that control the 
 wrist pitch and yaw. 
 
-The wrist class mixes together the signals for the two differential
-servos to create the poses specified by the pitch and yaw angles from
-the controller.
+The wrist class holds the pitch and yaw angles from the controller, and
+their ranges and motion limits. The mixer (see Mixer.h) mixes them into
+the signals for the two differential servos.
 */
 
 #include <Arduino.h>
 
-class ManagedServo;
+#include "MathUtils.h"
+#include "Trajectory.h"
 
 class Wrist {
     public:
-        Wrist(ManagedServo& leftPitchServo, ManagedServo& rightPitchServo);
-        virtual ~Wrist();
+        // Default ranges to something sane, but they can be overriden by a tuning
+        // routine or by the user if desired.
+        constexpr Wrist(const WristMotionConfig& motion = WristMotionConfig{})
+        : mPitch(motion.pitch), mYaw(motion.yaw), mPitchRange{-40, 40}, mYawRange{-40, 40} {
+        }
 
         // Loop
-        void update();          // Called from the main loop to update the wrist servos
+        bool tick();            // Steps the joint angles toward their targets, returns true if any moved
 
         // Positioning
         inline void setPosition(int16_t pitch, int16_t yaw) { setPitch(pitch); setYaw(yaw); }
@@ -33,8 +37,16 @@ class Wrist {
         void setYaw(int16_t yaw);
         inline void setDefaultPosition() { setPitch(0); setYaw(0); }
         
-        inline int16_t getPitch() const { return mPitchTarget;}
-        inline int16_t getYaw() const { return mYawTarget;}
+        inline int16_t getPitch() const { return mPitch.getTarget();}
+        inline int16_t getYaw() const { return mYaw.getTarget();}
+
+        // Angles the servos are currently being driven to
+        inline int16_t getPitchPosition() const { return mPitch.getPosition();}
+        inline int16_t getYawPosition() const { return mYaw.getPosition();}
+
+        // Motion limits
+        void setMotionLimits(const WristMotionConfig& motion);
+        inline bool isSettled() const { return mPitch.isSettled() && mYaw.isSettled(); }
         
         // Ranges
         inline void setPitchRange(int16_t min, int16_t max) { mPitchRange[0] = min; mPitchRange[1] = max; }
@@ -49,11 +61,8 @@ class Wrist {
         
 
     private:
-        ManagedServo& mLeftPitchServo;
-        ManagedServo& mRightPitchServo;
-        
-        int16_t mPitchTarget;
-        int16_t mYawTarget;
+        Trajectory mPitch;
+        Trajectory mYaw;
         
         int16_t mPitchRange[2];
         int16_t mYawRange[2];
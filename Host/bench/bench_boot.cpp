@@ -0,0 +1,81 @@
+// Boot to first servo pulse. The old setup() waited a fixed 2s for a serial
+// monitor before starting the servos at their compiled in positions. The new
+// one applies the ranges, loads the calibration and starts the servos at
+// their saved rest positions straight away. Runs the new boot path once
+// against a saved calibration and reports when the first pulse went out on
+// the virtual clock and what the path cost in host time, then the mean host
+// cost of loading and saving the calibration on their own.
+//
+// Usage: bench_boot [runs]
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <chrono>
+
+#include "Calibration.h"
+#include "DofRegistry.h"
+#include "FileCalibrationStorage.h"
+#include "Hand.h"
+
+namespace {
+
+    // The old setup() started with delay(2000)
+    const uint32_t OLD_BOOT_DELAY_US = 2000000;
+
+    double elapsedNs(std::chrono::steady_clock::time_point start) {
+        return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count());
+    }
+
+    // micros() when the first servo's state machine was last written
+    uint64_t firstPulseMicros() {
+        int sm = hostsim::pioStateMachineForPin(managedServos[0].getServoPin());
+        return sm >= 0 ? hostsim::pioStateMachine(sm).lastPutMicros : 0;
+    }
+}
+
+int main(int argc, char** argv) {
+    long runs = argc > 1 ? strtol(argv[1], nullptr, 10) : 1000;
+    if (runs <= 0) {
+        runs = 1000;
+    }
+
+    FileCalibrationStorage storage("bench_boot_slot");
+    storage.erase();
+
+    // A calibration from an earlier session, with a rest position that isn't the default
+    managedServos[0].setDefaultPosition(45);
+    saveCalibration(storage);
+    restoreDefaultCalibration();
+
+    // The boot path, as setup() runs it
+    hostsim::setMicros(0);
+    auto start = std::chrono::steady_clock::now();
+    applyDofRanges();
+    CalibrationResult result = loadCalibration(storage);
+    startServos();
+    double bootNs = elapsedNs(start);
+
+    printf("Boot benchmark: calibration %s, %d bytes\n", result == CALIBRATION_OK ? "loaded" : "not loaded", CALIBRATION_LENGTH);
+    printf("  first pulse before:  %10lu us (fixed delay, then the servos)\n", static_cast<unsigned long>(OLD_BOOT_DELAY_US));
+    printf("  first pulse after:   %10lu us on the virtual clock, %.1f us host time, servo 0 at %u\n",
+        static_cast<unsigned long>(firstPulseMicros()), bootNs / 1000.0, managedServos[0].getServoPosition());
+
+    double loadNs = 0;
+    double saveNs = 0;
+    for (long run = 0; run < runs; run++) {
+        start = std::chrono::steady_clock::now();
+        loadCalibration(storage);
+        loadNs += elapsedNs(start);
+
+        start = std::chrono::steady_clock::now();
+        saveCalibration(storage);
+        saveNs += elapsedNs(start);
+    }
+    printf("  load:  %10.1f ns mean over %ld runs\n", loadNs / runs, runs);
+    printf("  save:  %10.1f ns mean over %ld runs, host file writes rather than flash\n", saveNs / runs, runs);
+
+    storage.erase();
+    return 0;
+}
@@ -0,0 +1,148 @@
+// Benchmark for the serial/BLE command parser: commands per second and heap
+// allocations per command for the original String based parser against the
+// table driven one in CommandParser.cpp.
+//
+// The host String is a std::string, which keeps short strings inline, so the
+// String parser's allocation count here is a floor. Arduino's String mallocs
+// for every copy and substring.
+//
+// Usage: bench_command_parser [iterations]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <new>
+
+#include "CommandParser.h"
+#include "../reference/StringCommandParser.h"
+
+static long gAllocations = 0;
+
+void* operator new(size_t size) {
+    gAllocations++;
+    void* block = malloc(size ? size : 1);
+    if (block == nullptr) {
+        throw std::bad_alloc();
+    }
+    return block;
+}
+
+void operator delete(void* block) noexcept {
+    free(block);
+}
+
+void operator delete(void* block, size_t) noexcept {
+    free(block);
+}
+
+namespace {
+
+    // A mix of what the hand sees: streamed joint commands, heartbeats and
+    // the occasional status query
+    const char* const LINES[] = {
+        "set:3:90",
+        "fingerextension:2:55",
+        "wrist:pitch:-20",
+        "thumb:flexion:35",
+        "hb",
+        "fingermax:1",
+        "servostats",
+        "Gesture:Wave",
+        "jitter:80",
+        "bogus:1:2"
+    };
+
+    const int NUM_LINES = sizeof(LINES) / sizeof(LINES[0]);
+
+    int32_t gSum = 0;
+
+    void record(const CommandArgs& args) {
+        gSum += args.index + args.value + args.count;
+    }
+
+    // Same names as the sketch, all running the same handler
+    constexpr Command COMMANDS[] = {
+        { "count", record }, { "default", record }, { "dofs", record }, { "fingerextension", record },
+        { "fingermax", record }, { "fingermin", record }, { "fingertest", record }, { "four", record },
+        { "gesture", record }, { "hb", record }, { "jitter", record }, { "max", record },
+        { "min", record }, { "motion", record }, { "one", record }, { "servostats", record },
+        { "set", record }, { "shaka", record }, { "streamstats", record }, { "three", record },
+        { "thumb", record }, { "thumbtest", record }, { "two", record }, { "wave", record },
+        { "wrist", record }
+    };
+
+    static_assert(CommandParser::isSorted(COMMANDS, sizeof(COMMANDS) / sizeof(COMMANDS[0])), "COMMANDS must be sorted by name");
+
+    constexpr CommandParser parser(COMMANDS, sizeof(COMMANDS) / sizeof(COMMANDS[0]));
+
+    double elapsedNs(std::chrono::steady_clock::time_point start) {
+        return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count());
+    }
+}
+
+int main(int argc, char** argv) {
+    long iterations = argc > 1 ? strtol(argv[1], nullptr, 10) : 1000000;
+    if (iterations <= 0) {
+        iterations = 1000000;
+    }
+
+    // Both parsers must agree on every line
+    int mismatches = 0;
+    for (const char* text : LINES) {
+        String arg;
+        int index = 0;
+        int position = 0;
+        int found = reference::parseStringCommand(String(text), arg, index, position);
+
+        char line[COMMAND_MAX_LENGTH + 1];
+        strcpy(line, text);
+        CommandArgs args;
+        CommandParser::parse(line, args);
+        const Command* command = parser.find(args.name);
+
+        mismatches += (found >= 0) != (command != nullptr);
+        mismatches += found >= 0 && command != nullptr && strcmp(reference::STRING_COMMANDS[found], command->name) != 0;
+        mismatches += index != args.index || position != args.value || strcmp(arg.c_str(), args.arg) != 0;
+    }
+
+    // The sketch constructs a String from the received line, so that's counted too
+    long allocations = gAllocations;
+    auto start = std::chrono::steady_clock::now();
+    for (long i = 0; i < iterations; i++) {
+        String arg;
+        int index = 0;
+        int position = 0;
+        int found = reference::parseStringCommand(String(LINES[i % NUM_LINES]), arg, index, position);
+        if (found >= 0) {
+            gSum += index + position + found;
+        }
+    }
+    double stringNs = elapsedNs(start);
+    long stringAllocations = gAllocations - allocations;
+
+    allocations = gAllocations;
+    start = std::chrono::steady_clock::now();
+    for (long i = 0; i < iterations; i++) {
+        char line[COMMAND_MAX_LENGTH + 1];
+        strcpy(line, LINES[i % NUM_LINES]);
+        parser.execute(line);
+    }
+    double tableNs = elapsedNs(start);
+    long tableAllocations = gAllocations - allocations;
+
+    volatile int32_t sink = gSum;
+    (void)sink;
+
+    printf("Command parser benchmark: %ld commands, %d table entries\n", iterations, static_cast<int>(sizeof(COMMANDS) / sizeof(COMMANDS[0])));
+    printf("  String parser   %7.2f ns/command  %10.0f commands/s  %5.2f allocations/command\n",
+        stringNs / iterations, iterations * 1e9 / stringNs, static_cast<double>(stringAllocations) / iterations);
+    printf("  table parser    %7.2f ns/command  %10.0f commands/s  %5.2f allocations/command\n",
+        tableNs / iterations, iterations * 1e9 / tableNs, static_cast<double>(tableAllocations) / iterations);
+    printf("  speedup         %7.2fx\n", stringNs / tableNs);
+    printf("  parser mismatches %d\n", mismatches);
+
+    return mismatches == 0 && tableAllocations == 0 ? 0 : 1;
+}
@@ -0,0 +1,349 @@
+// Simulates the jitter buffer's dead reckoning (see JitterBuffer.h) on DOF
+// streams with frames lost on the way, and measures how far the pose it
+// plays out strays from the pose that was sent, with the newest frame held
+// through a gap and with it extrapolated.
+//
+// The streams are the synthetic tracker streams of bench_pipeline, sent
+// with keyframes and deltas, or a capture from record:dump on the hand (see
+// DofRecorder.h). Each is played with:
+//
+//   clean    Every packet arrives
+//   drop10   One packet in ten is lost, at random
+//   burst    Four packets in a row are lost every 1.7 seconds
+//   stall    The link stalls for 150ms every 1.7 seconds, then delivers
+//            what was held up all at once
+//
+// The losses come round every 1.7 seconds so they land at a different point
+// of the once a second finger curls each time.
+//
+// The sent pose is what a jitter buffer plays out from every pose of the
+// synthetic stream, whole and without the tracker's noise, so the error
+// includes what the deadband and noise cost as well as the losses. A
+// capture has nothing better to go on than itself, played clean and held.
+//
+// For each stream, loss pattern and mode it reports the RMS error over
+// every DOF and control tick, the RMS error over the ticks the buffer was
+// run dry or blending back afterwards, the worst error, all in degrees, and
+// the mean host time of a sample. The gap ticks are the same with and
+// without dead reckoning, as they only depend on when frames arrive, and
+// include the stream stopping at the end. --check exits non-zero unless
+// extrapolating gives a lower gap error than holding across the bursts and
+// stalls, which is what ctest runs. A single lost frame is mostly covered
+// by the jitter delay, so drop10 is reported but not checked.
+//
+// Usage: bench_dead_reckoning [--capture <file>] [--extrapolate <ms>] [--check]
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "DofRecorder.h"
+#include "DofStream.h"
+#include "Hand.h"
+
+namespace {
+
+    const int STREAM_RATE_HZ = 30;
+    const int STREAM_SECONDS = 20;
+    const uint32_t FRAME_US = 1000000 / STREAM_RATE_HZ;
+    const int16_t DEADBAND = 200;               // Hundredths of a degree, JOINT_DEADBAND in dexhand-ble.py
+    const uint16_t KEYFRAME_INTERVAL = STREAM_RATE_HZ;
+    const uint32_t TICK_US = 1000000 / CONTROL_RATE_HZ;
+    const uint32_t SETTLE_US = 500000;
+    const uint32_t LOSS_PERIOD_US = 1700000;
+    const uint32_t STALL_US = 150000;
+
+    struct Packet {
+        uint32_t arrivalUs;
+        std::vector<uint8_t> data;
+    };
+
+    struct Stream {
+        std::string name;
+        std::vector<Packet> packets;
+        std::vector<Packet> poses;          // Every pose whole, without the noise
+    };
+
+    enum Loss {
+        LOSS_CLEAN,
+        LOSS_DROP10,
+        LOSS_BURST,
+        LOSS_STALL,
+        LOSSES
+    };
+    const char* const LOSS_NAMES[LOSSES] = { "clean", "drop10", "burst", "stall" };
+
+    // A frame as the BLE handler passes it to the jitter buffer
+    struct Arrival {
+        DofFrame frame;
+        uint32_t arrivalUs;
+    };
+
+    struct Result {
+        double rmsError;
+        double gapRmsError;
+        double maxError;
+        double sampleNs;
+    };
+
+    uint32_t gSeed = 0;
+    uint32_t random32() {
+        gSeed = gSeed * 1664525u + 1013904223u;
+        return gSeed >> 8;
+    }
+
+    int16_t noise(int16_t amplitude) {
+        return static_cast<int16_t>(static_cast<int32_t>(random32() % (2*amplitude + 1)) - amplitude);
+    }
+
+    // One finger at a time curling, and the whole hand waving, as in
+    // bench_pipeline, though the curl here starts and ends at rest, as a
+    // real finger does, rather than at full speed. Packets arrive bunched up
+    // by the connection interval.
+    Stream makeStream(int kind) {
+        static const char* const NAMES[] = { "fingers", "wave" };
+        Stream stream;
+        stream.name = NAMES[kind];
+
+        int16_t rest[DOF_COUNT] = {};
+        for (int finger = 0; finger < NUM_FINGERS; finger++) {
+            rest[finger*3] = 1000;
+            rest[finger*3+2] = 1500;
+        }
+        rest[12] = 4500;
+        rest[13] = 2000;
+        rest[14] = 1000;
+
+        gSeed = 0x13579bdf;
+        DofDeltaEncoder encoder(DEADBAND, KEYFRAME_INTERVAL);
+        for (int frame = 0; frame < STREAM_SECONDS * STREAM_RATE_HZ; frame++) {
+            double t = static_cast<double>(frame) / STREAM_RATE_HZ;
+            int16_t pose[DOF_COUNT];
+            memcpy(pose, rest, sizeof(pose));
+
+            if (kind == 0) {
+                int finger = (frame / STREAM_RATE_HZ) % NUM_FINGERS;
+                double curl = 0.5 - 0.5 * cos(2 * M_PI * (frame % STREAM_RATE_HZ) / STREAM_RATE_HZ);
+                pose[finger*3] = static_cast<int16_t>(1000 + 3000 * curl);
+                pose[finger*3+2] = static_cast<int16_t>(1500 + 8500 * curl);
+            }
+            else {
+                for (int i = 0; i < DOF_COUNT; i++) {
+                    pose[i] = static_cast<int16_t>(rest[i] + 2000 * sin(2 * M_PI * 0.7 * t + i * 0.4));
+                }
+            }
+            uint8_t buffer[DOF_MAX_PACKET_LENGTH];
+            uint32_t sentUs = frame * FRAME_US;
+            uint32_t arrivalUs = sentUs + 7500 * (1 + frame % 3) - sentUs % 7500;
+            int length = encodeDofPacketV2(pose, static_cast<uint16_t>(frame), sentUs, buffer);
+            stream.poses.push_back({ arrivalUs, std::vector<uint8_t>(buffer, buffer + length) });
+
+            for (int16_t& angle : pose) {
+                angle = static_cast<int16_t>(angle + noise(150));
+            }
+            length = encoder.encode(pose, sentUs, buffer);
+            if (length > 0) {
+                stream.packets.push_back({ arrivalUs, std::vector<uint8_t>(buffer, buffer + length) });
+            }
+        }
+        return stream;
+    }
+
+    bool loadCapture(const char* path, Stream& stream) {
+        FILE* file = fopen(path, "r");
+        if (file == nullptr) {
+            return false;
+        }
+        stream.name = "capture";
+
+        char line[256];
+        uint32_t firstUs = 0;
+        while (fgets(line, sizeof(line), file) != nullptr) {
+            uint32_t timeUs;
+            uint8_t data[DOF_MAX_PACKET_LENGTH];
+            uint8_t length;
+            if (parseDofRecord(line, timeUs, data, length)) {
+                if (stream.packets.empty()) {
+                    firstUs = timeUs;
+                }
+                stream.packets.push_back({ timeUs - firstUs, std::vector<uint8_t>(data, data + length) });
+            }
+        }
+        fclose(file);
+        stream.poses = stream.packets;
+        return !stream.packets.empty();
+    }
+
+    // The packets that make it through the loss pattern, decoded and merged
+    // as receiveDofPacket() does, with when they arrive
+    std::vector<Arrival> deliver(const std::vector<Packet>& packets, Loss loss) {
+        std::vector<Arrival> arrivals;
+        DofFrame merged = {};
+        bool haveKeyframe = false;
+        gSeed = 0x2468ace1;
+
+        for (const Packet& packet : packets) {
+            uint32_t arrivalUs = packet.arrivalUs;
+            uint32_t phaseUs = arrivalUs % LOSS_PERIOD_US;
+            if ((loss == LOSS_DROP10 && random32() % 10 == 0) ||
+                (loss == LOSS_BURST && phaseUs >= LOSS_PERIOD_US / 2 && phaseUs < LOSS_PERIOD_US / 2 + 4 * FRAME_US)) {
+                continue;
+            }
+            if (loss == LOSS_STALL && phaseUs >= LOSS_PERIOD_US / 2 && phaseUs < LOSS_PERIOD_US / 2 + STALL_US) {
+                arrivalUs += LOSS_PERIOD_US / 2 + STALL_US - phaseUs;
+            }
+
+            DofFrame frame;
+            if (decodeDofPacket(packet.data.data(), static_cast<int>(packet.data.size()), frame) != DOF_PACKET_OK ||
+                frame.version == DOF_PROTOCOL_V1) {
+                continue;
+            }
+            if (frame.version == DOF_PROTOCOL_DELTA) {
+                if (!haveKeyframe) {
+                    continue;
+                }
+                for (int i = 0; i < DOF_COUNT; i++) {
+                    if (frame.mask & (1ul << i)) {
+                        merged.angles[i] = frame.angles[i];
+                    }
+                }
+            }
+            else {
+                memcpy(merged.angles, frame.angles, sizeof(merged.angles));
+                haveKeyframe = true;
+            }
+            merged.mask = DOF_ALL_MASK;
+            merged.sequence = frame.sequence;
+            merged.timestamp = frame.timestamp;
+            merged.version = frame.version;
+            arrivals.push_back({ merged, arrivalUs });
+        }
+        return arrivals;
+    }
+
+    // Plays the delivered frames through a jitter buffer at the control rate,
+    // next to the clean stream through one without dead reckoning, and
+    // compares what the two play out
+    Result simulate(const std::vector<Arrival>& sent, const std::vector<Arrival>& delivered, uint32_t extrapolateUs) {
+        JitterBuffer reference(DOF_JITTER_DELAY_MS * 1000ul);
+        JitterBuffer buffer(DOF_JITTER_DELAY_MS * 1000ul, extrapolateUs);
+        uint32_t endUs = sent.back().arrivalUs + SETTLE_US;
+        size_t nextSent = 0;
+        size_t nextDelivered = 0;
+
+        double squares = 0;
+        double gapSquares = 0;
+        double worst = 0;
+        double totalNs = 0;
+        long samples = 0;
+        long gapSamples = 0;
+        long ticks = 0;
+        uint32_t gapEndUs = 0;
+        for (uint32_t tickUs = 0; tickUs <= endUs; tickUs += TICK_US) {
+            for (; nextSent < sent.size() && sent[nextSent].arrivalUs < tickUs; nextSent++) {
+                reference.push(sent[nextSent].frame, sent[nextSent].arrivalUs);
+            }
+            for (; nextDelivered < delivered.size() && delivered[nextDelivered].arrivalUs < tickUs; nextDelivered++) {
+                buffer.push(delivered[nextDelivered].frame, delivered[nextDelivered].arrivalUs);
+            }
+
+            DofFrame expected;
+            DofFrame played;
+            auto start = std::chrono::steady_clock::now();
+            bool playing = buffer.sample(tickUs, played);
+            totalNs += static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start).count());
+            ticks++;
+            if (!reference.sample(tickUs, expected) || !playing) {
+                continue;
+            }
+
+            // Run dry, or still blending back after it. This only depends on
+            // when frames arrive, so it's the same ticks with and without
+            // dead reckoning.
+            if (buffer.getDepth() == 1) {
+                gapEndUs = tickUs + JITTER_BLEND_MS * 1000ul;
+            }
+            bool inGap = static_cast<int32_t>(gapEndUs - tickUs) >= 0 && gapEndUs != 0;
+
+            for (int i = 0; i < DOF_COUNT; i++) {
+                double error = fabs(static_cast<double>(played.angles[i] - expected.angles[i])) / DOF_V2_ANGLE_SCALE;
+                squares += error * error;
+                worst = error > worst ? error : worst;
+                samples++;
+                if (inGap) {
+                    gapSquares += error * error;
+                    gapSamples++;
+                }
+            }
+        }
+        return { samples ? sqrt(squares / samples) : 0, gapSamples ? sqrt(gapSquares / gapSamples) : 0, worst, totalNs / ticks };
+    }
+}
+
+int main(int argc, char** argv) {
+    const char* capture = nullptr;
+    long extrapolateMs = DOF_EXTRAPOLATE_MS;
+    bool check = false;
+    for (int arg = 1; arg < argc; arg++) {
+        if (strcmp(argv[arg], "--capture") == 0 && arg + 1 < argc) {
+            capture = argv[++arg];
+        }
+        else if (strcmp(argv[arg], "--extrapolate") == 0 && arg + 1 < argc) {
+            extrapolateMs = strtol(argv[++arg], nullptr, 10);
+        }
+        else if (strcmp(argv[arg], "--check") == 0) {
+            check = true;
+        }
+        else {
+            fprintf(stderr, "Usage: %s [--capture <file>] [--extrapolate <ms>] [--check]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (extrapolateMs < 1 || extrapolateMs > JITTER_MAX_EXTRAPOLATE_MS) {
+        fprintf(stderr, "The horizon is 1 to %d ms\n", JITTER_MAX_EXTRAPOLATE_MS);
+        return 1;
+    }
+
+    std::vector<Stream> streams;
+    if (capture != nullptr) {
+        Stream stream;
+        if (!loadCapture(capture, stream)) {
+            fprintf(stderr, "No records in %s\n", capture);
+            return 1;
+        }
+        streams.push_back(stream);
+    }
+    else {
+        streams.push_back(makeStream(0));
+        streams.push_back(makeStream(1));
+    }
+
+    printf("Dead reckoning: jitter delay %d ms, horizon %ld ms, blend %d ms, error in degrees\n",
+        DOF_JITTER_DELAY_MS, extrapolateMs, JITTER_BLEND_MS);
+    printf("                       ------------ hold ------------   ----------- extrap -----------\n");
+    printf("  stream    loss           rms   gap rms   max     ns       rms   gap rms   max     ns\n");
+
+    int failures = 0;
+    for (const Stream& stream : streams) {
+        std::vector<Arrival> sent = deliver(stream.poses, LOSS_CLEAN);
+        for (int loss = 0; loss < LOSSES; loss++) {
+            std::vector<Arrival> delivered = deliver(stream.packets, static_cast<Loss>(loss));
+            Result hold = simulate(sent, delivered, 0);
+            Result extrapolated = simulate(sent, delivered, static_cast<uint32_t>(extrapolateMs) * 1000);
+
+            bool failed = check && (loss == LOSS_BURST || loss == LOSS_STALL) && extrapolated.gapRmsError >= hold.gapRmsError;
+            failures += failed;
+            printf("  %-8s  %-8s  %8.3f  %8.3f  %4.0f  %5.0f  %8.3f  %8.3f  %4.0f  %5.0f%s\n", stream.name.c_str(),
+                LOSS_NAMES[loss], hold.rmsError, hold.gapRmsError, hold.maxError, hold.sampleNs,
+                extrapolated.rmsError, extrapolated.gapRmsError, extrapolated.maxError, extrapolated.sampleNs,
+                failed ? "  WORSE" : "");
+        }
+    }
+    return failures > 0 ? 1 : 0;
+}
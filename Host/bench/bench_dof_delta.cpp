@@ -0,0 +1,200 @@
+// Link bandwidth and control tick cost of delta frames against full frames.
+//
+// Three synthetic tracker streams at 30 frames/s: a hand held still with
+// tracker noise, one finger at a time curling and opening (the common case
+// when driving the hand from a camera), and the whole hand waving, where
+// every DOF moves every frame. Each stream goes through DofDeltaEncoder with
+// the deadband the Python streamer uses, and through the receive path and
+// control tick.
+//
+// For each stream it reports bytes per frame on the link for version 1,
+// version 2 and delta frames, and the cost of applying the stream: the
+// previous behavior of updating every joint on every frame, against only
+// updating joints whose targets changed, for full and delta frames. Servo
+// writes (issued plus skipped as unchanged) count the joint updates done.
+//
+// Usage: bench_dof_delta [seconds]
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <chrono>
+#include <vector>
+
+#include "DofStream.h"
+#include "Hand.h"
+
+namespace {
+
+    const int STREAM_RATE_HZ = 30;
+    const int16_t DEADBAND = 200;               // Hundredths of a degree, JOINT_DEADBAND in dexhand-ble.py
+    const uint16_t KEYFRAME_INTERVAL = STREAM_RATE_HZ;
+    const int TIMING_PASSES = 20;
+
+    typedef std::vector<std::vector<int16_t>> Stream;     // Frames of centidegrees
+
+    uint32_t gSeed = 0x13579bdf;
+    int16_t noise(int16_t amplitude) {
+        gSeed = gSeed * 1664525u + 1013904223u;
+        return static_cast<int16_t>(static_cast<int32_t>((gSeed >> 8) % (2*amplitude + 1)) - amplitude);
+    }
+
+    // A relaxed open hand, in centidegrees
+    std::vector<int16_t> restPose() {
+        std::vector<int16_t> pose(DOF_COUNT, 0);
+        for (int finger = 0; finger < NUM_FINGERS; finger++) {
+            pose[finger*3] = 1000;
+            pose[finger*3+2] = 1500;
+        }
+        pose[12] = 4500;
+        pose[13] = 2000;
+        pose[14] = 1000;
+        return pose;
+    }
+
+    Stream makeStream(int kind, int seconds) {
+        Stream stream;
+        std::vector<int16_t> rest = restPose();
+        int frames = seconds * STREAM_RATE_HZ;
+
+        for (int frame = 0; frame < frames; frame++) {
+            double t = static_cast<double>(frame) / STREAM_RATE_HZ;
+            std::vector<int16_t> pose = rest;
+
+            if (kind == 1) {
+                // One finger at a time curls over a second and opens again
+                int finger = (frame / STREAM_RATE_HZ) % NUM_FINGERS;
+                double curl = sin(M_PI * (frame % STREAM_RATE_HZ) / STREAM_RATE_HZ);
+                pose[finger*3] = static_cast<int16_t>(1000 + 3000 * curl);
+                pose[finger*3+2] = static_cast<int16_t>(1500 + 8500 * curl);
+            }
+            else if (kind == 2) {
+                // Everything moves, each DOF a little out of phase
+                for (int i = 0; i < DOF_COUNT; i++) {
+                    pose[i] = static_cast<int16_t>(rest[i] + 2000 * sin(2 * M_PI * 0.7 * t + i * 0.4));
+                }
+            }
+
+            // Tracker noise of up to a degree and a half on every DOF
+            for (int16_t& angle : pose) {
+                angle = static_cast<int16_t>(angle + noise(150));
+            }
+            stream.push_back(pose);
+        }
+        return stream;
+    }
+
+    struct Encoded {
+        std::vector<std::vector<uint8_t>> packets;      // Empty where nothing was sent
+        long bytes = 0;
+    };
+
+    Encoded encodeFull(const Stream& stream) {
+        Encoded encoded;
+        uint8_t buffer[DOF_MAX_PACKET_LENGTH];
+        for (size_t frame = 0; frame < stream.size(); frame++) {
+            int length = encodeDofPacketV2(stream[frame].data(), static_cast<uint16_t>(frame), 0, buffer);
+            encoded.packets.emplace_back(buffer, buffer + length);
+            encoded.bytes += length;
+        }
+        return encoded;
+    }
+
+    Encoded encodeDelta(const Stream& stream) {
+        Encoded encoded;
+        DofDeltaEncoder encoder(DEADBAND, KEYFRAME_INTERVAL);
+        uint8_t buffer[DOF_MAX_PACKET_LENGTH];
+        for (const std::vector<int16_t>& pose : stream) {
+            int length = encoder.encode(pose.data(), 0, buffer);
+            encoded.packets.emplace_back(buffer, buffer + length);
+            encoded.bytes += length;
+        }
+        return encoded;
+    }
+
+    struct Cost {
+        double nsPerFrame;
+        double servoWritesPerFrame;
+    };
+
+    // Plays the packets through the BLE receive path and one control tick per
+    // frame. With updateAll, every joint is updated on every frame, as the
+    // stream did before delta frames.
+    Cost play(const Encoded& encoded, bool updateAll) {
+        long writes = 0;
+        auto start = std::chrono::steady_clock::now();
+
+        for (int pass = 0; pass < TIMING_PASSES; pass++) {
+            resetDofStreamCounters();
+            restartDofStream();
+            ManagedServo::resetWriteCounters();
+
+            for (const std::vector<uint8_t>& packet : encoded.packets) {
+                if (!packet.empty()) {
+                    receiveDofPacket(packet.data(), static_cast<int>(packet.size()));
+                }
+
+                if (updateAll) {
+                    DofFrame frame;
+                    if (dofMailbox.take(frame)) {
+                        applyDofFrame(frame);
+                        updateHand();
+                    }
+                    tickHand();
+                }
+                else {
+                    controlTick();
+                }
+            }
+            writes += ManagedServo::getWritesIssued() + ManagedServo::getWritesSkipped();
+        }
+
+        double ns = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count());
+        double frames = static_cast<double>(encoded.packets.size()) * TIMING_PASSES;
+        return { ns / frames, writes / frames };
+    }
+}
+
+int main(int argc, char** argv) {
+    int seconds = argc > 1 ? atoi(argv[1]) : 60;
+    if (seconds <= 0) {
+        seconds = 60;
+    }
+
+    setupServos();
+    setMotionLimiting(false);    // Servos follow the targets directly
+    setDofJitterDelay(0);        // Frames are applied as they arrive
+
+    const char* names[] = { "still hand", "finger by finger", "whole hand wave" };
+
+    printf("DOF delta benchmark: %d s per stream at %d frames/s, deadband %.1f deg, keyframe every %d frames\n",
+        seconds, STREAM_RATE_HZ, DEADBAND / 100.0, KEYFRAME_INTERVAL);
+
+    for (int kind = 0; kind < 3; kind++) {
+        Stream stream = makeStream(kind, seconds);
+        Encoded full = encodeFull(stream);
+        Encoded delta = encodeDelta(stream);
+        double frames = static_cast<double>(stream.size());
+
+        long sent = 0;
+        for (const std::vector<uint8_t>& packet : delta.packets) {
+            sent += !packet.empty();
+        }
+
+        Cost fullAll = play(full, true);
+        Cost fullChanged = play(full, false);
+        Cost deltaChanged = play(delta, false);
+
+        printf("\n%s\n", names[kind]);
+        printf("  link     v1 %5.1f B/frame   v2 %5.1f B/frame   delta %5.1f B/frame (%.0f%% of v2, %.0f%% of frames sent)\n",
+            static_cast<double>(DOF_V1_PACKET_LENGTH), full.bytes / frames, delta.bytes / frames,
+            100.0 * delta.bytes / full.bytes, 100.0 * sent / frames);
+        printf("  v2, all joints updated         %7.0f ns/frame  %5.2f servo writes/frame\n", fullAll.nsPerFrame, fullAll.servoWritesPerFrame);
+        printf("  v2, changed joints updated     %7.0f ns/frame  %5.2f servo writes/frame\n", fullChanged.nsPerFrame, fullChanged.servoWritesPerFrame);
+        printf("  delta, changed joints updated  %7.0f ns/frame  %5.2f servo writes/frame\n", deltaChanged.nsPerFrame, deltaChanged.servoWritesPerFrame);
+    }
+
+    return 0;
+}
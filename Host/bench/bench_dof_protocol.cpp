@@ -0,0 +1,123 @@
+// Benchmark for the DOF wire format: encode and decode rates for both
+// versions, CRC throughput, and the original float unpacking of version 1
+// frames against the integer one in DofProtocol.cpp.
+//
+// As with bench_mapping, the float path costs much more on the RP2040 than
+// here, where the host FPU handles it.
+//
+// Usage: bench_dof_protocol [iterations]
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <chrono>
+
+#include "DofProtocol.h"
+
+namespace {
+
+    const int NUM_FRAMES = 256;
+
+    double elapsedNs(std::chrono::steady_clock::time_point start) {
+        return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count());
+    }
+
+    // The version 1 unpacking as it was before DofProtocol, in double
+    // precision, in the frame's hundredths of a degree
+    void floatDecodeV1(const uint8_t* data, DofFrame& frame) {
+        for (int i = 0; i < DOF_COUNT; i++) {
+            float angle = (data[i] - 127)*360.0/256.0;
+            frame.angles[i] = static_cast<int16_t>(static_cast<int16_t>(angle) * DOF_V2_ANGLE_SCALE);
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    long iterations = argc > 1 ? strtol(argv[1], nullptr, 10) : 1000000;
+    if (iterations <= 0) {
+        iterations = 1000000;
+    }
+
+    static int16_t centidegrees[NUM_FRAMES][DOF_COUNT];
+    static int16_t degrees[NUM_FRAMES][DOF_COUNT];
+    static uint8_t v1Packets[NUM_FRAMES][DOF_V1_PACKET_LENGTH];
+    static uint8_t v2Packets[NUM_FRAMES][DOF_V2_PACKET_LENGTH];
+
+    uint32_t seed = 0x2545f491;
+    for (int frame = 0; frame < NUM_FRAMES; frame++) {
+        for (int i = 0; i < DOF_COUNT; i++) {
+            seed = seed * 1664525u + 1013904223u;
+            centidegrees[frame][i] = static_cast<int16_t>(static_cast<int32_t>((seed >> 8) % 36001) - 18000);
+            degrees[frame][i] = static_cast<int16_t>(centidegrees[frame][i] / DOF_V2_ANGLE_SCALE);
+        }
+        encodeDofPacketV1(degrees[frame], v1Packets[frame]);
+        encodeDofPacketV2(centidegrees[frame], static_cast<uint16_t>(frame), frame * 10000u, v2Packets[frame]);
+    }
+
+    volatile int32_t sink = 0;
+    int32_t sum = 0;
+    uint8_t buffer[DOF_MAX_PACKET_LENGTH];
+    DofFrame frame;
+
+    // Every float decode must match the integer one
+    int mismatches = 0;
+    for (int i = 0; i < NUM_FRAMES; i++) {
+        DofFrame expected;
+        floatDecodeV1(v1Packets[i], expected);
+        decodeDofPacket(v1Packets[i], DOF_V1_PACKET_LENGTH, frame);
+        for (int j = 0; j < DOF_COUNT; j++) {
+            mismatches += expected.angles[j] != frame.angles[j];
+        }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (long i = 0; i < iterations; i++) {
+        sum += encodeDofPacketV1(degrees[i % NUM_FRAMES], buffer) + buffer[3];
+    }
+    double encodeV1Ns = elapsedNs(start);
+
+    start = std::chrono::steady_clock::now();
+    for (long i = 0; i < iterations; i++) {
+        sum += encodeDofPacketV2(centidegrees[i % NUM_FRAMES], static_cast<uint16_t>(i), static_cast<uint32_t>(i), buffer) + buffer[9];
+    }
+    double encodeV2Ns = elapsedNs(start);
+
+    start = std::chrono::steady_clock::now();
+    for (long i = 0; i < iterations; i++) {
+        floatDecodeV1(v1Packets[i % NUM_FRAMES], frame);
+        sum += frame.angles[i % DOF_COUNT];
+    }
+    double floatDecodeNs = elapsedNs(start);
+
+    start = std::chrono::steady_clock::now();
+    for (long i = 0; i < iterations; i++) {
+        sum += decodeDofPacket(v1Packets[i % NUM_FRAMES], DOF_V1_PACKET_LENGTH, frame) + frame.angles[i % DOF_COUNT];
+    }
+    double decodeV1Ns = elapsedNs(start);
+
+    start = std::chrono::steady_clock::now();
+    for (long i = 0; i < iterations; i++) {
+        sum += decodeDofPacket(v2Packets[i % NUM_FRAMES], DOF_V2_PACKET_LENGTH, frame) + frame.angles[i % DOF_COUNT];
+    }
+    double decodeV2Ns = elapsedNs(start);
+
+    start = std::chrono::steady_clock::now();
+    for (long i = 0; i < iterations; i++) {
+        sum += crc16(v2Packets[i % NUM_FRAMES], DOF_V2_PACKET_LENGTH - 2);
+    }
+    double crcNs = elapsedNs(start);
+    sink = sum;
+    (void)sink;
+
+    printf("DOF protocol benchmark: %ld iterations\n", iterations);
+    printf("  encode v1 (%2d bytes)        %7.2f ns/frame  %9.0f frames/s\n", DOF_V1_PACKET_LENGTH, encodeV1Ns / iterations, iterations * 1e9 / encodeV1Ns);
+    printf("  encode v2 (%2d bytes)        %7.2f ns/frame  %9.0f frames/s\n", DOF_V2_PACKET_LENGTH, encodeV2Ns / iterations, iterations * 1e9 / encodeV2Ns);
+    printf("  decode v1, float unpacking  %7.2f ns/frame (no checksum)\n", floatDecodeNs / iterations);
+    printf("  decode v1                   %7.2f ns/frame  %9.0f frames/s\n", decodeV1Ns / iterations, iterations * 1e9 / decodeV1Ns);
+    printf("  decode v2                   %7.2f ns/frame  %9.0f frames/s\n", decodeV2Ns / iterations, iterations * 1e9 / decodeV2Ns);
+    printf("  crc16                       %7.2f MB/s\n", (DOF_V2_PACKET_LENGTH - 2) * iterations * 1e3 / crcNs);
+    printf("  float/integer v1 mismatches %d\n", mismatches);
+
+    return mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,67 @@
+// Cost of the gestures on the control tick. Plays each canned gesture through
+// from start to finish at CONTROL_RATE_HZ, under the motion limits, and
+// reports the mean and worst host time of a control tick while it plays and
+// the gesture's length. The worst tick includes any host scheduling noise,
+// so it's an upper bound rather than what the RP2040 would see.
+//
+// Usage: bench_gesture [runs]
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <chrono>
+
+#include "DofStream.h"
+#include "Gestures.h"
+#include "Hand.h"
+
+namespace {
+
+    const uint32_t TICK_US = 1000000 / CONTROL_RATE_HZ;
+
+    const char* const GESTURE_NAMES[] = { "count", "wave", "shaka", "thumbtest", "fingertest" };
+}
+
+int main(int argc, char** argv) {
+    long runs = argc > 1 ? strtol(argv[1], nullptr, 10) : 20;
+    if (runs <= 0) {
+        runs = 20;
+    }
+
+    setupServos();
+    setDofJitterDelay(0);
+
+    printf("Gesture benchmark: %ld runs of each, control tick at %d Hz\n", runs, CONTROL_RATE_HZ);
+    printf("  %-12s %8s %8s %12s %12s\n", "gesture", "length", "ticks", "mean ns", "worst ns");
+
+    for (const char* name : GESTURE_NAMES) {
+        const Gesture& gesture = *findGesture(name);
+        long ticks = 0;
+        double totalNs = 0;
+        double worstNs = 0;
+        uint32_t lengthMs = 0;
+
+        for (long run = 0; run < runs; run++) {
+            setDefaultPose();
+            uint32_t startMs = millis();
+            gesturePlayer.play(gesture, startMs);
+            while (gesturePlayer.isPlaying()) {
+                hostsim::advanceMicros(TICK_US);
+                auto start = std::chrono::steady_clock::now();
+                controlTick();
+                double ns = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - start).count());
+                totalNs += ns;
+                worstNs = std::max(worstNs, ns);
+                ticks++;
+            }
+            lengthMs = millis() - startMs;
+        }
+
+        printf("  %-12s %6lums %8ld %12.1f %12.1f\n", name, static_cast<unsigned long>(lengthMs), ticks / runs,
+            totalNs / ticks, worstNs);
+    }
+
+    return 0;
+}
@@ -0,0 +1,71 @@
+// Benchmark for the streaming pipeline with its latency instrumentation:
+// plays version 2 frames through receiveDofPacket() and the control tick and
+// prints where the time goes, stage by stage. Built a second time as
+// bench_latency_disabled, against a core with the latency instrumentation
+// and the loop profiler compiled out, so the cost of the instrumentation
+// itself can be read off the per-frame times of the two.
+//
+// Usage: bench_latency [frames]
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <chrono>
+
+#include "DofStream.h"
+#include "Hand.h"
+#include "Latency.h"
+
+namespace {
+
+    const int NUM_FRAMES = 256;
+
+    double elapsedNs(std::chrono::steady_clock::time_point start) {
+        return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count());
+    }
+}
+
+int main(int argc, char** argv) {
+    long frames = argc > 1 ? strtol(argv[1], nullptr, 10) : 200000;
+    if (frames <= 0) {
+        frames = 200000;
+    }
+
+    setupServos();
+    setMotionLimiting(false);    // Servos follow the targets directly
+    setDofJitterDelay(0);        // Frames are applied as they arrive
+
+    // Every joint sweeping, so each frame moves servos
+    static uint8_t packets[NUM_FRAMES][DOF_MAX_PACKET_LENGTH];
+    for (int frame = 0; frame < NUM_FRAMES; frame++) {
+        int16_t centidegrees[DOF_COUNT];
+        for (int i = 0; i < DOF_COUNT; i++) {
+            centidegrees[i] = static_cast<int16_t>(((frame * 7 + i * 13) % 40) * 100);
+        }
+        encodeDofPacketV2(centidegrees, static_cast<uint16_t>(frame), frame * 33333u, packets[frame]);
+    }
+
+    resetLatency();
+    auto start = std::chrono::steady_clock::now();
+    for (long i = 0; i < frames; i++) {
+        receiveDofPacket(packets[i % NUM_FRAMES], DOF_V2_PACKET_LENGTH);
+        controlTick();
+    }
+    double totalNs = elapsedNs(start);
+
+    printf("Latency benchmark: %ld frames, instrumentation %s\n", frames, LATENCY_INSTRUMENTATION ? "on" : "compiled out");
+    printf("  receive + control tick  %8.1f ns/frame\n", totalNs / frames);
+
+#if LATENCY_INSTRUMENTATION
+    printf("  %-12s %10s %9s %9s %9s %9s\n", "stage", "count", "p50 ns", "p90 ns", "p99 ns", "max ns");
+    for (int stage = 0; stage < LATENCY_STAGES; stage++) {
+        const LatencyHistogram& histogram = latencyHistograms[stage];
+        printf("  %-12s %10u %9.0f %9.0f %9.0f %9.0f\n", getLatencyStageName(stage), histogram.getCount(),
+            histogram.getPercentile(50) * 1000.0 / LATENCY_TICKS_PER_US, histogram.getPercentile(90) * 1000.0 / LATENCY_TICKS_PER_US,
+            histogram.getPercentile(99) * 1000.0 / LATENCY_TICKS_PER_US, histogram.getMax() * 1000.0 / LATENCY_TICKS_PER_US);
+    }
+#endif
+
+    return 0;
+}
@@ -0,0 +1,103 @@
+// Benchmark for joint to servo mapping: the original float mapInteger()
+// against the precomputed LinearMap, and the float finger mixing against
+// the Q15 table driven mixer in Mixer.cpp.
+//
+// The host has an FPU, so the float path is much cheaper here than on the
+// RP2040, where every float operation is a soft-float library call. The
+// ratio is still a useful sanity check that the fixed path is not slower.
+//
+// Usage: bench_mapping [iterations]
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <chrono>
+#include <vector>
+
+#include "Hand.h"
+#include "MathUtils.h"
+#include "Mixer.h"
+#include "../reference/FloatKinematics.h"
+
+namespace {
+
+    const int NUM_VALUES = 4096;
+
+    double elapsedNs(std::chrono::steady_clock::time_point start) {
+        return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count());
+    }
+}
+
+int main(int argc, char** argv) {
+    long iterations = argc > 1 ? strtol(argv[1], nullptr, 10) : 2000000;
+    if (iterations <= 0) {
+        iterations = 2000000;
+    }
+
+    setupServos();
+    setMotionLimiting(false);    // Servos follow the targets directly
+
+    std::vector<int32_t> values(NUM_VALUES);
+    uint32_t seed = 0x2545f491;
+    for (int32_t& value : values) {
+        seed = seed * 1664525u + 1013904223u;
+        value = static_cast<int32_t>((seed >> 8) % 121) - 10;     // Includes some out of range values
+    }
+
+    volatile int32_t sink = 0;
+
+    // mapInteger() equivalent: pitch range 0..40 onto a 30..110 servo
+    auto start = std::chrono::steady_clock::now();
+    int32_t sum = 0;
+    for (long i = 0; i < iterations; i++) {
+        sum += reference::mapInteger(values[i % NUM_VALUES], 0, 100, 30, 110);
+    }
+    sink = sum;
+    double floatNs = elapsedNs(start);
+
+    LinearMap map;
+    map.setRange(0, 100, 30, 110);
+    start = std::chrono::steady_clock::now();
+    sum = 0;
+    for (long i = 0; i < iterations; i++) {
+        sum += map.map(values[i % NUM_VALUES]);
+    }
+    sink = sum;
+    double fixedNs = elapsedNs(start);
+
+    // Whole finger mixing, float reference against the mixer
+    Finger& finger = fingers[FINGER_INDEX];
+    reference::Range left = { managedServos[SERVO_INDEX_LOWER].getMinPosition(), managedServos[SERVO_INDEX_LOWER].getMaxPosition() };
+    reference::Range right = { managedServos[SERVO_INDEX_UPPER].getMinPosition(), managedServos[SERVO_INDEX_UPPER].getMaxPosition() };
+    reference::Range flex = { managedServos[SERVO_INDEX_TIP].getMinPosition(), managedServos[SERVO_INDEX_TIP].getMaxPosition() };
+
+    long fingerIterations = iterations / 4;
+    start = std::chrono::steady_clock::now();
+    sum = 0;
+    for (long i = 0; i < fingerIterations; i++) {
+        int32_t out[3];
+        int32_t value = values[i % NUM_VALUES];
+        reference::finger(value / 3, value / 3 - 20, value, { 0, 40 }, { -20, 20 }, { 0, 100 }, 60, left, right, flex, out);
+        sum += out[0] + out[1] + out[2];
+    }
+    sink = sum;
+    double floatFingerNs = elapsedNs(start);
+
+    start = std::chrono::steady_clock::now();
+    for (long i = 0; i < fingerIterations; i++) {
+        int32_t value = values[i % NUM_VALUES];
+        finger.setPosition(value / 3, value / 3 - 20, value);
+        mixHand(HAND_JOINT_FINGER(FINGER_INDEX));
+    }
+    double fixedFingerNs = elapsedNs(start);
+    (void)sink;
+
+    printf("Mapping benchmark: %ld iterations\n", iterations);
+    printf("  float mapInteger()          %6.2f ns/call\n", floatNs / iterations);
+    printf("  LinearMap::map()            %6.2f ns/call  (%.2fx)\n", fixedNs / iterations, floatNs / fixedNs);
+    printf("  float finger mixing         %6.2f ns/finger (no servo writes)\n", floatFingerNs / fingerIterations);
+    printf("  mixHand(), one finger       %6.2f ns/finger (including 3 servo writes)\n", fixedFingerNs / fingerIterations);
+
+    return 0;
+}
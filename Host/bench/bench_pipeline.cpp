@@ -0,0 +1,437 @@
+// Trace driven benchmark for the whole DOF pipeline. Plays DOF streams
+// through what the hand runs for them: the BLE handler's recording and
+// decode, the control tick with the jitter buffer and the DOF setters, the
+// mixer and the servo writes, down to the simulated PIO, which records every
+// pulse. Packets arrive at their stream times on the virtual clock, with the
+// control tick running at CONTROL_RATE_HZ in between, and the default jitter
+// delay and motion limits.
+//
+// The streams are synthetic tracker streams at 30 frames/s sent as the
+// Python streamer sends them, with keyframes and deltas, or a capture from
+// record:dump on the hand (see DofRecorder.h).
+//
+// For each stream it reports the frames per second of host time the pipeline
+// could keep up with, the mean and worst time from a packet arriving to the
+// end of the control tick that picks it up, and the servo writes and PIO
+// pulses per frame. Each stream is played a number of times, each after an
+// untimed run that leaves the hand where the stream ends, and each packet and tick is timed at the lowest it took in any of them, so
+// a host scheduler hiccup doesn't show up as the worst case. The writes and pulses
+// come out the same on every run.
+//
+// --save writes the results as a baseline, and --baseline compares them with
+// one and exits non-zero on a regression: a count that got worse at all, or
+// a time that got worse by more than the tolerance. Times depend on the
+// machine, so save a baseline of your own before comparing them.
+// --counts-only only compares the counts, which is what ctest runs against
+// the baseline kept in bench/baselines.
+//
+// Usage: bench_pipeline [--capture <file>] [--passes <n>] [--baseline <file>]
+//                       [--save <file>] [--tolerance <percent>] [--counts-only]
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "DofRecorder.h"
+#include "DofStream.h"
+#include "Hand.h"
+
+namespace {
+
+    const int STREAM_RATE_HZ = 30;
+    const int STREAM_SECONDS = 20;
+    const uint32_t FRAME_US = 1000000 / STREAM_RATE_HZ;
+    const int16_t DEADBAND = 200;               // Hundredths of a degree, JOINT_DEADBAND in dexhand-ble.py
+    const uint16_t KEYFRAME_INTERVAL = STREAM_RATE_HZ;
+    const uint32_t TICK_US = 1000000 / CONTROL_RATE_HZ;
+    const uint32_t SETTLE_US = 1000000;         // After the last packet, for the joints to get there
+    const double COUNT_TOLERANCE = 0.001;
+
+    struct Packet {
+        uint32_t arrivalUs;
+        std::vector<uint8_t> data;
+    };
+
+    struct Stream {
+        std::string name;
+        std::vector<Packet> packets;
+    };
+
+    // The results, by name, as they go in a baseline
+    struct Metric {
+        const char* name;
+        bool isCount;           // Exact, rather than a time
+        bool higherIsBetter;
+    };
+
+    const Metric METRICS[] = {
+        { "fps", false, true },
+        { "mean_ns", false, false },
+        { "max_ns", false, false },
+        { "writes_per_frame", true, false },
+        { "pulses_per_frame", true, false },
+    };
+    const int METRIC_COUNT = sizeof(METRICS) / sizeof(METRICS[0]);
+
+    struct Result {
+        std::string stream;
+        long frames;
+        double values[METRIC_COUNT];
+    };
+
+    uint32_t gSeed = 0x13579bdf;
+    int16_t noise(int16_t amplitude) {
+        gSeed = gSeed * 1664525u + 1013904223u;
+        return static_cast<int16_t>(static_cast<int32_t>((gSeed >> 8) % (2*amplitude + 1)) - amplitude);
+    }
+
+    // A still hand with tracker noise, one finger at a time curling, and the
+    // whole hand waving, as in bench_dof_delta. Packets arrive bunched up by
+    // the connection interval.
+    Stream makeStream(int kind) {
+        static const char* const NAMES[] = { "still", "fingers", "wave" };
+        Stream stream;
+        stream.name = NAMES[kind];
+
+        int16_t rest[DOF_COUNT] = {};
+        for (int finger = 0; finger < NUM_FINGERS; finger++) {
+            rest[finger*3] = 1000;
+            rest[finger*3+2] = 1500;
+        }
+        rest[12] = 4500;
+        rest[13] = 2000;
+        rest[14] = 1000;
+
+        gSeed = 0x13579bdf;
+        DofDeltaEncoder encoder(DEADBAND, KEYFRAME_INTERVAL);
+        for (int frame = 0; frame < STREAM_SECONDS * STREAM_RATE_HZ; frame++) {
+            double t = static_cast<double>(frame) / STREAM_RATE_HZ;
+            int16_t pose[DOF_COUNT];
+            memcpy(pose, rest, sizeof(pose));
+
+            if (kind == 1) {
+                int finger = (frame / STREAM_RATE_HZ) % NUM_FINGERS;
+                double curl = sin(M_PI * (frame % STREAM_RATE_HZ) / STREAM_RATE_HZ);
+                pose[finger*3] = static_cast<int16_t>(1000 + 3000 * curl);
+                pose[finger*3+2] = static_cast<int16_t>(1500 + 8500 * curl);
+            }
+            else if (kind == 2) {
+                for (int i = 0; i < DOF_COUNT; i++) {
+                    pose[i] = static_cast<int16_t>(rest[i] + 2000 * sin(2 * M_PI * 0.7 * t + i * 0.4));
+                }
+            }
+            for (int16_t& angle : pose) {
+                angle = static_cast<int16_t>(angle + noise(150));
+            }
+
+            uint8_t buffer[DOF_MAX_PACKET_LENGTH];
+            uint32_t sentUs = frame * FRAME_US;
+            int length = encoder.encode(pose, sentUs, buffer);
+            if (length > 0) {
+                // Held for up to two 7.5ms connection intervals
+                uint32_t arrivalUs = sentUs + 7500 * (1 + frame % 3) - sentUs % 7500;
+                stream.packets.push_back({ arrivalUs, std::vector<uint8_t>(buffer, buffer + length) });
+            }
+        }
+        return stream;
+    }
+
+    bool loadCapture(const char* path, Stream& stream) {
+        FILE* file = fopen(path, "r");
+        if (file == nullptr) {
+            return false;
+        }
+        stream.name = "capture";
+
+        char line[256];
+        uint32_t firstUs = 0;
+        while (fgets(line, sizeof(line), file) != nullptr) {
+            uint32_t timeUs;
+            uint8_t data[DOF_MAX_PACKET_LENGTH];
+            uint8_t length;
+            if (parseDofRecord(line, timeUs, data, length)) {
+                if (stream.packets.empty()) {
+                    firstUs = timeUs;
+                }
+                stream.packets.push_back({ timeUs - firstUs, std::vector<uint8_t>(data, data + length) });
+            }
+        }
+        fclose(file);
+        return !stream.packets.empty();
+    }
+
+    double elapsedNs(std::chrono::steady_clock::time_point start) {
+        return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count());
+    }
+
+    // What dofHandler() in the sketch does with a packet
+    void handlePacket(const Packet& packet) {
+        if (recordDofPacket(packet.data.data(), static_cast<int>(packet.data.size()))) {
+            receiveDofPacket(packet.data.data(), static_cast<int>(packet.data.size()));
+        }
+    }
+
+    // Host times of one run of the stream. Every run takes the same ticks, so
+    // they line up between runs.
+    struct Pass {
+        std::vector<double> packetNs;
+        std::vector<double> tickNs;
+        std::vector<size_t> packetTick;     // The tick that picked the packet up
+        uint32_t writes = 0;
+        uint32_t pulses = 0;
+    };
+
+    // One run of the stream, starting at startUs on the virtual clock
+    Pass play(const Stream& stream, uint64_t startUs) {
+        Pass pass;
+        resetDofStreamCounters();
+        restartDofStream();
+        ManagedServo::resetWriteCounters();
+        uint32_t pulsesBefore = hostsim::pioTotalPuts();
+
+        uint64_t tickUs = startUs;
+        uint64_t endUs = startUs + stream.packets.back().arrivalUs + SETTLE_US;
+        size_t next = 0;
+        while (tickUs <= endUs) {
+            while (next < stream.packets.size() && startUs + stream.packets[next].arrivalUs < tickUs) {
+                hostsim::setMicros(startUs + stream.packets[next].arrivalUs);
+                auto start = std::chrono::steady_clock::now();
+                handlePacket(stream.packets[next]);
+                pass.packetNs.push_back(elapsedNs(start));
+                pass.packetTick.push_back(pass.tickNs.size());
+                next++;
+            }
+
+            hostsim::setMicros(tickUs);
+            auto start = std::chrono::steady_clock::now();
+            controlTick();
+            pass.tickNs.push_back(elapsedNs(start));
+            tickUs += TICK_US;
+        }
+
+        pass.writes = ManagedServo::getWritesIssued();
+        pass.pulses = hostsim::pioTotalPuts() - pulsesBefore;
+        return pass;
+    }
+
+    // The stream once to leave the hand where it ends up, so every timed run
+    // starts from the same place, then the timed run
+    Pass playTimed(const Stream& stream) {
+        uint64_t passUs = stream.packets.back().arrivalUs + SETTLE_US + TICK_US;
+        uint64_t startUs = hostsim::nowMicros() + TICK_US;
+        play(stream, startUs);
+        return play(stream, startUs + passUs);
+    }
+
+    // Each packet and tick keeps the lowest time it took
+    void keepBest(Pass& best, const Pass& pass) {
+        for (size_t packet = 0; packet < best.packetNs.size(); packet++) {
+            best.packetNs[packet] = std::min(best.packetNs[packet], pass.packetNs[packet]);
+        }
+        for (size_t tick = 0; tick < best.tickNs.size(); tick++) {
+            best.tickNs[tick] = std::min(best.tickNs[tick], pass.tickNs[tick]);
+        }
+    }
+
+    Result summarize(const Stream& stream, const Pass& best) {
+        Result result;
+        result.stream = stream.name;
+        result.frames = static_cast<long>(stream.packets.size());
+        double frames = static_cast<double>(result.frames);
+        double totalNs = 0;
+        double frameSumNs = 0;
+        double worstNs = 0;
+        for (size_t packet = 0; packet < best.packetNs.size(); packet++) {
+            double frameNs = best.packetNs[packet] + best.tickNs[best.packetTick[packet]];
+            frameSumNs += frameNs;
+            worstNs = std::max(worstNs, frameNs);
+            totalNs += best.packetNs[packet];
+        }
+        for (double ns : best.tickNs) {
+            totalNs += ns;
+        }
+        result.values[0] = frames * 1e9 / totalNs;
+        result.values[1] = frameSumNs / frames;
+        result.values[2] = worstNs;
+        result.values[3] = best.writes / frames;
+        result.values[4] = best.pulses / frames;
+        return result;
+    }
+
+    bool saveBaseline(const char* path, const std::vector<Result>& results) {
+        FILE* file = fopen(path, "w");
+        if (file == nullptr) {
+            return false;
+        }
+        fprintf(file, "# bench_pipeline baseline: <stream> <metric> <value>. Times are from the machine it was saved on.\n");
+        for (const Result& result : results) {
+            fprintf(file, "%s frames %ld\n", result.stream.c_str(), result.frames);
+            for (int metric = 0; metric < METRIC_COUNT; metric++) {
+                fprintf(file, "%s %s %.3f\n", result.stream.c_str(), METRICS[metric].name, result.values[metric]);
+            }
+        }
+        fclose(file);
+        return true;
+    }
+
+    // Returns the number of regressions, or -1 if the baseline can't be read
+    int compareBaseline(const char* path, const std::vector<Result>& results, double tolerance, bool countsOnly) {
+        FILE* file = fopen(path, "r");
+        if (file == nullptr) {
+            return -1;
+        }
+
+        printf("\nAgainst %s (times within %.0f%%%s):\n", path, tolerance * 100, countsOnly ? ", not compared" : "");
+        int regressions = 0;
+        int compared = 0;
+        char line[256];
+        while (fgets(line, sizeof(line), file) != nullptr) {
+            char streamName[64];
+            char metricName[64];
+            double baseline;
+            if (line[0] == '#' || sscanf(line, "%63s %63s %lf", streamName, metricName, &baseline) != 3) {
+                continue;
+            }
+
+            const Result* result = nullptr;
+            for (const Result& candidate : results) {
+                result = candidate.stream == streamName ? &candidate : result;
+            }
+            if (result == nullptr) {
+                continue;
+            }
+
+            // A different number of frames is a different stream
+            if (strcmp(metricName, "frames") == 0) {
+                if (result->frames != static_cast<long>(baseline)) {
+                    printf("  %-8s frames %ld, baseline has %.0f\n", streamName, result->frames, baseline);
+                    regressions++;
+                }
+                continue;
+            }
+
+            for (int metric = 0; metric < METRIC_COUNT; metric++) {
+                const Metric& info = METRICS[metric];
+                if (strcmp(info.name, metricName) != 0 || (countsOnly && !info.isCount)) {
+                    continue;
+                }
+                double value = result->values[metric];
+                double change = baseline != 0 ? (value - baseline) / baseline : (value != 0 ? 1 : 0);
+                double worse = info.higherIsBetter ? -change : change;
+                bool regressed = worse > (info.isCount ? COUNT_TOLERANCE : tolerance);
+                bool improved = -worse > (info.isCount ? COUNT_TOLERANCE : tolerance);
+                printf("  %-8s %-17s %12.3f  baseline %12.3f  %+6.1f%%%s\n", streamName, metricName, value, baseline,
+                    change * 100, regressed ? "  REGRESSION" : improved ? "  improved" : "");
+                regressions += regressed;
+                compared++;
+            }
+        }
+        fclose(file);
+
+        if (compared == 0) {
+            printf("  nothing to compare\n");
+            return regressions + 1;
+        }
+        return regressions;
+    }
+}
+
+int main(int argc, char** argv) {
+    const char* capturePath = nullptr;
+    const char* baselinePath = nullptr;
+    const char* savePath = nullptr;
+    int passes = 20;
+    double tolerance = 0.25;
+    bool countsOnly = false;
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "--capture") == 0 && hasValue) {
+            capturePath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--passes") == 0 && hasValue) {
+            passes = std::max(1, atoi(argv[++i]));
+        }
+        else if (strcmp(argv[i], "--baseline") == 0 && hasValue) {
+            baselinePath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--save") == 0 && hasValue) {
+            savePath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--tolerance") == 0 && hasValue) {
+            tolerance = atof(argv[++i]) / 100.0;
+        }
+        else if (strcmp(argv[i], "--counts-only") == 0) {
+            countsOnly = true;
+        }
+        else {
+            fprintf(stderr, "Usage: %s [--capture <file>] [--passes <n>] [--baseline <file>] [--save <file>] "
+                "[--tolerance <percent>] [--counts-only]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    setupServos();
+
+    std::vector<Stream> streams;
+    if (capturePath != nullptr) {
+        Stream capture;
+        if (!loadCapture(capturePath, capture)) {
+            fprintf(stderr, "No records in %s\n", capturePath);
+            return 2;
+        }
+        streams.push_back(capture);
+    }
+    else {
+        for (int kind = 0; kind < 3; kind++) {
+            streams.push_back(makeStream(kind));
+        }
+    }
+
+    printf("DOF pipeline benchmark: best of %d passes, jitter delay %u ms, motion limits %s, control tick %d Hz\n",
+        passes, getDofJitterDelay(), isMotionLimiting() ? "on" : "off", CONTROL_RATE_HZ);
+    printf("  %-8s %7s %12s %10s %10s %14s %14s\n", "stream", "frames", "frames/s", "mean ns", "worst ns",
+        "writes/frame", "pulses/frame");
+
+    // The streams take turns, so a slow patch on the host is spread over them
+    std::vector<Pass> best(streams.size());
+    for (int pass = 0; pass < passes; pass++) {
+        for (size_t stream = 0; stream < streams.size(); stream++) {
+            if (pass == 0) {
+                best[stream] = playTimed(streams[stream]);
+            }
+            else {
+                keepBest(best[stream], playTimed(streams[stream]));
+            }
+        }
+    }
+
+    std::vector<Result> results;
+    for (size_t stream = 0; stream < streams.size(); stream++) {
+        Result result = summarize(streams[stream], best[stream]);
+        printf("  %-8s %7ld %12.0f %10.0f %10.0f %14.3f %14.3f\n", result.stream.c_str(), result.frames,
+            result.values[0], result.values[1], result.values[2], result.values[3], result.values[4]);
+        results.push_back(result);
+    }
+
+    if (savePath != nullptr && !saveBaseline(savePath, results)) {
+        fprintf(stderr, "Can't write %s\n", savePath);
+        return 2;
+    }
+    if (baselinePath != nullptr) {
+        int regressions = compareBaseline(baselinePath, results, tolerance, countsOnly);
+        if (regressions < 0) {
+            fprintf(stderr, "Can't read %s\n", baselinePath);
+            return 2;
+        }
+        printf("%d regression%s\n", regressions, regressions == 1 ? "" : "s");
+        return regressions > 0 ? 1 : 0;
+    }
+    return 0;
+}
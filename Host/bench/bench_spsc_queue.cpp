@@ -0,0 +1,92 @@
+// Cost of the SPSC queue. Times a push and a pop on one thread, for a word
+// and for a whole DofFrame, then a producer and consumer on two threads
+// passing frames through a queue the size of the jitter buffer, which is
+// what the two cores do. The cross thread figure includes the cache line
+// traffic between host cores, which the RP2040 doesn't have, and the
+// waiting side yields rather than spins, so on a host with fewer than two
+// free cores it measures the scheduler more than the queue.
+//
+// Usage: bench_spsc_queue [iterations]
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <chrono>
+#include <thread>
+
+#include "DofProtocol.h"
+#include "SpscQueue.h"
+
+namespace {
+
+    double elapsedNs(std::chrono::steady_clock::time_point start) {
+        return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count());
+    }
+
+    template <typename T>
+    void benchSameThread(const char* name, long iterations) {
+        static SpscQueue<T, 16> queue;
+        T value = {};
+        long checksum = 0;
+
+        auto start = std::chrono::steady_clock::now();
+        for (long i = 0; i < iterations; i++) {
+            queue.push(value);
+            queue.pop(value);
+            checksum += *reinterpret_cast<const uint8_t*>(&value);
+        }
+        double ns = elapsedNs(start);
+
+        printf("  %-24s %8.1f ns per push and pop (%ld)\n", name, ns / iterations, checksum);
+    }
+
+    void benchAcrossThreads(long iterations) {
+        static SpscQueue<DofFrame, 16> queue;
+        long fullSpins = 0;
+
+        auto start = std::chrono::steady_clock::now();
+        std::thread producer([&]() {
+            DofFrame frame = {};
+            for (long i = 0; i < iterations; i++) {
+                frame.sequence = static_cast<uint16_t>(i);
+                while (!queue.push(frame)) {
+                    fullSpins++;
+                    std::this_thread::yield();
+                }
+            }
+        });
+
+        DofFrame frame;
+        long received = 0;
+        long emptySpins = 0;
+        while (received < iterations) {
+            if (queue.pop(frame)) {
+                received++;
+            }
+            else {
+                emptySpins++;
+                std::this_thread::yield();
+            }
+        }
+        producer.join();
+        double ns = elapsedNs(start);
+
+        printf("  %-24s %8.1f ns per frame, %ld full and %ld empty spins\n", "DofFrame across threads",
+            ns / iterations, fullSpins, emptySpins);
+    }
+}
+
+int main(int argc, char** argv) {
+    long iterations = argc > 1 ? strtol(argv[1], nullptr, 10) : 10000000;
+    if (iterations <= 0) {
+        iterations = 10000000;
+    }
+
+    printf("SPSC queue benchmark: %ld iterations, DofFrame is %zu bytes\n", iterations, sizeof(DofFrame));
+    benchSameThread<uint32_t>("uint32_t", iterations);
+    benchSameThread<DofFrame>("DofFrame", iterations);
+    benchAcrossThreads(iterations / 10);
+
+    return 0;
+}
@@ -0,0 +1,202 @@
+// Simulation of the joint trajectory stage against the raw path.
+//
+// Plays a synthetic tracker stream into all 17 DOFs: smooth hand motion at
+// 30 frames/s with a little noise and the occasional 20 degree glitch, the
+// kind of jump MediaPipe produces when it briefly loses the hand. The control
+// tick runs at CONTROL_RATE_HZ. For the raw path (targets straight to the
+// servos) and the limited path (HandConfig.h motion limits) it reports how
+// far each one lags the clean motion, and the biggest single-tick jump a
+// joint is asked to make, which is what causes supply current spikes and
+// tendon snap.
+//
+// Usage: bench_trajectory [seconds]
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include "Hand.h"
+#include "Trajectory.h"
+
+namespace {
+
+    const int DOF_COUNT = 17;
+    const int STREAM_RATE_HZ = 30;
+    const int GLITCH_DEGREES = 20;
+
+    struct Dof {
+        int16_t min;
+        int16_t max;
+        MotionLimits limits;
+    };
+
+    std::vector<Dof> handDofs() {
+        std::vector<Dof> dofs;
+        for (int finger = 0; finger < NUM_FINGERS; finger++) {
+            dofs.push_back({ fingers[finger].getPitchMin(), fingers[finger].getPitchMax(), FINGER_MOTION.pitch });
+            dofs.push_back({ fingers[finger].getYawMin(), fingers[finger].getYawMax(), FINGER_MOTION.yaw });
+            dofs.push_back({ fingers[finger].getFlexionMin(), fingers[finger].getFlexionMax(), FINGER_MOTION.flexion });
+        }
+        dofs.push_back({ thumb.getPitchMin(), thumb.getPitchMax(), THUMB_MOTION.pitch });
+        dofs.push_back({ thumb.getYawMin(), thumb.getYawMax(), THUMB_MOTION.yaw });
+        dofs.push_back({ thumb.getFlexionMin(), thumb.getFlexionMax(), THUMB_MOTION.flexion });
+        dofs.push_back({ wrist.getPitchMin(), wrist.getPitchMax(), WRIST_MOTION.pitch });
+        dofs.push_back({ wrist.getYawMin(), wrist.getYawMax(), WRIST_MOTION.yaw });
+        return dofs;
+    }
+
+    // Deterministic generator so runs are comparable between builds
+    uint32_t gSeed = 0x2468ace1;
+    uint32_t nextRandom() {
+        gSeed = gSeed * 1664525u + 1013904223u;
+        return gSeed >> 8;
+    }
+
+    // Smooth motion for a DOF at a given time, sweeping most of its range
+    double cleanAngle(const Dof& dof, int index, double seconds) {
+        double center = (dof.min + dof.max) / 2.0;
+        double amplitude = (dof.max - dof.min) * 0.4;
+        double frequency = 0.3 + 0.05 * index;
+        return center + amplitude * sin(2.0 * M_PI * frequency * seconds + index);
+    }
+
+    struct PathStats {
+        double errorSum = 0;
+        double maxError = 0;
+        int maxStep = 0;
+        long bigSteps = 0;          // Steps larger than half a glitch
+        long samples = 0;
+
+        void add(double error, int step) {
+            errorSum += fabs(error);
+            maxError = std::max(maxError, fabs(error));
+            maxStep = std::max(maxStep, abs(step));
+            bigSteps += abs(step) > GLITCH_DEGREES / 2;
+            samples++;
+        }
+
+        void report(const char* name) const {
+            printf("  %-8s mean error %5.2f deg   max error %5.1f deg   max step %3d deg/tick   steps > %d deg: %ld\n",
+                name, errorSum / samples, maxError, maxStep, GLITCH_DEGREES / 2, bigSteps);
+        }
+    };
+
+    double elapsedNs(std::chrono::steady_clock::time_point start) {
+        return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count());
+    }
+}
+
+int main(int argc, char** argv) {
+    long seconds = argc > 1 ? strtol(argv[1], nullptr, 10) : 60;
+    if (seconds <= 0) {
+        seconds = 60;
+    }
+
+    setupServos();
+
+    std::vector<Dof> dofs = handDofs();
+    std::vector<Trajectory> trajectories;
+    for (const Dof& dof : dofs) {
+        trajectories.push_back(Trajectory(dof.limits));
+    }
+
+    std::vector<int16_t> target(DOF_COUNT, 0);
+    std::vector<int16_t> rawLast(DOF_COUNT, 0);
+    std::vector<int16_t> limitedLast(DOF_COUNT, 0);
+
+    PathStats raw;
+    PathStats limited;
+    PathStats limitedClean;     // Error of the limited path on frames without a glitch
+
+    const long ticks = seconds * CONTROL_RATE_HZ;
+    const int ticksPerFrame = CONTROL_RATE_HZ / STREAM_RATE_HZ;
+    long glitches = 0;
+
+    for (long tick = 0; tick < ticks; tick++) {
+        double now = static_cast<double>(tick) / CONTROL_RATE_HZ;
+
+        // A new frame from the tracker
+        if (tick % ticksPerFrame == 0) {
+            for (int dof = 0; dof < DOF_COUNT; dof++) {
+                double angle = cleanAngle(dofs[dof], dof, now) + static_cast<int>(nextRandom() % 5) - 2;
+                if (nextRandom() % 200 == 0) {
+                    angle += (nextRandom() & 1) ? GLITCH_DEGREES : -GLITCH_DEGREES;
+                    glitches++;
+                }
+                target[dof] = static_cast<int16_t>(std::max<double>(dofs[dof].min, std::min<double>(dofs[dof].max, angle)));
+                trajectories[dof].setTarget(target[dof]);
+
+                // Start from the first frame rather than from 0
+                if (tick == 0) {
+                    trajectories[dof].snapToTarget();
+                }
+            }
+        }
+
+        for (int dof = 0; dof < DOF_COUNT; dof++) {
+            trajectories[dof].tick();
+
+            double clean = cleanAngle(dofs[dof], dof, now);
+            int16_t rawPosition = target[dof];
+            int16_t limitedPosition = trajectories[dof].getPosition();
+
+            if (tick > 0) {
+                raw.add(rawPosition - clean, rawPosition - rawLast[dof]);
+                limited.add(limitedPosition - clean, limitedPosition - limitedLast[dof]);
+                if (abs(rawPosition - clean) < GLITCH_DEGREES / 2) {
+                    limitedClean.add(limitedPosition - clean, limitedPosition - limitedLast[dof]);
+                }
+            }
+            rawLast[dof] = rawPosition;
+            limitedLast[dof] = limitedPosition;
+        }
+    }
+
+    printf("Trajectory simulation: %ld s of %d Hz stream, %d Hz control tick, %ld glitches of %d deg\n",
+        seconds, STREAM_RATE_HZ, CONTROL_RATE_HZ, glitches, GLITCH_DEGREES);
+    printf("Tracking against the clean motion, over all %d DOFs:\n", DOF_COUNT);
+    raw.report("raw");
+    limited.report("limited");
+    printf("  limited path, away from glitches: mean error %5.2f deg (tracking lag)\n",
+        limitedClean.errorSum / limitedClean.samples);
+
+    // Cost of the whole hand's control tick with the limits on
+    setMotionLimiting(true);
+    const long costTicks = 200000;
+    double tickNs = 0;
+    for (long tick = 0; tick < costTicks; tick++) {
+        if (tick % ticksPerFrame == 0) {
+            for (int finger = 0; finger < NUM_FINGERS; finger++) {
+                fingers[finger].setPosition(static_cast<int16_t>(nextRandom() % 40), static_cast<int16_t>(nextRandom() % 40) - 20,
+                    static_cast<int16_t>(nextRandom() % 100));
+            }
+            thumb.setPosition(30 + static_cast<int16_t>(nextRandom() % 30), static_cast<int16_t>(nextRandom() % 45),
+                static_cast<int16_t>(nextRandom() % 45));
+            wrist.setPosition(static_cast<int16_t>(nextRandom() % 80) - 40, static_cast<int16_t>(nextRandom() % 80) - 40);
+        }
+        auto start = std::chrono::steady_clock::now();
+        tickHand();
+        tickNs += elapsedNs(start);
+    }
+    printf("tickHand() with all joints moving: %.1f ns/tick (%d DOFs)\n", tickNs / costTicks, DOF_COUNT);
+
+    // Trajectory steps on their own
+    Trajectory probe(FINGER_MOTION.flexion);
+    auto start = std::chrono::steady_clock::now();
+    long steps = 0;
+    for (long tick = 0; tick < costTicks * 10; tick++) {
+        if (probe.isSettled()) {
+            probe.setTarget(probe.getTarget() == 0 ? 100 : 0);
+        }
+        probe.tick();
+        steps++;
+    }
+    printf("Trajectory::tick(): %.1f ns/step\n", elapsedNs(start) / steps);
+
+    return 0;
+}
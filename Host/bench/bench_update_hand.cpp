@@ -0,0 +1,183 @@
+// Benchmark for the per-frame control path.
+//
+// Drives the real Finger/Thumb/Wrist/Mixer/ManagedServo code with a fixed sequence
+// of pseudo-random DOF frames and reports the host cost of updateHand() along
+// with the pulse widths each servo ends up with on the simulated PIO.
+//
+// Usage: bench_update_hand [iterations]
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <chrono>
+#include <vector>
+
+#include "Hand.h"
+#include "Mixer.h"
+#include "../reference/FixedKinematics.h"
+
+namespace {
+
+    const int DOF_COUNT = 17;
+    const int NUM_FRAMES = 1024;
+
+    struct Frame {
+        int16_t dof[DOF_COUNT];
+    };
+
+    // Deterministic generator so runs are comparable between builds
+    uint32_t gSeed = 0x12345678;
+    int16_t randomInRange(int16_t min, int16_t max) {
+        gSeed = gSeed * 1664525u + 1013904223u;
+        return static_cast<int16_t>(min + static_cast<int32_t>((gSeed >> 8) % static_cast<uint32_t>(max - min + 1)));
+    }
+
+    std::vector<Frame> makeFrames() {
+        std::vector<Frame> frames(NUM_FRAMES);
+        for (Frame& frame : frames) {
+            for (int finger = 0; finger < NUM_FINGERS; finger++) {
+                frame.dof[finger*3] = randomInRange(fingers[finger].getPitchMin(), fingers[finger].getPitchMax());
+                frame.dof[finger*3+1] = randomInRange(fingers[finger].getYawMin(), fingers[finger].getYawMax());
+                frame.dof[finger*3+2] = randomInRange(fingers[finger].getFlexionMin(), fingers[finger].getFlexionMax());
+            }
+            frame.dof[12] = randomInRange(thumb.getPitchMin(), thumb.getPitchMax());
+            frame.dof[13] = randomInRange(thumb.getYawMin(), thumb.getYawMax());
+            frame.dof[14] = randomInRange(thumb.getFlexionMin(), thumb.getFlexionMax());
+            frame.dof[15] = randomInRange(wrist.getPitchMin(), wrist.getPitchMax());
+            frame.dof[16] = randomInRange(wrist.getYawMin(), wrist.getYawMax());
+        }
+        return frames;
+    }
+
+    // Same order as dofHandler() in the sketch
+    void applyFrame(const Frame& frame) {
+        for (int i = 0; i < NUM_FINGERS; i++) {
+            fingers[i].setPitch(frame.dof[i*3]);
+            fingers[i].setYaw(frame.dof[i*3+1]);
+            fingers[i].setFlexion(frame.dof[i*3+2]);
+        }
+        thumb.setPitch(frame.dof[12]);
+        thumb.setYaw(frame.dof[13]);
+        thumb.setFlexion(frame.dof[14]);
+        wrist.setPitch(frame.dof[15]);
+        wrist.setYaw(frame.dof[16]);
+    }
+
+    double elapsedNs(std::chrono::steady_clock::time_point start) {
+        return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count());
+    }
+
+    void printServoTable(const char* title) {
+        printf("\n%s\n", title);
+        printf("  %-5s %-4s %-6s %-10s %-8s\n", "servo", "pin", "angle", "pulse(us)", "writes");
+        for (int index = 0; index < NUM_SERVOS; index++) {
+            int sm = hostsim::pioStateMachineForPin(managedServos[index].getServoPin());
+            if (sm < 0) {
+                printf("  %-5d %-4d unbound\n", index, managedServos[index].getServoPin());
+                continue;
+            }
+            const hostsim::PioStateMachine& machine = hostsim::pioStateMachine(sm);
+            printf("  %-5d %-4d %-6d %-10u %-8u\n", index, managedServos[index].getServoPin(),
+                managedServos[index].getServoPosition(), hostsim::pioPulseMicros(sm), machine.puts);
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    long iterations = argc > 1 ? strtol(argv[1], nullptr, 10) : 200000;
+    if (iterations <= 0) {
+        iterations = 200000;
+    }
+
+    setupServos();
+    setMotionLimiting(false);    // Servos follow the targets directly
+    setDefaultPose();
+
+    std::vector<Frame> frames = makeFrames();
+
+    // Warm up caches and branch predictors
+    for (int i = 0; i < NUM_FRAMES; i++) {
+        applyFrame(frames[i]);
+        updateHand();
+    }
+
+    // updateHand() on its own, with targets changing every call
+    uint32_t putsBefore = hostsim::pioTotalPuts();
+    double updateNs = 0;
+    for (long i = 0; i < iterations; i++) {
+        applyFrame(frames[i % NUM_FRAMES]);
+        auto start = std::chrono::steady_clock::now();
+        updateHand();
+        updateNs += elapsedNs(start);
+    }
+    uint32_t updatePuts = hostsim::pioTotalPuts() - putsBefore;
+
+    // The mixer on its own, and the same frames through the per-joint mixes
+    // in FixedKinematics.h, the reference the mixer is checked against
+    double mixNs = 0;
+    for (long i = 0; i < iterations; i++) {
+        applyFrame(frames[i % NUM_FRAMES]);
+        auto start = std::chrono::steady_clock::now();
+        ManagedServo::beginFrame();
+        mixHand(HAND_JOINTS_ALL);
+        ManagedServo::commitFrame();
+        mixNs += elapsedNs(start);
+    }
+
+    double jointsNs = 0;
+    for (long i = 0; i < iterations; i++) {
+        applyFrame(frames[i % NUM_FRAMES]);
+        auto start = std::chrono::steady_clock::now();
+        ManagedServo::beginFrame();
+        int32_t positions[NUM_SERVOS];
+        for (uint8_t joint = 0; joint <= JOINT_WRIST; joint++) {
+            reference::fixed::mixJoint(joint, positions);
+        }
+        for (int servo = 0; servo < NUM_SERVOS; servo++) {
+            managedServos[servo].setServoPosition(static_cast<uint8_t>(positions[servo]));
+        }
+        ManagedServo::commitFrame();
+        jointsNs += elapsedNs(start);
+    }
+
+    // The full frame as dofHandler applies it: setters plus updateHand()
+    auto start = std::chrono::steady_clock::now();
+    for (long i = 0; i < iterations; i++) {
+        applyFrame(frames[i % NUM_FRAMES]);
+        updateHand();
+    }
+    double frameNs = elapsedNs(start);
+
+    // Static hand - same targets every call
+    applyFrame(frames[0]);
+    updateHand();
+    uint32_t staticPutsBefore = hostsim::pioTotalPuts();
+    start = std::chrono::steady_clock::now();
+    for (long i = 0; i < iterations; i++) {
+        updateHand();
+    }
+    double staticNs = elapsedNs(start);
+    uint32_t staticPuts = hostsim::pioTotalPuts() - staticPutsBefore;
+
+    double writesPerUpdate = static_cast<double>(updatePuts) / iterations;
+
+    printf("DexHand host benchmark: %ld iterations, %d distinct frames\n", iterations, NUM_FRAMES);
+    printf("  updateHand()               %8.1f ns/call\n", updateNs / iterations);
+    printf("  mixHand()                  %8.1f ns/call\n", mixNs / iterations);
+    printf("  reference per-joint mixes  %8.1f ns/call\n", jointsNs / iterations);
+    printf("  setters + updateHand()     %8.1f ns/frame\n", frameNs / iterations);
+    printf("  updateHand(), static pose  %8.1f ns/call\n", staticNs / iterations);
+    printf("  servo writes per update    %8.2f\n", writesPerUpdate);
+    printf("  servo writes, static pose  %8.2f\n", static_cast<double>(staticPuts) / iterations);
+    printf("  updateHand() per servo     %8.1f ns/servo\n", updateNs / iterations / NUM_SERVOS);
+    printf("  driver writes issued       %8u\n", ManagedServo::getWritesIssued());
+    printf("  driver writes skipped      %8u\n", ManagedServo::getWritesSkipped());
+
+    printServoTable("Servo output after last frame:");
+
+    setDefaultPose();
+    printServoTable("Servo output at default pose:");
+
+    return 0;
+}
@@ -0,0 +1,152 @@
+#ifndef HOST_FIXED_KINEMATICS_H
+#define HOST_FIXED_KINEMATICS_H
+
+// The Q15 fixed point joint to servo mixing, as the Finger, Thumb and Wrist
+// classes did it before the table driven mixer in Mixer.cpp replaced it.
+// Kept as the readable reference for each mix, and for test_mixer, which
+// checks the mixer gives exactly the same positions. The arguments and
+// results are as in FloatKinematics.h, and mixJoint() runs them on the hand.
+
+#include <stdint.h>
+
+#include "FloatKinematics.h"
+#include "Hand.h"
+#include "MathUtils.h"
+
+namespace reference {
+namespace fixed {
+
+    inline LinearMap linearMap(Range in, Range out) {
+        LinearMap map;
+        map.setRange(in.min, in.max, out.min, out.max);
+        return map;
+    }
+
+    // The finger's two pitch servos both follow its pitch. The yaw is applied
+    // as a bias to the two targets, pulling the finger to the left or right,
+    // and is reduced as the finger flexes so it doesn't bend sideways as the
+    // fingers align into more of a fist. The bias is empirical, arrived at by
+    // tuning rather than calculated. Above 50% flexion both pitch servos get
+    // up to FINGER_FLEXION_PITCH_GAIN degrees more pitch.
+    //
+    // Finger: out = { left pitch, right pitch, flexion }
+    inline void finger(int32_t pitch, int32_t yaw, int32_t flexion,
+        Range pitchRange, Range yawRange, Range flexionRange, int32_t yawBias,
+        Range left, Range right, Range flex, int32_t out[3]) {
+
+        int32_t normalizedFlexion = linearMap(flexionRange, { 0, Q15_ONE }).map(flexion);
+        int32_t normalizedYaw = linearMap(yawRange, { 0, Q15_ONE }).map(yaw) - Q15_HALF;
+
+        // Split shift keeps the intermediate within 32 bits without dropping precision
+        int32_t scaledYaw = (((normalizedYaw * (Q15_ONE - normalizedFlexion)) >> 9) * yawBias) >> 6;
+
+        int32_t leftPitch = linearMap(pitchRange, left).map(pitch);
+        int32_t rightPitch = linearMap(pitchRange, right).map(pitch);
+
+        leftPitch = q15ToInt((leftPitch << Q15_SHIFT) + scaledYaw + MIX_ROUNDING);
+        rightPitch = q15ToInt((rightPitch << Q15_SHIFT) - scaledYaw + MIX_ROUNDING);
+
+        if (normalizedFlexion > Q15_HALF) {
+            int32_t flexionGain = ((normalizedFlexion - Q15_HALF) * FINGER_FLEXION_PITCH_GAIN + MIX_ROUNDING) >> Q15_SHIFT;
+            leftPitch += flexionGain;
+            rightPitch += flexionGain;
+        }
+
+        out[0] = REF_CLAMP(leftPitch, left.min, left.max);
+        out[1] = REF_CLAMP(rightPitch, right.min, right.max);
+        out[2] = linearMap(flexionRange, flex).map(flexion);
+    }
+
+    // The yaw from the MediaPipe tracker covers about 45 degrees. At around
+    // THUMB_YAW_CROSSOVER the thumb is roughly parallel with the index finger,
+    // and beyond it the thumb crosses over the palm. The upper (right pitch)
+    // servo follows the yaw up to the crossover, then backs off at twice the
+    // rate so the thumb can extend back out past the fingers. Not
+    // mathematically correct, but close to the fidelity of the tracker.
+    //
+    // Thumb: out = { left pitch, right pitch, flexion, roll }
+    inline void thumb(int32_t pitch, int32_t yaw, int32_t flexion, int32_t roll,
+        Range pitchRange, Range yawRange, Range flexionRange, Range rollRange,
+        Range left, Range right, Range flex, Range rollServo, int32_t out[4]) {
+
+        if (yaw >= THUMB_YAW_CROSSOVER) {
+            int32_t yawOver = yaw - THUMB_YAW_CROSSOVER;
+            yaw = REF_CLAMP(THUMB_YAW_CROSSOVER - 2*yawOver, yawRange.min, THUMB_YAW_CROSSOVER);
+        }
+
+        out[0] = linearMap(pitchRange, left).map(pitch);
+        out[1] = linearMap({ yawRange.min, THUMB_YAW_CROSSOVER }, right).map(yaw);
+        out[2] = linearMap(flexionRange, flex).map(flexion);
+        out[3] = linearMap(rollRange, rollServo).map(roll);
+    }
+
+    // The wrist's two differential servos moving with and against each other
+    // give its range of motion:
+    //
+    //   Left    Right   Result
+    //   MIN     MIN     Pitch centered, yaw to the left
+    //   MAX     MAX     Pitch centered, yaw to the right
+    //   MIN     MAX     Pitch to the back, yaw centered
+    //   MAX     MIN     Pitch to the front, yaw centered
+    //
+    // With the servos' orientation and cable windings, left = pitch + yaw and
+    // right = yaw - pitch, both over the span of the pitch range.
+    //
+    // Wrist: out = { left pitch, right pitch }
+    inline void wrist(int32_t pitch, int32_t yaw, Range pitchRange, Range left, Range right, int32_t out[2]) {
+        out[0] = linearMap(pitchRange, left).map(pitch + yaw);
+        out[1] = linearMap(pitchRange, right).map(yaw - pitch);
+    }
+
+    inline Range servoRange(int index) {
+        return { managedServos[index].getMinPosition(), managedServos[index].getMaxPosition() };
+    }
+
+    // The positions the joint's servos get from the hand's current angles,
+    // ranges and servo limits, by servo index. Other entries are left alone.
+    inline void mixJoint(uint8_t joint, int32_t positions[NUM_SERVOS]) {
+        if (joint < NUM_FINGERS) {
+            const Finger& angles = ::fingers[joint];
+            const FingerConfig& config = FINGER_CONFIG[joint];
+            int32_t out[3];
+            fixed::finger(angles.getPitchPosition(), angles.getYawPosition(), angles.getFlexionPosition(),
+                { angles.getPitchMin(), angles.getPitchMax() },
+                { angles.getYawMin(), angles.getYawMax() },
+                { angles.getFlexionMin(), angles.getFlexionMax() },
+                angles.getYawBias(),
+                servoRange(config.leftPitchServo), servoRange(config.rightPitchServo), servoRange(config.flexionServo),
+                out);
+            positions[config.leftPitchServo] = out[0];
+            positions[config.rightPitchServo] = out[1];
+            positions[config.flexionServo] = out[2];
+        }
+        else if (joint == JOINT_THUMB) {
+            int32_t out[4];
+            fixed::thumb(::thumb.getPitchPosition(), ::thumb.getYawPosition(), ::thumb.getFlexionPosition(),
+                ::thumb.getRollPosition(),
+                { ::thumb.getPitchMin(), ::thumb.getPitchMax() },
+                { ::thumb.getYawMin(), ::thumb.getYawMax() },
+                { ::thumb.getFlexionMin(), ::thumb.getFlexionMax() },
+                { ::thumb.getRollMin(), ::thumb.getRollMax() },
+                servoRange(THUMB_CONFIG.leftPitchServo), servoRange(THUMB_CONFIG.rightPitchServo),
+                servoRange(THUMB_CONFIG.flexionServo), servoRange(THUMB_CONFIG.rollServo),
+                out);
+            positions[THUMB_CONFIG.leftPitchServo] = out[0];
+            positions[THUMB_CONFIG.rightPitchServo] = out[1];
+            positions[THUMB_CONFIG.flexionServo] = out[2];
+            positions[THUMB_CONFIG.rollServo] = out[3];
+        }
+        else {
+            int32_t out[2];
+            fixed::wrist(::wrist.getPitchPosition(), ::wrist.getYawPosition(),
+                { ::wrist.getPitchMin(), ::wrist.getPitchMax() },
+                servoRange(WRIST_CONFIG.leftPitchServo), servoRange(WRIST_CONFIG.rightPitchServo),
+                out);
+            positions[WRIST_CONFIG.leftPitchServo] = out[0];
+            positions[WRIST_CONFIG.rightPitchServo] = out[1];
+        }
+    }
+}
+}
+
+#endif
@@ -0,0 +1,84 @@
+#ifndef HOST_FLOAT_KINEMATICS_H
+#define HOST_FLOAT_KINEMATICS_H
+
+// The original float implementation of the joint to servo mixing, kept as
+// a reference for equivalence tests and benchmarks. Each function returns
+// the servo positions the joint class would have requested.
+
+#include <stdint.h>
+
+#define REF_CLAMP(value, min, max) (value < min ? min : (value > max ? max : value))
+
+namespace reference {
+
+    struct Range {
+        int32_t min;
+        int32_t max;
+    };
+
+    inline float normalizedValue(int32_t value, int32_t min, int32_t max) {
+        float scaled = static_cast<float>(value - min) / static_cast<float>(max - min);
+        return REF_CLAMP(scaled, 0.0f, 1.0f);
+    }
+
+    inline int32_t mapInteger(int32_t value, int32_t inMin, int32_t inMax, int32_t outMin, int32_t outMax) {
+        float scaled = normalizedValue(value, inMin, inMax);
+        int32_t val = static_cast<int32_t>(scaled * (outMax - outMin) + outMin);
+        return REF_CLAMP(val, outMin, outMax);
+    }
+
+    // Finger: out = { left pitch, right pitch, flexion }
+    inline void finger(int32_t pitch, int32_t yaw, int32_t flexion,
+        Range pitchRange, Range yawRange, Range flexionRange, int32_t yawBias,
+        Range left, Range right, Range flex, int32_t out[3]) {
+
+        float normalizedFlexion = normalizedValue(flexion, flexionRange.min, flexionRange.max);
+        float normalizedYaw = normalizedValue(yaw, yawRange.min, yawRange.max) - 0.5f;
+        float scaledYaw = normalizedYaw * (1.0f - normalizedFlexion) * yawBias;
+
+        int32_t leftPitch = mapInteger(pitch, pitchRange.min, pitchRange.max, left.min, left.max);
+        int32_t rightPitch = mapInteger(pitch, pitchRange.min, pitchRange.max, right.min, right.max);
+
+        leftPitch = static_cast<int32_t>(leftPitch + scaledYaw);
+        rightPitch = static_cast<int32_t>(rightPitch - scaledYaw);
+
+        if (normalizedFlexion > 0.5f) {
+            int flexionGain = static_cast<int32_t>((normalizedFlexion - 0.5f) * 30.0f);
+            leftPitch += flexionGain;
+            rightPitch += flexionGain;
+        }
+
+        out[0] = REF_CLAMP(leftPitch, left.min, left.max);
+        out[1] = REF_CLAMP(rightPitch, right.min, right.max);
+        out[2] = mapInteger(flexion, flexionRange.min, flexionRange.max, flex.min, flex.max);
+    }
+
+    // Thumb: out = { left pitch, right pitch, flexion, roll }
+    inline void thumb(int32_t pitch, int32_t yaw, int32_t flexion, int32_t roll,
+        Range pitchRange, Range yawRange, Range flexionRange, Range rollRange,
+        Range left, Range right, Range flex, Range rollServo, int32_t out[4]) {
+
+        const int32_t yawThreshold = 30;
+        int32_t clamped;
+        if (yaw < yawThreshold) {
+            clamped = REF_CLAMP(yaw, yawRange.min, yawThreshold);
+        }
+        else {
+            int32_t yawOver = yaw - yawThreshold;
+            clamped = REF_CLAMP(yawThreshold - 2*yawOver, yawRange.min, yawThreshold);
+        }
+
+        out[0] = mapInteger(pitch, pitchRange.min, pitchRange.max, left.min, left.max);
+        out[1] = mapInteger(clamped, yawRange.min, yawThreshold, right.min, right.max);
+        out[2] = mapInteger(flexion, flexionRange.min, flexionRange.max, flex.min, flex.max);
+        out[3] = mapInteger(roll, rollRange.min, rollRange.max, rollServo.min, rollServo.max);
+    }
+
+    // Wrist: out = { left pitch, right pitch }
+    inline void wrist(int32_t pitch, int32_t yaw, Range pitchRange, Range left, Range right, int32_t out[2]) {
+        out[0] = mapInteger(pitch + yaw, pitchRange.min, pitchRange.max, left.min, left.max);
+        out[1] = mapInteger(yaw - pitch, pitchRange.min, pitchRange.max, right.min, right.max);
+    }
+}
+
+#endif
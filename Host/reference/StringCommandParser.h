@@ -0,0 +1,65 @@
+#ifndef HOST_STRING_COMMAND_PARSER_H
+#define HOST_STRING_COMMAND_PARSER_H
+
+// The original String based command parser from the sketch, kept as a
+// reference for the command parser benchmark. It splits the line the same
+// way processCommand() used to and walks the same chain of comparisons,
+// returning the position of the command in the chain rather than running it.
+
+#include <Arduino.h>
+
+namespace reference {
+
+    // In the order processCommand() used to compare them
+    const char* const STRING_COMMANDS[] = {
+        "set", "max", "min", "fingermax", "fingermin", "fingerextension", "wrist", "thumb",
+        "one", "two", "three", "four", "default", "count", "wave", "shaka", "thumbtest",
+        "fingertest", "hb", "gesture", "dofs", "motion", "streamstats", "jitter", "servostats"
+    };
+
+    const int STRING_COMMAND_COUNT = sizeof(STRING_COMMANDS) / sizeof(STRING_COMMANDS[0]);
+
+    // Returns the command's position, or -1 if it isn't one
+    inline int parseStringCommand(String cmd, String& arg, int& index, int& position) {
+
+        cmd.toLowerCase();
+
+        // Split the string
+        int colonPos = cmd.indexOf(':');
+        String cmdType;
+        String servoIndex;
+        String servoPosition;
+        index = 0;
+        position = 0;
+
+        if (colonPos != -1) {
+            cmdType = cmd.substring(0, colonPos);
+            cmd = cmd.substring(colonPos + 1);
+            colonPos = cmd.indexOf(':');
+            servoIndex = colonPos != -1 ? cmd.substring(0, colonPos) : cmd;
+
+            if (colonPos != -1) {
+                servoPosition = cmd.substring(colonPos + 1);
+                position = servoPosition.toInt();
+            }
+
+            // Convert to integers
+            index = servoIndex.toInt();
+        }
+        else {
+            // Single word command
+            cmdType = cmd;
+            cmdType.trim();
+        }
+        arg = servoIndex;
+
+        for (int i = 0; i < STRING_COMMAND_COUNT; i++) {
+            if (cmdType == STRING_COMMANDS[i]) {
+                return i;
+            }
+        }
+        return -1;
+    }
+}
+
+#endif
@@ -0,0 +1,229 @@
+#include <ctype.h>
+#include <stdio.h>
+
+#include <deque>
+
+#include "Arduino.h"
+
+
+HostSerial Serial;
+
+namespace {
+    uint64_t gMicros = 0;
+    bool gSerialEcho = false;
+    std::string gSerialOutput;
+    std::deque<char> gSerialInput;
+    int gDigitalInputs[NUM_DIGITAL_PINS];
+    bool gDigitalInputsInitialized = false;
+
+    void initDigitalInputs() {
+        if (!gDigitalInputsInitialized) {
+            for (int pin = 0; pin < NUM_DIGITAL_PINS; pin++) {
+                gDigitalInputs[pin] = HIGH;
+            }
+            gDigitalInputsInitialized = true;
+        }
+    }
+}
+
+
+// --- Arduino core -----------------------------
+
+long map(long x, long inMin, long inMax, long outMin, long outMax) {
+    return (x - inMin) * (outMax - outMin) / (inMax - inMin) + outMin;
+}
+
+void pinMode(uint8_t pin, int mode) {
+    (void)pin;
+    (void)mode;
+}
+
+void digitalWrite(uint8_t pin, int value) {
+    (void)pin;
+    (void)value;
+}
+
+int digitalRead(uint8_t pin) {
+    initDigitalInputs();
+    return pin < NUM_DIGITAL_PINS ? gDigitalInputs[pin] : LOW;
+}
+
+unsigned long millis() {
+    return static_cast<unsigned long>(gMicros / 1000);
+}
+
+unsigned long micros() {
+    return static_cast<unsigned long>(gMicros);
+}
+
+void delay(unsigned long ms) {
+    gMicros += static_cast<uint64_t>(ms) * 1000;
+}
+
+void delayMicroseconds(unsigned int us) {
+    gMicros += us;
+}
+
+
+// --- String -----------------------------------
+
+int String::indexOf(char c, unsigned int from) const {
+    size_t pos = mStr.find(c, from);
+    return pos == std::string::npos ? -1 : static_cast<int>(pos);
+}
+
+int String::indexOf(const char* str, unsigned int from) const {
+    size_t pos = mStr.find(str, from);
+    return pos == std::string::npos ? -1 : static_cast<int>(pos);
+}
+
+String String::substring(unsigned int begin) const {
+    return begin < mStr.length() ? String(mStr.substr(begin)) : String();
+}
+
+String String::substring(unsigned int begin, unsigned int end) const {
+    if (begin > end) {
+        unsigned int tmp = begin;
+        begin = end;
+        end = tmp;
+    }
+    if (begin >= mStr.length()) {
+        return String();
+    }
+    return String(mStr.substr(begin, end - begin));
+}
+
+long String::toInt() const {
+    return strtol(mStr.c_str(), nullptr, 10);
+}
+
+void String::toLowerCase() {
+    for (size_t i = 0; i < mStr.length(); i++) {
+        mStr[i] = static_cast<char>(tolower(static_cast<unsigned char>(mStr[i])));
+    }
+}
+
+void String::trim() {
+    size_t begin = mStr.find_first_not_of(" \t\r\n");
+    if (begin == std::string::npos) {
+        mStr.clear();
+        return;
+    }
+    size_t end = mStr.find_last_not_of(" \t\r\n");
+    mStr = mStr.substr(begin, end - begin + 1);
+}
+
+
+// --- Serial -----------------------------------
+
+int HostSerial::available() {
+    return static_cast<int>(gSerialInput.size());
+}
+
+int HostSerial::read() {
+    if (gSerialInput.empty()) {
+        return -1;
+    }
+    char c = gSerialInput.front();
+    gSerialInput.pop_front();
+    return static_cast<unsigned char>(c);
+}
+
+String HostSerial::readStringUntil(char terminator) {
+    std::string result;
+    while (!gSerialInput.empty()) {
+        char c = gSerialInput.front();
+        gSerialInput.pop_front();
+        if (c == terminator) {
+            break;
+        }
+        result += c;
+    }
+    return String(result);
+}
+
+size_t HostSerial::readBytesUntil(char terminator, char* buffer, size_t length) {
+    size_t count = 0;
+    while (count < length && !gSerialInput.empty()) {
+        char c = gSerialInput.front();
+        gSerialInput.pop_front();
+        if (c == terminator) {
+            break;
+        }
+        buffer[count++] = c;
+    }
+    return count;
+}
+
+size_t HostSerial::write(const uint8_t* data, size_t length) {
+    gSerialOutput.append(reinterpret_cast<const char*>(data), length);
+    if (gSerialEcho) {
+        fwrite(data, 1, length, stdout);
+    }
+    return length;
+}
+
+void HostSerial::print(const char* str) {
+    gSerialOutput += str;
+    if (gSerialEcho) {
+        fputs(str, stdout);
+    }
+}
+
+void HostSerial::print(char c) {
+    char str[2] = { c, 0 };
+    print(str);
+}
+
+void HostSerial::print(long value) {
+    print(std::to_string(value).c_str());
+}
+
+void HostSerial::print(unsigned long value) {
+    print(std::to_string(value).c_str());
+}
+
+void HostSerial::print(double value, int digits) {
+    char str[32];
+    snprintf(str, sizeof(str), "%.*f", digits, value);
+    print(str);
+}
+
+
+// --- Simulation hooks -------------------------
+
+namespace hostsim {
+
+    void setMicros(uint64_t us) {
+        gMicros = us;
+    }
+
+    void advanceMicros(uint64_t us) {
+        gMicros += us;
+    }
+
+    uint64_t nowMicros() {
+        return gMicros;
+    }
+
+    void setSerialEcho(bool echo) {
+        gSerialEcho = echo;
+    }
+
+    std::string& serialOutput() {
+        return gSerialOutput;
+    }
+
+    void serialInput(const char* text) {
+        while (*text) {
+            gSerialInput.push_back(*text++);
+        }
+    }
+
+    void setDigitalInput(uint8_t pin, int value) {
+        initDigitalInputs();
+        if (pin < NUM_DIGITAL_PINS) {
+            gDigitalInputs[pin] = value;
+        }
+    }
+}
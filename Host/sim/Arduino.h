@@ -0,0 +1,159 @@
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+/*
+Host Arduino Shim
+
+A minimal stand-in for the parts of the Arduino core that the hand
+kinematics touch, so that the sketch sources can be compiled and run on
+a Linux box. Only what the firmware actually uses is provided here -
+this is not a general purpose Arduino emulator.
+
+Time is virtual. millis()/micros() only move when delay() is called or
+when a test advances the clock through hostsim::advanceMicros(), which
+keeps tests deterministic. Serial output is captured into a buffer and
+can optionally be echoed to stdout.
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <string>
+
+typedef unsigned int uint;
+
+#define LOW     0
+#define HIGH    1
+
+#define INPUT           0
+#define OUTPUT          1
+#define INPUT_PULLUP    2
+
+#define NUM_DIGITAL_PINS    30
+
+#ifndef constrain
+#define constrain(amt,low,high) ((amt)<(low)?(low):((amt)>(high)?(high):(amt)))
+#endif
+
+long map(long x, long inMin, long inMax, long outMin, long outMax);
+
+void pinMode(uint8_t pin, int mode);
+void digitalWrite(uint8_t pin, int value);
+int digitalRead(uint8_t pin);
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+// There are no interrupts on the host
+inline void noInterrupts() {}
+inline void interrupts() {}
+
+
+// Arduino String, backed by std::string
+class String {
+    public:
+        String() {}
+        String(const char* str) : mStr(str ? str : "") {}
+        String(const std::string& str) : mStr(str) {}
+        explicit String(char c) : mStr(1, c) {}
+        explicit String(int value) : mStr(std::to_string(value)) {}
+        explicit String(unsigned int value) : mStr(std::to_string(value)) {}
+        explicit String(long value) : mStr(std::to_string(value)) {}
+        explicit String(unsigned long value) : mStr(std::to_string(value)) {}
+
+        inline const char* c_str() const { return mStr.c_str(); }
+        inline unsigned int length() const { return static_cast<unsigned int>(mStr.length()); }
+        inline char charAt(unsigned int index) const { return index < mStr.length() ? mStr[index] : 0; }
+        inline char operator[](unsigned int index) const { return charAt(index); }
+
+        inline String& operator+=(const String& rhs) { mStr += rhs.mStr; return *this; }
+        inline String& operator+=(const char* rhs) { mStr += rhs; return *this; }
+        inline String& operator+=(char rhs) { mStr += rhs; return *this; }
+        inline String& operator+=(int rhs) { mStr += std::to_string(rhs); return *this; }
+        inline String& operator+=(unsigned int rhs) { mStr += std::to_string(rhs); return *this; }
+        inline String& operator+=(long rhs) { mStr += std::to_string(rhs); return *this; }
+        inline String& operator+=(unsigned long rhs) { mStr += std::to_string(rhs); return *this; }
+
+        friend String operator+(const String& lhs, const String& rhs) { return String(lhs.mStr + rhs.mStr); }
+        friend String operator+(const char* lhs, const String& rhs) { return String(std::string(lhs) + rhs.mStr); }
+        friend String operator+(const String& lhs, const char* rhs) { return String(lhs.mStr + rhs); }
+
+        inline bool operator==(const String& rhs) const { return mStr == rhs.mStr; }
+        inline bool operator==(const char* rhs) const { return mStr == rhs; }
+        inline bool operator!=(const String& rhs) const { return mStr != rhs.mStr; }
+        inline bool operator!=(const char* rhs) const { return mStr != rhs; }
+
+        int indexOf(char c, unsigned int from = 0) const;
+        int indexOf(const char* str, unsigned int from = 0) const;
+        String substring(unsigned int begin) const;
+        String substring(unsigned int begin, unsigned int end) const;
+        long toInt() const;
+        void toLowerCase();
+        void trim();
+
+    private:
+        std::string mStr;
+};
+
+
+// Serial port - output is captured, input is injected by the test
+class HostSerial {
+    public:
+        void begin(unsigned long baud) { (void)baud; }
+        int available();
+        int read();
+        String readStringUntil(char terminator);
+        size_t readBytesUntil(char terminator, char* buffer, size_t length);
+        void flush() {}
+
+        size_t write(const uint8_t* data, size_t length);
+        size_t write(uint8_t value) { return write(&value, 1); }
+
+        void print(const char* str);
+        void print(const String& str) { print(str.c_str()); }
+        void print(char c);
+        void print(int value) { print(static_cast<long>(value)); }
+        void print(unsigned int value) { print(static_cast<unsigned long>(value)); }
+        void print(unsigned char value) { print(static_cast<unsigned long>(value)); }
+        void print(long value);
+        void print(unsigned long value);
+        void print(double value, int digits = 2);
+
+        template <typename T> void println(const T& value) { print(value); print("\r\n"); }
+        void println(double value, int digits) { print(value, digits); print("\r\n"); }
+        void println() { print("\r\n"); }
+
+        operator bool() const { return true; }
+};
+
+extern HostSerial Serial;
+
+
+// Clock conversion used by the PIO servo driver
+namespace RP2040 {
+    inline int usToPIOCycles(int us) { return us * 125; }   // 125MHz system clock
+}
+
+#include "pio_program.h"
+
+
+// Hooks for tests and benchmarks to drive the simulated board
+namespace hostsim {
+    void setMicros(uint64_t us);
+    void advanceMicros(uint64_t us);
+    uint64_t nowMicros();
+
+    void setSerialEcho(bool echo);
+    std::string& serialOutput();
+    void serialInput(const char* text);
+
+    void setDigitalInput(uint8_t pin, int value);
+}
+
+
+#endif
@@ -0,0 +1,69 @@
+#ifndef HOST_FILE_CALIBRATION_STORAGE_H
+#define HOST_FILE_CALIBRATION_STORAGE_H
+
+/*
+Stand-in for the calibration flash, for the host build. Each slot is a file
+of its own, <prefix>.<slot>, so tests can damage or delete one slot and see
+what a reboot makes of the other. A write can be made to fail part way, as
+if the power went during the erase and program.
+*/
+
+#include <stdio.h>
+
+#include <string>
+
+#include "CalibrationStorage.h"
+
+class FileCalibrationStorage : public CalibrationStorage {
+
+    public:
+        explicit FileCalibrationStorage(const std::string& prefix)
+        : mPrefix(prefix), mTornWrites(false) {
+        }
+
+        std::string getPath(uint8_t slot) const {
+            return mPrefix + "." + std::to_string(slot);
+        }
+
+        bool read(uint8_t slot, uint8_t* data, size_t length) override {
+            FILE* file = slot < CALIBRATION_SLOTS ? fopen(getPath(slot).c_str(), "rb") : nullptr;
+            if (file == nullptr) {
+                return false;
+            }
+            size_t got = fread(data, 1, length, file);
+            fclose(file);
+            return got == length;
+        }
+
+        bool write(uint8_t slot, const uint8_t* data, size_t length) override {
+            if (slot >= CALIBRATION_SLOTS || length > CALIBRATION_SLOT_SIZE) {
+                return false;
+            }
+            FILE* file = fopen(getPath(slot).c_str(), "wb");
+            if (file == nullptr) {
+                return false;
+            }
+
+            // A torn write leaves the first half, and reports nothing
+            size_t written = fwrite(data, 1, mTornWrites ? length / 2 : length, file);
+            fclose(file);
+            return mTornWrites || written == length;
+        }
+
+        // Drops both slots
+        void erase() {
+            for (uint8_t slot = 0; slot < CALIBRATION_SLOTS; slot++) {
+                remove(getPath(slot).c_str());
+            }
+        }
+
+        // Writes after this stop half way
+        inline void setTornWrites(bool torn) { mTornWrites = torn; }
+
+    private:
+        std::string mPrefix;
+        bool mTornWrites;
+};
+
+
+#endif
@@ -0,0 +1,90 @@
+#ifndef HOST_HARDWARE_PIO_H
+#define HOST_HARDWARE_PIO_H
+
+/*
+Simulated PIO
+
+Stand-in for the pico-sdk PIO API as used by RP2040_ISR_Servo. Rather than
+executing the servo program, every state machine records the words pushed
+into its TX FIFO so that tests and benchmarks can see exactly what the
+servo driver would have sent to the hardware.
+
+The first word pushed to a state machine is the refresh period, subsequent
+words are pulse widths. Both are in units of 3 PIO cycles, the same as the
+servo program expects. The simulated block has more state machines than
+the real RP2040 (which has 8) so that the full 18 servo table can be bound.
+*/
+
+#include <stdint.h>
+
+typedef unsigned int uint;
+
+typedef struct pio_hw {
+    int index;
+} pio_hw_t;
+
+typedef pio_hw_t* PIO;
+
+extern pio_hw_t host_pio0;
+#define pio0 (&host_pio0)
+
+typedef struct pio_program {
+    const uint16_t* instructions;
+    uint8_t length;
+    int8_t origin;
+} pio_program_t;
+
+enum pio_src_dest {
+    pio_pins = 0u,
+    pio_x = 1u,
+    pio_y = 2u,
+    pio_null = 3u,
+    pio_pindirs = 4u,
+    pio_exec_mov = 5u,
+    pio_status = 6u,
+    pio_pc = 7u,
+    pio_isr = 8u,
+    pio_osr = 9u,
+    pio_exec_out = 10u,
+};
+
+#define HOST_PIO_NUM_SM     32
+
+void pio_sm_set_enabled(PIO pio, uint sm, bool enabled);
+void pio_sm_clear_fifos(PIO pio, uint sm);
+void pio_sm_put_blocking(PIO pio, uint sm, uint32_t data);
+void pio_sm_exec(PIO pio, uint sm, uint instr);
+
+inline uint pio_encode_pull(bool ifEmpty, bool block) { return 0x8080u | (ifEmpty ? 0x40u : 0u) | (block ? 0x20u : 0u); }
+inline uint pio_encode_out(enum pio_src_dest dest, uint count) { return 0x6000u | ((dest & 7u) << 5) | (count & 0x1fu); }
+inline uint pio_encode_mov(enum pio_src_dest dest, enum pio_src_dest src) { return 0xa000u | ((dest & 7u) << 5) | (src & 7u); }
+
+
+namespace hostsim {
+
+    struct PioStateMachine {
+        bool claimed;
+        bool enabled;
+        int pin;                // GPIO bound by the servo program, -1 if none
+        uint32_t period;        // Refresh period word
+        uint32_t pulse;         // Most recent pulse width word
+        uint32_t puts;          // Words pushed, including the period
+        uint32_t clears;        // FIFO clears
+        uint64_t lastPutMicros; // Virtual time of the most recent push
+    };
+
+    void resetPio();
+    void pioBindPin(uint sm, uint pin);
+    int pioClaimStateMachine();
+
+    const PioStateMachine& pioStateMachine(uint sm);
+    int pioStateMachineForPin(uint pin);
+    uint16_t pioPulseMicros(uint sm);     // Pulse width decoded back into microseconds
+    uint32_t pioTotalPuts();
+
+    // Virtual time each blocking push takes, 0 by default. Lets tests see the
+    // spread a sequence of writes would have on the real bus.
+    void setPioPutMicros(uint32_t us);
+}
+
+#endif
@@ -0,0 +1,126 @@
+#include "Arduino.h"
+#include "hardware/pio.h"
+#include "pio_program.h"
+
+
+pio_hw_t host_pio0 = { 0 };
+
+namespace {
+    hostsim::PioStateMachine gStateMachines[HOST_PIO_NUM_SM];
+    uint32_t gPutMicros = 0;
+
+    struct PioInit {
+        PioInit() { hostsim::resetPio(); }
+    } gPioInit;
+}
+
+
+void pio_sm_set_enabled(PIO pio, uint sm, bool enabled) {
+    (void)pio;
+    if (sm < HOST_PIO_NUM_SM) {
+        gStateMachines[sm].enabled = enabled;
+    }
+}
+
+void pio_sm_clear_fifos(PIO pio, uint sm) {
+    (void)pio;
+    if (sm < HOST_PIO_NUM_SM) {
+        gStateMachines[sm].clears++;
+    }
+}
+
+void pio_sm_put_blocking(PIO pio, uint sm, uint32_t data) {
+    (void)pio;
+    if (sm >= HOST_PIO_NUM_SM) {
+        return;
+    }
+
+    hostsim::advanceMicros(gPutMicros);
+
+    hostsim::PioStateMachine& machine = gStateMachines[sm];
+    if (machine.puts == 0) {
+        machine.period = data;
+    }
+    else {
+        machine.pulse = data;
+    }
+    machine.puts++;
+    machine.lastPutMicros = hostsim::nowMicros();
+}
+
+void pio_sm_exec(PIO pio, uint sm, uint instr) {
+    (void)pio;
+    (void)sm;
+    (void)instr;
+}
+
+
+bool PIOProgram::prepare(PIO* pio, int* sm, int* offset) {
+    (void)mPgm;
+    int claimed = hostsim::pioClaimStateMachine();
+    if (claimed < 0) {
+        return false;
+    }
+    *pio = pio0;
+    *sm = claimed;
+    *offset = 0;
+    return true;
+}
+
+
+namespace hostsim {
+
+    void resetPio() {
+        for (int sm = 0; sm < HOST_PIO_NUM_SM; sm++) {
+            gStateMachines[sm] = PioStateMachine();
+            gStateMachines[sm].pin = -1;
+        }
+    }
+
+    void pioBindPin(uint sm, uint pin) {
+        if (sm < HOST_PIO_NUM_SM) {
+            gStateMachines[sm].pin = static_cast<int>(pin);
+        }
+    }
+
+    int pioClaimStateMachine() {
+        for (int sm = 0; sm < HOST_PIO_NUM_SM; sm++) {
+            if (!gStateMachines[sm].claimed) {
+                gStateMachines[sm].claimed = true;
+                return sm;
+            }
+        }
+        return -1;
+    }
+
+    const PioStateMachine& pioStateMachine(uint sm) {
+        return gStateMachines[sm < HOST_PIO_NUM_SM ? sm : 0];
+    }
+
+    int pioStateMachineForPin(uint pin) {
+        for (int sm = 0; sm < HOST_PIO_NUM_SM; sm++) {
+            if (gStateMachines[sm].claimed && gStateMachines[sm].pin == static_cast<int>(pin)) {
+                return sm;
+            }
+        }
+        return -1;
+    }
+
+    uint16_t pioPulseMicros(uint sm) {
+        // Inverse of RP2040::usToPIOCycles(us) / 3, rounded up to undo the truncation
+        uint32_t word = pioStateMachine(sm).pulse;
+        return static_cast<uint16_t>((word * 3 + 124) / 125);
+    }
+
+    uint32_t pioTotalPuts() {
+        uint32_t total = 0;
+        for (int sm = 0; sm < HOST_PIO_NUM_SM; sm++) {
+            total += gStateMachines[sm].puts;
+        }
+        return total;
+    }
+
+    void setPioPutMicros(uint32_t us) {
+        gPutMicros = us;
+    }
+}
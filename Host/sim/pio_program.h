@@ -0,0 +1,19 @@
+#ifndef HOST_PIO_PROGRAM_H
+#define HOST_PIO_PROGRAM_H
+
+// Simulated version of the arduino-pico PIOProgram helper, which loads a
+// program and claims a free state machine for it.
+
+#include "hardware/pio.h"
+
+class PIOProgram {
+    public:
+        PIOProgram(const pio_program_t* pgm) : mPgm(pgm) {}
+
+        bool prepare(PIO* pio, int* sm, int* offset);
+
+    private:
+        const pio_program_t* mPgm;
+};
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef HOST_SERVO_PIO_H
+#define HOST_SERVO_PIO_H
+
+// Simulated version of the servo program header generated by pioasm. The
+// instructions are never executed, binding the pin is all that matters here.
+
+#include "hardware/pio.h"
+
+static const uint16_t servo_program_instructions[] = { 0 };
+
+static const pio_program_t servo_program = {
+    servo_program_instructions,
+    1,
+    -1,
+};
+
+static inline void servo_program_init(PIO pio, uint sm, uint offset, uint pin) {
+    (void)pio;
+    (void)offset;
+    hostsim::pioBindPin(sm, pin);
+}
+
+#endif
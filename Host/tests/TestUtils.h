@@ -0,0 +1,37 @@
+#ifndef HOST_TEST_UTILS_H
+#define HOST_TEST_UTILS_H
+
+// Minimal check macros for the host tests. Each test is a plain executable
+// that returns non-zero if any check failed, which is all ctest needs.
+
+#include <stdio.h>
+
+namespace testutils {
+    inline int& failures() {
+        static int count = 0;
+        return count;
+    }
+}
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            printf("FAILED %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+            testutils::failures()++; \
+        } \
+    } while (0)
+
+#define CHECK_EQ(actual, expected) \
+    do { \
+        long long actualValue = static_cast<long long>(actual); \
+        long long expectedValue = static_cast<long long>(expected); \
+        if (actualValue != expectedValue) { \
+            printf("FAILED %s:%d: %s == %s (%lld vs %lld)\n", __FILE__, __LINE__, #actual, #expected, actualValue, expectedValue); \
+            testutils::failures()++; \
+        } \
+    } while (0)
+
+#define TEST_RESULT() \
+    (printf("%s\n", testutils::failures() == 0 ? "PASSED" : "FAILED"), testutils::failures() == 0 ? 0 : 1)
+
+#endif
@@ -0,0 +1,217 @@
+// Checks the joint arbiter: a source takes joints from lower priorities but
+// never from higher ones, leases run out and wrap with millis(), and in the
+// control tick a gesture holds its joints while the stream drives the rest,
+// a command keeps the stream off its joints until its lease is up, a
+// gesture that loses a joint stops, and a central that has gone lets go.
+
+#include <string.h>
+
+#include "DofStream.h"
+#include "Gestures.h"
+#include "Hand.h"
+#include "JointArbiter.h"
+#include "TestUtils.h"
+
+namespace {
+
+    const uint32_t TICK_US = 1000000 / CONTROL_RATE_HZ;
+
+    const int INDEX_FLEXION = 2;
+    const int WRIST_YAW = 16;
+
+    void tickUntil(uint32_t ms) {
+        while (millis() < ms) {
+            hostsim::advanceMicros(TICK_US);
+            controlTick();
+        }
+    }
+
+    void streamFrame(uint16_t sequence, int16_t indexFlexion, int16_t wristYaw) {
+        int16_t centidegrees[DOF_COUNT] = {};
+        centidegrees[INDEX_FLEXION] = static_cast<int16_t>(indexFlexion * 100);
+        centidegrees[WRIST_YAW] = static_cast<int16_t>(wristYaw * 100);
+        uint8_t packet[DOF_MAX_PACKET_LENGTH];
+        int length = encodeDofPacketV2(centidegrees, sequence, millis() * 1000u, packet);
+        CHECK_EQ(receiveDofPacket(packet, length), DOF_PACKET_OK);
+    }
+
+    void restart() {
+        gesturePlayer.stop();
+        gesturePlayer.setStreamMode(GESTURE_STREAM_PREEMPT);
+        restartDofStream();
+        resetArbiter();
+        setDefaultPose();
+        hostsim::setMicros(0);
+    }
+
+    void testPriorities() {
+        resetArbiter();
+        const uint8_t INDEX = HAND_JOINT_FINGER(FINGER_INDEX);
+        const uint8_t FINGERS = HAND_JOINT_FINGER(FINGER_INDEX) | HAND_JOINT_FINGER(FINGER_MIDDLE);
+
+        // Free joints go to anyone
+        CHECK_EQ(claimJoints(CONTROL_SOURCE_UART, INDEX, 1000), INDEX);
+        CHECK_EQ(getJointOwner(JOINT_INDEX, 1000), CONTROL_SOURCE_UART);
+        CHECK_EQ(getJointLeaseMs(JOINT_INDEX, 1000), ARBITER_UART_LEASE_MS);
+        CHECK_EQ(getJointOwner(JOINT_WRIST, 1000), CONTROL_SOURCES);
+
+        // Lower priorities get the rest, and can't take the index
+        uint32_t denied = getArbiterDenied(CONTROL_SOURCE_STREAM);
+        CHECK_EQ(claimJoints(CONTROL_SOURCE_STREAM, HAND_JOINTS_ALL, 1000), HAND_JOINTS_ALL & ~INDEX);
+        CHECK_EQ(claimJoints(CONTROL_SOURCE_GESTURE, FINGERS, 1010), FINGERS & ~INDEX);
+        CHECK_EQ(getArbiterDenied(CONTROL_SOURCE_STREAM) - denied, 1);
+        CHECK_EQ(getClaimableJoints(CONTROL_SOURCE_STREAM, HAND_JOINTS_ALL, 1010), HAND_JOINTS_ALL & ~FINGERS);
+
+        // A higher priority takes over, and a source renews its own lease
+        uint32_t takeovers = getArbiterTakeovers();
+        CHECK_EQ(claimJoints(CONTROL_SOURCE_SERIAL, INDEX | HAND_JOINT_WRIST, 1020), INDEX | HAND_JOINT_WRIST);
+        CHECK_EQ(getArbiterTakeovers() - takeovers, 2);
+        CHECK_EQ(getOwnedJoints(CONTROL_SOURCE_SERIAL, HAND_JOINTS_ALL, 1020), INDEX | HAND_JOINT_WRIST);
+        CHECK_EQ(getOwnedJoints(CONTROL_SOURCE_SERIAL, INDEX | HAND_JOINT_THUMB, 1020), INDEX);
+        CHECK_EQ(claimJoints(CONTROL_SOURCE_SERIAL, INDEX, 1500), INDEX);
+        CHECK_EQ(getJointLeaseMs(JOINT_INDEX, 1500), ARBITER_SERIAL_LEASE_MS);
+        CHECK_EQ(claimJoints(CONTROL_SOURCE_UART, INDEX, 1500), 0);
+
+        // Leases run out, and then anyone can have the joint
+        CHECK_EQ(getJointOwner(JOINT_THUMB, 1000 + ARBITER_STREAM_LEASE_MS - 1), CONTROL_SOURCE_STREAM);
+        CHECK_EQ(getJointOwner(JOINT_THUMB, 1000 + ARBITER_STREAM_LEASE_MS), CONTROL_SOURCES);
+        CHECK_EQ(claimJoints(CONTROL_SOURCE_STREAM, INDEX, 1500 + ARBITER_SERIAL_LEASE_MS), INDEX);
+
+        // Releasing only frees the source's own joints
+        releaseJoints(CONTROL_SOURCE_GESTURE, HAND_JOINTS_ALL);
+        CHECK_EQ(getJointOwner(JOINT_INDEX, 1500 + ARBITER_SERIAL_LEASE_MS), CONTROL_SOURCE_STREAM);
+        releaseJoints(CONTROL_SOURCE_STREAM, INDEX);
+        CHECK_EQ(getJointOwner(JOINT_INDEX, 1500 + ARBITER_SERIAL_LEASE_MS), CONTROL_SOURCES);
+
+        // Across millis() wrapping
+        resetArbiter();
+        uint32_t nearWrap = UINT32_MAX - 100;
+        CHECK_EQ(claimJoints(CONTROL_SOURCE_UART, INDEX, nearWrap), INDEX);
+        CHECK_EQ(claimJoints(CONTROL_SOURCE_STREAM, INDEX, nearWrap + 1000), 0);
+        CHECK_EQ(getJointLeaseMs(JOINT_INDEX, nearWrap + 1000), ARBITER_UART_LEASE_MS - 1000);
+        CHECK_EQ(claimJoints(CONTROL_SOURCE_STREAM, INDEX, nearWrap + ARBITER_UART_LEASE_MS), INDEX);
+
+        CHECK(strcmp(getControlSourceName(CONTROL_SOURCE_UART), "uart") == 0);
+        CHECK(strcmp(getControlSourceName(CONTROL_SOURCES), "none") == 0);
+    }
+
+    void testGestureHoldsWrist() {
+        // The wave has the wrist, the stream has the fingers
+        restart();
+        gesturePlayer.setStreamMode(GESTURE_STREAM_BLEND);
+        gesturePlayer.play(*findGesture("wave"), millis());
+        tickUntil(WAVE_SWEEP_MS / 4 - 10);
+        streamFrame(1, 50, 10);
+        tickUntil(WAVE_SWEEP_MS / 4);
+        CHECK(gesturePlayer.isPlaying());
+        CHECK_EQ(wrist.getYaw(), -20);
+        CHECK_EQ(fingers[FINGER_INDEX].getFlexion(), 50);
+        CHECK_EQ(getJointOwner(JOINT_WRIST, millis()), CONTROL_SOURCE_GESTURE);
+        CHECK_EQ(getJointOwner(JOINT_INDEX, millis()), CONTROL_SOURCE_STREAM);
+
+        // Once it's over the wrist is let go, and the stream has it
+        tickUntil(WAVE_MS);
+        CHECK(!gesturePlayer.isPlaying());
+        tickUntil(WAVE_MS + 5);
+        CHECK_EQ(getJointOwner(JOINT_WRIST, millis()), CONTROL_SOURCES);
+        streamFrame(2, 60, 10);
+        tickUntil(WAVE_MS + 15);
+        CHECK_EQ(wrist.getYaw(), 10);
+        CHECK_EQ(getJointOwner(JOINT_WRIST, millis()), CONTROL_SOURCE_STREAM);
+    }
+
+    void testCommandHoldsJoint() {
+        restart();
+        streamFrame(1, 20, 10);
+        tickUntil(10);
+        CHECK_EQ(fingers[FINGER_INDEX].getFlexion(), 20);
+
+        // A command from the central sets the index, and the stream leaves
+        // it alone while the lease runs
+        CHECK_EQ(claimJoints(CONTROL_SOURCE_UART, HAND_JOINT_FINGER(FINGER_INDEX), millis()), HAND_JOINT_FINGER(FINGER_INDEX));
+        fingers[FINGER_INDEX].setFlexion(70);
+        updateHandJoints(HAND_JOINT_FINGER(FINGER_INDEX));
+        uint32_t commandMs = millis();
+
+        uint16_t sequence = 2;
+        for (uint32_t ms = 40; ms < commandMs + ARBITER_UART_LEASE_MS - 40; ms += 33) {
+            tickUntil(ms);
+            streamFrame(sequence, 30, static_cast<int16_t>(sequence % 20));
+            sequence++;
+            tickUntil(ms + 10);
+            CHECK_EQ(fingers[FINGER_INDEX].getFlexion(), 70);
+            CHECK_EQ(wrist.getYaw(), (sequence - 1) % 20);
+        }
+
+        // Then the stream takes it back
+        tickUntil(commandMs + ARBITER_UART_LEASE_MS + 10);
+        streamFrame(sequence, 30, 0);
+        tickUntil(commandMs + ARBITER_UART_LEASE_MS + 20);
+        CHECK_EQ(fingers[FINGER_INDEX].getFlexion(), 30);
+        CHECK_EQ(getJointOwner(JOINT_INDEX, millis()), CONTROL_SOURCE_STREAM);
+    }
+
+    void testGestureLosesJoint() {
+        // A serial command on the wrist stops the wave, rather than the two
+        // taking turns
+        restart();
+        gesturePlayer.play(*findGesture("wave"), millis());
+        tickUntil(WAVE_SWEEP_MS / 4);
+        CHECK_EQ(wrist.getYaw(), -20);
+
+        CHECK_EQ(claimJoints(CONTROL_SOURCE_SERIAL, HAND_JOINT_WRIST, millis()), HAND_JOINT_WRIST);
+        wrist.setYaw(5);
+        updateHandJoints(HAND_JOINT_WRIST);
+        tickUntil(100);
+        CHECK(!gesturePlayer.isPlaying());
+        CHECK_EQ(wrist.getYaw(), 5);
+        CHECK_EQ(getJointOwner(JOINT_WRIST, millis()), CONTROL_SOURCE_SERIAL);
+
+        // And a gesture can't start on joints a command holds
+        CHECK_EQ(getClaimableJoints(CONTROL_SOURCE_GESTURE, findGesture("wave")->joints, millis()), 0);
+        CHECK_EQ(getClaimableJoints(CONTROL_SOURCE_GESTURE, findGesture("count")->joints, millis()), findGesture("count")->joints);
+    }
+
+    void testCentralGone() {
+        // What the sketch does when the central disconnects: its stream and
+        // its commands' leases go, and only the joints nobody else holds go
+        // back to the default pose, without being claimed
+        restart();
+        streamFrame(1, 60, 20);
+        tickUntil(10);
+        CHECK_EQ(claimJoints(CONTROL_SOURCE_UART, HAND_JOINT_FINGER(FINGER_MIDDLE), millis()), HAND_JOINT_FINGER(FINGER_MIDDLE));
+        CHECK_EQ(claimJoints(CONTROL_SOURCE_SERIAL, HAND_JOINT_THUMB, millis()), HAND_JOINT_THUMB);
+        thumb.setFlexion(40);
+        updateHandJoints(HAND_JOINT_THUMB);
+        uint8_t thumbPosition = managedServos[SERVO_THUMB_TIP].getServoPosition();
+        streamFrame(2, 70, 25);
+
+        dropDofStreamFrames();
+        releaseJoints(CONTROL_SOURCE_UART, HAND_JOINTS_ALL);
+        releaseJoints(CONTROL_SOURCE_STREAM, HAND_JOINTS_ALL);
+        setDefaultPose(getClaimableJoints(CONTROL_SOURCE_STREAM, HAND_JOINTS_ALL, millis()));
+        tickUntil(50);
+
+        CHECK_EQ(managedServos[SERVO_INDEX_LOWER].getServoPosition(), managedServos[SERVO_INDEX_LOWER].getDefaultPosition());
+        CHECK_EQ(managedServos[SERVO_WRIST_L].getServoPosition(), managedServos[SERVO_WRIST_L].getDefaultPosition());
+        CHECK_EQ(managedServos[SERVO_THUMB_TIP].getServoPosition(), thumbPosition);
+        CHECK(thumbPosition != managedServos[SERVO_THUMB_TIP].getDefaultPosition());
+        CHECK_EQ(getJointOwner(JOINT_MIDDLE, millis()), CONTROL_SOURCES);
+        CHECK_EQ(getJointOwner(JOINT_INDEX, millis()), CONTROL_SOURCES);
+        CHECK_EQ(getJointOwner(JOINT_THUMB, millis()), CONTROL_SOURCE_SERIAL);
+    }
+}
+
+int main() {
+    setupServos();
+    setMotionLimiting(false);    // Servos follow the targets directly
+    setDofJitterDelay(0);        // Frames are applied as they arrive
+
+    testPriorities();
+    testGestureHoldsWrist();
+    testCommandHoldsJoint();
+    testGestureLosesJoint();
+    testCentralGone();
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,221 @@
+// Checks the calibration store against the file backed stand-in for flash:
+// saved limits, ranges, rest positions and yaw biases come back on a reload,
+// saves alternate slots so a torn or damaged write falls back to the one
+// before, and blobs from another layout or with bad values are turned down
+// without touching the hand.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "Calibration.h"
+#include "DofRegistry.h"
+#include "FileCalibrationStorage.h"
+#include "Hand.h"
+#include "TestUtils.h"
+
+namespace {
+
+    FileCalibrationStorage storage("test_calibration_slot");
+
+    const int SERVO = 3;
+    const int DOF = 13;     // thumb_yaw
+
+    int16_t dofMin(int dof) {
+        int16_t min, max;
+        DOF_REGISTRY[dof].getRange(min, max);
+        return min;
+    }
+
+    int16_t dofMax(int dof) {
+        int16_t min, max;
+        DOF_REGISTRY[dof].getRange(min, max);
+        return max;
+    }
+
+    // Changes one of everything the calibration covers
+    void tune(uint8_t maxPosition, uint8_t rest, int16_t rangeMax, int16_t bias) {
+        managedServos[SERVO].setMaxPosition(maxPosition);
+        managedServos[SERVO].setDefaultPosition(rest);
+        DOF_REGISTRY[DOF].setRange(0, rangeMax);
+        fingers[FINGER_RING].setYawBias(bias);
+    }
+
+    bool isTuned(uint8_t maxPosition, uint8_t rest, int16_t rangeMax, int16_t bias) {
+        return managedServos[SERVO].getMaxPosition() == maxPosition && managedServos[SERVO].getDefaultPosition() == rest &&
+            dofMax(DOF) == rangeMax && fingers[FINGER_RING].getYawBias() == bias;
+    }
+
+    bool isDefault() {
+        return isTuned(SERVO_CONFIG[SERVO].maxPosition, SERVO_CONFIG[SERVO].defaultPosition, DOF_REGISTRY[DOF].max, FINGER_YAW_BIAS);
+    }
+
+    // Rewrites a slot with one byte changed
+    void damage(uint8_t slot, size_t offset) {
+        uint8_t blob[CALIBRATION_LENGTH];
+        CHECK(storage.read(slot, blob, sizeof(blob)));
+        blob[offset] ^= 0x55;
+        CHECK(storage.write(slot, blob, sizeof(blob)));
+    }
+
+    void testNothingSaved() {
+        storage.erase();
+        restoreDefaultCalibration();
+        CHECK_EQ(loadCalibration(storage), CALIBRATION_EMPTY);
+        CHECK_EQ(getCalibrationSlot(), -1);
+        CHECK(isDefault());
+    }
+
+    void testSaveAndLoad() {
+        storage.erase();
+        restoreDefaultCalibration();
+        tune(120, 40, 40, 50);
+        CHECK_EQ(saveCalibration(storage), CALIBRATION_OK);
+        CHECK_EQ(getCalibrationSlot(), 0);
+        CHECK_EQ(getCalibrationSequence(), 1);
+
+        // As after a reboot
+        restoreDefaultCalibration();
+        CHECK(isDefault());
+        CHECK_EQ(loadCalibration(storage), CALIBRATION_OK);
+        CHECK(isTuned(120, 40, 40, 50));
+        CHECK_EQ(dofMin(DOF), 0);
+
+        // The next save goes in the other slot, and is the one loaded
+        tune(110, 35, 30, 70);
+        CHECK_EQ(saveCalibration(storage), CALIBRATION_OK);
+        CHECK_EQ(getCalibrationSlot(), 1);
+        CHECK_EQ(getCalibrationSequence(), 2);
+        restoreDefaultCalibration();
+        CHECK_EQ(loadCalibration(storage), CALIBRATION_OK);
+        CHECK(isTuned(110, 35, 30, 70));
+        CHECK_EQ(getCalibrationSlot(), 1);
+
+        // The servos come up at the stored rest position
+        setDefaultPose();
+        CHECK_EQ(managedServos[SERVO].getServoPosition(), 35);
+    }
+
+    void testTornWrite() {
+        storage.erase();
+        restoreDefaultCalibration();
+        tune(120, 40, 40, 50);
+        CHECK_EQ(saveCalibration(storage), CALIBRATION_OK);
+
+        // The power goes half way through the next save
+        tune(110, 35, 30, 70);
+        storage.setTornWrites(true);
+        saveCalibration(storage);
+        storage.setTornWrites(false);
+
+        restoreDefaultCalibration();
+        CHECK_EQ(loadCalibration(storage), CALIBRATION_OK);
+        CHECK(isTuned(120, 40, 40, 50));
+        CHECK_EQ(getCalibrationSlot(), 0);
+
+        // And the save after that doesn't overwrite the good slot
+        CHECK_EQ(saveCalibration(storage), CALIBRATION_OK);
+        CHECK_EQ(getCalibrationSlot(), 1);
+    }
+
+    void testDamaged() {
+        storage.erase();
+        restoreDefaultCalibration();
+        tune(120, 40, 40, 50);
+        saveCalibration(storage);
+        tune(110, 35, 30, 70);
+        saveCalibration(storage);
+
+        // The newer slot fails its CRC, so the older one is used
+        damage(1, CALIBRATION_HEADER_LENGTH + 3);
+        restoreDefaultCalibration();
+        CHECK_EQ(loadCalibration(storage), CALIBRATION_OK);
+        CHECK(isTuned(120, 40, 40, 50));
+
+        // With both damaged, the hand keeps what it has
+        damage(0, CALIBRATION_LENGTH - 1);
+        restoreDefaultCalibration();
+        CHECK_EQ(loadCalibration(storage), CALIBRATION_BAD_CHECKSUM);
+        CHECK(isDefault());
+    }
+
+    void testBadFormat() {
+        restoreDefaultCalibration();
+        uint8_t blob[CALIBRATION_LENGTH];
+        CHECK_EQ(encodeCalibration(blob, 1), CALIBRATION_LENGTH);
+        CHECK_EQ(decodeCalibration(blob, sizeof(blob), false), CALIBRATION_OK);
+        CHECK_EQ(decodeCalibration(blob, sizeof(blob) - 1, false), CALIBRATION_EMPTY);
+
+        // Re-signs a blob after it's been changed
+        auto sign = [](uint8_t* data) {
+            uint16_t crc = crc16(data, CALIBRATION_LENGTH - 2);
+            data[CALIBRATION_LENGTH - 2] = static_cast<uint8_t>(crc);
+            data[CALIBRATION_LENGTH - 1] = static_cast<uint8_t>(crc >> 8);
+        };
+
+        // Another version, or a build with a different number of servos
+        uint8_t other[CALIBRATION_LENGTH];
+        memcpy(other, blob, sizeof(other));
+        other[2] = CALIBRATION_VERSION + 1;
+        sign(other);
+        CHECK_EQ(decodeCalibration(other, sizeof(other), true), CALIBRATION_BAD_FORMAT);
+        memcpy(other, blob, sizeof(other));
+        other[3] = NUM_SERVOS - 1;
+        sign(other);
+        CHECK_EQ(decodeCalibration(other, sizeof(other), true), CALIBRATION_BAD_FORMAT);
+
+        // A servo limit the servo wouldn't take, after other good values -
+        // none of which are applied
+        memcpy(other, blob, sizeof(other));
+        other[CALIBRATION_HEADER_LENGTH + 1] = 120;
+        other[CALIBRATION_HEADER_LENGTH + 3 * NUM_SERVOS - 2] = 180;
+        sign(other);
+        CHECK_EQ(decodeCalibration(other, sizeof(other), true), CALIBRATION_BAD_FORMAT);
+        CHECK_EQ(managedServos[0].getMaxPosition(), SERVO_CONFIG[0].maxPosition);
+
+        // An empty range
+        memcpy(other, blob, sizeof(other));
+        int range = CALIBRATION_HEADER_LENGTH + 3 * NUM_SERVOS + 4 * DOF;
+        other[range + 2] = other[range];
+        other[range + 3] = other[range + 1];
+        sign(other);
+        CHECK_EQ(decodeCalibration(other, sizeof(other), true), CALIBRATION_BAD_FORMAT);
+        CHECK(isDefault());
+    }
+
+    void testSequenceWrap() {
+        storage.erase();
+        restoreDefaultCalibration();
+
+        // Slot 1 has the sequence after slot 0's, across the wrap
+        uint8_t blob[CALIBRATION_LENGTH];
+        tune(120, 40, 40, 50);
+        encodeCalibration(blob, 0xFFFFFFFF);
+        storage.write(0, blob, sizeof(blob));
+        tune(110, 35, 30, 70);
+        encodeCalibration(blob, 0);
+        storage.write(1, blob, sizeof(blob));
+
+        restoreDefaultCalibration();
+        CHECK_EQ(loadCalibration(storage), CALIBRATION_OK);
+        CHECK(isTuned(110, 35, 30, 70));
+        CHECK_EQ(getCalibrationSequence(), 0);
+        CHECK_EQ(saveCalibration(storage), CALIBRATION_OK);
+        CHECK_EQ(getCalibrationSlot(), 0);
+        CHECK_EQ(getCalibrationSequence(), 1);
+    }
+}
+
+int main() {
+    setupServos();
+    setMotionLimiting(false);
+
+    testNothingSaved();
+    testSaveAndLoad();
+    testTornWrite();
+    testDamaged();
+    testBadFormat();
+    testSequenceWrap();
+
+    storage.erase();
+    return TEST_RESULT();
+}
@@ -0,0 +1,245 @@
+// Checks the command parser: splitting and number conversion the same way
+// the String parser did, lookup in the sorted table, line extraction from
+// BLE writes and serial reads, and that none of it touches the heap.
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <new>
+
+#include <Arduino.h>
+
+#include "CommandParser.h"
+#include "TestUtils.h"
+
+// Every heap allocation in the test goes through here
+static long gAllocations = 0;
+
+void* operator new(size_t size) {
+    gAllocations++;
+    void* block = malloc(size ? size : 1);
+    if (block == nullptr) {
+        throw std::bad_alloc();
+    }
+    return block;
+}
+
+void operator delete(void* block) noexcept {
+    free(block);
+}
+
+void operator delete(void* block, size_t) noexcept {
+    free(block);
+}
+
+namespace {
+
+    CommandArgs lastArgs;
+    const char* lastCommand = nullptr;
+    int calls = 0;
+
+    void record(const char* name, const CommandArgs& args) {
+        lastCommand = name;
+        lastArgs = args;
+        calls++;
+    }
+
+    void cmdFingerExtension(const CommandArgs& args) { record("fingerextension", args); }
+    void cmdHeartbeat(const CommandArgs& args) { record("hb", args); }
+    void cmdSet(const CommandArgs& args) { record("set", args); }
+    void cmdWrist(const CommandArgs& args) { record("wrist", args); }
+
+    constexpr Command COMMANDS[] = {
+        { "fingerextension", cmdFingerExtension },
+        { "hb", cmdHeartbeat },
+        { "set", cmdSet },
+        { "wrist", cmdWrist }
+    };
+
+    static_assert(CommandParser::isSorted(COMMANDS, sizeof(COMMANDS) / sizeof(COMMANDS[0])), "COMMANDS must be sorted by name");
+
+    constexpr CommandParser parser(COMMANDS, sizeof(COMMANDS) / sizeof(COMMANDS[0]));
+
+    CommandResult run(const char* text) {
+        char line[COMMAND_MAX_LENGTH + 1];
+        strncpy(line, text, sizeof(line) - 1);
+        line[sizeof(line) - 1] = '\0';
+        lastCommand = nullptr;
+        return parser.execute(line);
+    }
+
+    void testParse() {
+        char line[] = "Set:3:90";
+        CommandArgs args;
+        CHECK(CommandParser::parse(line, args));
+        CHECK(strcmp(args.name, "set") == 0);
+        CHECK(strcmp(args.arg, "3") == 0);
+        CHECK_EQ(args.index, 3);
+        CHECK_EQ(args.value, 90);
+        CHECK_EQ(args.count, 2);
+
+        // Text arguments, negative numbers, and anything past the second argument
+        char wrist[] = "WRIST:Pitch:-25:ignored";
+        CHECK(CommandParser::parse(wrist, args));
+        CHECK(strcmp(args.name, "wrist") == 0);
+        CHECK(args.argIs("pitch"));
+        CHECK_EQ(args.index, 0);
+        CHECK_EQ(args.value, -25);
+        CHECK_EQ(args.count, 2);
+
+        // Single words lose their line ending and surrounding spaces
+        char single[] = "  hb \r\n";
+        CHECK(CommandParser::parse(single, args));
+        CHECK(strcmp(args.name, "hb") == 0);
+        CHECK(args.argIs(""));
+        CHECK_EQ(args.count, 0);
+
+        // Numbers stop at the first non-digit, as String::toInt() does
+        char partial[] = "jitter:40ms";
+        CHECK(CommandParser::parse(partial, args));
+        CHECK_EQ(args.index, 40);
+        CHECK_EQ(args.count, 1);
+
+        char empty[] = " \r\n";
+        CHECK(!CommandParser::parse(empty, args));
+        char colon[] = ":1:2";
+        CHECK(!CommandParser::parse(colon, args));
+    }
+
+    void testDispatch() {
+        CHECK_EQ(run("set:12:45"), COMMAND_OK);
+        CHECK(lastCommand != nullptr && strcmp(lastCommand, "set") == 0);
+        CHECK_EQ(lastArgs.index, 12);
+        CHECK_EQ(lastArgs.value, 45);
+
+        CHECK_EQ(run("FingerExtension:4:100"), COMMAND_OK);
+        CHECK(lastCommand != nullptr && strcmp(lastCommand, "fingerextension") == 0);
+        CHECK_EQ(lastArgs.value, 100);
+
+        // Every entry can be found, and names either side of them can't
+        for (const Command& command : COMMANDS) {
+            CHECK(parser.find(command.name) == &command);
+        }
+        CHECK(parser.find("a") == nullptr);
+        CHECK(parser.find("se") == nullptr);
+        CHECK(parser.find("sets") == nullptr);
+        CHECK(parser.find("zzz") == nullptr);
+
+        int before = calls;
+        CHECK_EQ(run("bogus:1:2"), COMMAND_UNKNOWN);
+        CHECK_EQ(run(""), COMMAND_EMPTY);
+        CHECK_EQ(calls, before);
+        CHECK(lastCommand == nullptr);
+    }
+
+    void testSorted() {
+        const Command unsorted[] = { { "set", cmdSet }, { "hb", cmdHeartbeat } };
+        const Command duplicate[] = { { "hb", cmdHeartbeat }, { "hb", cmdHeartbeat } };
+        CHECK(!CommandParser::isSorted(unsorted, 2));
+        CHECK(!CommandParser::isSorted(duplicate, 2));
+        CHECK(CommandParser::isSorted(COMMANDS, 1));
+        CHECK(CommandParser::compare("hb", "hbx") < 0);
+    }
+
+    void testExtractLine() {
+        char line[COMMAND_MAX_LENGTH + 1];
+
+        // BLE writes aren't terminated, and may carry more after the newline
+        const char write[] = { 'h', 'b', '\n', 'x', 'y' };
+        CHECK(CommandParser::extractLine(reinterpret_cast<const uint8_t*>(write), sizeof(write), line));
+        CHECK(strcmp(line, "hb") == 0);
+
+        const char noNewline[] = { 'h', 'b' };
+        CHECK(!CommandParser::extractLine(reinterpret_cast<const uint8_t*>(noNewline), sizeof(noNewline), line));
+
+        char longest[COMMAND_MAX_LENGTH + 2];
+        memset(longest, 'a', sizeof(longest));
+        longest[COMMAND_MAX_LENGTH] = '\n';
+        CHECK(CommandParser::extractLine(reinterpret_cast<const uint8_t*>(longest), COMMAND_MAX_LENGTH + 1, line));
+        CHECK_EQ(strlen(line), COMMAND_MAX_LENGTH);
+        longest[COMMAND_MAX_LENGTH] = 'a';
+        longest[COMMAND_MAX_LENGTH + 1] = '\n';
+        CHECK(!CommandParser::extractLine(reinterpret_cast<const uint8_t*>(longest), sizeof(longest), line));
+    }
+
+    // Feeds the serial input to a reader as the sketch's serial task does,
+    // returning the next whole line or nullptr once it runs out
+    char* readSerialLine(CommandLineReader& reader) {
+        while (Serial.available()) {
+            if (reader.add(static_cast<char>(Serial.read()))) {
+                return reader.getLine();
+            }
+        }
+        return nullptr;
+    }
+
+    void testSerialRead() {
+        // Lines come off the serial port into a fixed buffer, as in the sketch
+        CommandLineReader reader;
+        hostsim::serialInput("wrist:yaw:30\nhb\n");
+        char* line = readSerialLine(reader);
+        CHECK(line != nullptr);
+        CHECK_EQ(parser.execute(line), COMMAND_OK);
+        CHECK(lastArgs.argIs("yaw"));
+        CHECK_EQ(lastArgs.value, 30);
+
+        line = readSerialLine(reader);
+        CHECK(line != nullptr && strcmp(line, "hb") == 0);
+        CHECK_EQ(Serial.available(), 0);
+
+        // Part of a line waits for the rest of it
+        hostsim::serialInput("wri");
+        CHECK(readSerialLine(reader) == nullptr);
+        hostsim::serialInput("st:pitch:10\n");
+        line = readSerialLine(reader);
+        CHECK(line != nullptr && strcmp(line, "wrist:pitch:10") == 0);
+
+        // A line that doesn't fit is dropped whole, and the next one is read as usual
+        char longest[COMMAND_MAX_LENGTH + 2];
+        memset(longest, 'a', COMMAND_MAX_LENGTH);
+        longest[COMMAND_MAX_LENGTH] = '\0';
+        hostsim::serialInput(longest);
+        hostsim::serialInput("\n");
+        line = readSerialLine(reader);
+        CHECK(line != nullptr);
+        CHECK_EQ(strlen(line), COMMAND_MAX_LENGTH);
+
+        longest[COMMAND_MAX_LENGTH] = 'a';
+        longest[COMMAND_MAX_LENGTH + 1] = '\0';
+        hostsim::serialInput(longest);
+        hostsim::serialInput("bc\nhb\n");
+        line = readSerialLine(reader);
+        CHECK(line != nullptr && strcmp(line, "hb") == 0);
+        CHECK_EQ(Serial.available(), 0);
+    }
+
+    void testNoAllocation() {
+        const char* lines[] = {
+            "set:3:90", "fingerextension:2:55", "WRIST:PITCH:-20", "hb", "nothing:here", "", "set"
+        };
+
+        long before = gAllocations;
+        for (int repeat = 0; repeat < 100; repeat++) {
+            for (const char* text : lines) {
+                run(text);
+            }
+            const uint8_t write[] = { 's', 'e', 't', ':', '1', ':', '2', '\n' };
+            char line[COMMAND_MAX_LENGTH + 1];
+            if (CommandParser::extractLine(write, sizeof(write), line)) {
+                parser.execute(line);
+            }
+        }
+        CHECK_EQ(gAllocations - before, 0);
+    }
+}
+
+int main() {
+    testParse();
+    testDispatch();
+    testSorted();
+    testExtractLine();
+    testSerialRead();
+    testNoAllocation();
+
+    return TEST_RESULT();
+}
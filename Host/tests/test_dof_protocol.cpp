@@ -0,0 +1,238 @@
+// Checks the DOF wire format: the CRC against its published check value,
+// round trips through every version, that corruption is caught, and the
+// lost and stale frame counting done on version 2 sequence numbers.
+
+#include <string.h>
+
+#include "DofProtocol.h"
+#include "DofStream.h"
+#include "Hand.h"
+#include "TestUtils.h"
+
+namespace {
+
+    void fillAngles(int16_t* angles, int16_t first, int16_t step) {
+        for (int i = 0; i < DOF_COUNT; i++) {
+            angles[i] = static_cast<int16_t>(first + i * step);
+        }
+    }
+
+    void testCrc() {
+        const char* check = "123456789";
+        CHECK_EQ(crc16(reinterpret_cast<const uint8_t*>(check), strlen(check)), 0x29B1);
+        CHECK_EQ(crc16(nullptr, 0), 0xFFFF);
+    }
+
+    void testV1RoundTrip() {
+        uint8_t packet[DOF_MAX_PACKET_LENGTH];
+        int16_t angles[DOF_COUNT];
+        DofFrame frame;
+
+        // 8-bit packing loses up to about 1.4 degrees each way
+        fillAngles(angles, -170, 20);
+        CHECK_EQ(encodeDofPacketV1(angles, packet), DOF_V1_PACKET_LENGTH);
+        CHECK_EQ(decodeDofPacket(packet, DOF_V1_PACKET_LENGTH, frame), DOF_PACKET_OK);
+        CHECK_EQ(frame.version, DOF_PROTOCOL_V1);
+        CHECK_EQ(frame.sequence, 0);
+        int worst = 0;
+        for (int i = 0; i < DOF_COUNT; i++) {
+            int error = dofAngleDegrees(frame.angles[i]) - angles[i];
+            error = error < 0 ? -error : error;
+            worst = error > worst ? error : worst;
+        }
+        CHECK(worst <= 2);
+
+        packet[4] ^= 0x10;
+        CHECK_EQ(decodeDofPacket(packet, DOF_V1_PACKET_LENGTH, frame), DOF_PACKET_BAD_CHECKSUM);
+    }
+
+    void testV2RoundTrip() {
+        uint8_t packet[DOF_MAX_PACKET_LENGTH];
+        int16_t centidegrees[DOF_COUNT];
+        DofFrame frame;
+
+        fillAngles(centidegrees, -8000, 1003);
+        centidegrees[0] = 4549;
+        centidegrees[1] = 4550;
+        centidegrees[2] = -4550;
+        centidegrees[3] = -4549;
+
+        CHECK_EQ(encodeDofPacketV2(centidegrees, 0xBEEF, 0x12345678, packet), DOF_V2_PACKET_LENGTH);
+        CHECK_EQ(DOF_V2_PACKET_LENGTH, 44);
+        CHECK_EQ(packet[0], DOF_PROTOCOL_V2);
+        CHECK_EQ(packet[2], 0xEF);      // Little endian
+        CHECK_EQ(packet[4], 0x78);
+
+        CHECK_EQ(decodeDofPacket(packet, DOF_V2_PACKET_LENGTH, frame), DOF_PACKET_OK);
+        CHECK_EQ(frame.version, DOF_PROTOCOL_V2);
+        CHECK_EQ(frame.sequence, 0xBEEF);
+        CHECK_EQ(frame.timestamp, 0x12345678);
+        for (int i = 0; i < DOF_COUNT; i++) {
+            CHECK_EQ(frame.angles[i], centidegrees[i]);
+        }
+
+        // The frame keeps the hundredths, and they're only rounded to the
+        // joints' whole degrees as it's applied
+        CHECK_EQ(dofAngleDegrees(frame.angles[0]), 45);
+        CHECK_EQ(dofAngleDegrees(frame.angles[1]), 46);
+        CHECK_EQ(dofAngleDegrees(frame.angles[2]), -46);     // Away from zero
+        CHECK_EQ(dofAngleDegrees(frame.angles[3]), -45);
+    }
+
+    void testV2Corruption() {
+        uint8_t packet[DOF_MAX_PACKET_LENGTH];
+        int16_t centidegrees[DOF_COUNT];
+        DofFrame frame;
+        fillAngles(centidegrees, 100, 250);
+        encodeDofPacketV2(centidegrees, 7, 1000, packet);
+
+        // Every single bit flip is caught
+        int missed = 0;
+        for (int byte = 0; byte < DOF_V2_PACKET_LENGTH; byte++) {
+            for (int bit = 0; bit < 8; bit++) {
+                packet[byte] ^= static_cast<uint8_t>(1 << bit);
+                missed += decodeDofPacket(packet, DOF_V2_PACKET_LENGTH, frame) == DOF_PACKET_OK;
+                packet[byte] ^= static_cast<uint8_t>(1 << bit);
+            }
+        }
+        CHECK_EQ(missed, 0);
+
+        // Swapped bytes keep an additive checksum but not the CRC
+        uint8_t swapped[DOF_MAX_PACKET_LENGTH];
+        memcpy(swapped, packet, DOF_V2_PACKET_LENGTH);
+        uint8_t first = swapped[DOF_V2_HEADER_LENGTH];
+        swapped[DOF_V2_HEADER_LENGTH] = swapped[DOF_V2_HEADER_LENGTH + 1];
+        swapped[DOF_V2_HEADER_LENGTH + 1] = first;
+        CHECK_EQ(decodeDofPacket(swapped, DOF_V2_PACKET_LENGTH, frame), DOF_PACKET_BAD_CHECKSUM);
+
+        // Unknown versions and DOF counts are rejected before the CRC
+        packet[0] = DOF_PROTOCOL_DELTA + 1;
+        CHECK_EQ(decodeDofPacket(packet, DOF_V2_PACKET_LENGTH, frame), DOF_PACKET_BAD_VERSION);
+        packet[0] = DOF_PROTOCOL_V2;
+        packet[1] = DOF_COUNT - 1;
+        CHECK_EQ(decodeDofPacket(packet, DOF_V2_PACKET_LENGTH, frame), DOF_PACKET_BAD_VERSION);
+
+        CHECK_EQ(decodeDofPacket(packet, DOF_V2_PACKET_LENGTH - 1, frame), DOF_PACKET_BAD_LENGTH);
+    }
+
+    void testDeltaRoundTrip() {
+        uint8_t packet[DOF_MAX_PACKET_LENGTH];
+        int16_t previous[DOF_COUNT];
+        int16_t centidegrees[DOF_COUNT];
+        DofFrame frame = {};
+
+        fillAngles(previous, 0, 100);
+        fillAngles(centidegrees, 0, 100);
+        centidegrees[0] += 50;          // Inside the deadband
+        centidegrees[2] += 250;
+        centidegrees[16] -= 1000;
+
+        uint32_t mask = dofChangedMask(previous, centidegrees, 100);
+        CHECK_EQ(mask, (1ul << 2) | (1ul << 16));
+        CHECK_EQ(dofMaskCount(mask), 2);
+        CHECK_EQ(dofMaskCount(DOF_ALL_MASK), DOF_COUNT);
+
+        int length = encodeDofPacketDelta(centidegrees, mask, 9, 500, packet);
+        CHECK_EQ(length, DOF_DELTA_PACKET_LENGTH(2));
+        CHECK_EQ(length, 17);
+        CHECK_EQ(decodeDofPacket(packet, length, frame), DOF_PACKET_OK);
+        CHECK_EQ(frame.version, DOF_PROTOCOL_DELTA);
+        CHECK_EQ(frame.mask, mask);
+        CHECK_EQ(frame.sequence, 9);
+        CHECK_EQ(frame.angles[2], 450);
+        CHECK_EQ(frame.angles[16], 600);
+        CHECK_EQ(frame.angles[0], 0);       // Not in the frame, left alone
+
+        // An empty delta is valid, and a full one is the largest packet
+        CHECK_EQ(encodeDofPacketDelta(centidegrees, 0, 10, 600, packet), DOF_DELTA_PACKET_LENGTH(0));
+        CHECK_EQ(decodeDofPacket(packet, DOF_DELTA_PACKET_LENGTH(0), frame), DOF_PACKET_OK);
+        CHECK_EQ(encodeDofPacketDelta(centidegrees, DOF_ALL_MASK, 11, 700, packet), DOF_MAX_PACKET_LENGTH);
+        CHECK_EQ(decodeDofPacket(packet, DOF_MAX_PACKET_LENGTH, frame), DOF_PACKET_OK);
+        CHECK_EQ(frame.angles[0], 50);
+
+        // The length has to match the mask, and the mask can't name DOFs we don't have
+        length = encodeDofPacketDelta(centidegrees, mask, 12, 800, packet);
+        CHECK_EQ(decodeDofPacket(packet, length + 2, frame), DOF_PACKET_BAD_LENGTH);
+        packet[DOF_V2_HEADER_LENGTH + 2] |= 0x80;
+        CHECK_EQ(decodeDofPacket(packet, length, frame), DOF_PACKET_BAD_VERSION);
+        packet[DOF_V2_HEADER_LENGTH + 2] &= 0x7F;
+        packet[DOF_DELTA_HEADER_LENGTH] ^= 0x01;
+        CHECK_EQ(decodeDofPacket(packet, length, frame), DOF_PACKET_BAD_CHECKSUM);
+    }
+
+    DofPacketResult receiveSequence(uint16_t sequence) {
+        uint8_t packet[DOF_MAX_PACKET_LENGTH];
+        int16_t centidegrees[DOF_COUNT];
+        fillAngles(centidegrees, 0, 0);
+        centidegrees[16] = static_cast<int16_t>(sequence % 30 * 100);
+        int length = encodeDofPacketV2(centidegrees, sequence, sequence * 10000u, packet);
+        return receiveDofPacket(packet, length);
+    }
+
+    void testSequenceTracking() {
+        resetDofStreamCounters();
+        restartDofStream();
+        DofFrame frame;
+
+        // In order, then two frames missing
+        CHECK_EQ(receiveSequence(10), DOF_PACKET_OK);
+        CHECK_EQ(receiveSequence(11), DOF_PACKET_OK);
+        CHECK_EQ(receiveSequence(14), DOF_PACKET_OK);
+        CHECK_EQ(getDofFramesLost(), 2);
+
+        // A late frame and a duplicate are dropped, and the newest stays in the mailbox
+        CHECK_EQ(receiveSequence(12), DOF_PACKET_OK);
+        CHECK_EQ(receiveSequence(14), DOF_PACKET_OK);
+        CHECK_EQ(getDofFramesStale(), 2);
+        CHECK(dofMailbox.take(frame));
+        CHECK_EQ(frame.sequence, 14);
+        CHECK_EQ(dofMailbox.getCoalesced(), 2);
+
+        // Wrapping around is not a gap
+        resetDofStreamCounters();
+        restartDofStream();
+        CHECK_EQ(receiveSequence(0xFFFE), DOF_PACKET_OK);
+        CHECK_EQ(receiveSequence(0xFFFF), DOF_PACKET_OK);
+        CHECK_EQ(receiveSequence(0), DOF_PACKET_OK);
+        CHECK_EQ(receiveSequence(1), DOF_PACKET_OK);
+        CHECK_EQ(getDofFramesLost(), 0);
+        CHECK_EQ(getDofFramesStale(), 0);
+
+        // A sender that restarts from 0 is followed rather than ignored
+        CHECK_EQ(receiveSequence(5000), DOF_PACKET_OK);
+        CHECK_EQ(receiveSequence(0), DOF_PACKET_OK);
+        CHECK_EQ(receiveSequence(1), DOF_PACKET_OK);
+        CHECK_EQ(getDofFramesStale(), 0);
+        CHECK(dofMailbox.take(frame));
+        CHECK_EQ(frame.sequence, 1);
+
+        // Version 1 frames carry no sequence and are never counted as stale
+        int16_t angles[DOF_COUNT];
+        uint8_t packet[DOF_MAX_PACKET_LENGTH];
+        fillAngles(angles, 0, 0);
+        encodeDofPacketV1(angles, packet);
+        CHECK_EQ(receiveDofPacket(packet, DOF_V1_PACKET_LENGTH), DOF_PACKET_OK);
+        CHECK_EQ(receiveDofPacket(packet, DOF_V1_PACKET_LENGTH), DOF_PACKET_OK);
+        CHECK_EQ(getDofFramesStale(), 0);
+
+        packet[0] = DOF_PROTOCOL_DELTA + 1;
+        packet[1] = DOF_COUNT;
+        CHECK_EQ(receiveDofPacket(packet, DOF_V2_PACKET_LENGTH), DOF_PACKET_BAD_VERSION);
+        CHECK_EQ(getDofPacketsBadVersion(), 1);
+    }
+}
+
+int main() {
+    setupServos();
+    setMotionLimiting(false);    // Servos follow the targets directly
+    setDofJitterDelay(0);        // Frames are applied as they arrive
+
+    testCrc();
+    testV1RoundTrip();
+    testV2RoundTrip();
+    testV2Corruption();
+    testDeltaRoundTrip();
+    testSequenceTracking();
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,290 @@
+// Checks the DOF recorder: packets are captured with their arrival times and
+// the oldest make way once the ring is full, a dump prints every record in a
+// form that parses back, and a replay feeds the packets through the stream
+// at their original spacing, or faster, while the live stream is held back.
+
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+
+#include "DofRecorder.h"
+#include "DofRegistry.h"
+#include "DofStream.h"
+#include "Hand.h"
+#include "TestUtils.h"
+
+namespace {
+
+    const uint32_t FRAME_US = 33000;
+
+    // A version 2 packet with the first DOF at the given angle
+    int makePacket(uint16_t sequence, int16_t degrees, uint8_t* packet) {
+        int16_t centidegrees[DOF_COUNT] = {};
+        centidegrees[0] = degrees * DOF_V2_ANGLE_SCALE;
+        return encodeDofPacketV2(centidegrees, sequence, sequence * FRAME_US, packet);
+    }
+
+    // Records a packet as the BLE handler would, at the given time
+    void arrive(uint32_t timeUs, uint16_t sequence, int16_t degrees) {
+        uint8_t packet[DOF_MAX_PACKET_LENGTH];
+        int length = makePacket(sequence, degrees, packet);
+        hostsim::setMicros(timeUs);
+        if (recordDofPacket(packet, length)) {
+            receiveDofPacket(packet, length);
+        }
+    }
+
+    // Takes up the request, then runs the recorder every 1ms until it's done
+    void runUntilIdle() {
+        runDofRecorder();
+        for (int run = 0; run < 100000 && getDofRecorderActivity() != DOF_RECORDER_IDLE; run++) {
+            hostsim::advanceMicros(1000);
+            runDofRecorder();
+        }
+    }
+
+    void clear() {
+        requestDofRecordingClear();
+        runDofRecorder();
+        setDofRecording(true);
+    }
+
+    void testFormat() {
+        uint8_t packet[DOF_MAX_PACKET_LENGTH];
+        int length = makePacket(7, 30, packet);
+
+        char line[DOF_RECORD_LINE_LENGTH + 1];
+        size_t lineLength = formatDofRecord(4000000123u, packet, static_cast<uint8_t>(length), line, sizeof(line));
+        CHECK_EQ(lineLength, strlen(line));
+        CHECK(strncmp(line, "REC:4000000123 ", 15) == 0);
+        CHECK_EQ(lineLength, 15 + 2 * length);
+
+        // Back again, with a line ending as a capture would have
+        std::string captured = std::string(line) + "\r\n";
+        uint32_t timeUs;
+        uint8_t parsed[DOF_MAX_PACKET_LENGTH];
+        uint8_t parsedLength;
+        CHECK(parseDofRecord(captured.c_str(), timeUs, parsed, parsedLength));
+        CHECK_EQ(timeUs, 4000000123u);
+        CHECK_EQ(parsedLength, length);
+        CHECK(memcmp(parsed, packet, length) == 0);
+
+        // The longest packet fits a line
+        uint8_t longest[DOF_MAX_PACKET_LENGTH];
+        memset(longest, 0xAB, sizeof(longest));
+        CHECK_EQ(formatDofRecord(UINT32_MAX, longest, DOF_MAX_PACKET_LENGTH, line, sizeof(line)), DOF_RECORD_LINE_LENGTH);
+
+        // Anything else in a capture is skipped
+        CHECK(!parseDofRecord("REC:begin records:3 span:66000us", timeUs, parsed, parsedLength));
+        CHECK(!parseDofRecord("LOG:1000 I command: CMD:record:0:0", timeUs, parsed, parsedLength));
+        CHECK(!parseDofRecord("REC:1000 0a0", timeUs, parsed, parsedLength));
+        CHECK(!parseDofRecord("REC:1000 0g", timeUs, parsed, parsedLength));
+        CHECK(parseDofRecord("REC:1000 ", timeUs, parsed, parsedLength));
+        CHECK_EQ(parsedLength, 0);
+    }
+
+    void testRecording() {
+        clear();
+        uint32_t recorded = getDofRecordsRecorded();
+        for (int frame = 0; frame < 10; frame++) {
+            arrive(1000000 + frame * FRAME_US, static_cast<uint16_t>(frame), static_cast<int16_t>(frame));
+        }
+        CHECK_EQ(getDofRecordCount(), 10);
+        CHECK_EQ(getDofRecordsRecorded() - recorded, 10);
+        CHECK_EQ(getDofRecordBytes(), 10 * (DOF_RECORD_HEADER_LENGTH + DOF_V2_PACKET_LENGTH));
+        CHECK_EQ(getDofRecordSpanUs(), 9 * FRAME_US);
+
+        // Nothing is kept with recording off
+        setDofRecording(false);
+        arrive(2000000, 10, 10);
+        CHECK_EQ(getDofRecordCount(), 10);
+        setDofRecording(true);
+
+        // Once the ring is full the oldest go, and the span stays on the newest
+        uint32_t overwritten = getDofRecordsOverwritten();
+        const int FRAMES = 2 * DOF_RECORD_BUFFER_BYTES / (DOF_RECORD_HEADER_LENGTH + DOF_V2_PACKET_LENGTH);
+        for (int frame = 0; frame < FRAMES; frame++) {
+            arrive(3000000 + frame * FRAME_US, static_cast<uint16_t>(frame), 0);
+        }
+        uint32_t capacity = DOF_RECORD_BUFFER_BYTES / (DOF_RECORD_HEADER_LENGTH + DOF_V2_PACKET_LENGTH);
+        CHECK_EQ(getDofRecordCount(), capacity);
+        CHECK_EQ(getDofRecordsOverwritten() - overwritten, 10 + FRAMES - capacity);
+        CHECK(getDofRecordBytes() <= DOF_RECORD_BUFFER_BYTES);
+        CHECK_EQ(getDofRecordSpanUs(), (capacity - 1) * FRAME_US);
+    }
+
+    void testDump() {
+        clear();
+        for (int frame = 0; frame < 5; frame++) {
+            arrive(1000000 + frame * FRAME_US, static_cast<uint16_t>(frame), static_cast<int16_t>(10 * frame));
+        }
+        // A bad packet is kept as it came
+        uint8_t junk[3] = { 1, 2, 3 };
+        hostsim::setMicros(1200000);
+        recordDofPacket(junk, sizeof(junk));
+
+        hostsim::serialOutput().clear();
+        requestDofDump();
+        runDofRecorder();
+        CHECK_EQ(getDofRecorderActivity(), DOF_RECORDER_DUMPING);
+
+        // Arrivals during the dump are decoded but not recorded
+        arrive(1300000, 5, 50);
+        runUntilIdle();
+        CHECK_EQ(getDofRecordCount(), 6);
+
+        const std::string& output = hostsim::serialOutput();
+        CHECK(output.find("REC:begin records:6 span:200000us\r\n") == 0);
+        CHECK(output.find("REC:end records:6\r\n") != std::string::npos);
+
+        // Every record parses back to what was recorded
+        int records = 0;
+        size_t start = 0;
+        while (start < output.size()) {
+            size_t end = output.find('\n', start);
+            std::string line = output.substr(start, end - start);
+            start = end + 1;
+
+            uint32_t timeUs;
+            uint8_t packet[DOF_MAX_PACKET_LENGTH];
+            uint8_t length;
+            if (!parseDofRecord(line.c_str(), timeUs, packet, length)) {
+                continue;
+            }
+            if (records < 5) {
+                uint8_t expected[DOF_MAX_PACKET_LENGTH];
+                CHECK_EQ(length, makePacket(static_cast<uint16_t>(records), static_cast<int16_t>(10 * records), expected));
+                CHECK(memcmp(packet, expected, length) == 0);
+                CHECK_EQ(timeUs, 1000000 + records * FRAME_US);
+            }
+            else {
+                CHECK_EQ(length, 3);
+                CHECK_EQ(timeUs, 1200000);
+            }
+            records++;
+        }
+        CHECK_EQ(records, 6);
+    }
+
+    // Records a stream of frames 33ms apart with the first DOF at 0, 1, 2...
+    void recordStream(int frames) {
+        clear();
+        for (int frame = 0; frame < frames; frame++) {
+            arrive(1000000 + frame * FRAME_US, static_cast<uint16_t>(frame), static_cast<int16_t>(frame));
+        }
+    }
+
+    void testReplay() {
+        const int FRAMES = 8;
+        recordStream(FRAMES);
+
+        // A live stream that's got well ahead of the recording
+        setDofRecording(false);
+        arrive(2000000, 500, 30);
+        controlTick();
+        CHECK_EQ(DOF_REGISTRY[0].get(), 30);
+        setDofRecording(true);
+
+        uint32_t received = getDofPacketsReceived();
+        uint32_t stale = getDofFramesStale();
+        uint32_t lost = getDofFramesLost();
+        uint32_t replayed = getDofRecordsReplayed();
+        hostsim::setMicros(3000000);
+        requestDofReplay(1);
+        runDofRecorder();
+        CHECK_EQ(getDofRecorderActivity(), DOF_RECORDER_REPLAYING);
+
+        // The first frame goes straight away, each one after at its spacing,
+        // and all of them make it past the sequence checks
+        uint32_t sentUs[FRAMES] = {};
+        int16_t lastAngle = -1;
+        bool inOrder = true;
+        while (getDofRecorderActivity() == DOF_RECORDER_REPLAYING) {
+            // Live packets are held back
+            uint8_t packet[DOF_MAX_PACKET_LENGTH];
+            int length = makePacket(600, 30, packet);
+            CHECK(!recordDofPacket(packet, length));
+
+            uint32_t before = getDofPacketsReceived() - received;
+            runDofRecorder();
+            if (getDofPacketsReceived() - received != before && before < FRAMES) {
+                sentUs[before] = static_cast<uint32_t>(hostsim::nowMicros()) - 3000000;
+            }
+            controlTick();
+            if (DOF_REGISTRY[0].get() < lastAngle) {
+                inOrder = false;
+            }
+            lastAngle = DOF_REGISTRY[0].get();
+            hostsim::advanceMicros(1000);
+        }
+        CHECK_EQ(getDofRecordsReplayed() - replayed, FRAMES);
+        CHECK_EQ(getDofPacketsReceived() - received, FRAMES);
+        CHECK_EQ(getDofFramesStale() - stale, 0);
+        CHECK_EQ(getDofFramesLost() - lost, 0);
+        for (int frame = 0; frame < FRAMES; frame++) {
+            CHECK_EQ(sentUs[frame], frame * FRAME_US);
+        }
+        CHECK(inOrder);
+        CHECK_EQ(DOF_REGISTRY[0].get(), FRAMES - 1);
+
+        // The recording is still there to replay again, and the live stream
+        // picks up where it was
+        CHECK_EQ(getDofRecordCount(), FRAMES);
+        setDofRecording(false);
+        arrive(static_cast<uint32_t>(hostsim::nowMicros()), 601, 35);
+        controlTick();
+        CHECK_EQ(DOF_REGISTRY[0].get(), 35);
+        CHECK_EQ(getDofFramesStale() - stale, 0);
+    }
+
+    void testReplayFaster() {
+        const int FRAMES = 8;
+        recordStream(FRAMES);
+        setDofRecording(false);
+
+        hostsim::setMicros(5000000);
+        requestDofReplay(4);
+        runUntilIdle();
+        uint32_t tookUs = static_cast<uint32_t>(hostsim::nowMicros()) - 5000000;
+        CHECK(tookUs >= (FRAMES - 1) * FRAME_US / 4);
+        CHECK(tookUs <= (FRAMES - 1) * FRAME_US / 4 + 2000);
+
+        // Stopped part way through
+        hostsim::setMicros(6000000);
+        uint32_t replayed = getDofRecordsReplayed();
+        requestDofReplay(1);
+        runDofRecorder();
+        hostsim::advanceMicros(FRAME_US);
+        runDofRecorder();
+        requestDofRecorderStop();
+        runDofRecorder();
+        CHECK_EQ(getDofRecorderActivity(), DOF_RECORDER_IDLE);
+        CHECK_EQ(getDofRecordsReplayed() - replayed, 2);
+
+        // Speeds are kept to the range
+        requestDofReplay(200);
+        runUntilIdle();
+        CHECK_EQ(getDofRecorderActivity(), DOF_RECORDER_IDLE);
+
+        // Nothing to replay
+        clear();
+        requestDofReplay(1);
+        runDofRecorder();
+        CHECK_EQ(getDofRecorderActivity(), DOF_RECORDER_IDLE);
+    }
+}
+
+int main() {
+    setupServos();
+    setMotionLimiting(false);
+    setDofJitterDelay(0);       // Frames apply on the next tick
+
+    testFormat();
+    testRecording();
+    testDump();
+    testReplay();
+    testReplayFaster();
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,119 @@
+// Checks the DOF registry: that the descriptor decodes back to the table,
+// that the joints end up with the registry's ranges, and that streamed
+// frames reach the joint each DOF names.
+
+#include <string.h>
+
+#include "DofRegistry.h"
+#include "DofStream.h"
+#include "Hand.h"
+#include "TestUtils.h"
+
+namespace {
+
+    int16_t readInt16(const uint8_t* data) {
+        return static_cast<int16_t>(data[0] | (data[1] << 8));
+    }
+
+    void testDescriptor() {
+        CHECK_EQ(DOF_DESCRIPTOR[0], DOF_DESCRIPTOR_VERSION);
+        CHECK_EQ(DOF_DESCRIPTOR[1], DOF_COUNT);
+
+        size_t position = 2;
+        for (int i = 0; i < DOF_COUNT && position < DOF_DESCRIPTOR_LENGTH; i++) {
+            const DofInfo& dof = DOF_REGISTRY[i];
+            const uint8_t* entry = DOF_DESCRIPTOR + position;
+            CHECK_EQ(entry[0], dof.joint);
+            CHECK_EQ(entry[1], dof.axis);
+            CHECK_EQ(readInt16(entry + 2), dof.min);
+            CHECK_EQ(readInt16(entry + 4), dof.max);
+            CHECK_EQ(entry[6], strlen(dof.name));
+            CHECK(memcmp(entry + 7, dof.name, entry[6]) == 0);
+            position += 7 + entry[6];
+        }
+        CHECK_EQ(position, DOF_DESCRIPTOR_LENGTH);
+
+        // The layout streamed frames and the Python tools rely on
+        CHECK(strcmp(DOF_REGISTRY[0].name, "index_pitch") == 0);
+        CHECK(strcmp(DOF_REGISTRY[14].name, "thumb_flexion") == 0);
+        CHECK(strcmp(DOF_REGISTRY[16].name, "wrist_yaw") == 0);
+        CHECK_EQ(readInt16(DOF_DESCRIPTOR + 2 + 2), 0);
+    }
+
+    void testRanges() {
+        // setupServos() has given every joint its range from the registry
+        for (int finger = 0; finger < NUM_FINGERS; finger++) {
+            const DofInfo& pitch = DOF_REGISTRY[finger * 3];
+            const DofInfo& yaw = DOF_REGISTRY[finger * 3 + 1];
+            const DofInfo& flexion = DOF_REGISTRY[finger * 3 + 2];
+            CHECK_EQ(pitch.joint, finger);
+            CHECK_EQ(fingers[finger].getPitchMin(), pitch.min);
+            CHECK_EQ(fingers[finger].getPitchMax(), pitch.max);
+            CHECK_EQ(fingers[finger].getYawMin(), yaw.min);
+            CHECK_EQ(fingers[finger].getYawMax(), yaw.max);
+            CHECK_EQ(fingers[finger].getFlexionMin(), flexion.min);
+            CHECK_EQ(fingers[finger].getFlexionMax(), flexion.max);
+        }
+        CHECK_EQ(thumb.getPitchMin(), findDof("thumb_pitch")->min);
+        CHECK_EQ(thumb.getFlexionMax(), findDof("thumb_flexion")->max);
+        CHECK_EQ(wrist.getYawMin(), findDof("wrist_yaw")->min);
+        CHECK_EQ(wrist.getYawMax(), findDof("wrist_yaw")->max);
+    }
+
+    void testLookup() {
+        const DofInfo* dof = findDof("ring_yaw");
+        CHECK(dof == &DOF_REGISTRY[7]);
+        CHECK(dof != nullptr && dof->joint == JOINT_RING && dof->axis == DOF_AXIS_YAW);
+        CHECK(findDof("ring") == nullptr);
+        CHECK(findDof("") == nullptr);
+
+        // Setters reach the right joint, within its range
+        findDof("thumb_yaw")->set(30);
+        CHECK_EQ(thumb.getYaw(), 30);
+        CHECK_EQ(findDof("thumb_yaw")->get(), 30);
+        findDof("wrist_pitch")->set(-90);
+        CHECK_EQ(wrist.getPitch(), -40);
+    }
+
+    void testApplyFrame() {
+        DofFrame frame = {};
+        for (int i = 0; i < DOF_COUNT; i++) {
+            frame.angles[i] = static_cast<int16_t>(((DOF_REGISTRY[i].min + DOF_REGISTRY[i].max) / 2 + i % 3) * DOF_V2_ANGLE_SCALE);
+        }
+        applyDofFrame(frame);
+
+        for (int i = 0; i < DOF_COUNT; i++) {
+            CHECK_EQ(DOF_REGISTRY[i].get() * DOF_V2_ANGLE_SCALE, frame.angles[i]);
+        }
+        CHECK_EQ(fingers[FINGER_PINKY].getFlexion() * DOF_V2_ANGLE_SCALE, frame.angles[11]);
+        CHECK_EQ(thumb.getPitch() * DOF_V2_ANGLE_SCALE, frame.angles[12]);
+        CHECK_EQ(wrist.getYaw() * DOF_V2_ANGLE_SCALE, frame.angles[16]);
+
+        // Hundredths are rounded to the nearest degree
+        int16_t yaw = static_cast<int16_t>(wrist.getYaw());
+        frame.angles[16] = static_cast<int16_t>(yaw * DOF_V2_ANGLE_SCALE + 51);
+        CHECK_EQ(applyDofFrame(frame), HAND_JOINT_WRIST);
+        CHECK_EQ(wrist.getYaw(), yaw + 1);
+        frame.angles[16] = static_cast<int16_t>(yaw * DOF_V2_ANGLE_SCALE - 49);
+        CHECK_EQ(applyDofFrame(frame), HAND_JOINT_WRIST);
+        CHECK_EQ(wrist.getYaw(), yaw);
+
+        // Only the joint whose DOF changed is reported
+        frame.angles[13] = static_cast<int16_t>(frame.angles[13] + 5 * DOF_V2_ANGLE_SCALE);
+        CHECK_EQ(applyDofFrame(frame), HAND_JOINT_THUMB);
+        CHECK_EQ(applyDofFrame(frame), 0);
+    }
+}
+
+int main() {
+    setupServos();
+    setMotionLimiting(false);    // Servos follow the targets directly
+    setDofJitterDelay(0);        // Frames are applied as they arrive
+
+    testDescriptor();
+    testRanges();
+    testLookup();
+    testApplyFrame();
+
+    return TEST_RESULT();
+}
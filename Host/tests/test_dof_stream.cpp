@@ -0,0 +1,329 @@
+// Checks the DOF stream path: packet validation and decoding, the latest-frame
+// mailbox between the BLE handler and the control tick, that bursts of
+// frames are coalesced so each tick applies only the newest one, and that
+// delta frames only touch the joints they change. Two threads check that
+// the mailbox never hands over a value torn by a publish.
+
+#include <atomic>
+#include <thread>
+
+#include "DofStream.h"
+#include "Hand.h"
+#include "TestUtils.h"
+
+namespace {
+
+    struct Packet {
+        uint8_t data[DOF_PACKET_LENGTH];
+    };
+
+    // Every DOF packed to the same byte, with a valid checksum
+    Packet makePacket(uint8_t value) {
+        Packet packet;
+        uint8_t checksum = 0;
+        for (int i = 0; i < DOF_COUNT; i++) {
+            packet.data[i] = value;
+            checksum += value;
+        }
+        packet.data[DOF_COUNT] = checksum;
+        return packet;
+    }
+
+    void testDecode() {
+        DofFrame frame;
+
+        Packet packet = makePacket(127);
+        CHECK_EQ(decodeDofPacket(packet.data, DOF_PACKET_LENGTH, frame), DOF_PACKET_OK);
+        CHECK_EQ(frame.angles[0], 0);
+
+        packet = makePacket(127 + 64);
+        CHECK_EQ(decodeDofPacket(packet.data, DOF_PACKET_LENGTH, frame), DOF_PACKET_OK);
+        CHECK_EQ(frame.angles[DOF_COUNT-1], 90 * DOF_V2_ANGLE_SCALE);
+
+        packet = makePacket(127 - 10);
+        CHECK_EQ(decodeDofPacket(packet.data, DOF_PACKET_LENGTH, frame), DOF_PACKET_OK);
+        CHECK_EQ(frame.angles[5], -14 * DOF_V2_ANGLE_SCALE);     // -14.06 truncated toward zero
+
+        CHECK_EQ(decodeDofPacket(packet.data, DOF_PACKET_LENGTH - 1, frame), DOF_PACKET_BAD_LENGTH);
+
+        packet.data[3]++;
+        CHECK_EQ(decodeDofPacket(packet.data, DOF_PACKET_LENGTH, frame), DOF_PACKET_BAD_CHECKSUM);
+    }
+
+    void testMailboxKeepsNewest() {
+        Mailbox<DofFrame> mailbox;
+        DofFrame frame = {};
+
+        CHECK(!mailbox.take(frame));
+
+        for (int16_t value = 1; value <= 3; value++) {
+            DofFrame published = {};
+            published.angles[0] = value;
+            mailbox.publish(published);
+        }
+        CHECK(mailbox.hasNew());
+        CHECK(mailbox.take(frame));
+        CHECK_EQ(frame.angles[0], 3);
+        CHECK_EQ(mailbox.getCoalesced(), 2);
+        CHECK_EQ(mailbox.getTaken(), 1);
+        CHECK(!mailbox.take(frame));
+
+        DofFrame published = {};
+        published.angles[0] = 4;
+        mailbox.publish(published);
+        CHECK(mailbox.take(frame));
+        CHECK_EQ(frame.angles[0], 4);
+        CHECK_EQ(mailbox.getCoalesced(), 2);
+        CHECK_EQ(mailbox.getPublished(), 4);
+    }
+
+    void testBurstyArrivals() {
+        resetDofStreamCounters();
+        restartDofStream();
+        hostsim::setMicros(0);
+
+        // Packets land three at a time every 40ms, the control tick runs every 10ms
+        const int BURSTS = 50;
+        const int BURST_SIZE = 3;
+        const uint64_t TICK_US = 1000000 / CONTROL_RATE_HZ;
+        uint8_t value = 100;
+        uint8_t lastValue = value;
+        int ticksWithFrame = 0;
+
+        for (int tick = 0; tick < BURSTS * 4; tick++) {
+            if (tick % 4 == 0) {
+                for (int packet = 0; packet < BURST_SIZE; packet++) {
+                    value = static_cast<uint8_t>(100 + (value - 99) % 50);
+                    Packet burst = makePacket(value);
+                    CHECK_EQ(receiveDofPacket(burst.data, DOF_PACKET_LENGTH), DOF_PACKET_OK);
+                }
+                lastValue = value;
+            }
+
+            uint32_t appliedBefore = getDofFramesApplied();
+            uint32_t commitsBefore = ManagedServo::getFramesCommitted();
+            controlTick();
+
+            if (getDofFramesApplied() != appliedBefore) {
+                ticksWithFrame++;
+
+                // Only the newest frame of the burst reaches the joints, in one servo commit
+                DofFrame expected;
+                Packet newest = makePacket(lastValue);
+                decodeDofPacket(newest.data, DOF_PACKET_LENGTH, expected);
+                CHECK_EQ(wrist.getYaw(), CLAMP(dofAngleDegrees(expected.angles[16]), wrist.getYawMin(), wrist.getYawMax()));
+                CHECK(ManagedServo::getFramesCommitted() - commitsBefore <= 1);
+            }
+            hostsim::advanceMicros(TICK_US);
+        }
+
+        CHECK_EQ(ticksWithFrame, BURSTS);
+        CHECK_EQ(getDofPacketsReceived(), BURSTS * BURST_SIZE);
+        CHECK_EQ(getDofFramesApplied(), BURSTS);
+        CHECK_EQ(getDofFramesCoalesced(), BURSTS * (BURST_SIZE - 1));
+
+        // Bad packets are counted and never reach the mailbox
+        Packet bad = makePacket(120);
+        bad.data[DOF_COUNT]++;
+        CHECK_EQ(receiveDofPacket(bad.data, DOF_PACKET_LENGTH), DOF_PACKET_BAD_CHECKSUM);
+        CHECK_EQ(receiveDofPacket(bad.data, 5), DOF_PACKET_BAD_LENGTH);
+        CHECK_EQ(getDofPacketsBadChecksum(), 1);
+        CHECK_EQ(getDofPacketsBadLength(), 1);
+        CHECK(!dofMailbox.hasNew());
+    }
+
+    int receiveDelta(const int16_t* centidegrees, uint32_t mask, uint16_t sequence) {
+        uint8_t packet[DOF_MAX_PACKET_LENGTH];
+        int length = mask == DOF_ALL_MASK ?
+            encodeDofPacketV2(centidegrees, sequence, 0, packet) :
+            encodeDofPacketDelta(centidegrees, mask, sequence, 0, packet);
+        return receiveDofPacket(packet, length);
+    }
+
+    void testDeltaFrames() {
+        resetDofStreamCounters();
+        restartDofStream();
+        controlTick();
+
+        int16_t centidegrees[DOF_COUNT] = {};
+        for (int i = 0; i < NUM_FINGERS; i++) {
+            centidegrees[i*3] = 1000;
+            centidegrees[i*3+2] = 3000;
+        }
+        centidegrees[12] = 4000;
+
+        // A delta before any keyframe has nothing to apply to
+        CHECK_EQ(receiveDelta(centidegrees, 1ul << 0, 1), DOF_PACKET_OK);
+        CHECK_EQ(getDofDeltasDropped(), 1);
+        CHECK(!dofMailbox.hasNew());
+
+        CHECK_EQ(receiveDelta(centidegrees, DOF_ALL_MASK, 2), DOF_PACKET_OK);
+        controlTick();
+        CHECK_EQ(fingers[FINGER_RING].getFlexion(), 30);
+
+        // Two deltas before a tick: both changes survive the coalescing
+        centidegrees[0] = 2000;
+        CHECK_EQ(receiveDelta(centidegrees, 1ul << 0, 3), DOF_PACKET_OK);
+        centidegrees[16] = 1500;
+        CHECK_EQ(receiveDelta(centidegrees, 1ul << 16, 4), DOF_PACKET_OK);
+        controlTick();
+        CHECK_EQ(fingers[FINGER_INDEX].getPitch(), 20);
+        CHECK_EQ(wrist.getYaw(), 15);
+        CHECK_EQ(getDofDeltaFrames(), 2);
+        CHECK_EQ(getDofFramesCoalesced(), 1);
+
+        // Only the index finger's servos are written for an index finger change
+        centidegrees[2] = 5000;
+        ManagedServo::resetWriteCounters();
+        CHECK_EQ(receiveDelta(centidegrees, 1ul << 2, 5), DOF_PACKET_OK);
+        controlTick();
+        CHECK_EQ(fingers[FINGER_INDEX].getFlexion(), 50);
+        CHECK(ManagedServo::getWritesIssued() + ManagedServo::getWritesSkipped() <= 3);
+        CHECK(ManagedServo::getWritesIssued() >= 1);
+
+        // An unchanged keyframe doesn't touch the servos at all
+        ManagedServo::resetWriteCounters();
+        CHECK_EQ(receiveDelta(centidegrees, DOF_ALL_MASK, 6), DOF_PACKET_OK);
+        controlTick();
+        CHECK_EQ(getDofFramesApplied(), 4);
+        CHECK_EQ(ManagedServo::getWritesIssued() + ManagedServo::getWritesSkipped(), 0);
+
+        // The BLE handler's counters are only zeroed from its own side, when
+        // it takes up the request
+        CHECK(getDofPacketsReceived() > 0);
+        resetDofStreamCounters();
+        CHECK(getDofPacketsReceived() > 0);
+        takeDofStreamRequests();
+        CHECK_EQ(getDofPacketsReceived(), 0);
+
+        // Zeroing the counters mid stream doesn't make deltas wait for a keyframe
+        resetDofStreamCounters();
+        centidegrees[0] = 3000;
+        CHECK_EQ(receiveDelta(centidegrees, 1ul << 0, 7), DOF_PACKET_OK);
+        controlTick();
+        CHECK_EQ(fingers[FINGER_INDEX].getPitch(), 30);
+        CHECK_EQ(getDofDeltasDropped(), 0);
+        CHECK_EQ(getDofFramesLost(), 0);
+    }
+
+    // Producer and consumer on separate threads: every frame taken must be one
+    // that was published whole, and they must come out in order
+    void testMailboxAcrossThreads() {
+        Mailbox<DofFrame> mailbox;
+        const int16_t FRAMES = 20000;
+        std::atomic<bool> done(false);
+
+        std::thread producer([&]() {
+            for (int16_t value = 1; value <= FRAMES; value++) {
+                DofFrame frame;
+                for (int i = 0; i < DOF_COUNT; i++) {
+                    frame.angles[i] = value;
+                }
+                mailbox.publish(frame);
+            }
+            done = true;
+        });
+
+        int torn = 0;
+        int outOfOrder = 0;
+        int16_t last = 0;
+        DofFrame frame;
+        while (!done || mailbox.hasNew()) {
+            if (!mailbox.take(frame)) {
+                continue;
+            }
+            for (int i = 1; i < DOF_COUNT; i++) {
+                torn += frame.angles[i] != frame.angles[0];
+            }
+            outOfOrder += frame.angles[0] <= last;
+            last = frame.angles[0];
+        }
+        producer.join();
+
+        CHECK_EQ(torn, 0);
+        CHECK_EQ(outOfOrder, 0);
+        CHECK_EQ(last, FRAMES);
+        CHECK_EQ(mailbox.getTaken() + mailbox.getCoalesced(), FRAMES);
+    }
+
+    // A value that gives up the CPU part way through being copied, every few
+    // words on the consumer's side and at varying points on the producer's.
+    // That makes the producer finish one publish and get part way through
+    // the next while the consumer is still copying, which a free running
+    // test on a lightly loaded machine almost never hits.
+    thread_local int yieldEvery = 64;
+
+    struct SlowValue {
+        uint32_t words[64];
+
+        SlowValue& operator=(const SlowValue& other) {
+            for (int i = 0; i < 64; i++) {
+                words[i] = other.words[i];
+                if (i % yieldEvery == 0) {
+                    std::this_thread::yield();
+                }
+            }
+            return *this;
+        }
+    };
+
+    void testMailboxNeverTears() {
+        static Mailbox<SlowValue> mailbox;
+        const uint32_t VALUES = 30000;
+        std::atomic<bool> done(false);
+
+        std::thread producer([&]() {
+            for (uint32_t value = 1; value <= VALUES; value++) {
+                SlowValue published;
+                for (uint32_t& word : published.words) {
+                    word = value;
+                }
+                yieldEvery = 8 + static_cast<int>(value * 7 % 57);
+                mailbox.publish(published);
+            }
+            done = true;
+        });
+
+        yieldEvery = 16;
+        int torn = 0;
+        int outOfOrder = 0;
+        uint32_t last = 0;
+        SlowValue taken;
+        while (!done || mailbox.hasNew()) {
+            if (!mailbox.take(taken)) {
+                std::this_thread::yield();
+                continue;
+            }
+            for (uint32_t word : taken.words) {
+                if (word != taken.words[0]) {
+                    torn++;
+                    break;
+                }
+            }
+            outOfOrder += taken.words[0] <= last;
+            last = taken.words[0];
+        }
+        producer.join();
+
+        CHECK_EQ(torn, 0);
+        CHECK_EQ(outOfOrder, 0);
+        CHECK_EQ(last, VALUES);
+        CHECK(mailbox.getTaken() > 100);
+        CHECK_EQ(mailbox.getTaken() + mailbox.getCoalesced(), VALUES);
+    }
+}
+
+int main() {
+    setupServos();
+    setMotionLimiting(false);    // Servos follow the targets directly
+    setDofJitterDelay(0);        // Frames are applied as they arrive
+
+    testDecode();
+    testMailboxKeepsNewest();
+    testBurstyArrivals();
+    testDeltaFrames();
+    testMailboxAcrossThreads();
+    testMailboxNeverTears();
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,217 @@
+// Equivalence test for the fixed point joint to servo mapping.
+//
+// Sweeps every integer target of every joint in the hand and compares the
+// servo positions the mixer gives against the original float implementation. The documented
+// tolerance is 1 degree: the fixed point path gives the exact answer, while
+// the float path occasionally rounds an exact integer result down by one.
+
+#include <stdlib.h>
+
+#include "Hand.h"
+#include "MathUtils.h"
+#include "Mixer.h"
+#include "../reference/FloatKinematics.h"
+#include "TestUtils.h"
+
+namespace {
+
+    struct Stats {
+        long compared = 0;
+        long mismatched = 0;
+        int worst = 0;
+
+        void add(int32_t actual, int32_t expected) {
+            compared++;
+            int diff = abs(actual - expected);
+            if (diff != 0) {
+                mismatched++;
+            }
+            if (diff > worst) {
+                worst = diff;
+            }
+        }
+
+        void report(const char* name) const {
+            printf("  %-8s %8ld positions, %6ld differ, worst %d\n", name, compared, mismatched, worst);
+        }
+    };
+
+    reference::Range servoRange(int index) {
+        return { managedServos[index].getMinPosition(), managedServos[index].getMaxPosition() };
+    }
+
+    // Exact rational result, truncated toward zero, for checking LinearMap itself
+    int32_t exactMap(int32_t value, int32_t inMin, int32_t inMax, int32_t outMin, int32_t outMax) {
+        value = CLAMP(value, inMin, inMax);
+        long long num = static_cast<long long>(value - inMin) * (outMax - outMin) + static_cast<long long>(outMin) * (inMax - inMin);
+        return static_cast<int32_t>(num / (inMax - inMin));
+    }
+
+    void testLinearMap() {
+        Stats floatStats;
+        long exactMismatches = 0;
+
+        for (int32_t inMin = -60; inMin <= 60; inMin += 5) {
+            for (int32_t inSpan = 1; inSpan <= 200; inSpan += 3) {
+                for (int32_t outMin = -40; outMin <= 120; outMin += 20) {
+                    for (int32_t outSpan = 0; outSpan <= 180; outSpan += 7) {
+                        LinearMap map;
+                        map.setRange(inMin, inMin + inSpan, outMin, outMin + outSpan);
+
+                        for (int32_t value = inMin - 5; value <= inMin + inSpan + 5; value++) {
+                            int32_t fixed = map.map(value);
+                            if (fixed != exactMap(value, inMin, inMin + inSpan, outMin, outMin + outSpan)) {
+                                exactMismatches++;
+                            }
+                            floatStats.add(fixed, reference::mapInteger(value, inMin, inMin + inSpan, outMin, outMin + outSpan));
+                        }
+                    }
+                }
+            }
+        }
+
+        floatStats.report("map");
+        CHECK_EQ(exactMismatches, 0);
+        CHECK(floatStats.worst <= 1);
+
+        // Q15 normalisation as used by the finger mixing
+        LinearMap q15;
+        q15.setRange(0, 100, 0, Q15_ONE);
+        CHECK_EQ(q15.map(0), 0);
+        CHECK_EQ(q15.map(50), Q15_HALF);
+        CHECK_EQ(q15.map(100), Q15_ONE);
+        CHECK_EQ(q15.map(200), Q15_ONE);
+
+        // Degenerate range
+        LinearMap flat;
+        flat.setRange(10, 10, 30, 90);
+        CHECK_EQ(flat.map(5), 30);
+        CHECK_EQ(flat.map(50), 30);
+
+        CHECK_EQ(q15ToInt(-Q15_ONE - 1), -1);
+        CHECK_EQ(q15ToInt(Q15_ONE + Q15_HALF), 1);
+    }
+
+    void testFingers() {
+        const int servos[NUM_FINGERS][3] = {
+            { SERVO_INDEX_LOWER, SERVO_INDEX_UPPER, SERVO_INDEX_TIP },
+            { SERVO_MIDDLE_LOWER, SERVO_MIDDLE_UPPER, SERVO_MIDDLE_TIP },
+            { SERVO_RING_LOWER, SERVO_RING_UPPER, SERVO_RING_TIP },
+            { SERVO_PINKY_LOWER, SERVO_PINKY_UPPER, SERVO_PINKY_TIP },
+        };
+
+        Stats stats;
+        for (int index = 0; index < NUM_FINGERS; index++) {
+            Finger& finger = fingers[index];
+            for (int pitch = finger.getPitchMin(); pitch <= finger.getPitchMax(); pitch++) {
+                for (int yaw = finger.getYawMin(); yaw <= finger.getYawMax(); yaw++) {
+                    for (int flexion = finger.getFlexionMin(); flexion <= finger.getFlexionMax(); flexion++) {
+                        finger.setPosition(pitch, yaw, flexion);
+                        uint8_t positions[NUM_SERVOS] = {};
+                        mixServos(HAND_JOINT_FINGER(index), positions);
+
+                        int32_t expected[3];
+                        reference::finger(pitch, yaw, flexion,
+                            { finger.getPitchMin(), finger.getPitchMax() },
+                            { finger.getYawMin(), finger.getYawMax() },
+                            { finger.getFlexionMin(), finger.getFlexionMax() },
+                            finger.getYawBias(),
+                            servoRange(servos[index][0]), servoRange(servos[index][1]), servoRange(servos[index][2]),
+                            expected);
+
+                        for (int servo = 0; servo < 3; servo++) {
+                            stats.add(positions[servos[index][servo]], expected[servo]);
+                        }
+                    }
+                }
+            }
+        }
+
+        stats.report("fingers");
+        CHECK(stats.worst <= 1);
+    }
+
+    void testThumb() {
+        Stats stats;
+        for (int pitch = thumb.getPitchMin(); pitch <= thumb.getPitchMax(); pitch++) {
+            for (int yaw = thumb.getYawMin(); yaw <= thumb.getYawMax(); yaw++) {
+                for (int flexion = thumb.getFlexionMin(); flexion <= thumb.getFlexionMax(); flexion++) {
+                    for (int roll = thumb.getRollMin(); roll <= thumb.getRollMax(); roll += 5) {
+                        thumb.setPosition(pitch, yaw, flexion);
+                        thumb.setRoll(roll);
+                        uint8_t positions[NUM_SERVOS] = {};
+                        mixServos(HAND_JOINT_THUMB, positions);
+
+                        int32_t expected[4];
+                        reference::thumb(pitch, yaw, flexion, roll,
+                            { thumb.getPitchMin(), thumb.getPitchMax() },
+                            { thumb.getYawMin(), thumb.getYawMax() },
+                            { thumb.getFlexionMin(), thumb.getFlexionMax() },
+                            { thumb.getRollMin(), thumb.getRollMax() },
+                            servoRange(SERVO_THUMB_LEFT), servoRange(SERVO_THUMB_RIGHT),
+                            servoRange(SERVO_THUMB_TIP), servoRange(SERVO_THUMB_ROTATE),
+                            expected);
+
+                        stats.add(positions[SERVO_THUMB_LEFT], expected[0]);
+                        stats.add(positions[SERVO_THUMB_RIGHT], expected[1]);
+                        stats.add(positions[SERVO_THUMB_TIP], expected[2]);
+                        stats.add(positions[SERVO_THUMB_ROTATE], expected[3]);
+                    }
+                }
+            }
+        }
+
+        stats.report("thumb");
+        CHECK(stats.worst <= 1);
+    }
+
+    void testWrist() {
+        Stats stats;
+        for (int pitch = wrist.getPitchMin(); pitch <= wrist.getPitchMax(); pitch++) {
+            for (int yaw = wrist.getYawMin(); yaw <= wrist.getYawMax(); yaw++) {
+                wrist.setPosition(pitch, yaw);
+                uint8_t positions[NUM_SERVOS] = {};
+                mixServos(HAND_JOINT_WRIST, positions);
+
+                int32_t expected[2];
+                reference::wrist(pitch, yaw, { wrist.getPitchMin(), wrist.getPitchMax() },
+                    servoRange(SERVO_WRIST_L), servoRange(SERVO_WRIST_R), expected);
+
+                stats.add(positions[SERVO_WRIST_L], expected[0]);
+                stats.add(positions[SERVO_WRIST_R], expected[1]);
+            }
+        }
+
+        stats.report("wrist");
+        CHECK(stats.worst <= 1);
+    }
+
+    void testServoLimitChange() {
+        // A min:/max: command changes the servo limits - the maps must follow
+        ManagedServo& flexion = managedServos[SERVO_INDEX_TIP];
+        uint8_t oldMax = flexion.getMaxPosition();
+
+        flexion.setMaxPosition(60);
+        fingers[FINGER_INDEX].setFlexion(fingers[FINGER_INDEX].getFlexionMax());
+        updateHandJoints(HAND_JOINT_FINGER(FINGER_INDEX));
+        CHECK_EQ(flexion.getServoPosition(), 60);
+
+        flexion.setMaxPosition(oldMax);
+        updateHandJoints(HAND_JOINT_FINGER(FINGER_INDEX));
+        CHECK_EQ(flexion.getServoPosition(), oldMax);
+    }
+}
+
+int main() {
+    setupServos();
+    setMotionLimiting(false);    // Servos follow the targets directly
+
+    printf("Fixed point vs float mapping:\n");
+    testLinearMap();
+    testFingers();
+    testThumb();
+    testWrist();
+    testServoLimitChange();
+
+    return TEST_RESULT();
+}
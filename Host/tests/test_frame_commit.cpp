@@ -0,0 +1,168 @@
+// Checks that servo writes made inside a frame are held back until
+// commitFrame(), land together, are deferred rather than waited for at the
+// end of a refresh period, and that the reported spread matches the time the
+// writes took.
+
+#include "Hand.h"
+#include "TestUtils.h"
+
+namespace {
+
+    int stateMachineFor(int index) {
+        return hostsim::pioStateMachineForPin(managedServos[index].getServoPin());
+    }
+
+    void moveAllJoints(int16_t amount) {
+        for (int index = 0; index < NUM_FINGERS; index++) {
+            fingers[index].setPitch(fingers[index].getPitchMin() + amount);
+            fingers[index].setYaw(fingers[index].getYawMin() + amount);
+            fingers[index].setFlexion(fingers[index].getFlexionMin() + amount);
+        }
+        thumb.setPitch(thumb.getPitchMin() + amount);
+        thumb.setYaw(thumb.getYawMin() + amount);
+        thumb.setFlexion(thumb.getFlexionMin() + amount);
+        wrist.setPitch(wrist.getPitchMin() + amount);
+        wrist.setYaw(wrist.getYawMin() + amount);
+    }
+
+    void testWritesAreStagedUntilCommit() {
+        ManagedServo& servo = managedServos[SERVO_WRIST_L];
+        int sm = stateMachineFor(SERVO_WRIST_L);
+        uint16_t before = hostsim::pioPulseMicros(sm);
+        uint32_t putsBefore = hostsim::pioTotalPuts();
+
+        ManagedServo::beginFrame();
+        servo.setServoPosition(servo.getServoPosition() + 5);
+        servo.setServoPosition(servo.getServoPosition() + 5);
+
+        // Nothing reaches the hardware while the frame is open
+        CHECK_EQ(hostsim::pioTotalPuts(), putsBefore);
+        CHECK_EQ(hostsim::pioPulseMicros(sm), before);
+
+        ManagedServo::commitFrame();
+
+        // Only the final position of the frame is written
+        CHECK_EQ(hostsim::pioTotalPuts(), putsBefore + 1);
+        CHECK(hostsim::pioPulseMicros(sm) > before);
+
+        // Outside a frame, writes go straight through as before
+        servo.setServoPosition(servo.getServoPosition() - 10);
+        CHECK_EQ(hostsim::pioTotalPuts(), putsBefore + 2);
+        CHECK_EQ(hostsim::pioPulseMicros(sm), before);
+    }
+
+    void testFrameLandsTogether() {
+        hostsim::setMicros(5 * REFRESH_INTERVAL + 1000);
+        moveAllJoints(5);
+        updateHand();
+
+        // Every servo the frame changed was written at the same moment
+        uint64_t when = 0;
+        int written = 0;
+        for (int index = 0; index < NUM_SERVOS; index++) {
+            const hostsim::PioStateMachine& machine = hostsim::pioStateMachine(stateMachineFor(index));
+            if (machine.lastPutMicros >= 5 * REFRESH_INTERVAL) {
+                if (written == 0) {
+                    when = machine.lastPutMicros;
+                }
+                CHECK_EQ(machine.lastPutMicros, when);
+                written++;
+            }
+        }
+        CHECK(written > 0);
+        CHECK_EQ(when, 5 * REFRESH_INTERVAL + 1000);
+        CHECK_EQ(ManagedServo::getLastFrameSpreadUs(), 0);
+    }
+
+    void testCommitDefersAtRefreshBoundary() {
+        // Too close to the end of the period - the frame stays staged, and the
+        // commit returns straight away
+        const hostsim::PioStateMachine& indexTip = hostsim::pioStateMachine(stateMachineFor(SERVO_INDEX_TIP));
+        uint64_t lastPut = indexTip.lastPutMicros;
+        uint32_t committed = ManagedServo::getFramesCommitted();
+        uint32_t deferred = ManagedServo::getFramesDeferred();
+        hostsim::setMicros(7 * REFRESH_INTERVAL - FRAME_COMMIT_GUARD_US / 2);
+        moveAllJoints(10);
+        updateHand();
+        CHECK_EQ(hostsim::nowMicros(), 7 * REFRESH_INTERVAL - FRAME_COMMIT_GUARD_US / 2);
+        CHECK_EQ(indexTip.lastPutMicros, lastPut);
+        CHECK_EQ(ManagedServo::getFramesCommitted(), committed);
+        CHECK_EQ(ManagedServo::getFramesDeferred(), deferred + 1);
+
+        // The next commit sends it, with nothing new of its own
+        hostsim::setMicros(7 * REFRESH_INTERVAL + 10000 - FRAME_COMMIT_GUARD_US / 2);
+        ManagedServo::beginFrame();
+        ManagedServo::commitFrame();
+        CHECK_EQ(indexTip.lastPutMicros, 7 * REFRESH_INTERVAL + 10000 - FRAME_COMMIT_GUARD_US / 2);
+        CHECK_EQ(ManagedServo::getFramesCommitted(), committed + 1);
+        uint16_t sent = hostsim::pioPulseMicros(stateMachineFor(SERVO_INDEX_TIP));
+
+        // A deferred position is replaced by a later one for the same servo
+        hostsim::setMicros(8 * REFRESH_INTERVAL - FRAME_COMMIT_GUARD_US / 2);
+        moveAllJoints(5);
+        updateHand();
+        moveAllJoints(10);
+        hostsim::setMicros(8 * REFRESH_INTERVAL + 5000);
+        updateHand();
+        CHECK_EQ(hostsim::pioPulseMicros(stateMachineFor(SERVO_INDEX_TIP)), sent);
+        CHECK_EQ(indexTip.lastPutMicros, 7 * REFRESH_INTERVAL + 10000 - FRAME_COMMIT_GUARD_US / 2);
+
+        // And a direct write isn't undone by a deferred one
+        ManagedServo& tip = managedServos[SERVO_INDEX_TIP];
+        uint8_t position = tip.getServoPosition();
+        hostsim::setMicros(9 * REFRESH_INTERVAL - FRAME_COMMIT_GUARD_US / 2);
+        ManagedServo::beginFrame();
+        tip.setServoPosition(position - 5);
+        ManagedServo::commitFrame();
+        tip.setServoPosition(position + 5);
+        uint16_t direct = hostsim::pioPulseMicros(stateMachineFor(SERVO_INDEX_TIP));
+        hostsim::setMicros(9 * REFRESH_INTERVAL + 5000);
+        ManagedServo::beginFrame();
+        ManagedServo::commitFrame();
+        CHECK_EQ(hostsim::pioPulseMicros(stateMachineFor(SERVO_INDEX_TIP)), direct);
+        CHECK_EQ(indexTip.lastPutMicros, 9 * REFRESH_INTERVAL - FRAME_COMMIT_GUARD_US / 2);
+
+        // Anywhere else in the period, it goes straight out
+        hostsim::setMicros(9 * REFRESH_INTERVAL + 10000);
+        moveAllJoints(5);
+        updateHand();
+        CHECK_EQ(indexTip.lastPutMicros, 9 * REFRESH_INTERVAL + 10000);
+    }
+
+    void testSpreadIsReported() {
+        const uint32_t putMicros = 3;
+        hostsim::setPioPutMicros(putMicros);
+        hostsim::setMicros(10 * REFRESH_INTERVAL);
+
+        ManagedServo::resetWriteCounters();
+        moveAllJoints(10);
+        updateHand();
+
+        uint32_t issued = ManagedServo::getWritesIssued();
+        CHECK(issued > 1);
+        CHECK_EQ(ManagedServo::getLastFrameSpreadUs(), issued * putMicros);
+        CHECK_EQ(ManagedServo::getMaxFrameSpreadUs(), issued * putMicros);
+        CHECK_EQ(ManagedServo::getFramesCommitted(), 1);
+
+        // A static frame writes nothing, so there is no spread
+        updateHand();
+        CHECK_EQ(ManagedServo::getLastFrameSpreadUs(), 0);
+        CHECK_EQ(ManagedServo::getMaxFrameSpreadUs(), issued * putMicros);
+
+        hostsim::setPioPutMicros(0);
+    }
+}
+
+int main() {
+    hostsim::setMicros(0);
+    setupServos();
+    setMotionLimiting(false);    // Servos follow the targets directly
+    setDefaultPose();
+
+    testWritesAreStagedUntilCommit();
+    testFrameLandsTogether();
+    testCommitDefersAtRefreshBoundary();
+    testSpreadIsReported();
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,271 @@
+// Checks the gesture player: steps and sweeps land on schedule, the wrist
+// reaches the ends of a wave under its motion limits, repeats run the right
+// number of times, late ticks don't stretch a gesture, queued gestures
+// follow on, and streamed frames either stop a gesture or blend with it.
+
+#include "DofStream.h"
+#include "Gestures.h"
+#include "Hand.h"
+#include "TestUtils.h"
+
+namespace {
+
+    const uint32_t TICK_US = 1000000 / CONTROL_RATE_HZ;
+
+    const int INDEX_FLEXION = 2;
+    const int WRIST_YAW = 16;
+
+    // Control ticks at the control rate until the given time in ms
+    void tickUntil(uint32_t ms) {
+        while (millis() < ms) {
+            hostsim::advanceMicros(TICK_US);
+            controlTick();
+        }
+    }
+
+    void streamFrame(uint16_t sequence, int16_t indexFlexion, int16_t wristYaw) {
+        int16_t centidegrees[DOF_COUNT] = {};
+        centidegrees[INDEX_FLEXION] = static_cast<int16_t>(indexFlexion * 100);
+        centidegrees[WRIST_YAW] = static_cast<int16_t>(wristYaw * 100);
+        uint8_t packet[DOF_MAX_PACKET_LENGTH];
+        int length = encodeDofPacketV2(centidegrees, sequence, millis() * 1000u, packet);
+        CHECK_EQ(receiveDofPacket(packet, length), DOF_PACKET_OK);
+    }
+
+    void restart() {
+        gesturePlayer.stop();
+        gesturePlayer.setStreamMode(GESTURE_STREAM_PREEMPT);
+        resetDofStreamCounters();
+        restartDofStream();
+        setDefaultPose();
+        hostsim::setMicros(0);
+    }
+
+    void testWave() {
+        restart();
+        const Gesture* wave = findGesture("wave");
+        CHECK(wave != nullptr);
+        CHECK(findGesture("juggle") == nullptr);
+
+        gesturePlayer.play(*wave, millis());
+        CHECK(gesturePlayer.isPlaying());
+
+        // The sweep runs from -40 to 40, holds there, and comes back again
+        tickUntil(WAVE_SWEEP_MS / 4);
+        CHECK_EQ(wrist.getYaw(), -20);
+        tickUntil(WAVE_SWEEP_MS / 2);
+        CHECK_EQ(wrist.getYaw(), 0);
+        tickUntil(WAVE_SWEEP_MS);
+        CHECK_EQ(wrist.getYaw(), 40);
+        tickUntil(WAVE_SWEEP_MS + WAVE_HOLD_MS);
+        CHECK_EQ(wrist.getYaw(), 40);
+        tickUntil(WAVE_SWEEP_MS + WAVE_HOLD_MS + WAVE_SWEEP_MS / 2);
+        CHECK_EQ(wrist.getYaw(), 0);
+
+        // Five times over, and it ends on the default pose
+        int peaks = 0;
+        bool atPeak = false;
+        while (gesturePlayer.isPlaying()) {
+            tickUntil(millis() + 10);
+            if (wrist.getYaw() == 40 && !atPeak) {
+                peaks++;
+            }
+            atPeak = wrist.getYaw() == 40;
+        }
+        CHECK_EQ(peaks, 4);             // The first was before the loop
+        CHECK_EQ(millis(), WAVE_MS);
+        CHECK_EQ(gesturePlayer.getPreempted(), 0);
+    }
+
+    void checkLimitedSweeps(const char* name, int16_t yaw, uint32_t sweepMs, uint32_t holdMs) {
+        // With the wrist's motion limits on it still reaches each end of the
+        // sweep before the hold is over, and doesn't overshoot
+        restart();
+        wrist.setYaw(0);
+        setMotionLimiting(true);
+        gesturePlayer.play(*findGesture(name), millis());
+
+        int end = yaw;
+        int furthest = 0;
+        for (int sweep = 1; sweep <= 10; sweep++) {
+            uint32_t endMs = sweep * (sweepMs + holdMs);
+            while (millis() < endMs) {
+                tickUntil(millis() + 10);
+                int position = wrist.getYawPosition();
+                if (position > furthest || -position > furthest) {
+                    furthest = position > 0 ? position : -position;
+                }
+            }
+            CHECK_EQ(wrist.getYawPosition(), end);
+            end = -end;
+        }
+        CHECK_EQ(furthest, yaw);
+        CHECK(!gesturePlayer.isPlaying());
+
+        // And it ends on the default pose, with the wrist settled so the
+        // limiter doesn't move the servos off it again
+        tickUntil(millis() + 100);
+        CHECK_EQ(managedServos[SERVO_WRIST_L].getServoPosition(), managedServos[SERVO_WRIST_L].getDefaultPosition());
+        CHECK_EQ(managedServos[SERVO_WRIST_R].getServoPosition(), managedServos[SERVO_WRIST_R].getDefaultPosition());
+        setMotionLimiting(false);
+    }
+
+    void testLimitedSweeps() {
+        checkLimitedSweeps("wave", WAVE_YAW, WAVE_SWEEP_MS, WAVE_HOLD_MS);
+        checkLimitedSweeps("shaka", SHAKA_YAW, SHAKA_SWEEP_MS, SHAKA_HOLD_MS);
+    }
+
+    void testLateTicks() {
+        // A tick that comes late catches up, and the gesture ends on time
+        restart();
+        gesturePlayer.play(*findGesture("count"), millis());
+
+        hostsim::setMicros(1500 * 1000);
+        controlTick();
+        CHECK_EQ(gesturePlayer.getStep(), 2);       // Zero at 200ms, one at 1200ms
+
+        hostsim::setMicros(11199 * 1000);
+        controlTick();
+        CHECK(gesturePlayer.isPlaying());
+        hostsim::setMicros(11200 * 1000);
+        controlTick();
+        CHECK(!gesturePlayer.isPlaying());
+    }
+
+    void testQueue() {
+        restart();
+        uint32_t played = gesturePlayer.getPlayed();
+        const Gesture& wave = *findGesture("wave");
+        CHECK(gesturePlayer.queue(wave, millis()));
+        CHECK(gesturePlayer.isPlaying());
+        for (int i = 0; i < GESTURE_QUEUE_LENGTH; i++) {
+            CHECK(gesturePlayer.queue(wave, millis()));
+        }
+        CHECK(!gesturePlayer.queue(wave, millis()));
+
+        // The second starts where the first ended, not at the next tick
+        hostsim::setMicros((WAVE_MS + WAVE_SWEEP_MS / 4) * 1000);
+        controlTick();
+        CHECK_EQ(gesturePlayer.getPlayed(), played + 2);
+        CHECK_EQ(wrist.getYaw(), -20);
+
+        gesturePlayer.stop();
+        CHECK(!gesturePlayer.isPlaying());
+        controlTick();
+        CHECK_EQ(gesturePlayer.getPlayed(), played + 2);
+    }
+
+    void testPreempt() {
+        restart();
+        gesturePlayer.play(*findGesture("wave"), millis());
+        tickUntil(100);
+        CHECK(gesturePlayer.isPlaying());
+
+        // The first streamed frame takes over
+        streamFrame(1, 50, 10);
+        tickUntil(110);
+        CHECK(!gesturePlayer.isPlaying());
+        CHECK_EQ(gesturePlayer.getPreempted(), 1);
+        CHECK_EQ(wrist.getYaw(), 10);
+        CHECK_EQ(fingers[FINGER_INDEX].getFlexion(), 50);
+    }
+
+    void testBlend() {
+        restart();
+        uint32_t preempted = gesturePlayer.getPreempted();
+        gesturePlayer.setStreamMode(GESTURE_STREAM_BLEND);
+        gesturePlayer.play(*findGesture("wave"), millis());
+        CHECK_EQ(gesturePlayer.getStreamJoints(), HAND_JOINTS_ALL & ~HAND_JOINT_WRIST);
+
+        // The wave keeps the wrist, and the stream drives the fingers
+        tickUntil(WAVE_SWEEP_MS / 4 - 10);
+        streamFrame(1, 50, 10);
+        tickUntil(WAVE_SWEEP_MS / 4);
+        CHECK(gesturePlayer.isPlaying());
+        CHECK_EQ(gesturePlayer.getPreempted(), preempted);
+        CHECK_EQ(wrist.getYaw(), -20);
+        CHECK_EQ(fingers[FINGER_INDEX].getFlexion(), 50);
+
+        // Once it's over the stream has the whole hand again
+        tickUntil(WAVE_MS);
+        CHECK(!gesturePlayer.isPlaying());
+        CHECK_EQ(gesturePlayer.getStreamJoints(), HAND_JOINTS_ALL);
+        streamFrame(2, 60, 10);
+        tickUntil(WAVE_MS + 10);
+        CHECK_EQ(wrist.getYaw(), 10);
+    }
+
+    void testBlendKeepsStreamedJoints() {
+        // A wave only claims the wrist, so its default pose steps leave the
+        // fingers where the stream put them
+        restart();
+        gesturePlayer.setStreamMode(GESTURE_STREAM_BLEND);
+        streamFrame(1, 50, 10);
+        tickUntil(10);
+        ManagedServo& flexion = managedServos[FINGER_CONFIG[FINGER_INDEX].flexionServo];
+        uint8_t streamed = flexion.getServoPosition();
+        CHECK(streamed != flexion.getDefaultPosition());
+
+        gesturePlayer.play(*findGesture("wave"), millis());
+        tickUntil(20);
+        CHECK_EQ(flexion.getServoPosition(), streamed);
+        tickUntil(WAVE_MS + 20);
+        CHECK(!gesturePlayer.isPlaying());
+        CHECK_EQ(flexion.getServoPosition(), streamed);
+        CHECK_EQ(fingers[FINGER_INDEX].getFlexion(), 50);
+        CHECK_EQ(managedServos[SERVO_WRIST_L].getServoPosition(), managedServos[SERVO_WRIST_L].getDefaultPosition());
+    }
+
+    void testHeldFrames() {
+        // A jitter buffer holding its last frame isn't a new frame, and
+        // doesn't stop a gesture started after the stream went quiet
+        restart();
+        setDofJitterDelay(DOF_JITTER_DELAY_MS);
+        streamFrame(1, 50, 10);
+        tickUntil(200);
+        CHECK_EQ(wrist.getYaw(), 10);
+
+        uint32_t preempted = gesturePlayer.getPreempted();
+        gesturePlayer.play(*findGesture("wave"), millis());
+        tickUntil(200 + WAVE_SWEEP_MS / 4);
+        CHECK(gesturePlayer.isPlaying());
+        CHECK_EQ(gesturePlayer.getPreempted(), preempted);
+        CHECK_EQ(wrist.getYaw(), -20);
+        setDofJitterDelay(0);
+    }
+
+    void testThumbTest() {
+        // The left servo steps fastest, and neither leaves its range
+        restart();
+        gesturePlayer.play(*findGesture("thumbtest"), millis());
+        tickUntil(100);
+        CHECK_EQ(managedServos[SERVO_THUMB_RIGHT].getServoPosition(), SERVO_CONFIG[SERVO_THUMB_RIGHT].minPosition);
+        CHECK_EQ(managedServos[SERVO_THUMB_LEFT].getServoPosition(), SERVO_CONFIG[SERVO_THUMB_LEFT].minPosition + 5);
+
+        while (gesturePlayer.getStep() == 0) {
+            tickUntil(millis() + 10);
+            if (gesturePlayer.getStep() == 0) {
+                CHECK(managedServos[SERVO_THUMB_LEFT].getServoPosition() <= SERVO_CONFIG[SERVO_THUMB_LEFT].maxPosition);
+            }
+        }
+        CHECK(!gesturePlayer.isPlaying());
+    }
+}
+
+int main() {
+    setupServos();
+    setMotionLimiting(false);    // Servos follow the targets directly
+    setDofJitterDelay(0);        // Frames are applied as they arrive
+
+    testWave();
+    testLimitedSweeps();
+    testLateTicks();
+    testQueue();
+    testPreempt();
+    testBlend();
+    testBlendKeepsStreamedJoints();
+    testHeldFrames();
+    testThumbTest();
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,303 @@
+// Checks the jitter buffer: interpolation between buffered frames, holding
+// the newest frame when it runs dry, dead reckoning across a gap and blending
+// back out of it, overflow and clock resync, and that a stream sent at an
+// uneven rate and bunched up by the link comes out of the control tick as
+// smooth motion with bounded latency.
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "DofStream.h"
+#include "Hand.h"
+#include "TestUtils.h"
+
+namespace {
+
+    const uint32_t TICK_US = 1000000 / CONTROL_RATE_HZ;
+
+    DofFrame makeFrame(int16_t degrees, uint16_t sequence, uint32_t timestamp) {
+        DofFrame frame = {};
+        frame.angles[0] = static_cast<int16_t>(degrees * DOF_V2_ANGLE_SCALE);
+        frame.mask = DOF_ALL_MASK;
+        frame.sequence = sequence;
+        frame.timestamp = timestamp;
+        frame.version = DOF_PROTOCOL_V2;
+        return frame;
+    }
+
+    // The first DOF as the joint gets it
+    int16_t degrees(const DofFrame& frame) {
+        return dofAngleDegrees(frame.angles[0]);
+    }
+
+    void testInterpolation() {
+        JitterBuffer buffer(50000);
+        DofFrame frame;
+
+        // Three frames 1ms in transit, arriving together
+        for (int i = 0; i < 3; i++) {
+            CHECK(buffer.push(makeFrame(static_cast<int16_t>(i * 30), static_cast<uint16_t>(i), i * 33333u), i * 33333u + 1000));
+        }
+        CHECK_EQ(buffer.getDepth(), 3);
+
+        // Nothing plays until the target delay has passed
+        CHECK(!buffer.sample(50999, frame));
+        CHECK(buffer.sample(51000, frame));
+        CHECK_EQ(degrees(frame), 0);
+        CHECK_EQ(buffer.getLastLatencyUs(), 50000);
+
+        // Half way between the first two frames, then a third of the way between the next two
+        CHECK(buffer.sample(51000 + 16667, frame));
+        CHECK_EQ(degrees(frame), 15);
+        CHECK(buffer.sample(51000 + 33333 + 11111, frame));
+        CHECK_EQ(degrees(frame), 40);
+        CHECK_EQ(buffer.getPlayed(), 2);
+        CHECK_EQ(buffer.getUnderruns(), 0);
+
+        // Past the newest frame, it's held and the underrun counted once
+        CHECK(buffer.sample(51000 + 70000, frame));
+        CHECK_EQ(degrees(frame), 60);
+        CHECK(buffer.sample(51000 + 80000, frame));
+        CHECK_EQ(degrees(frame), 60);
+        CHECK_EQ(buffer.getUnderruns(), 1);
+        CHECK_EQ(buffer.getDepth(), 1);
+
+        // A frame that turns up after its playout time is counted as late
+        CHECK(buffer.push(makeFrame(90, 3, 70000), 51000 + 80000));
+        CHECK(buffer.sample(51000 + 90000, frame));
+        CHECK_EQ(buffer.getLate(), 1);
+        CHECK_EQ(degrees(frame), 90);
+
+        // Hundredths of a degree are kept through the interpolation, and
+        // only rounded as the frame reaches the joints
+        buffer.reset();
+        DofFrame from = makeFrame(0, 10, 1000000u);
+        DofFrame to = makeFrame(0, 11, 1000000u + 30000);
+        to.angles[0] = 150;
+        CHECK(buffer.push(from, 1001000));
+        CHECK(buffer.push(to, 1031000));
+        CHECK(buffer.sample(1051000 + 10000, frame));
+        CHECK_EQ(frame.angles[0], 50);
+        CHECK_EQ(degrees(frame), 1);
+        CHECK(buffer.sample(1051000 + 20000, frame));
+        CHECK_EQ(frame.angles[0], 100);
+    }
+
+    // 10 degrees a frame at 30 Hz, 1ms in transit, played up to the newest
+    // frame at 51000 + 3 * 33333
+    void playRamp(JitterBuffer& buffer) {
+        DofFrame frame;
+        for (int i = 0; i < 4; i++) {
+            CHECK(buffer.push(makeFrame(static_cast<int16_t>(i * 10), static_cast<uint16_t>(i), i * 33333u), i * 33333u + 1000));
+        }
+        for (int i = 0; i < 4; i++) {
+            CHECK(buffer.sample(51000 + i * 33333u, frame));
+            CHECK_EQ(degrees(frame), i * 10);
+        }
+    }
+
+    void testDeadReckoning() {
+        JitterBuffer buffer(50000, 60000);
+        DofFrame frame;
+        playRamp(buffer);
+
+        // Run dry on the newest frame, it carries on at the same speed up to
+        // the horizon, then eases back to the frame over another one
+        uint32_t dryUs = 51000 + 3 * 33333u;
+        CHECK(buffer.sample(dryUs + 16667, frame));
+        CHECK_EQ(degrees(frame), 35);
+        CHECK(buffer.sample(dryUs + 60000, frame));
+        CHECK_EQ(degrees(frame), 48);
+        CHECK(buffer.sample(dryUs + 90000, frame));
+        CHECK_EQ(degrees(frame), 39);
+        CHECK(buffer.sample(dryUs + 120000, frame));
+        CHECK_EQ(degrees(frame), 30);
+        CHECK(buffer.sample(dryUs + 200000, frame));
+        CHECK_EQ(degrees(frame), 30);
+        CHECK_EQ(buffer.getUnderruns(), 1);
+        CHECK_EQ(buffer.getExtrapolations(), 1);
+
+        // The same again, but frames showing the hand stopped arrive part way
+        // through. The step back to them is faded out over the blend.
+        buffer.reset();
+        playRamp(buffer);
+        CHECK(buffer.sample(dryUs + 30000, frame));
+        CHECK_EQ(degrees(frame), 39);
+        CHECK(buffer.push(makeFrame(30, 4, 4 * 33333u), dryUs + 30000));
+        CHECK(buffer.push(makeFrame(30, 5, 5 * 33333u), dryUs + 30000));
+        CHECK(buffer.sample(dryUs + 40000, frame));
+        CHECK_EQ(degrees(frame), 39);
+        CHECK(buffer.sample(dryUs + 40000 + JITTER_BLEND_MS * 500, frame));
+        CHECK_EQ(degrees(frame), 35);
+        CHECK(buffer.sample(dryUs + 40000 + JITTER_BLEND_MS * 1000, frame));
+        CHECK_EQ(degrees(frame), 30);
+
+        // Frames too far apart to take a speed from, and with dead reckoning
+        // off, the newest frame is held
+        buffer.reset();
+        CHECK(buffer.push(makeFrame(0, 0, 0), 1000));
+        CHECK(buffer.push(makeFrame(50, 1, 200000), 201000));
+        CHECK(buffer.sample(51000, frame));
+        CHECK(buffer.sample(251000, frame));
+        CHECK(buffer.sample(291000, frame));
+        CHECK_EQ(degrees(frame), 50);
+
+        buffer.reset();
+        buffer.resetCounters();
+        buffer.setExtrapolationUs(0);
+        playRamp(buffer);
+        CHECK(buffer.sample(dryUs + 30000, frame));
+        CHECK_EQ(degrees(frame), 30);
+        CHECK_EQ(buffer.getUnderruns(), 1);
+        CHECK_EQ(buffer.getExtrapolations(), 0);
+    }
+
+    void testOverflowAndResync() {
+        JitterBuffer buffer(20000);
+        DofFrame frame;
+
+        int accepted = 0;
+        for (int i = 0; i < JITTER_BUFFER_FRAMES + 4; i++) {
+            accepted += buffer.push(makeFrame(0, static_cast<uint16_t>(i), i * 10000u), i * 10000u);
+        }
+        CHECK_EQ(accepted, JITTER_BUFFER_FRAMES);
+        CHECK_EQ(buffer.getOverflows(), 4);
+
+        // Play everything out, then the sender's clock jumps ten seconds
+        CHECK(buffer.sample(JITTER_BUFFER_FRAMES * 10000u + 20000, frame));
+        CHECK_EQ(buffer.getDepth(), 1);
+        uint32_t now = JITTER_BUFFER_FRAMES * 10000u + 30000;
+        CHECK(buffer.push(makeFrame(20, 100, 10000000u), now));
+        CHECK(buffer.push(makeFrame(40, 101, 10010000u), now + 10000));
+        CHECK(buffer.sample(now + 20000, frame));
+        CHECK_EQ(buffer.getResyncs(), 1);
+        CHECK_EQ(degrees(frame), 20);
+        CHECK(buffer.sample(now + 25000, frame));
+        CHECK_EQ(degrees(frame), 30);
+
+        buffer.reset();
+        CHECK_EQ(buffer.getDepth(), 0);
+        CHECK(!buffer.sample(now + 30000, frame));
+
+        // Zeroing the counters leaves the producer's count alone, and the
+        // overflows start again from where it stood
+        buffer.resetCounters();
+        CHECK_EQ(buffer.getOverflows(), 0);
+        for (int i = 0; i < JITTER_BUFFER_FRAMES + 2; i++) {
+            buffer.push(makeFrame(0, static_cast<uint16_t>(200 + i), 20000000u + i * 10000u), now + 40000);
+        }
+        CHECK_EQ(buffer.getOverflows(), 2);
+        buffer.reset();
+        CHECK_EQ(buffer.getDepth(), 0);
+    }
+
+    struct Arrival {
+        uint64_t arrivalUs;
+        uint16_t sequence;
+        uint32_t senderUs;
+        int16_t centidegrees;
+    };
+
+    // Wrist yaw sweeping at 40 degrees/s, sent at an uneven 15-30 Hz and
+    // delivered on 12.5ms connection events with up to 20ms of extra delay.
+    std::vector<Arrival> makeStream(uint64_t startUs) {
+        std::vector<Arrival> stream;
+        uint32_t seed = 0x0badf00d;
+        uint32_t senderUs = 0;
+        uint64_t lastArrival = 0;
+
+        for (uint16_t sequence = 0; senderUs < 1500000; sequence++) {
+            seed = seed * 1664525u + 1013904223u;
+            uint32_t transit = 5000 + (seed >> 8) % 20000;
+            uint64_t arrival = startUs + senderUs + transit;
+            arrival = (arrival + 12499) / 12500 * 12500;
+            arrival = arrival < lastArrival ? lastArrival : arrival;
+            lastArrival = arrival;
+
+            int16_t centidegrees = static_cast<int16_t>(-3000 + static_cast<int32_t>(senderUs / 250));
+            stream.push_back({ arrival, sequence, senderUs, centidegrees });
+
+            seed = seed * 1664525u + 1013904223u;
+            senderUs += 33333 + (seed >> 8) % 33334;
+        }
+        return stream;
+    }
+
+    // Plays the stream through the BLE receive path and the control tick, and
+    // returns the largest change in wrist yaw between two ticks while it moves
+    int playStream(uint16_t delayMs, int& stalls) {
+        setDofJitterDelay(delayMs);
+        resetDofStreamCounters();
+        restartDofStream();
+        hostsim::setMicros(1000000);
+
+        std::vector<Arrival> stream = makeStream(hostsim::nowMicros());
+        size_t next = 0;
+        int16_t lastYaw = wrist.getYaw();
+        int maxStep = 0;
+        bool moving = false;
+        stalls = 0;
+
+        while (next < stream.size()) {
+            while (next < stream.size() && stream[next].arrivalUs <= hostsim::nowMicros()) {
+                int16_t centidegrees[DOF_COUNT] = {};
+                centidegrees[16] = stream[next].centidegrees;
+                uint8_t packet[DOF_MAX_PACKET_LENGTH];
+                int length = encodeDofPacketV2(centidegrees, stream[next].sequence, stream[next].senderUs, packet);
+                CHECK_EQ(receiveDofPacket(packet, length), DOF_PACKET_OK);
+                next++;
+            }
+
+            controlTick();
+
+            int16_t yaw = wrist.getYaw();
+            int step = yaw > lastYaw ? yaw - lastYaw : lastYaw - yaw;
+            if (moving && next < stream.size()) {
+                maxStep = step > maxStep ? step : maxStep;
+                stalls += step == 0;
+            }
+            moving = moving || step != 0;
+            lastYaw = yaw;
+            hostsim::advanceMicros(TICK_US);
+        }
+        return maxStep;
+    }
+
+    void testSmoothPlayout() {
+        int stallsDirect = 0;
+        int stallsBuffered = 0;
+        int stepDirect = playStream(0, stallsDirect);
+        int stepBuffered = playStream(DOF_JITTER_DELAY_MS, stallsBuffered);
+
+        // 40 degrees/s is 0.4 degrees a tick, so the buffered motion never
+        // jumps more than a degree or holds still for long
+        CHECK(stepBuffered <= 1);
+        CHECK(stepDirect >= 3);
+        CHECK(stallsBuffered < stallsDirect);
+
+        CHECK_EQ(dofJitterBuffer.getUnderruns(), 0);
+        CHECK_EQ(dofJitterBuffer.getOverflows(), 0);
+        CHECK_EQ(dofJitterBuffer.getLate(), 0);
+        CHECK(dofJitterBuffer.getMaxDepth() <= 4);
+        CHECK(dofJitterBuffer.getMaxLatencyUs() <= DOF_JITTER_DELAY_MS * 1000u + TICK_US);
+        CHECK(dofJitterBuffer.getMeanLatencyUs() >= 40000);
+
+        // Turning the buffer off empties it, and frames go to the mailbox again
+        setDofJitterDelay(0);
+        CHECK_EQ(dofJitterBuffer.getDepth(), 0);
+        CHECK_EQ(getDofJitterDelay(), 0);
+    }
+}
+
+int main() {
+    setupServos();
+    setMotionLimiting(false);    // Servos follow the targets directly
+
+    testInterpolation();
+    testDeadReckoning();
+    testOverflowAndResync();
+    testSmoothPlayout();
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,192 @@
+// Checks the latency histograms, and that streamed frames are timed through
+// every stage of the pipeline exactly once. Built twice, the second time
+// against a core with LATENCY_INSTRUMENTATION set to 0, where it checks that
+// nothing is recorded and the macros don't evaluate their arguments.
+
+#include "DofStream.h"
+#include "Hand.h"
+#include "Latency.h"
+#include "TestUtils.h"
+
+namespace {
+
+    void testBuckets() {
+        CHECK_EQ(LatencyHistogram::bucketOf(0), 0);
+        CHECK_EQ(LatencyHistogram::bucketOf(1), 1);
+        CHECK_EQ(LatencyHistogram::bucketOf(2), 2);
+        CHECK_EQ(LatencyHistogram::bucketOf(3), 2);
+        CHECK_EQ(LatencyHistogram::bucketOf(4), 3);
+        CHECK_EQ(LatencyHistogram::bucketOf(1000), 10);
+        CHECK_EQ(LatencyHistogram::bucketOf(1023), 10);
+        CHECK_EQ(LatencyHistogram::bucketOf(1024), 11);
+        CHECK_EQ(LatencyHistogram::bucketOf(UINT32_MAX), LATENCY_BUCKETS - 1);
+
+        // Every value is within its bucket's limits
+        for (uint32_t value = 1; value < 100000; value = value * 3 + 1) {
+            uint8_t bucket = LatencyHistogram::bucketOf(value);
+            CHECK(value <= LatencyHistogram::bucketMax(bucket));
+            CHECK(value > LatencyHistogram::bucketMax(bucket - 1));
+        }
+        CHECK_EQ(LatencyHistogram::bucketMax(LATENCY_BUCKETS - 1), UINT32_MAX);
+    }
+
+    void testPercentiles() {
+        LatencyHistogram histogram;
+        CHECK_EQ(histogram.getPercentile(50), 0);
+        CHECK_EQ(histogram.getMin(), 0);
+        CHECK_EQ(histogram.getMean(), 0);
+
+        // 90 fast values and 10 slow ones
+        for (int i = 0; i < 90; i++) {
+            histogram.record(100);
+        }
+        for (int i = 0; i < 10; i++) {
+            histogram.record(5000);
+        }
+        CHECK_EQ(histogram.getCount(), 100);
+        CHECK_EQ(histogram.getMin(), 100);
+        CHECK_EQ(histogram.getMax(), 5000);
+        CHECK_EQ(histogram.getMean(), 590);
+        CHECK_EQ(histogram.getBucket(7), 90);
+        CHECK_EQ(histogram.getBucket(13), 10);
+
+        CHECK_EQ(histogram.getPercentile(50), 127);
+        CHECK_EQ(histogram.getPercentile(90), 127);
+        CHECK_EQ(histogram.getPercentile(91), 5000);     // No more than the largest value
+        CHECK_EQ(histogram.getPercentile(100), 5000);
+
+        histogram.reset();
+        CHECK_EQ(histogram.getCount(), 0);
+        CHECK_EQ(histogram.getMax(), 0);
+        CHECK_EQ(histogram.getBucket(7), 0);
+        histogram.record(0);
+        CHECK_EQ(histogram.getPercentile(99), 0);
+    }
+
+    void streamFrames(int count) {
+        int16_t centidegrees[DOF_COUNT] = {};
+        uint8_t packet[DOF_MAX_PACKET_LENGTH];
+        for (int i = 0; i < count; i++) {
+            centidegrees[16] = static_cast<int16_t>(i * 100);
+            int length = encodeDofPacketV2(centidegrees, static_cast<uint16_t>(i), i * 10000u, packet);
+            CHECK_EQ(receiveDofPacket(packet, length), DOF_PACKET_OK);
+            controlTick();
+
+            // Ticks with nothing new don't count again
+            controlTick();
+        }
+
+        // Rejected packets are counted, but not timed
+        packet[3] ^= 0xff;
+        CHECK_EQ(receiveDofPacket(packet, DOF_V2_PACKET_LENGTH), DOF_PACKET_BAD_CHECKSUM);
+    }
+
+#if LATENCY_INSTRUMENTATION
+
+    void testPipeline() {
+        resetLatency();
+        resetDofStreamCounters();
+        restartDofStream();
+        streamFrames(20);
+
+        CHECK_EQ(latencyHistograms[LATENCY_VALIDATE].getCount(), 20);
+        CHECK_EQ(latencyHistograms[LATENCY_QUEUE].getCount(), 20);
+        CHECK_EQ(latencyHistograms[LATENCY_APPLY].getCount(), 20);
+        CHECK_EQ(latencyHistograms[LATENCY_UPDATE].getCount(), 20);
+        CHECK_EQ(latencyHistograms[LATENCY_SERVO_WRITE].getCount(), 20);
+        CHECK_EQ(latencyHistograms[LATENCY_END_TO_END].getCount(), 20);
+
+        // End to end covers every other stage
+        CHECK(latencyHistograms[LATENCY_END_TO_END].getMin() >= latencyHistograms[LATENCY_APPLY].getMin());
+        CHECK(latencyHistograms[LATENCY_END_TO_END].getMax() >= latencyHistograms[LATENCY_SERVO_WRITE].getMin());
+
+        uint8_t stats[LATENCY_STATS_LENGTH];
+        CHECK_EQ(encodeLatencyStats(stats), LATENCY_STATS_LENGTH);
+        CHECK_EQ(stats[0], LATENCY_STATS_VERSION);
+        CHECK_EQ(stats[1], LATENCY_STAGES);
+        CHECK_EQ(stats[2] | (stats[3] << 8), LATENCY_TICKS_PER_US);
+        CHECK_EQ(stats[4], 21);         // Received
+        CHECK_EQ(stats[12], 1);         // Bad checksum
+
+        // Each stage's bucket counts add up to its count
+        for (int stage = 0; stage < LATENCY_STAGES; stage++) {
+            const uint8_t* entry = stats + 20 + stage * (8 + 2 * LATENCY_BUCKETS);
+            CHECK_EQ(entry[0], 20);
+            int total = 0;
+            for (int bucket = 0; bucket < LATENCY_BUCKETS; bucket++) {
+                total += entry[8 + bucket * 2] | (entry[9 + bucket * 2] << 8);
+            }
+            CHECK_EQ(total, 20);
+        }
+
+        resetLatency();
+        CHECK_EQ(latencyHistograms[LATENCY_END_TO_END].getCount(), 0);
+    }
+
+    void testJitterBufferedFrames() {
+        // Interpolated and held frames are timed once, when they start to play
+        setDofJitterDelay(DOF_JITTER_DELAY_MS);
+        resetLatency();
+        hostsim::setMicros(0);
+
+        int16_t centidegrees[DOF_COUNT] = {};
+        uint8_t packet[DOF_MAX_PACKET_LENGTH];
+        for (int i = 0; i < 10; i++) {
+            int length = encodeDofPacketV2(centidegrees, static_cast<uint16_t>(100 + i), i * 30000u, packet);
+            receiveDofPacket(packet, length);
+            for (int tick = 0; tick < 3; tick++) {
+                controlTick();
+                hostsim::advanceMicros(10000);
+            }
+        }
+        for (int tick = 0; tick < 20; tick++) {
+            controlTick();
+            hostsim::advanceMicros(10000);
+        }
+
+        CHECK_EQ(latencyHistograms[LATENCY_VALIDATE].getCount(), 10);
+        CHECK_EQ(latencyHistograms[LATENCY_QUEUE].getCount(), 10);
+        CHECK_EQ(latencyHistograms[LATENCY_END_TO_END].getCount(), 10);
+        CHECK(latencyHistograms[LATENCY_APPLY].getCount() > 10);
+        setDofJitterDelay(0);
+    }
+
+#else
+
+    int evaluated = 0;
+
+    // Only referenced from the compiled out macro, so unused by design
+    [[maybe_unused]] uint32_t sideEffect() {
+        return ++evaluated;
+    }
+
+    void testCompiledOut() {
+        LATENCY_START(start);
+        LATENCY_RECORD(LATENCY_APPLY, sideEffect());
+        CHECK_EQ(evaluated, 0);
+
+        streamFrames(5);
+        uint8_t stats[LATENCY_STATS_LENGTH];
+        CHECK_EQ(encodeLatencyStats(stats), 0);
+        CHECK_EQ(getDofFramesApplied(), 5);
+    }
+
+#endif
+}
+
+int main() {
+    setupServos();
+    setMotionLimiting(false);    // Servos follow the targets directly
+    setDofJitterDelay(0);        // Frames are applied as they arrive
+
+    testBuckets();
+    testPercentiles();
+#if LATENCY_INSTRUMENTATION
+    testPipeline();
+    testJitterBufferedFrames();
+#else
+    testCompiledOut();
+#endif
+
+    return TEST_RESULT();
+}
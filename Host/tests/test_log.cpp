@@ -0,0 +1,166 @@
+// Checks the log: messages are filtered by module and level before anything
+// is recorded, the control path only records and never prints, records come
+// out formatted in order a few at a time, a full ring drops and says so, and
+// binary frames carry just the id, time and the arguments the format uses.
+
+#include <string.h>
+
+#include <string>
+
+#include "Hand.h"
+#include "Log.h"
+#include "TestUtils.h"
+
+namespace {
+
+    void restart() {
+        resetLog();
+        setLogOutput(LOG_OUTPUT_TEXT);
+        setLogLevel(LOG_MODULES, LOG_LEVEL_WARN);
+        setLogLevel(LOG_MODULE_COMMAND, LOG_LEVEL_INFO);
+        hostsim::serialOutput().clear();
+    }
+
+    void testFiltering() {
+        restart();
+        CHECK(isLogEnabled(LOG_DOF_BAD_CHECKSUM));
+        CHECK(isLogEnabled(LOG_COMMAND));
+        CHECK(!isLogEnabled(LOG_FINGER_FLEXION_GAIN));
+
+        // Skipped messages don't get as far as their arguments
+        int evaluated = 0;
+        LOG(FINGER_FLEXION_GAIN, ++evaluated);
+        CHECK_EQ(evaluated, 0);
+        CHECK_EQ(getLogRecordsLogged(), 0);
+
+        setLogLevel(findLogModule("finger"), LOG_LEVEL_DEBUG);
+        LOG(FINGER_FLEXION_GAIN, ++evaluated);
+        CHECK_EQ(evaluated, 1);
+        CHECK_EQ(getLogRecordsLogged(), 1);
+
+        // One module's level leaves the others alone, and all can go off at once
+        CHECK(!isLogEnabled(LOG_THUMB_YAW_OVER));
+        setLogLevel(LOG_MODULES, LOG_LEVEL_OFF);
+        CHECK(!isLogEnabled(LOG_DOF_BAD_CHECKSUM));
+        CHECK(!isLogEnabled(LOG_COMMAND));
+        setLogLevel(LOG_MODULE_STREAM, LOG_LEVEL_ERROR);
+        CHECK(!isLogEnabled(LOG_DOF_BAD_CHECKSUM));
+
+        CHECK_EQ(findLogModule("stream"), LOG_MODULE_STREAM);
+        CHECK_EQ(findLogModule("nothing"), LOG_MODULES);
+        CHECK(strcmp(getLogModuleName(LOG_MODULE_THUMB), "thumb") == 0);
+    }
+
+    void testControlPathOnlyRecords() {
+        restart();
+        setupServos();
+        setMotionLimiting(false);
+        setLogLevel(LOG_MODULE_MIXER, LOG_LEVEL_DEBUG);
+        hostsim::serialOutput().clear();
+
+        fingers[0].setExtension(10);
+        updateHandJoints(HAND_JOINT_FINGER(0));
+        CHECK_EQ(getLogDepth(), 3);
+        CHECK(hostsim::serialOutput().empty());
+
+        drainLog(LOG_RING_RECORDS);
+        CHECK_EQ(getLogDepth(), 0);
+        CHECK(hostsim::serialOutput().find(" D mixer: Servo: ") != std::string::npos);
+    }
+
+    void testDrain() {
+        restart();
+        hostsim::setMicros(1000);
+        LOG_TEXT(COMMAND, "wave", 3, -20);
+        hostsim::setMicros(2000);
+        LOG(DOF_BAD_LENGTH, 7);
+        LOG(DOF_BAD_CHECKSUM);
+
+        // A few at a time, oldest first
+        CHECK_EQ(drainLog(2), 2);
+        CHECK(hostsim::serialOutput() == "LOG:1000 I command: CMD:wave:3:-20\r\nLOG:2000 W stream: Invalid DOF length: 7\r\n");
+        CHECK_EQ(getLogDepth(), 1);
+        CHECK_EQ(drainLog(2), 1);
+        CHECK_EQ(drainLog(2), 0);
+
+        // Text is cut to fit the record
+        restart();
+        LOG_TEXT(COMMAND, "fingerextension", 0, 0);
+        drainLog(1);
+        CHECK(hostsim::serialOutput().find("CMD:fingerexten:0:0") != std::string::npos);
+
+        // Every argument type
+        LogRecord record = {};
+        record.id = LOG_DROPPED;
+        record.args[0] = -1;
+        char line[LOG_MAX_LINE_LENGTH + 1];
+        formatLogRecord(record, line, sizeof(line));
+        CHECK(strcmp(line, "LOG:0 W system: 4294967295 messages dropped, the log was full") == 0);
+
+        // A line that doesn't fit is cut, and still terminated
+        CHECK_EQ(formatLogRecord(record, line, 12), 11);
+        CHECK(strcmp(line, "LOG:0 W sys") == 0);
+    }
+
+    void testFull() {
+        restart();
+        for (int i = 0; i < LOG_RING_RECORDS + 10; i++) {
+            LOG(DOF_BAD_LENGTH, i);
+        }
+        CHECK_EQ(getLogDepth(), LOG_RING_RECORDS);
+        CHECK_EQ(getLogRecordsDropped(), 10);
+        CHECK_EQ(getLogMaxDepth(), LOG_RING_RECORDS);
+
+        // The oldest are kept, then the drops are reported once the ring is empty
+        int printed = 0;
+        while (int count = drainLog(4)) {
+            printed += count;
+        }
+        CHECK_EQ(printed, LOG_RING_RECORDS + 1);
+        const std::string& output = hostsim::serialOutput();
+        CHECK(output.find("length: 0\r\n") != std::string::npos);
+        CHECK(output.find("length: 63\r\n") != std::string::npos);
+        CHECK(output.find("length: 64\r\n") == std::string::npos);
+        CHECK(output.find("W system: 10 messages dropped") != std::string::npos);
+        CHECK_EQ(drainLog(4), 0);
+
+        resetLogCounters();
+        CHECK_EQ(getLogRecordsDropped(), 0);
+    }
+
+    void testBinary() {
+        restart();
+        setLogOutput(LOG_OUTPUT_BINARY);
+        hostsim::setMicros(0x01020304);
+        LOG_TEXT(COMMAND, "wave", 3, -2);
+        LOG(DOF_BAD_CHECKSUM);
+        CHECK_EQ(drainLog(4), 2);
+
+        // Two ints and the text, then no arguments at all
+        const uint8_t expected[] = {
+            LOG_FRAME_SYNC, 17, LOG_COMMAND, 0x04, 0x03, 0x02, 0x01,
+            0x03, 0x00, 0x00, 0x00, 0xFE, 0xFF, 0xFF, 0xFF, 'w', 'a', 'v', 'e',
+            LOG_FRAME_SYNC, 5, LOG_DOF_BAD_CHECKSUM, 0x04, 0x03, 0x02, 0x01
+        };
+        const std::string& output = hostsim::serialOutput();
+        CHECK_EQ(output.size(), sizeof(expected));
+        CHECK(memcmp(output.data(), expected, sizeof(expected)) == 0);
+
+        // The longest frame fits
+        LogRecord record = {};
+        record.id = LOG_FINGER_YAW_MIX;
+        uint8_t frame[LOG_MAX_FRAME_LENGTH];
+        CHECK_EQ(encodeLogRecord(record, frame), 7 + 4 * 4);
+        CHECK_EQ(frame[1], 7 + 4 * 4 - 2);
+    }
+}
+
+int main() {
+    testFiltering();
+    testControlPathOnlyRecords();
+    testDrain();
+    testFull();
+    testBinary();
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,158 @@
+// Equivalence test for the mixer. Sweeps every integer angle of every joint
+// and checks the mixer gives exactly the servo positions the per-joint Q15
+// mixes in FixedKinematics.h do, with the default ranges and again after the
+// ranges, servo limits and yaw biases have been retuned the way the
+// calibration would.
+
+#include <stdio.h>
+
+#include "Hand.h"
+#include "Mixer.h"
+#include "../reference/FixedKinematics.h"
+#include "TestUtils.h"
+
+namespace {
+
+    struct Stats {
+        long compared = 0;
+        long mismatched = 0;
+
+        void add(int32_t mixed, int32_t expected) {
+            compared++;
+            if (mixed != expected) {
+                mismatched++;
+            }
+        }
+
+        void report(const char* name) const {
+            printf("  %-8s %8ld positions, %6ld differ\n", name, compared, mismatched);
+        }
+    };
+
+    // Compares the mixer with the reference at the joint's current angles
+    void compare(uint8_t joint, Stats& stats) {
+        uint8_t positions[NUM_SERVOS] = {};
+        int32_t expected[NUM_SERVOS] = {};
+        mixServos(HAND_JOINT(joint), positions);
+        reference::fixed::mixJoint(joint, expected);
+        for (int servo = 0; servo < NUM_SERVOS; servo++) {
+            if (SERVO_CONFIG[servo].joint == joint) {
+                stats.add(positions[servo], expected[servo]);
+            }
+        }
+    }
+
+    void sweepFingers(Stats& stats) {
+        for (int index = 0; index < NUM_FINGERS; index++) {
+            Finger& finger = fingers[index];
+            for (int pitch = finger.getPitchMin(); pitch <= finger.getPitchMax(); pitch++) {
+                for (int yaw = finger.getYawMin(); yaw <= finger.getYawMax(); yaw++) {
+                    for (int flexion = finger.getFlexionMin(); flexion <= finger.getFlexionMax(); flexion++) {
+                        finger.setPosition(pitch, yaw, flexion);
+                        compare(index, stats);
+                    }
+                }
+            }
+        }
+    }
+
+    void sweepThumb(Stats& stats) {
+        // A few degrees either side of the yaw range, which the setters clamp
+        for (int pitch = thumb.getPitchMin(); pitch <= thumb.getPitchMax(); pitch++) {
+            for (int yaw = thumb.getYawMin() - 5; yaw <= thumb.getYawMax() + 5; yaw++) {
+                for (int flexion = thumb.getFlexionMin(); flexion <= thumb.getFlexionMax(); flexion += 3) {
+                    for (int roll = thumb.getRollMin(); roll <= thumb.getRollMax(); roll += 5) {
+                        thumb.setPosition(pitch, yaw, flexion);
+                        thumb.setRoll(roll);
+                        compare(JOINT_THUMB, stats);
+                    }
+                }
+            }
+        }
+    }
+
+    void sweepWrist(Stats& stats) {
+        for (int pitch = wrist.getPitchMin(); pitch <= wrist.getPitchMax(); pitch++) {
+            for (int yaw = wrist.getYawMin(); yaw <= wrist.getYawMax(); yaw++) {
+                wrist.setPosition(pitch, yaw);
+                compare(JOINT_WRIST, stats);
+            }
+        }
+    }
+
+    void sweep(const char* title) {
+        Stats fingerStats, thumbStats, wristStats;
+        sweepFingers(fingerStats);
+        sweepThumb(thumbStats);
+        sweepWrist(wristStats);
+
+        printf("%s\n", title);
+        fingerStats.report("fingers");
+        thumbStats.report("thumb");
+        wristStats.report("wrist");
+        CHECK_EQ(fingerStats.mismatched, 0);
+        CHECK_EQ(thumbStats.mismatched, 0);
+        CHECK_EQ(wristStats.mismatched, 0);
+    }
+
+    void testDefaults() {
+        sweep("Mixer vs reference, default ranges:");
+    }
+
+    void testRetuned() {
+        // Ranges, limits and biases the mixer has to notice on its own
+        for (int index = 0; index < NUM_FINGERS; index++) {
+            fingers[index].setPitchRange(-5, 35);
+            fingers[index].setYawRange(-25, 15);
+            fingers[index].setFlexionRange(10, 90);
+            fingers[index].setYawBias(40 + 10 * index);
+        }
+        thumb.setPitchRange(25, 65);
+        thumb.setYawRange(-10, 40);
+        thumb.setRollRange(5, 25);
+        wrist.setPitchRange(-30, 35);
+        wrist.setYawRange(-20, 45);
+        managedServos[SERVO_INDEX_UPPER].setMaxPosition(120);
+        managedServos[SERVO_THUMB_RIGHT].setMinPosition(40);
+        managedServos[SERVO_WRIST_R].setMaxPosition(140);
+
+        sweep("Mixer vs reference, retuned:");
+    }
+
+    void testJointMask() {
+        setDefaultPose();
+
+        // Only the wrist is mixed, so a servo set directly elsewhere stays put
+        managedServos[SERVO_INDEX_TIP].setServoPosition(77);
+        wrist.setPosition(10, -10);
+        fingers[FINGER_INDEX].setFlexion(fingers[FINGER_INDEX].getFlexionMax());
+        updateHandJoints(HAND_JOINT_WRIST);
+        CHECK_EQ(managedServos[SERVO_INDEX_TIP].getServoPosition(), 77);
+
+        int32_t expected[NUM_SERVOS] = {};
+        reference::fixed::mixJoint(JOINT_WRIST, expected);
+        CHECK_EQ(managedServos[SERVO_WRIST_L].getServoPosition(), expected[SERVO_WRIST_L]);
+        CHECK_EQ(managedServos[SERVO_WRIST_R].getServoPosition(), expected[SERVO_WRIST_R]);
+
+        // The whole hand through the control tick
+        setMotionLimiting(true);
+        fingers[FINGER_INDEX].setFlexion(fingers[FINGER_INDEX].getFlexionMin());
+        for (int tick = 0; tick < CONTROL_RATE_HZ; tick++) {
+            tickHand();
+        }
+        reference::fixed::mixJoint(FINGER_INDEX, expected);
+        CHECK_EQ(managedServos[SERVO_INDEX_TIP].getServoPosition(), expected[SERVO_INDEX_TIP]);
+        setMotionLimiting(false);
+    }
+}
+
+int main() {
+    setupServos();
+    setMotionLimiting(false);    // Servos follow the targets directly
+
+    testDefaults();
+    testRetuned();
+    testJointMask();
+
+    return TEST_RESULT();
+}
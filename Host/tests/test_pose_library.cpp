@@ -0,0 +1,265 @@
+// Checks the pose library: built in poses interpolate to their keyframes on
+// schedule, the one and two byte commands play and stop them, and sequences
+// uploaded in chunks are checked before they reach their slot. Play and queue
+// are arbitrated like any other command.
+
+#include <string.h>
+
+#include <initializer_list>
+
+#include "DofRegistry.h"
+#include "DofStream.h"
+#include "JointArbiter.h"
+#include "PoseLibrary.h"
+#include "TestUtils.h"
+
+namespace {
+
+    const uint32_t TICK_US = 1000000 / CONTROL_RATE_HZ;
+
+    const int INDEX_FLEXION = 2;
+
+    // Control ticks at the control rate until the given time in ms
+    void tickUntil(uint32_t ms) {
+        while (millis() < ms) {
+            hostsim::advanceMicros(TICK_US);
+            controlTick();
+        }
+    }
+
+    void restart() {
+        gesturePlayer.stop();
+        resetArbiter();
+        for (int dof = 0; dof < DOF_COUNT; dof++) {
+            DOF_REGISTRY[dof].set(0);
+        }
+        updateHand();
+        hostsim::setMicros(0);
+    }
+
+    PoseCommandResult command(std::initializer_list<uint8_t> bytes, ControlSource source = CONTROL_SOURCE_UART) {
+        return receivePoseCommand(bytes.begin(), static_cast<int>(bytes.size()), source, millis());
+    }
+
+    // Writes a sequence in POSE_UPLOAD_CHUNK pieces, as the UART would
+    PoseCommandResult upload(uint8_t slot, const uint8_t* sequence, size_t length) {
+        for (size_t offset = 0; offset < length; offset += POSE_UPLOAD_CHUNK) {
+            uint8_t chunk[POSE_UPLOAD_HEADER_LENGTH + POSE_UPLOAD_CHUNK] = {
+                POSE_OP_UPLOAD, slot, static_cast<uint8_t>(offset & 0xFF), static_cast<uint8_t>(offset >> 8)
+            };
+            size_t chunkLength = length - offset < POSE_UPLOAD_CHUNK ? length - offset : POSE_UPLOAD_CHUNK;
+            memcpy(chunk + POSE_UPLOAD_HEADER_LENGTH, sequence + offset, chunkLength);
+            PoseCommandResult result = receivePoseCommand(chunk, static_cast<int>(POSE_UPLOAD_HEADER_LENGTH + chunkLength), CONTROL_SOURCE_UART, millis());
+            if (result != POSE_COMMAND_OK) {
+                return result;
+            }
+        }
+        return POSE_COMMAND_OK;
+    }
+
+    PoseCommandResult commit(uint8_t slot, size_t length, uint16_t crc) {
+        return command({ POSE_OP_COMMIT, slot, static_cast<uint8_t>(length & 0xFF), static_cast<uint8_t>(length >> 8),
+            static_cast<uint8_t>(crc & 0xFF), static_cast<uint8_t>(crc >> 8) });
+    }
+
+    // Two keyframes: wrist to -30 and index half closed, then wrist to 30
+    // and the index past its range
+    const uint8_t WAVE_SEQUENCE[] = {
+        POSE_FORMAT_VERSION, 2,
+        POSE_KEYFRAME(100, 0, 0, 50, 0, 0, 0, 0, 0, 0, 0, 0, 0, 30, 0, 0, 0, POSE_ANGLE(-30)),
+        POSE_KEYFRAME(200, 0, 0, 120, 0, 0, 0, 0, 0, 0, 0, 0, 0, 30, 0, 0, 0, 30)
+    };
+
+    void testLibrary() {
+        CHECK(getPoseLibraryCount() > 0);
+        CHECK(findPose("fist") != nullptr);
+        CHECK(findPose("juggle") == nullptr);
+        CHECK(findPose(getPoseLibraryCount()) == nullptr);
+        CHECK(findPose(POSE_UPLOAD_FIRST_ID) == nullptr);      // Nothing uploaded yet
+
+        for (uint8_t id = 0; id < getPoseLibraryCount(); id++) {
+            const Gesture* pose = findPose(id);
+            CHECK(pose != nullptr);
+            CHECK(pose->keyframes != nullptr);
+            CHECK(pose->stepCount > 0);
+            CHECK(findPose(pose->name) == pose);
+        }
+    }
+
+    void testPlay() {
+        // Two bytes play the fist, which closes the fingers over 300ms
+        restart();
+        uint8_t fist = 0;
+        while (strcmp(findPose(fist)->name, "fist") != 0) {
+            fist++;
+        }
+        CHECK_EQ(command({ POSE_OP_PLAY, fist }), POSE_COMMAND_OK);
+        CHECK(gesturePlayer.isPlaying());
+
+        tickUntil(150);
+        CHECK_EQ(fingers[FINGER_INDEX].getFlexion(), 50);
+        CHECK_EQ(fingers[FINGER_PINKY].getPitch(), 20);
+        tickUntil(300);
+        CHECK(!gesturePlayer.isPlaying());
+        CHECK_EQ(fingers[FINGER_INDEX].getFlexion(), 100);
+        CHECK_EQ(thumb.getFlexion(), 45);
+
+        // One byte stops it part way
+        restart();
+        command({ POSE_OP_PLAY, fist });
+        tickUntil(60);
+        CHECK_EQ(command({ POSE_OP_STOP }), POSE_COMMAND_OK);
+        CHECK(!gesturePlayer.isPlaying());
+        tickUntil(200);
+        CHECK_EQ(fingers[FINGER_INDEX].getFlexion(), 20);
+
+        CHECK_EQ(command({ POSE_OP_PLAY }), POSE_COMMAND_BAD_LENGTH);
+        CHECK_EQ(command({ POSE_OP_PLAY, 0x3F }), POSE_COMMAND_UNKNOWN);
+        CHECK_EQ(command({ 0xFF }), POSE_COMMAND_UNKNOWN);
+    }
+
+    void testSequence() {
+        // Keyframes follow on from when the last was due, through late ticks
+        restart();
+        gesturePlayer.play(*findPose("ripple"), millis());
+        hostsim::setMicros(450 * 1000);     // Open by 300ms, pinky closed by 450ms
+        controlTick();
+        CHECK_EQ(gesturePlayer.getStep(), 2);
+        CHECK_EQ(fingers[FINGER_PINKY].getFlexion(), 100);
+        CHECK_EQ(fingers[FINGER_RING].getFlexion(), 0);
+
+        const Gesture& ripple = *findPose("ripple");
+        uint32_t lengthMs = 0;
+        for (int keyframe = 0; keyframe < ripple.stepCount; keyframe++) {
+            lengthMs += poseKeyframeDuration(ripple.keyframes + keyframe * POSE_KEYFRAME_LENGTH);
+        }
+        hostsim::setMicros((lengthMs - 1) * 1000);
+        controlTick();
+        CHECK(gesturePlayer.isPlaying());
+        hostsim::setMicros(lengthMs * 1000);
+        controlTick();
+        CHECK(!gesturePlayer.isPlaying());
+        CHECK_EQ(fingers[FINGER_PINKY].getFlexion(), 0);
+    }
+
+    void testUpload() {
+        restart();
+        uint16_t crc = crc16(WAVE_SEQUENCE, sizeof(WAVE_SEQUENCE));
+        uint32_t committed = getPoseUploadsCommitted();
+        uint32_t rejected = getPoseUploadsRejected();
+
+        // A bad checksum or a chunk out of order doesn't reach the slot
+        CHECK_EQ(upload(1, WAVE_SEQUENCE, sizeof(WAVE_SEQUENCE)), POSE_COMMAND_OK);
+        CHECK_EQ(commit(1, sizeof(WAVE_SEQUENCE), crc ^ 1), POSE_COMMAND_BAD_CHECKSUM);
+        CHECK_EQ(getPoseUploadsRejected(), rejected + 1);
+        CHECK(findPose(POSE_UPLOAD_FIRST_ID + 1) == nullptr);
+
+        uint8_t skipped[] = { POSE_OP_UPLOAD, 1, POSE_UPLOAD_CHUNK, 0, 0 };
+        CHECK_EQ(upload(1, WAVE_SEQUENCE, POSE_UPLOAD_CHUNK), POSE_COMMAND_OK);
+        CHECK_EQ(receivePoseCommand(skipped, sizeof(skipped), CONTROL_SOURCE_UART, millis()), POSE_COMMAND_OK);
+        skipped[2] = POSE_UPLOAD_CHUNK * 3;
+        CHECK_EQ(receivePoseCommand(skipped, sizeof(skipped), CONTROL_SOURCE_UART, millis()), POSE_COMMAND_OUT_OF_ORDER);
+        CHECK_EQ(commit(2, sizeof(WAVE_SEQUENCE), crc), POSE_COMMAND_OUT_OF_ORDER);
+
+        // A sequence that doesn't match its keyframe count
+        uint8_t truncated[sizeof(WAVE_SEQUENCE) - 1];
+        memcpy(truncated, WAVE_SEQUENCE, sizeof(truncated));
+        CHECK_EQ(upload(1, truncated, sizeof(truncated)), POSE_COMMAND_OK);
+        CHECK_EQ(commit(1, sizeof(truncated), crc16(truncated, sizeof(truncated))), POSE_COMMAND_BAD_FORMAT);
+
+        // And one that's good
+        CHECK_EQ(upload(1, WAVE_SEQUENCE, sizeof(WAVE_SEQUENCE)), POSE_COMMAND_OK);
+        CHECK_EQ(commit(1, sizeof(WAVE_SEQUENCE), crc), POSE_COMMAND_OK);
+        CHECK_EQ(getPoseUploadsCommitted(), committed + 1);
+        CHECK(findPose("upload1") == findPose(POSE_UPLOAD_FIRST_ID + 1));
+
+        CHECK_EQ(command({ POSE_OP_PLAY, POSE_UPLOAD_FIRST_ID + 1 }), POSE_COMMAND_OK);
+        tickUntil(50);
+        CHECK_EQ(wrist.getYaw(), -15);
+        CHECK_EQ(fingers[FINGER_INDEX].getFlexion(), 25);
+        tickUntil(100);
+        CHECK_EQ(wrist.getYaw(), -30);
+        tickUntil(200);
+        CHECK_EQ(wrist.getYaw(), 0);
+        tickUntil(300);
+        CHECK(!gesturePlayer.isPlaying());
+        CHECK_EQ(wrist.getYaw(), 30);
+        CHECK_EQ(thumb.getPitch(), 30);
+
+        // Angles outside a DOF's range are clamped, as a streamed frame's are
+        CHECK_EQ(DOF_REGISTRY[INDEX_FLEXION].get(), 100);
+    }
+
+    void testQueue() {
+        // A queued pose moves on from where the last one left the hand
+        restart();
+        CHECK_EQ(command({ POSE_OP_PLAY, POSE_UPLOAD_FIRST_ID + 1 }), POSE_COMMAND_OK);
+        CHECK_EQ(command({ POSE_OP_QUEUE, 0 }), POSE_COMMAND_OK);
+        tickUntil(300 + 150);
+        CHECK(gesturePlayer.isPlaying());
+        CHECK_EQ(wrist.getYaw(), 15);
+        tickUntil(600);
+        CHECK(!gesturePlayer.isPlaying());
+        CHECK_EQ(wrist.getYaw(), 0);
+    }
+
+    void testArbitration() {
+        // The sender's own lease on a joint goes to the pose, which then
+        // plays through rather than losing the joint on its first tick
+        restart();
+        claimJoints(CONTROL_SOURCE_UART, HAND_JOINT_FINGER(FINGER_INDEX), millis());
+        CHECK_EQ(command({ POSE_OP_PLAY, 0 }), POSE_COMMAND_OK);
+        CHECK_EQ(getJointOwner(FINGER_INDEX, millis()), CONTROL_SOURCE_GESTURE);
+        tickUntil(50);
+        CHECK(gesturePlayer.isPlaying());
+
+        // Someone at the serial port holding a joint turns it down
+        restart();
+        claimJoints(CONTROL_SOURCE_SERIAL, HAND_JOINT_WRIST, millis());
+        CHECK_EQ(command({ POSE_OP_PLAY, 0 }), POSE_COMMAND_BUSY);
+        CHECK_EQ(command({ POSE_OP_QUEUE, 0 }), POSE_COMMAND_BUSY);
+        CHECK(!gesturePlayer.isPlaying());
+        CHECK_EQ(getJointOwner(JOINT_WRIST, millis()), CONTROL_SOURCE_SERIAL);
+
+        // As does a pose the serial port started, which keeps playing
+        restart();
+        CHECK_EQ(command({ POSE_OP_PLAY, POSE_UPLOAD_FIRST_ID + 1 }, CONTROL_SOURCE_SERIAL), POSE_COMMAND_OK);
+        CHECK_EQ(command({ POSE_OP_PLAY, 0 }), POSE_COMMAND_BUSY);
+        CHECK_EQ(command({ POSE_OP_QUEUE, 0 }), POSE_COMMAND_BUSY);
+        CHECK_EQ(command({ POSE_OP_STOP }), POSE_COMMAND_BUSY);
+        CHECK_EQ(command({ POSE_OP_STOP }, CONTROL_SOURCE_GESTURE), POSE_COMMAND_BUSY);
+        CHECK(gesturePlayer.getGesture() == findPose(POSE_UPLOAD_FIRST_ID + 1));
+
+        // A commit would stop it too, so waits with the upload staged
+        uint16_t crc = crc16(WAVE_SEQUENCE, sizeof(WAVE_SEQUENCE));
+        CHECK_EQ(upload(2, WAVE_SEQUENCE, sizeof(WAVE_SEQUENCE)), POSE_COMMAND_OK);
+        CHECK_EQ(commit(2, sizeof(WAVE_SEQUENCE), crc), POSE_COMMAND_BUSY);
+        CHECK(gesturePlayer.isPlaying());
+        tickUntil(300);
+        CHECK(!gesturePlayer.isPlaying());
+        CHECK_EQ(wrist.getYaw(), 30);
+        CHECK_EQ(commit(2, sizeof(WAVE_SEQUENCE), crc), POSE_COMMAND_OK);
+
+        // and which the serial port can replace and stop
+        CHECK_EQ(command({ POSE_OP_PLAY, POSE_UPLOAD_FIRST_ID + 1 }, CONTROL_SOURCE_SERIAL), POSE_COMMAND_OK);
+        CHECK_EQ(command({ POSE_OP_PLAY, 0 }, CONTROL_SOURCE_SERIAL), POSE_COMMAND_OK);
+        CHECK(gesturePlayer.getGesture() == findPose(uint8_t(0)));
+        CHECK_EQ(command({ POSE_OP_STOP }, CONTROL_SOURCE_SERIAL), POSE_COMMAND_OK);
+        CHECK(!gesturePlayer.isPlaying());
+    }
+}
+
+int main() {
+    setupServos();
+    setMotionLimiting(false);    // Servos follow the targets directly
+    setDofJitterDelay(0);        // Frames are applied as they arrive
+
+    testLibrary();
+    testPlay();
+    testSequence();
+    testUpload();
+    testQueue();
+    testArbitration();
+
+    return TEST_RESULT();
+}
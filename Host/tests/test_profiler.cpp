@@ -0,0 +1,135 @@
+// Checks the loop profiler's busy and idle accounting, and that the probes in
+// the control tick and hand update record. Built twice, the second time
+// against a core with PROFILING set to 0, where the probes record nothing.
+
+#include "DofStream.h"
+#include "Hand.h"
+#include "Profiler.h"
+#include "TestUtils.h"
+
+namespace {
+
+    // One pass of the loop that took the given ticks, with the given work in it
+    void pass(Profiler& profiler, uint32_t ticks, uint32_t busyTicks) {
+        profiler.enter(PROFILE_LOOP);
+        if (busyTicks > 0) {
+            bool outermost = profiler.enter(PROFILE_CONTROL_TICK);
+            CHECK(outermost);
+            CHECK(!profiler.enter(PROFILE_UPDATE_HAND));
+            profiler.leave(PROFILE_UPDATE_HAND, busyTicks / 2, false);
+            profiler.leave(PROFILE_CONTROL_TICK, busyTicks, outermost);
+        }
+        profiler.leave(PROFILE_LOOP, ticks, false);
+    }
+
+    void testAccounting() {
+        Profiler profiler;
+        CHECK_EQ(profiler.getUtilisation(), 0);
+
+        pass(profiler, 1000, 0);
+        pass(profiler, 1000, 0);
+        pass(profiler, 2000, 1000);
+        pass(profiler, 1000, 0);
+
+        CHECK_EQ(profiler.getPasses(), 4);
+        CHECK_EQ(profiler.getIdlePasses(), 3);
+        CHECK_EQ(profiler.getLoopTicks(), 5000);
+        CHECK_EQ(profiler.getBusyTicks(), 1000);     // Nested work isn't counted again
+        CHECK_EQ(profiler.getUtilisation(), 200);
+
+        const LatencyHistogram& loop = profiler.getSection(PROFILE_LOOP);
+        CHECK_EQ(loop.getCount(), 4);
+        CHECK_EQ(loop.getMin(), 1000);
+        CHECK_EQ(loop.getMax(), 2000);
+        CHECK_EQ(loop.getMean(), 1250);
+        CHECK_EQ(profiler.getSection(PROFILE_CONTROL_TICK).getCount(), 1);
+        CHECK_EQ(profiler.getSection(PROFILE_UPDATE_HAND).getMax(), 500);
+        CHECK_EQ(profiler.getSection(PROFILE_DOF_HANDLER).getCount(), 0);
+
+        // Work outside any pass can't be more than all of the time
+        profiler.enter(PROFILE_RX_HANDLER);
+        profiler.leave(PROFILE_RX_HANDLER, 10000, true);
+        CHECK_EQ(profiler.getUtilisation(), 1000);
+
+        profiler.reset();
+        CHECK_EQ(profiler.getPasses(), 0);
+        CHECK_EQ(profiler.getBusyTicks(), 0);
+        CHECK_EQ(profiler.getSection(PROFILE_LOOP).getCount(), 0);
+        CHECK(profiler.enter(PROFILE_DOF_HANDLER));
+        profiler.leave(PROFILE_DOF_HANDLER, 1, true);
+    }
+
+    void testWindow() {
+        // The window utilisation only changes once a full window has passed
+        Profiler profiler;
+        const uint32_t tenth = PROFILE_WINDOW_US / 10 * LATENCY_TICKS_PER_US;
+        for (int i = 0; i < 9; i++) {
+            pass(profiler, tenth, tenth / 4);
+        }
+        CHECK_EQ(profiler.getWindowUtilisation(), 0);
+        pass(profiler, tenth, tenth / 4);
+        CHECK_EQ(profiler.getWindowUtilisation(), 250);
+
+        // Going idle shows up in the next window but not the first
+        for (int i = 0; i < 9; i++) {
+            pass(profiler, tenth, 0);
+        }
+        CHECK_EQ(profiler.getWindowUtilisation(), 250);
+        pass(profiler, tenth, 0);
+        CHECK_EQ(profiler.getWindowUtilisation(), 0);
+        CHECK_EQ(profiler.getUtilisation(), 125);
+    }
+
+    void testScope() {
+        // Probes record into the global profiler, measuring the real time spent in them
+        volatile uint32_t sink = 0;
+        {
+            ProfileScope scope(PROFILE_LOOP);
+            uint32_t start = latencyTicks();
+            while (latencyTicks() - start < 50 * LATENCY_TICKS_PER_US) {
+                sink = sink + 1;
+            }
+        }
+        CHECK_EQ(profiler.getSection(PROFILE_LOOP).getCount(), 1);
+        CHECK(profiler.getSection(PROFILE_LOOP).getMin() >= 50 * LATENCY_TICKS_PER_US);
+        CHECK_EQ(profiler.getPasses(), 1);
+    }
+
+    void testProbes() {
+        // The control tick and hand update are probed in the core
+        profiler.reset();
+        int16_t centidegrees[DOF_COUNT] = {};
+        uint8_t packet[DOF_MAX_PACKET_LENGTH];
+        for (int i = 0; i < 10; i++) {
+            centidegrees[16] = static_cast<int16_t>(i * 100);
+            int length = encodeDofPacketV2(centidegrees, static_cast<uint16_t>(i), i * 10000u, packet);
+            receiveDofPacket(packet, length);
+            controlTick();
+        }
+        updateHand();
+
+#if PROFILING
+        CHECK_EQ(profiler.getSection(PROFILE_CONTROL_TICK).getCount(), 10);
+        CHECK_EQ(profiler.getSection(PROFILE_UPDATE_HAND).getCount(), 11);
+        CHECK(profiler.getBusyTicks() > 0);
+#else
+        CHECK_EQ(profiler.getSection(PROFILE_CONTROL_TICK).getCount(), 0);
+        CHECK_EQ(profiler.getSection(PROFILE_UPDATE_HAND).getCount(), 0);
+        CHECK_EQ(profiler.getBusyTicks(), 0);
+#endif
+        CHECK_EQ(getDofFramesApplied(), 10);
+    }
+}
+
+int main() {
+    setupServos();
+    setMotionLimiting(false);    // Servos follow the targets directly
+    setDofJitterDelay(0);        // Frames are applied as they arrive
+
+    testAccounting();
+    testWindow();
+    testScope();
+    testProbes();
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,203 @@
+// Checks the cooperative scheduler against the virtual clock: tasks run once
+// per period, the most overdue goes first, overruns and missed periods are
+// counted, the schedule stays on its period after falling behind, and the
+// idle time and enabling work across the clock wrapping.
+
+#include <stdint.h>
+
+#include <string>
+
+#include "Scheduler.h"
+#include "TestUtils.h"
+
+namespace {
+
+    // What each task does when it runs: takes some time, and leaves its name
+    uint32_t workUs[SCHEDULER_MAX_TASKS];
+    std::string order;
+
+    template <int ID>
+    void task() {
+        order += static_cast<char>('a' + ID);
+        hostsim::advanceMicros(workUs[ID]);
+    }
+
+    void reset(uint64_t nowUs) {
+        hostsim::setMicros(nowUs);
+        for (uint32_t& work : workUs) {
+            work = 0;
+        }
+        order.clear();
+    }
+
+    // Runs the loop the way the sketch does until the clock reaches endUs
+    void runUntil(Scheduler& scheduler, uint64_t endUs) {
+        while (hostsim::nowMicros() < endUs) {
+            if (!scheduler.runNext()) {
+                uint32_t idleUs = scheduler.getIdleUs();
+                CHECK(idleUs > 0);
+                hostsim::advanceMicros(idleUs < endUs - hostsim::nowMicros() ? idleUs : endUs - hostsim::nowMicros());
+            }
+        }
+    }
+
+    void testPeriods() {
+        reset(0);
+        Scheduler scheduler;
+        CHECK_EQ(scheduler.addTask("fast", task<0>, 1000, 500, 0), 0);
+        CHECK_EQ(scheduler.addTask("slow", task<1>, 2500, 500, 0), 1);
+        workUs[0] = 100;
+        workUs[1] = 200;
+
+        runUntil(scheduler, 10000);
+        const SchedulerTask& fast = scheduler.getTask(0);
+        const SchedulerTask& slow = scheduler.getTask(1);
+        CHECK_EQ(fast.runs, 10);
+        CHECK_EQ(slow.runs, 4);
+        CHECK_EQ(fast.totalRunUs, 1000);
+        CHECK_EQ(slow.maxRunUs, 200);
+        CHECK_EQ(scheduler.getOverruns(), 0);
+        CHECK_EQ(fast.skipped + slow.skipped, 0);
+
+        // The slow task waited behind the fast one at 0 and 5000
+        CHECK_EQ(slow.maxLateUs, 100);
+        CHECK(order.compare(0, 4, "abaa") == 0);
+    }
+
+    void testEarliestDeadlineFirst() {
+        reset(0);
+        Scheduler scheduler;
+        scheduler.addTask("a", task<0>, 1000, 500, 600);
+        scheduler.addTask("b", task<1>, 1000, 500, 200);
+        scheduler.addTask("c", task<2>, 1000, 500, 400);
+        scheduler.addTask("d", task<3>, 1000, 500, 400);
+        scheduler.addTask("e", task<4>, 1000, 500, 900);
+
+        // Nothing is due yet
+        CHECK(!scheduler.runNext());
+        CHECK_EQ(scheduler.getIdleUs(), 200);
+
+        // The most overdue first, the first added of any that tie, and the
+        // one that isn't due yet waits
+        hostsim::setMicros(800);
+        while (scheduler.runNext()) {
+        }
+        CHECK(order == "bcda");
+        CHECK_EQ(scheduler.getTask(1).maxLateUs, 600);
+        CHECK_EQ(scheduler.getIdleUs(), 100);
+    }
+
+    void testOverrunsAndSkipped() {
+        reset(0);
+        Scheduler scheduler;
+        scheduler.addTask("control", task<0>, 1000, 300, 0);
+        scheduler.addTask("serial", task<1>, 10000, 1000, 0);
+
+        // The control task runs first, then a long serial command holds it up
+        // for three and a half periods
+        workUs[0] = 100;
+        workUs[1] = 3500;
+        CHECK(scheduler.runNext());
+        CHECK(scheduler.runNext());
+        CHECK_EQ(hostsim::nowMicros(), 3600);
+        const SchedulerTask& serial = scheduler.getTask(1);
+        CHECK_EQ(serial.overruns, 1);
+        CHECK_EQ(scheduler.getOverruns(), 1);
+
+        // The control task runs once for its period at 3000, and drops the
+        // two before it rather than running them back to back
+        workUs[1] = 0;
+        CHECK(scheduler.runNext());
+        const SchedulerTask& control = scheduler.getTask(0);
+        CHECK_EQ(control.runs, 2);
+        CHECK_EQ(control.skipped, 2);
+        CHECK_EQ(control.maxLateUs, 2600);
+        CHECK_EQ(control.overruns, 0);
+        CHECK(!scheduler.runNext());
+
+        // Still on its period
+        CHECK_EQ(scheduler.getIdleUs(), 300);
+        runUntil(scheduler, 10000);
+        CHECK_EQ(control.runs, 8);
+        CHECK_EQ(control.skipped, 2);
+        CHECK_EQ(control.maxRunUs, 100);
+
+        scheduler.resetStats();
+        CHECK_EQ(control.runs, 0);
+        CHECK_EQ(control.skipped, 0);
+        CHECK_EQ(scheduler.getOverruns(), 0);
+    }
+
+    void testEnable() {
+        reset(0);
+        Scheduler scheduler;
+        CHECK_EQ(scheduler.getIdleUs(), UINT32_MAX);
+
+        int heartbeat = scheduler.addTask("heartbeat", task<0>, 5000, 500, 0);
+        int poll = scheduler.addTask("poll", task<1>, 1000, 500, 0);
+        scheduler.setEnabled(heartbeat, false);
+        runUntil(scheduler, 4500);
+        CHECK_EQ(scheduler.getTask(heartbeat).runs, 0);
+        CHECK_EQ(scheduler.getTask(poll).runs, 5);
+
+        // Enabling it makes it due now, and it goes from there
+        scheduler.setEnabled(heartbeat, true);
+        CHECK_EQ(scheduler.getIdleUs(), 0);
+        runUntil(scheduler, 10000);
+        CHECK_EQ(scheduler.getTask(heartbeat).runs, 2);
+        CHECK_EQ(scheduler.getTask(heartbeat).skipped, 0);
+
+        // Enabling one that already is doesn't move it
+        scheduler.setEnabled(poll, true);
+        CHECK_EQ(scheduler.getIdleUs(), 0);
+        scheduler.setEnabled(poll, false);
+        CHECK_EQ(scheduler.getIdleUs(), 4500);
+        scheduler.setEnabled(heartbeat, false);
+        CHECK_EQ(scheduler.getIdleUs(), UINT32_MAX);
+        CHECK(!scheduler.runNext());
+
+        // Out of range ids are ignored
+        scheduler.setEnabled(-1, true);
+        scheduler.setEnabled(SCHEDULER_MAX_TASKS, true);
+    }
+
+    void testAddTask() {
+        reset(0);
+        Scheduler scheduler;
+        CHECK_EQ(scheduler.addTask("never", task<0>, 0, 500, 0), -1);
+        for (int i = 0; i < SCHEDULER_MAX_TASKS; i++) {
+            CHECK_EQ(scheduler.addTask("task", task<0>, 1000, 500, 0), i);
+        }
+        CHECK_EQ(scheduler.addTask("full", task<0>, 1000, 500, 0), -1);
+        CHECK_EQ(scheduler.getTaskCount(), SCHEDULER_MAX_TASKS);
+    }
+
+    void testWrap() {
+        // Starts just short of micros() wrapping in 32 bits
+        uint64_t startUs = 0xFFFFF000ull;
+        reset(startUs);
+        Scheduler scheduler;
+        scheduler.addTask("control", task<0>, 1000, 500, static_cast<uint32_t>(startUs));
+        workUs[0] = 100;
+
+        runUntil(scheduler, startUs + 10000);
+        const SchedulerTask& control = scheduler.getTask(0);
+        CHECK_EQ(control.runs, 10);
+        CHECK_EQ(control.skipped, 0);
+        CHECK_EQ(control.maxLateUs, 0);
+
+        // Due again right on the period
+        CHECK_EQ(scheduler.getIdleUs(), 0);
+    }
+}
+
+int main() {
+    testPeriods();
+    testEarliestDeadlineFirst();
+    testOverrunsAndSkipped();
+    testEnable();
+    testAddTask();
+    testWrap();
+
+    return TEST_RESULT();
+}
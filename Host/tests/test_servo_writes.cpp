@@ -0,0 +1,88 @@
+// Checks that the servo driver only pushes pulse widths to the PIO when they
+// change, and that the issued/skipped counters account for every write.
+
+#include "Hand.h"
+#include "TestUtils.h"
+
+namespace {
+
+    uint32_t putsForServo(int index) {
+        int sm = hostsim::pioStateMachineForPin(managedServos[index].getServoPin());
+        return sm < 0 ? 0 : hostsim::pioStateMachine(sm).puts;
+    }
+
+    void testSetupWritesEveryServo() {
+        for (int index = 0; index < NUM_SERVOS; index++) {
+            int sm = hostsim::pioStateMachineForPin(managedServos[index].getServoPin());
+            CHECK(sm >= 0);
+
+            // Period, the write consumed during setup, the forced write after enabling,
+            // and the default position from ManagedServo::setupServo()
+            CHECK(putsForServo(index) >= 3);
+            CHECK(hostsim::pioPulseMicros(sm) > 0);
+        }
+    }
+
+    void testUnchangedWritesAreSkipped() {
+        setDefaultPose();
+        ManagedServo::resetWriteCounters();
+        uint32_t putsBefore = hostsim::pioTotalPuts();
+
+        setDefaultPose();
+        setDefaultPose();
+
+        CHECK_EQ(hostsim::pioTotalPuts(), putsBefore);
+        CHECK_EQ(ManagedServo::getWritesIssued(), 0);
+        CHECK_EQ(ManagedServo::getWritesSkipped(), 2 * NUM_SERVOS);
+    }
+
+    void testOnlyChangedServosAreWritten() {
+        setDefaultPose();
+        updateHand();
+        ManagedServo::resetWriteCounters();
+
+        uint32_t indexLower = putsForServo(SERVO_INDEX_LOWER);
+        uint32_t indexTip = putsForServo(SERVO_INDEX_TIP);
+        uint32_t wristLeft = putsForServo(SERVO_WRIST_L);
+
+        // Flexion only moves the tip, but it also changes the pitch mix above 50%
+        fingers[FINGER_INDEX].setFlexion(fingers[FINGER_INDEX].getFlexionMax());
+        updateHand();
+
+        CHECK(putsForServo(SERVO_INDEX_TIP) == indexTip + 1);
+        CHECK(putsForServo(SERVO_INDEX_LOWER) == indexLower + 1);
+        CHECK_EQ(putsForServo(SERVO_WRIST_L), wristLeft);
+        CHECK_EQ(ManagedServo::getWritesIssued() + ManagedServo::getWritesSkipped(), NUM_SERVOS);
+
+        // Repeating the same frame writes nothing
+        uint32_t issued = ManagedServo::getWritesIssued();
+        updateHand();
+        CHECK_EQ(ManagedServo::getWritesIssued(), issued);
+    }
+
+    void testPulseIsStillCorrect() {
+        ManagedServo& servo = managedServos[SERVO_WRIST_L];
+        int sm = hostsim::pioStateMachineForPin(servo.getServoPin());
+
+        servo.setServoPosition(40);
+        uint16_t first = hostsim::pioPulseMicros(sm);
+        servo.setServoPosition(41);
+        uint16_t second = hostsim::pioPulseMicros(sm);
+        servo.setServoPosition(40);
+
+        CHECK(second > first);
+        CHECK_EQ(hostsim::pioPulseMicros(sm), first);
+    }
+}
+
+int main() {
+    setupServos();
+    setMotionLimiting(false);    // Servos follow the targets directly
+
+    testSetupWritesEveryServo();
+    testUnchangedWritesAreSkipped();
+    testOnlyChangedServosAreWritten();
+    testPulseIsStillCorrect();
+
+    return TEST_RESULT();
+}
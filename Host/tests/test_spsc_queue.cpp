@@ -0,0 +1,185 @@
+// Checks the SPSC queue: order, overflow and the peek/discard interface on
+// one thread, then a producer and consumer on two threads hammering it, with
+// every value checked for tearing and order. Built with the thread sanitizer,
+// and separately with the address and undefined behaviour sanitizers, when
+// the compiler has them.
+
+#include <stdint.h>
+
+#include <atomic>
+#include <thread>
+
+#include "SpscQueue.h"
+#include "TestUtils.h"
+
+namespace {
+
+    // Big enough that a torn copy would show
+    struct Value {
+        uint32_t sequence;
+        uint32_t copies[15];
+    };
+
+    Value makeValue(uint32_t sequence) {
+        Value value;
+        value.sequence = sequence;
+        for (uint32_t& copy : value.copies) {
+            copy = sequence * 2654435761u;
+        }
+        return value;
+    }
+
+    bool isWhole(const Value& value) {
+        for (uint32_t copy : value.copies) {
+            if (copy != value.sequence * 2654435761u) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void testOrder() {
+        SpscQueue<int, 4> queue;
+        int value = 0;
+        CHECK(queue.isEmpty());
+        CHECK(!queue.pop(value));
+        CHECK_EQ(queue.getCapacity(), 4);
+
+        // Round the ring several times, so the indexes wrap the slots
+        for (int round = 0; round < 10; round++) {
+            for (int i = 0; i < 3; i++) {
+                CHECK(queue.push(round * 10 + i));
+            }
+            for (int i = 0; i < 3; i++) {
+                CHECK(queue.pop(value));
+                CHECK_EQ(value, round * 10 + i);
+            }
+        }
+        CHECK(queue.isEmpty());
+        CHECK_EQ(queue.getMaxDepth(), 3);
+    }
+
+    void testOverflow() {
+        SpscQueue<int, 4> queue;
+        for (int i = 0; i < 4; i++) {
+            CHECK(queue.push(i));
+        }
+        CHECK(!queue.push(4));
+        CHECK_EQ(queue.getDropped(), 1);
+        CHECK_EQ(queue.getDepth(), 4);
+
+        // The oldest are kept, and there's room again once one is taken
+        int value = -1;
+        CHECK(queue.pop(value));
+        CHECK_EQ(value, 0);
+        CHECK(queue.push(5));
+        CHECK_EQ(queue.peek(3), 5);
+
+        queue.resetCounters();
+        CHECK_EQ(queue.getDropped(), 0);
+        queue.reset();
+        CHECK(queue.isEmpty());
+    }
+
+    void testPeek() {
+        SpscQueue<int, 8> queue;
+        for (int i = 0; i < 5; i++) {
+            queue.push(i * 2);
+        }
+        CHECK_EQ(queue.peek(0), 0);
+        CHECK_EQ(queue.peek(4), 8);
+
+        queue.discard(3);
+        CHECK_EQ(queue.getDepth(), 2);
+        CHECK_EQ(queue.peek(0), 6);
+        int value = 0;
+        CHECK(queue.pop(value));
+        CHECK_EQ(value, 6);
+    }
+
+    // A producer that waits for room, so every value gets through
+    void testLosslessAcrossThreads() {
+        static SpscQueue<Value, 16> queue;
+        const uint32_t VALUES = 200000;
+
+        std::thread producer([&]() {
+            for (uint32_t sequence = 1; sequence <= VALUES; sequence++) {
+                Value value = makeValue(sequence);
+                while (!queue.push(value)) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+
+        uint32_t expected = 1;
+        int torn = 0;
+        int outOfOrder = 0;
+        Value value;
+        while (expected <= VALUES) {
+            if (!queue.pop(value)) {
+                std::this_thread::yield();
+                continue;
+            }
+            torn += !isWhole(value);
+            outOfOrder += value.sequence != expected;
+            expected = value.sequence + 1;
+        }
+        producer.join();
+
+        CHECK_EQ(torn, 0);
+        CHECK_EQ(outOfOrder, 0);
+        CHECK(queue.isEmpty());
+    }
+
+    // A producer that never waits, as the BLE handler doesn't, and a consumer
+    // that looks in place like the jitter buffer. What's dropped is only ever
+    // the newest, so what gets through is still in order.
+    void testDroppingAcrossThreads() {
+        static SpscQueue<Value, 8> queue;
+        const uint32_t VALUES = 200000;
+        std::atomic<bool> done(false);
+
+        std::thread producer([&]() {
+            for (uint32_t sequence = 1; sequence <= VALUES; sequence++) {
+                queue.push(makeValue(sequence));
+            }
+            done.store(true, std::memory_order_release);
+        });
+
+        uint32_t received = 0;
+        uint32_t last = 0;
+        int torn = 0;
+        int outOfOrder = 0;
+        for (;;) {
+            bool finished = done.load(std::memory_order_acquire);
+            uint32_t depth = queue.getDepth();
+            for (uint32_t i = 0; i < depth; i++) {
+                const Value& value = queue.peek(i);
+                torn += !isWhole(value);
+                outOfOrder += value.sequence <= last;
+                last = value.sequence;
+            }
+            queue.discard(depth);
+            received += depth;
+            if (finished && queue.isEmpty()) {
+                break;
+            }
+        }
+        producer.join();
+
+        CHECK_EQ(torn, 0);
+        CHECK_EQ(outOfOrder, 0);
+        CHECK_EQ(received + queue.getDropped(), VALUES);
+        CHECK(received > 0);
+    }
+}
+
+int main() {
+    testOrder();
+    testOverflow();
+    testPeek();
+    testLosslessAcrossThreads();
+    testDroppingAcrossThreads();
+
+    return TEST_RESULT();
+}
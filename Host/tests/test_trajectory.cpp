@@ -0,0 +1,199 @@
+// Checks the joint trajectory stage: the velocity and acceleration limits are
+// respected, the position lands on the target without overshoot, and the
+// hand only writes servos for joints that are still moving.
+
+#include <stdlib.h>
+
+#include "Hand.h"
+#include "Trajectory.h"
+#include "TestUtils.h"
+
+namespace {
+
+    // Built at compile time like the joints in Hand.cpp
+    constexpr MotionLimits FAST = { 400, 4000 };     // 4 degrees/tick, 0.4 degrees/tick^2 at 100Hz
+    constexpr Trajectory constTrajectory(FAST);
+
+    struct Run {
+        int ticks = 0;
+        int maxStep = 0;            // Largest change in one tick
+        int maxStepChange = 0;      // Largest change in step between ticks
+        bool overshot = false;
+    };
+
+    Run runToTarget(Trajectory& trajectory, int16_t target, int maxTicks = 1000) {
+        Run run;
+        int16_t start = trajectory.getPosition();
+        int16_t last = start;
+        int lastStep = 0;
+
+        trajectory.setTarget(target);
+        while (!trajectory.isSettled() && run.ticks < maxTicks) {
+            trajectory.tick();
+            run.ticks++;
+
+            int16_t position = trajectory.getPosition();
+            int step = position - last;
+            run.maxStep = abs(step) > run.maxStep ? abs(step) : run.maxStep;
+            run.maxStepChange = abs(step - lastStep) > run.maxStepChange ? abs(step - lastStep) : run.maxStepChange;
+            if ((target >= start && position > target) || (target < start && position < target)) {
+                run.overshot = true;
+            }
+            last = position;
+            lastStep = step;
+        }
+        return run;
+    }
+
+    void testUnlimitedFollowsImmediately() {
+        Trajectory trajectory;
+        CHECK(!trajectory.isLimited());
+
+        trajectory.setTarget(37);
+        CHECK_EQ(trajectory.getPosition(), 37);
+        CHECK(trajectory.isSettled());
+        CHECK(!trajectory.tick());
+    }
+
+    void testVelocityLimit() {
+        Trajectory trajectory;
+        trajectory.setLimits(MotionLimits{ 500, 0 });   // 5 degrees per tick
+
+        Run run = runToTarget(trajectory, 100);
+        CHECK_EQ(run.ticks, 20);
+        CHECK_EQ(run.maxStep, 5);
+        CHECK(!run.overshot);
+        CHECK_EQ(trajectory.getPosition(), 100);
+    }
+
+    void testVelocityAndAccelerationLimits() {
+        Trajectory trajectory = constTrajectory;
+        CHECK(trajectory.isLimited());
+
+        // Ramp up to 4 degrees/tick over 10 ticks, cruise, ramp down: about 35 ticks for 100 degrees
+        Run run = runToTarget(trajectory, 100);
+        CHECK(run.ticks >= 33 && run.ticks <= 38);
+        CHECK(run.maxStep <= 5);            // 4 degrees/tick, plus 1 for rounding to whole degrees
+        CHECK(run.maxStepChange <= 2);      // 0.4 degrees/tick^2, plus rounding
+        CHECK(!run.overshot);
+        CHECK_EQ(trajectory.getPosition(), 100);
+
+        // And back down through negative angles
+        run = runToTarget(trajectory, -40);
+        CHECK(!run.overshot);
+        CHECK_EQ(trajectory.getPosition(), -40);
+        CHECK(trajectory.isSettled());
+    }
+
+    void testSmallStepDoesNotHunt() {
+        Trajectory trajectory = constTrajectory;
+        runToTarget(trajectory, 10);
+
+        Run run = runToTarget(trajectory, 11);
+        CHECK(!run.overshot);
+        CHECK(run.ticks < 10);
+        CHECK_EQ(trajectory.getPosition(), 11);
+    }
+
+    void testReversalMidMove() {
+        Trajectory trajectory = constTrajectory;
+        trajectory.setTarget(100);
+        for (int tick = 0; tick < 15; tick++) {
+            trajectory.tick();
+        }
+        int16_t midway = trajectory.getPosition();
+        CHECK(midway > 10 && midway < 100);
+
+        // Reverse while at speed - the joint has to brake before coming back
+        trajectory.setTarget(0);
+        int16_t furthest = midway;
+        int ticks = 0;
+        while (!trajectory.isSettled() && ticks < 1000) {
+            trajectory.tick();
+            furthest = trajectory.getPosition() > furthest ? trajectory.getPosition() : furthest;
+            ticks++;
+        }
+        CHECK(furthest > midway);       // Carried on while braking rather than reversing instantly
+        CHECK_EQ(trajectory.getPosition(), 0);
+        CHECK(ticks < 1000);
+    }
+
+    void testDisablingLimitsSnaps() {
+        Trajectory trajectory = constTrajectory;
+        trajectory.setTarget(50);
+        trajectory.tick();
+        CHECK(trajectory.getPosition() < 50);
+
+        trajectory.setLimits(MotionLimits{ 0, 0 });
+        CHECK_EQ(trajectory.getPosition(), 50);
+        CHECK(trajectory.isSettled());
+    }
+
+    void testHandTicksOnlyMovingJoints() {
+        setMotionLimiting(true);
+        CHECK(isMotionLimiting());
+
+        // Let everything settle
+        for (int tick = 0; tick < CONTROL_RATE_HZ * 5; tick++) {
+            tickHand();
+        }
+        updateHand();
+
+        ManagedServo& tip = managedServos[SERVO_INDEX_TIP];
+        uint8_t start = tip.getServoPosition();
+
+        fingers[FINGER_INDEX].setFlexion(fingers[FINGER_INDEX].getFlexionMax());
+
+        // A plain update doesn't move the joint, only ticks do
+        updateHand();
+        CHECK_EQ(tip.getServoPosition(), start);
+
+        // The joint accelerates, so give it a few ticks to get going
+        const int startTicks = 5;
+        ManagedServo::resetWriteCounters();
+        for (int tick = 0; tick < startTicks; tick++) {
+            tickHand();
+        }
+        CHECK(tip.getServoPosition() > start);
+        CHECK(tip.getServoPosition() < tip.getMaxPosition());
+
+        // Only the index finger's servos are touched while it moves
+        CHECK(ManagedServo::getWritesIssued() + ManagedServo::getWritesSkipped() <= 3 * startTicks);
+
+        int ticks = startTicks;
+        while (!fingers[FINGER_INDEX].isSettled() && ticks < CONTROL_RATE_HZ * 5) {
+            tickHand();
+            ticks++;
+        }
+        CHECK(ticks < CONTROL_RATE_HZ);
+        CHECK_EQ(fingers[FINGER_INDEX].getFlexionPosition(), fingers[FINGER_INDEX].getFlexionMax());
+        CHECK_EQ(tip.getServoPosition(), tip.getMaxPosition());
+
+        // Once settled, servos set directly are left alone by the tick
+        tip.setServoPosition(start);
+        tickHand();
+        CHECK_EQ(tip.getServoPosition(), start);
+
+        // Turning the limits off jumps straight to the targets
+        fingers[FINGER_INDEX].setFlexion(fingers[FINGER_INDEX].getFlexionMin());
+        tickHand();
+        CHECK(fingers[FINGER_INDEX].getFlexionPosition() != fingers[FINGER_INDEX].getFlexionMin());
+        setMotionLimiting(false);
+        CHECK_EQ(fingers[FINGER_INDEX].getFlexionPosition(), fingers[FINGER_INDEX].getFlexionMin());
+        CHECK(!isMotionLimiting());
+    }
+}
+
+int main() {
+    setupServos();
+
+    testUnlimitedFollowsImmediately();
+    testVelocityLimit();
+    testVelocityAndAccelerationLimits();
+    testSmallStepDoesNotHunt();
+    testReversalMidMove();
+    testDisablingLimitsSnaps();
+    testHandTicksOnlyMovingJoints();
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,119 @@
+// Replays a DOF stream captured on the hand (record:dump, see DofRecorder.h)
+// through the kinematics in simulation. The capture is loaded into the
+// recorder as if it had just arrived, and replayed through the same
+// recorder, stream and control tick code as on the hand, on the virtual
+// clock. Prints a CSV line for every control tick: the time since the replay
+// started, then every servo's position, so a glitch can be found and
+// stepped through. The stream counters go to stderr at the end.
+//
+// The capture can be a whole serial log, only the REC: lines are read.
+//
+// Usage: replay_dof <capture> [speed] [jitter delay ms]
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "DofRecorder.h"
+#include "DofStream.h"
+#include "Hand.h"
+
+namespace {
+
+    const uint32_t TICK_US = 1000000 / CONTROL_RATE_HZ;
+    const uint32_t SETTLE_US = 500000;      // Kept going after the last packet, for the joints to get there
+
+    int loadCapture(const char* path) {
+        FILE* file = fopen(path, "r");
+        if (file == nullptr) {
+            return -1;
+        }
+
+        int records = 0;
+        char line[256];
+        while (fgets(line, sizeof(line), file) != nullptr) {
+            uint32_t timeUs;
+            uint8_t packet[DOF_MAX_PACKET_LENGTH];
+            uint8_t length;
+            if (parseDofRecord(line, timeUs, packet, length)) {
+                hostsim::setMicros(timeUs);
+                recordDofPacket(packet, length);
+                records++;
+            }
+        }
+        fclose(file);
+        return records;
+    }
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <capture> [speed] [jitter delay ms]\n", argv[0]);
+        return 1;
+    }
+    long speed = argc > 2 ? strtol(argv[2], nullptr, 10) : 1;
+    long jitterMs = argc > 3 ? strtol(argv[3], nullptr, 10) : DOF_JITTER_DELAY_MS;
+
+    setupServos();
+    setDefaultPose();
+    setDofJitterDelay(static_cast<uint16_t>(jitterMs < 0 ? 0 : jitterMs > JITTER_MAX_DELAY_MS ? JITTER_MAX_DELAY_MS : jitterMs));
+
+    int records = loadCapture(argv[1]);
+    if (records < 0) {
+        fprintf(stderr, "Can't open %s\n", argv[1]);
+        return 1;
+    }
+    if (records == 0 || static_cast<uint32_t>(records) != getDofRecordCount()) {
+        fprintf(stderr, "%d records in %s, %lu kept\n", records, argv[1], static_cast<unsigned long>(getDofRecordCount()));
+        if (records == 0) {
+            return 1;
+        }
+    }
+    setDofRecording(false);
+
+    // The recorder's task runs every 1ms on the hand
+    hostsim::setMicros(0);
+    requestDofReplay(static_cast<uint8_t>(speed < 1 ? 1 : speed > DOF_REPLAY_MAX_SPEED ? DOF_REPLAY_MAX_SPEED : speed));
+    runDofRecorder();
+
+    printf("time_us");
+    for (int servo = 0; servo < NUM_SERVOS; servo++) {
+        printf(",servo%d", servo);
+    }
+    printf("\n");
+
+    uint32_t nextTickUs = 0;
+    uint32_t finishedUs = 0;
+    bool finished = false;
+    while (!finished || hostsim::nowMicros() < finishedUs + SETTLE_US) {
+        uint32_t nowUs = static_cast<uint32_t>(hostsim::nowMicros());
+        runDofRecorder();
+        if (!finished && getDofRecorderActivity() == DOF_RECORDER_IDLE) {
+            finished = true;
+            finishedUs = nowUs;
+        }
+
+        if (nowUs >= nextTickUs) {
+            controlTick();
+            nextTickUs += TICK_US;
+
+            printf("%lu", static_cast<unsigned long>(nowUs));
+            for (int servo = 0; servo < NUM_SERVOS; servo++) {
+                printf(",%u", managedServos[servo].getServoPosition());
+            }
+            printf("\n");
+        }
+        hostsim::advanceMicros(1000);
+    }
+
+    fprintf(stderr, "Replayed %lu of %d records in %.3fs at %ldx\n", static_cast<unsigned long>(getDofRecordsReplayed()),
+        records, finishedUs / 1e6, speed);
+    fprintf(stderr, "  received:%lu badlength:%lu badchecksum:%lu badversion:%lu lost:%lu stale:%lu deltas:%lu deltasdropped:%lu\n",
+        static_cast<unsigned long>(getDofPacketsReceived()), static_cast<unsigned long>(getDofPacketsBadLength()),
+        static_cast<unsigned long>(getDofPacketsBadChecksum()), static_cast<unsigned long>(getDofPacketsBadVersion()),
+        static_cast<unsigned long>(getDofFramesLost()), static_cast<unsigned long>(getDofFramesStale()),
+        static_cast<unsigned long>(getDofDeltaFrames()), static_cast<unsigned long>(getDofDeltasDropped()));
+    fprintf(stderr, "  jitter played:%lu underruns:%lu overflows:%lu late:%lu\n",
+        static_cast<unsigned long>(dofJitterBuffer.getPlayed()), static_cast<unsigned long>(dofJitterBuffer.getUnderruns()),
+        static_cast<unsigned long>(dofJitterBuffer.getOverflows()), static_cast<unsigned long>(dofJitterBuffer.getLate()));
+    return 0;
+}
@@ -15,7 +15,7 @@ from bleak.backends.characteristic import BleakGATTCharacteristic
 from bleak.backends.device import BLEDevice
 from bleak.backends.scanner import AdvertisementData
 
-import json
+from dof_protocol import DofEncoder, parse_descriptor
 
 
 # Constants and controls - see the README.md file for details
@@ -24,8 +24,9 @@ JOINT_DEADBAND = 0  # Number of degrees to ignore for joint movement to help set
 # Connection flag - set to True when connected to hand
 hand_connected = False
 
-# DOF table - ultimately this will be retrieved from the hand, but for now we're just using the string you can request from the firmware
-dof_table = json.loads('[ { "name": "index_pitch", "range": [0, 40] }, { "name": "index_yaw", "range": [-20, 20] }, { "name": "index_flexion", "range": [0, 100] }, { "name": "middle_pitch", "range": [0, 40] }, { "name": "middle_yaw", "range": [-20, 20] }, { "name": "middle_flexion", "range": [0, 100] }, { "name": "ring_pitch", "range": [0, 40] }, { "name": "ring_yaw", "range": [-20, 20] }, { "name": "ring_flexion", "range": [0, 100] }, { "name": "pinky_pitch", "range": [0, 40] }, { "name": "pinky_yaw", "range": [-20, 20] }, { "name": "pinky_flexion", "range": [0, 100] }, { "name": "thumb_pitch", "range": [30, 60] }, { "name": "thumb_yaw", "range": [0, 45] }, { "name": "thumb_flexion", "range": [0, 45] }, { "name": "wrist_pitch", "range": [-40, 40] }, { "name": "wrist_yaw", "range": [-40, 40] } ]')
+# DOF table - names and ranges of the DOFs in the order they are streamed, read
+# from the hand's DOF descriptor characteristic once connected
+dof_table = []
      
 # User function - this is where you can do things with the joint angles
 # Don't forget to yield periodically to allow the bluetooth communication to run
@@ -76,6 +77,7 @@ UART_TX_CHAR_UUID = "6E400003-B5A3-F393-E0A9-E50E24DCCA9E"
 
 DOF_SERVICE_UUID = "1e16c1b4-1936-4f0e-ab62-5e0a702a4935"
 DOF_CHAR_UUID = "1e16c1b5-1936-4f0e-ab62-5e0a702a4935"
+DOF_DESCRIPTOR_CHAR_UUID = "1e16c1b6-1936-4f0e-ab62-5e0a702a4935"
 
 # Main BLE communication task       
 async def ble_communication(tx_queue):
@@ -128,6 +130,11 @@ async def ble_communication(tx_queue):
     async with BleakClient(device, disconnected_callback=handle_disconnect) as client:
         await client.start_notify(UART_TX_CHAR_UUID, handle_rx)
 
+        # The hand describes its DOFs - read them before the angles task starts using them
+        global dof_table
+        dof_table = parse_descriptor(await client.read_gatt_char(DOF_DESCRIPTOR_CHAR_UUID))
+        print("DOFs:", ", ".join(dof["name"] for dof in dof_table))
+
         global hand_connected
         hand_connected = True
 
@@ -141,6 +148,12 @@ async def ble_communication(tx_queue):
         dof_service = client.services.get_service(DOF_SERVICE_UUID)
         dof_char = dof_service.get_characteristic(DOF_CHAR_UUID)
 
+        # Version 2 frames carry full precision angles and sequence numbers, and
+        # only the joints that changed are sent between keyframes, but they don't
+        # fit in the default MTU. Fall back to version 1 frames if needed.
+        dof_encoder = DofEncoder(client.mtu_size)
+        print("DOF protocol version", dof_encoder.version, "(MTU", str(client.mtu_size) + ")")
+
         # Schedule a timer to send a heartbeat message to the hand every 3 seconds via UART. 
         # The Arduino firmware auto-disconnects if it doesn't receive a periodic heartbeat
         # in order to prevent it from getting hung up on a connection that is left open.
@@ -155,10 +168,6 @@ async def ble_communication(tx_queue):
 
         asyncio.create_task(send_heartbeat())
 
-        # Send a request to the hand to send the DOF table
-        print("Requesting DOF table from hand...")
-        await client.write_gatt_char(rx_char, "dofs\n".encode(), True)
-        
         try:
             previous_angles = await tx_queue.get()
 
@@ -180,20 +189,13 @@ async def ble_communication(tx_queue):
                 previous_angles = joint_angles
                 
 
-                # Encode the joint angles into 8-bit integers. We scale everything to 0-255
-                # to represent -180 to 180 degrees with 128 as the zero point.
-                clipped = np.clip(joint_angles, -180, 180)
-                scaled = np.interp(clipped, (-180, 180), (0, 255))
-                encoded = scaled.astype(np.uint8)
-
-                data = bytearray(encoded)
-
-                # Add a checksum to the data
-                checksum = sum(data) % 256
-                data.append(checksum)
+                # Encode the joint angles for the protocol version picked at connection
+                # Nothing is sent if no joint has moved since the last frame
+                data = dof_encoder.encode(joint_angles)
                 
                 # Send the joint angles to the hand without response as it's faster
-                await client.write_gatt_char(dof_char, data)
+                if data is not None:
+                    await client.write_gatt_char(dof_char, data)
 
                 # Yield
                 await asyncio.sleep(0)
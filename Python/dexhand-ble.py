@@ -20,6 +20,8 @@ from bleak.backends.characteristic import BleakGATTCharacteristic
 from bleak.backends.device import BLEDevice
 from bleak.backends.scanner import AdvertisementData
 
+from dof_protocol import DofEncoder
+
 # Constants and controls - see the README.md file for details
 NUM_DOFS = 17       # Number of DOF's transmitted to hand
 JOINT_DEADBAND = 2  # Number of degrees to ignore for joint movement to help settle noise from MediaPipe
@@ -334,6 +336,12 @@ async def ble_communication(tx_queue):
         dof_service = client.services.get_service(DOF_SERVICE_UUID)
         dof_char = dof_service.get_characteristic(DOF_CHAR_UUID)
 
+        # Version 2 frames carry full precision angles and sequence numbers, and
+        # only the joints that changed are sent between keyframes, but they don't
+        # fit in the default MTU. Fall back to version 1 frames if needed.
+        dof_encoder = DofEncoder(client.mtu_size)
+        print("DOF protocol version", dof_encoder.version, "(MTU", str(client.mtu_size) + ")")
+
         # Schedule a timer to send a heartbeat message to the hand every 3 seconds via UART. 
         # The Arduino firmware auto-disconnects if it doesn't receive a periodic heartbeat
         # in order to prevent it from getting hung up on a connection that is left open.
@@ -367,21 +375,13 @@ async def ble_communication(tx_queue):
                 previous_angles = joint_angles
                 
 
-                # Encode the joint angles into 8-bit integers. We scale everything to 0-255
-                # to represent -180 to 180 degrees with 128 as the zero point.
-                clipped = np.clip(joint_angles, -180, 180)
-                scaled = np.interp(clipped, (-180, 180), (0, 255))
-                encoded = scaled.astype(np.uint8)
-
-                
-                data = bytearray(encoded)
-                
-                # Add a checksum to the data
-                checksum = sum(data) % 256
-                data.append(checksum)
+                # Encode the joint angles for the protocol version picked at connection
+                # Nothing is sent if no joint has moved since the last frame
+                data = dof_encoder.encode(joint_angles)
                 
                 # Send the joint angles to the hand without response as it's faster
-                await client.write_gatt_char(dof_char, data)
+                if data is not None:
+                    await client.write_gatt_char(dof_char, data)
 
                 # Yield
                 await asyncio.sleep(0)
@@ -0,0 +1,187 @@
+# dof_protocol.py
+#
+# Encoders for the frames written to the DexHand DOF characteristic. The wire
+# format is documented in Arduino/DexHand-RP2040-BLE/DofProtocol.h.
+#
+# Version 1 packs each angle into 8 bits with an additive checksum. Version 2
+# sends hundredths of a degree with a sequence number, a timestamp and a
+# CRC-16, but needs a 44 byte write, so it's only used when the negotiated
+# MTU allows it. Delta frames send only the DOFs that changed, between
+# periodic version 2 keyframes.
+
+import struct
+import time
+
+import numpy as np
+
+
+DOF_COUNT = 17
+
+PROTOCOL_V1 = 1
+PROTOCOL_V2 = 2
+PROTOCOL_DELTA = 3
+
+ALL_MASK = (1 << DOF_COUNT) - 1
+
+V1_PACKET_LENGTH = DOF_COUNT + 1
+V2_PACKET_LENGTH = 8 + 2 * DOF_COUNT + 2
+DELTA_HEADER_LENGTH = 8 + 3
+
+KEYFRAME_INTERVAL = 30      # Frames between keyframes, about a second from the camera
+
+ATT_HEADER_LENGTH = 3
+
+
+def _make_crc16_table():
+    table = []
+    for byte in range(256):
+        crc = byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if (crc & 0x8000) else (crc << 1)
+        table.append(crc & 0xFFFF)
+    return table
+
+_CRC16_TABLE = _make_crc16_table()
+
+
+def crc16(data):
+    """CRC-16/CCITT-FALSE, the same as crc16() in the firmware."""
+    crc = 0xFFFF
+    for byte in data:
+        crc = ((crc << 8) & 0xFFFF) ^ _CRC16_TABLE[((crc >> 8) ^ byte) & 0xFF]
+    return crc
+
+
+def encode_v1(joint_angles):
+    """Packs angles in degrees into the legacy 8-bit frame."""
+    # Scale -180 to 180 degrees onto 0-255 with 127 as the zero point
+    clipped = np.clip(joint_angles, -180, 180)
+    scaled = np.interp(clipped, (-180, 180), (0, 255))
+    data = bytearray(scaled.astype(np.uint8))
+
+    data.append(sum(data) % 256)
+    return data
+
+
+def to_centidegrees(joint_angles):
+    return np.clip(np.round(np.asarray(joint_angles, dtype=float) * 100), -32768, 32767).astype(np.int16).tolist()
+
+
+def _header(version, sequence, timestamp_us):
+    if timestamp_us is None:
+        timestamp_us = time.monotonic_ns() // 1000
+    return bytearray(struct.pack('<BBHI', version, DOF_COUNT, sequence & 0xFFFF, timestamp_us & 0xFFFFFFFF))
+
+
+def encode_v2(joint_angles, sequence, timestamp_us=None):
+    """Packs angles in degrees into a version 2 frame."""
+    data = _header(PROTOCOL_V2, sequence, timestamp_us)
+    data += struct.pack('<%dh' % DOF_COUNT, *to_centidegrees(joint_angles))
+
+    data += struct.pack('<H', crc16(data))
+    return data
+
+
+def encode_delta(joint_angles, mask, sequence, timestamp_us=None):
+    """Packs the angles in degrees of the DOFs in the mask into a delta frame."""
+    centidegrees = to_centidegrees(joint_angles)
+
+    data = _header(PROTOCOL_DELTA, sequence, timestamp_us)
+    data += struct.pack('<I', mask & ALL_MASK)[:3]
+    for i in range(DOF_COUNT):
+        if mask & (1 << i):
+            data += struct.pack('<h', centidegrees[i])
+
+    data += struct.pack('<H', crc16(data))
+    return data
+
+
+DESCRIPTOR_VERSION = 1
+
+
+def parse_descriptor(data):
+    """Decodes the DOF descriptor characteristic into a list of DOFs in wire
+    order, each a dict with name, joint, axis and range in degrees. The format
+    is documented in Arduino/DexHand-RP2040-BLE/DofRegistry.h."""
+    data = bytes(data)
+    if len(data) < 2 or data[0] != DESCRIPTOR_VERSION:
+        raise ValueError("Unsupported DOF descriptor")
+
+    dofs = []
+    position = 2
+    for _ in range(data[1]):
+        joint, axis, minimum, maximum, length = struct.unpack_from('<BBhhB', data, position)
+        position += 7
+        name = data[position:position + length].decode("ascii")
+        position += length
+        dofs.append({ "name": name, "joint": joint, "axis": axis, "range": [minimum, maximum] })
+
+    if len(dofs) != DOF_COUNT or position != len(data):
+        raise ValueError("Malformed DOF descriptor")
+    return dofs
+
+
+class DofEncoder:
+    """Picks the protocol version for a connection and numbers the frames.
+
+    With version 2, DOFs that moved less than deadband degrees since they were
+    last sent are left out, and encode() returns None if there's nothing to
+    send. This matches DofDeltaEncoder in the firmware's DofProtocol.h.
+    """
+
+    def __init__(self, mtu_size, deadband=1.0, keyframe_interval=KEYFRAME_INTERVAL):
+        self.version = PROTOCOL_V2 if mtu_size - ATT_HEADER_LENGTH >= V2_PACKET_LENGTH else PROTOCOL_V1
+        self.deadband = int(round(deadband * 100))
+        self.keyframe_interval = keyframe_interval
+        self.sequence = 0
+        self.since_keyframe = 0
+        self.sent = None
+
+    def reset(self):
+        """Forces a keyframe next time."""
+        self.sent = None
+
+    def encode(self, joint_angles):
+        if self.version == PROTOCOL_V1:
+            return encode_v1(joint_angles)
+
+        centidegrees = to_centidegrees(joint_angles)
+        mask = ALL_MASK
+        if self.sent is not None:
+            self.since_keyframe += 1
+            if self.since_keyframe < self.keyframe_interval:
+                mask = 0
+                for i in range(DOF_COUNT):
+                    if abs(centidegrees[i] - self.sent[i]) > self.deadband:
+                        mask |= 1 << i
+                if mask == 0:
+                    return None
+
+        # A delta is only worth sending if it's smaller than a keyframe
+        count = bin(mask).count("1")
+        if mask == ALL_MASK or DELTA_HEADER_LENGTH + 2 * count + 2 >= V2_PACKET_LENGTH:
+            data = encode_v2(joint_angles, self.sequence)
+            mask = ALL_MASK
+            self.sent = list(centidegrees)
+            self.since_keyframe = 0
+        else:
+            data = encode_delta(joint_angles, mask, self.sequence)
+            for i in range(DOF_COUNT):
+                if mask & (1 << i):
+                    self.sent[i] = centidegrees[i]
+
+        self.sequence = (self.sequence + 1) & 0xFFFF
+        return data
+
+
+if __name__ == "__main__":
+    # Check value for CRC-16/CCITT-FALSE
+    assert crc16(b"123456789") == 0x29B1
+    assert len(encode_v1([0] * DOF_COUNT)) == V1_PACKET_LENGTH
+    assert len(encode_v2([0] * DOF_COUNT, 0, 0)) == V2_PACKET_LENGTH
+    assert len(encode_delta([0] * DOF_COUNT, 0b101, 0, 0)) == DELTA_HEADER_LENGTH + 2 * 2 + 2
+    descriptor = bytes([DESCRIPTOR_VERSION, DOF_COUNT])
+    for i in range(DOF_COUNT):
+        descriptor += struct.pack('<BBhhB', 0, i % 3, -20, 20, 4) + b"d%03d" % i
+    assert parse_descriptor(descriptor)[16] == { "name": "d016", "joint": 0, "axis": 1, "range": [-20, 20] }
+    print("OK")
@@ -0,0 +1,135 @@
+# log_decoder.py
+#
+# Turns the DexHand's binary log back into text. After log:binary the
+# firmware prints each log record as a short frame holding just the message
+# id, the time and the arguments (see Arduino/DexHand-RP2040-BLE/Log.h), mixed
+# in with the ordinary text output. The formats are read from LogMessages.h,
+# so the decoder always matches the firmware it's built from.
+#
+# Decode a capture of the serial output to stdout:
+#
+#   python log_decoder.py capture.bin
+#
+# or read a serial port directly, which needs pyserial:
+#
+#   python log_decoder.py --port /dev/ttyACM0
+
+import argparse
+import os
+import re
+import struct
+import sys
+
+
+FRAME_SYNC = 0xFE
+LEVEL_LETTERS = {'OFF': '-', 'ERROR': 'E', 'WARN': 'W', 'INFO': 'I', 'DEBUG': 'D'}
+
+MESSAGES_PATH = os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                             '..', 'Arduino', 'DexHand-RP2040-BLE', 'LogMessages.h')
+
+MESSAGE_PATTERN = re.compile(r'^LOG_MESSAGE\((\w+),\s*LOG_MODULE_(\w+),\s*LOG_LEVEL_(\w+),\s*"(.*)"\)\s*$')
+SPEC_PATTERN = re.compile(r'%([dusx%])')
+
+
+def load_messages(path=MESSAGES_PATH):
+    """Reads the message table, a list of (name, module, level letter, format) by id."""
+    messages = []
+    with open(path) as f:
+        for line in f:
+            match = MESSAGE_PATTERN.match(line.strip())
+            if match:
+                name, module, level, fmt = match.groups()
+                messages.append((name, module.lower(), LEVEL_LETTERS[level], fmt))
+    return messages
+
+
+def format_message(fmt, args, text):
+    """Fills a format in the way the firmware does, integers then the %s text."""
+    values = iter(args)
+
+    def replace(match):
+        spec = match.group(1)
+        if spec == '%':
+            return '%'
+        if spec == 's':
+            return text
+        value = next(values, 0)
+        if spec == 'd':
+            return str(value)
+        if spec == 'u':
+            return str(value & 0xFFFFFFFF)
+        return '%x' % (value & 0xFFFFFFFF)
+
+    return SPEC_PATTERN.sub(replace, fmt)
+
+
+def decode_frame(messages, body):
+    """Decodes the bytes after a frame's length into a line of text."""
+    message_id = body[0]
+    (time_us,) = struct.unpack_from('<I', body, 1)
+    if message_id >= len(messages):
+        return 'LOG:%d ? unknown message %d' % (time_us, message_id)
+
+    _, module, level, fmt = messages[message_id]
+    count = len([s for s in SPEC_PATTERN.findall(fmt) if s in 'dux'])
+    args = list(struct.unpack_from('<%di' % count, body, 5))
+    text = bytes(body[5 + 4 * count:]).decode('ascii', errors='replace')
+    return 'LOG:%d %s %s: %s' % (time_us, level, module, format_message(fmt, args, text))
+
+
+class LogDecoder:
+    """Splits a byte stream into text and frames, across any number of feeds."""
+
+    def __init__(self, messages=None):
+        self.messages = messages if messages is not None else load_messages()
+        self.pending = bytearray()
+
+    def feed(self, data):
+        """Returns the decoded text for as much of the stream as is complete."""
+        self.pending += data
+        out = []
+        while self.pending:
+            sync = self.pending.find(FRAME_SYNC)
+            if sync < 0:
+                out.append(self.pending.decode('ascii', errors='replace'))
+                self.pending.clear()
+                break
+            if sync > 0:
+                out.append(self.pending[:sync].decode('ascii', errors='replace'))
+                del self.pending[:sync]
+
+            # Wait for the rest of the frame
+            if len(self.pending) < 2 or len(self.pending) < 2 + self.pending[1]:
+                break
+            length = self.pending[1]
+            body = self.pending[2:2 + length]
+            del self.pending[:2 + length]
+            if length < 5:
+                continue
+            out.append(decode_frame(self.messages, body) + '\r\n')
+        return ''.join(out)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Decode the DexHand binary log')
+    parser.add_argument('capture', nargs='?', help='File of captured serial output')
+    parser.add_argument('--port', help='Serial port to read instead')
+    parser.add_argument('--baud', type=int, default=115200)
+    args = parser.parse_args()
+
+    decoder = LogDecoder()
+    if args.port:
+        import serial
+        with serial.Serial(args.port, args.baud) as port:
+            while True:
+                sys.stdout.write(decoder.feed(port.read(port.in_waiting or 1)))
+                sys.stdout.flush()
+    elif args.capture:
+        with open(args.capture, 'rb') as f:
+            sys.stdout.write(decoder.feed(f.read()))
+    else:
+        parser.print_help()
+
+
+if __name__ == "__main__":
+    main()
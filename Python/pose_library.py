@@ -0,0 +1,65 @@
+# pose_library.py
+#
+# Encoders for the binary pose commands written to the DexHand UART RX
+# characteristic. The format is documented in
+# Arduino/DexHand-RP2040-BLE/PoseLibrary.h.
+#
+# A sequence is a list of keyframes, each a duration in ms and one angle per
+# DOF in whole degrees. It's uploaded to one of the firmware's slots in
+# chunks that fit a 20 byte write, then committed with its length and CRC,
+# and played with two bytes from then on.
+
+import struct
+
+from dof_protocol import DOF_COUNT, crc16
+
+
+FORMAT_VERSION = 1
+MAX_KEYFRAMES = 16
+
+OP_PLAY = 0x80
+OP_QUEUE = 0x81
+OP_STOP = 0x82
+OP_UPLOAD = 0x83
+OP_COMMIT = 0x84
+
+UPLOAD_SLOTS = 4
+UPLOAD_FIRST_ID = 0x40
+UPLOAD_CHUNK = 16
+
+# Replies on the TX characteristic, "POSE:<result>"
+RESULTS = ['ok', 'bad length', 'unknown', 'out of order', 'bad checksum', 'bad format', 'busy']
+
+
+def encode_sequence(keyframes):
+    """Packs a list of (duration_ms, angles) keyframes into a sequence."""
+    if not 0 < len(keyframes) <= MAX_KEYFRAMES:
+        raise ValueError('A sequence has 1 to %d keyframes' % MAX_KEYFRAMES)
+
+    data = bytearray([FORMAT_VERSION, len(keyframes)])
+    for duration_ms, angles in keyframes:
+        if len(angles) != DOF_COUNT:
+            raise ValueError('A keyframe has %d angles' % DOF_COUNT)
+        data += struct.pack('<H%db' % DOF_COUNT, duration_ms, *[max(-128, min(127, round(a))) for a in angles])
+    return data
+
+
+def play_command(pose_id, queue=False):
+    return bytes([OP_QUEUE if queue else OP_PLAY, pose_id])
+
+
+def stop_command():
+    return bytes([OP_STOP])
+
+
+def upload_commands(slot, sequence):
+    """The writes that upload a sequence to a slot, ending with the commit."""
+    writes = []
+    for offset in range(0, len(sequence), UPLOAD_CHUNK):
+        writes.append(struct.pack('<BBH', OP_UPLOAD, slot, offset) + bytes(sequence[offset:offset + UPLOAD_CHUNK]))
+    writes.append(struct.pack('<BBHH', OP_COMMIT, slot, len(sequence), crc16(sequence)))
+    return writes
+
+
+def uploaded_id(slot):
+    return UPLOAD_FIRST_ID + slot